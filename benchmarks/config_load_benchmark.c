@@ -0,0 +1,278 @@
+/*
+ * Compare the time taken at startup to get the blob for a large configuration
+ * by parsing the JSON file, as the daemon used to do, and by mapping the cache
+ * written the last time the JSON was parsed. Either way the file is first read
+ * and hashed, as the daemon does to tell whether it has changed, and the
+ * interfaces in the blob are then visited, as loading the configuration does.
+ */
+#include "config_cache.h"
+#include "config_hash.h"
+
+#include <libubox/blobmsg.h>
+#include <libubox/blobmsg_json.h>
+#include <libubox/utils.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t
+now_usecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* A configuration like the example in the README for each interface. */
+static bool
+write_config(char const * const path, unsigned const count)
+{
+    FILE * const fp = fopen(path, "w");
+
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    fprintf(fp, "{\"interfaces\":{");
+    for (unsigned i = 0; i < count; i++)
+    {
+        fprintf(fp,
+                "%s\"tun%u\":{"
+                "\"success_condition\":\"all_tests_must_pass\","
+                "\"settling_delay_secs\":5,"
+                "\"passing_interval_secs\":900,"
+                "\"failing_interval_secs\":4,"
+                "\"pass_threshold\":3,"
+                "\"fail_threshold\":4,"
+                "\"response_timeout_secs\":16,"
+                "\"tests\":["
+                "{\"executable\":\"ping\",\"label\":\"Ping Google\",\"response_timeout_secs\":5,"
+                "\"params\":{\"hostname\":\"8.8.8.8\",\"count\":\"1\"}},"
+                "{\"executable\":\"ping\",\"label\":\"Ping alt. Google\",\"response_timeout_secs\":5,"
+                "\"params\":{\"hostname\":\"1.1.1.1\",\"count\":\"1\"}}],"
+                "\"recovery_tasks\":["
+                "{\"executable\":\"restart\",\"label\":\"Restart interface\","
+                "\"response_timeout_secs\":30,\"params\":{}}]}",
+                i > 0 ? "," : "",
+                i);
+    }
+    fprintf(fp, "}}\n");
+
+    return fclose(fp) == 0;
+}
+
+/* Read the file as the daemon does. The caller must free the contents. */
+static char *
+read_file(char const * const path, struct stat * const st)
+{
+    char * contents = NULL;
+    int const fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        goto done;
+    }
+
+    if (fstat(fd, st) < 0)
+    {
+        goto done;
+    }
+
+    contents = malloc(st->st_size + 1);
+    if (contents == NULL)
+    {
+        goto done;
+    }
+
+    size_t total = 0;
+    ssize_t len;
+
+    while (total < (size_t)st->st_size
+           && (len = read(fd, contents + total, st->st_size - total)) > 0)
+    {
+        total += len;
+    }
+    contents[total] = '\0';
+
+done:
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return contents;
+}
+
+static unsigned
+count_interfaces(struct blob_attr * const config)
+{
+    static const struct blobmsg_policy policy =
+        { .name = "interfaces", .type = BLOBMSG_TYPE_TABLE };
+    struct blob_attr * interfaces;
+    struct blob_attr * cur;
+    size_t rem;
+    unsigned count = 0;
+
+    blobmsg_parse(&policy, 1, &interfaces, blob_data(config), blob_len(config));
+    blobmsg_for_each_attr(cur, interfaces, rem)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+static bool
+run_benchmark(char const * const path, unsigned const count, unsigned const rounds)
+{
+    char cache_path[PATH_MAX];
+    unsigned counted = 0;
+
+    snprintf(cache_path, sizeof(cache_path), "%s.cache", path);
+    if (!write_config(path, count))
+    {
+        fprintf(stderr, "unable to write %s\n", path);
+        return false;
+    }
+
+    uint64_t const json_start = now_usecs();
+
+    for (unsigned i = 0; i < rounds; i++)
+    {
+        struct stat st;
+        char * const contents = read_file(path, &st);
+
+        if (contents == NULL)
+        {
+            fprintf(stderr, "unable to read %s\n", path);
+            return false;
+        }
+
+        uint64_t const hash = config_content_hash(contents, strlen(contents));
+        struct blob_buf b = { 0 };
+
+        blob_buf_init(&b, 0);
+        blobmsg_add_json_from_string(&b, contents);
+        counted += count_interfaces(b.head);
+        if (i == 0)
+        {
+            config_cache_write(path, &st, hash, b.head);
+        }
+        blob_buf_free(&b);
+        free(contents);
+    }
+
+    uint64_t const json_usecs = now_usecs() - json_start;
+    uint64_t const cache_start = now_usecs();
+
+    for (unsigned i = 0; i < rounds; i++)
+    {
+        struct stat st;
+        char * const contents = read_file(path, &st);
+
+        if (contents == NULL)
+        {
+            fprintf(stderr, "unable to read %s\n", path);
+            return false;
+        }
+
+        uint64_t const hash = config_content_hash(contents, strlen(contents));
+        config_cache_st cache;
+
+        free(contents);
+        if (!config_cache_open(&cache, path, &st, hash))
+        {
+            fprintf(stderr, "unable to open the cache for %s\n", path);
+            return false;
+        }
+        counted += count_interfaces(config_cache_blob(&cache));
+        config_cache_close(&cache);
+    }
+
+    uint64_t const cache_usecs = now_usecs() - cache_start;
+
+    printf("%-12u %14.2f %14.2f %10.1f\n",
+           count,
+           (double)json_usecs / rounds / 1000,
+           (double)cache_usecs / rounds / 1000,
+           (double)json_usecs / (cache_usecs > 0 ? cache_usecs : 1));
+
+    unlink(cache_path);
+    unlink(path);
+
+    return counted == 2 * rounds * count;
+}
+
+static void
+usage(FILE * const fp, char const * const progname)
+{
+    fprintf(fp, "Usage: %s [options]\n"
+            "Options:\n"
+            " -i <count>: Number of interfaces (default 1000 and then 10000)\n"
+            " -r <count>: Number of times to load the configuration (default 10)\n"
+            " -f <path>:  Configuration file to write (default /tmp/config_load_benchmark.json)\n"
+            "\n",
+            progname);
+}
+
+int
+main(int const argc, char * * const argv)
+{
+    unsigned counts[] = { 1000, 10000 };
+    size_t num_counts = ARRAY_SIZE(counts);
+    unsigned rounds = 10;
+    char const * path = "/tmp/config_load_benchmark.json";
+    int ch;
+
+    while ((ch = getopt(argc, argv, "i:r:f:")) != -1)
+    {
+        switch (ch)
+        {
+        case 'i':
+            counts[0] = strtoul(optarg, NULL, 0);
+            num_counts = 1;
+            break;
+
+        case 'r':
+            rounds = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'f':
+            path = optarg;
+            break;
+
+        default:
+            usage(stderr, argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (counts[0] == 0 || rounds == 0)
+    {
+        usage(stderr, argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-12s %14s %14s %10s\n", "interfaces", "json_msecs", "cache_msecs", "speedup");
+
+    for (size_t i = 0; i < num_counts; i++)
+    {
+        if (!run_benchmark(path, counts[i], rounds))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
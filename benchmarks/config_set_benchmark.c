@@ -0,0 +1,322 @@
+/*
+ * Measure how long it takes a running interface tester to change the
+ * configuration of some of its interfaces when many interfaces are
+ * configured: one at a time with config_set, a batch at a time with
+ * config_bulk, and by sending the whole configuration again with config,
+ * which has every interface compared with its existing configuration. The
+ * interfaces are added with config_bulk, and removed again afterwards.
+ */
+#include <libubox/blobmsg.h>
+#include <libubox/utils.h>
+#include <libubus.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCHMARK_TIMEOUT_MSECS 60000
+#define BENCHMARK_BATCH_SIZE 1000
+
+static uint64_t
+now_usecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void
+add_interface_config(struct blob_buf * const b, char const * const name, uint32_t const interval)
+{
+    void * const iface_cky = blobmsg_open_table(b, name);
+
+    blobmsg_add_string(b, "success_condition", "all_tests_must_pass");
+    blobmsg_add_u32(b, "settling_delay_secs", 5);
+    blobmsg_add_u32(b, "passing_interval_secs", interval);
+    blobmsg_add_u32(b, "failing_interval_secs", 4);
+    blobmsg_add_u32(b, "pass_threshold", 3);
+    blobmsg_add_u32(b, "fail_threshold", 4);
+    blobmsg_add_u32(b, "response_timeout_secs", 16);
+    blobmsg_add_u32(b, "failing_tests_metrics_increase", 1);
+
+    void * const tests_cky = blobmsg_open_array(b, "tests");
+    void * const test_cky = blobmsg_open_table(b, NULL);
+
+    blobmsg_add_string(b, "executable", "ping");
+    blobmsg_add_string(b, "label", "Ping Google");
+    blobmsg_close_table(b, blobmsg_open_table(b, "params"));
+    blobmsg_close_table(b, test_cky);
+    blobmsg_close_array(b, tests_cky);
+    blobmsg_close_array(b, blobmsg_open_array(b, "recovery_tasks"));
+
+    blobmsg_close_table(b, iface_cky);
+}
+
+static void
+interface_name(char * const name, size_t const size, unsigned const i)
+{
+    snprintf(name, size, "bench%u", i);
+}
+
+/* The interfaces are only configured, never connected, so no tests are run. */
+static void
+build_config(struct blob_buf * const b, unsigned const count, uint32_t const first_interval)
+{
+    char name[32];
+
+    blob_buf_init(b, 0);
+
+    void * const interfaces_cky = blobmsg_open_table(b, "interfaces");
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        interface_name(name, sizeof(name), i);
+        add_interface_config(b, name, i == 0 ? first_interval : 900);
+    }
+
+    blobmsg_close_table(b, interfaces_cky);
+}
+
+static void
+build_config_set(struct blob_buf * const b, uint32_t const interval)
+{
+    blob_buf_init(b, 0);
+    blobmsg_add_string(b, "interface", "bench0");
+    add_interface_config(b, "config", interval);
+}
+
+static void
+build_config_bulk(
+    struct blob_buf * const b,
+    unsigned const first,
+    unsigned const count,
+    uint32_t const interval,
+    bool const delete)
+{
+    char name[32];
+
+    blob_buf_init(b, 0);
+
+    void * const cky = delete ? blobmsg_open_array(b, "delete") : blobmsg_open_table(b, "set");
+
+    for (unsigned i = first; i < first + count; i++)
+    {
+        interface_name(name, sizeof(name), i);
+        if (delete)
+        {
+            blobmsg_add_string(b, NULL, name);
+        }
+        else
+        {
+            add_interface_config(b, name, interval);
+        }
+    }
+
+    if (delete)
+    {
+        blobmsg_close_array(b, cky);
+    }
+    else
+    {
+        blobmsg_close_table(b, cky);
+    }
+}
+
+static bool
+invoke(
+    struct ubus_context * const ubus,
+    uint32_t const id,
+    char const * const method,
+    struct blob_buf const * const b,
+    uint64_t * const usecs)
+{
+    uint64_t const start = now_usecs();
+    int const res = ubus_invoke(ubus, id, method, b->head, NULL, NULL, BENCHMARK_TIMEOUT_MSECS);
+
+    *usecs = now_usecs() - start;
+    if (res != UBUS_STATUS_OK)
+    {
+        fprintf(stderr, "%s failed: %s\n", method, ubus_strerror(res));
+    }
+
+    return res == UBUS_STATUS_OK;
+}
+
+/* Add or remove all of the interfaces, in batches that fit in a ubus message. */
+static bool
+bulk_all(
+    struct ubus_context * const ubus,
+    uint32_t const id,
+    struct blob_buf * const b,
+    unsigned const count,
+    bool const delete,
+    uint64_t * const usecs)
+{
+    bool success = true;
+    uint64_t usecs_total = 0;
+
+    for (unsigned first = 0; success && first < count; first += BENCHMARK_BATCH_SIZE)
+    {
+        uint64_t batch_usecs;
+        unsigned const batch =
+            count - first < BENCHMARK_BATCH_SIZE ? count - first : BENCHMARK_BATCH_SIZE;
+
+        build_config_bulk(b, first, batch, 900, delete);
+        success = invoke(ubus, id, "config_bulk", b, &batch_usecs);
+        usecs_total += batch_usecs;
+    }
+
+    *usecs = usecs_total;
+
+    return success;
+}
+
+static void
+usage(FILE * const fp, char const * const progname)
+{
+    fprintf(fp, "Usage: %s [options]\n"
+            "Options:\n"
+            " -s <path>:  Path to the ubus socket\n"
+            " -i <count>: Number of interfaces (default 10000)\n"
+            " -r <count>: Number of calls to time with each method (default 20)\n"
+            " -b <count>: Number of interfaces changed by each config_bulk call (default 100)\n"
+            "\n",
+            progname);
+}
+
+int
+main(int const argc, char * * const argv)
+{
+    char const * ubus_socket = NULL;
+    unsigned count = 10000;
+    unsigned rounds = 20;
+    unsigned deltas = 100;
+    int exit_code = EXIT_FAILURE;
+    struct blob_buf b = { 0 };
+    uint32_t id;
+    uint64_t usecs;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "s:i:r:b:")) != -1)
+    {
+        switch (ch)
+        {
+        case 's':
+            ubus_socket = optarg;
+            break;
+
+        case 'i':
+            count = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'r':
+            rounds = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'b':
+            deltas = strtoul(optarg, NULL, 0);
+            break;
+
+        default:
+            usage(stderr, argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (count == 0 || rounds == 0 || deltas == 0)
+    {
+        usage(stderr, argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct ubus_context * const ubus = ubus_connect(ubus_socket);
+
+    if (ubus == NULL || ubus_lookup_id(ubus, "interface.tester", &id) != UBUS_STATUS_OK)
+    {
+        fprintf(stderr, "unable to find interface.tester on ubus\n");
+        goto done;
+    }
+
+    if (!bulk_all(ubus, id, &b, count, false, &usecs))
+    {
+        goto done;
+    }
+    printf("%u interfaces\n", count);
+    printf("%-32s %10.1f\n", "config_bulk load msecs:", (double)usecs / 1000);
+
+    /* Change the passing interval of the first interface each time. */
+    uint64_t config_set_usecs = 0;
+
+    for (unsigned i = 0; i < rounds; i++)
+    {
+        build_config_set(&b, 300 + i % 2);
+        if (!invoke(ubus, id, "config_set", &b, &usecs))
+        {
+            goto done;
+        }
+        config_set_usecs += usecs;
+    }
+    printf("%-32s %10.2f\n",
+           "config_set msecs per change:", (double)config_set_usecs / rounds / 1000);
+
+    uint64_t config_bulk_usecs = 0;
+
+    deltas = deltas < count ? deltas : count;
+    for (unsigned i = 0; i < rounds; i++)
+    {
+        build_config_bulk(&b, 0, deltas, 600 + i % 2, false);
+        if (!invoke(ubus, id, "config_bulk", &b, &usecs))
+        {
+            goto done;
+        }
+        config_bulk_usecs += usecs;
+    }
+    printf("%-32s %10.2f (%u changes each)\n",
+           "config_bulk msecs per call:", (double)config_bulk_usecs / rounds / 1000, deltas);
+
+    /* The whole configuration may be too big for a single ubus message. */
+    build_config(&b, count, 900);
+    if (blob_pad_len(b.head) > UBUS_MAX_MSGLEN)
+    {
+        printf("%-32s too big to send (%zu bytes)\n",
+               "config msecs per change:", blob_pad_len(b.head));
+    }
+    else
+    {
+        uint64_t config_usecs = 0;
+
+        for (unsigned i = 0; i < rounds; i++)
+        {
+            build_config(&b, count, 120 + i % 2);
+            if (!invoke(ubus, id, "config", &b, &usecs))
+            {
+                goto done;
+            }
+            config_usecs += usecs;
+        }
+        printf("%-32s %10.2f\n",
+               "config msecs per change:", (double)config_usecs / rounds / 1000);
+    }
+
+    if (!bulk_all(ubus, id, &b, count, true, &usecs))
+    {
+        goto done;
+    }
+    printf("%-32s %10.1f\n", "config_bulk remove msecs:", (double)usecs / 1000);
+
+    exit_code = EXIT_SUCCESS;
+
+done:
+    blob_buf_free(&b);
+    if (ubus != NULL)
+    {
+        ubus_free(ubus);
+    }
+
+    return exit_code;
+}
@@ -0,0 +1,199 @@
+/*
+ * Measure how many events per second each interface's event queue can handle,
+ * and how long events wait to be handled, when events arrive in bursts (as
+ * they do when several tests complete in the same loop iteration) and the
+ * handlers raise further events of their own (as the tester does when a test
+ * run ends).
+ */
+#include "event_queue.h"
+
+#include <libubox/uloop.h>
+#include <libubox/utils.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct benchmark_interface_st
+{
+    event_q_st event_queue;
+    uint64_t handled;
+} benchmark_interface_st;
+
+typedef struct benchmark_st
+{
+    benchmark_interface_st * interfaces;
+    unsigned num_interfaces;
+    unsigned burst;
+    unsigned rounds;
+    unsigned round;
+    uint64_t outstanding;
+    timer_st round_timer;
+} benchmark_st;
+
+static benchmark_st benchmark;
+
+static uint64_t
+now_usecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void
+event_handler(void * const event_ctx, tester_event_t const event)
+{
+    benchmark_interface_st * const iface = event_ctx;
+
+    iface->handled++;
+    benchmark.outstanding--;
+
+    /* A passed test ends the test run and starts the interval timer. */
+    if (event == TESTER_EVENT_TEST_PASSED)
+    {
+        benchmark.outstanding++;
+        event_queue_add_event(
+            &iface->event_queue, event_handler, iface, TESTER_EVENT_INTERVAL_TIMER_ELAPSED);
+    }
+
+    if (benchmark.outstanding == 0 && benchmark.round == benchmark.rounds)
+    {
+        uloop_end();
+    }
+}
+
+static void
+round_timer_expired(timer_st * const t)
+{
+    for (unsigned i = 0; i < benchmark.num_interfaces; i++)
+    {
+        benchmark_interface_st * const iface = &benchmark.interfaces[i];
+
+        for (unsigned j = 0; j < benchmark.burst; j++)
+        {
+            tester_event_t const event =
+                j % 2 == 0 ? TESTER_EVENT_TEST_PASSED : TESTER_EVENT_TEST_FAILED;
+
+            benchmark.outstanding++;
+            event_queue_add_event(&iface->event_queue, event_handler, iface, event);
+        }
+    }
+
+    benchmark.round++;
+    if (benchmark.round < benchmark.rounds)
+    {
+        timer_start(t, 0);
+    }
+}
+
+static void
+usage(FILE * const fp, char const * const progname)
+{
+    fprintf(fp, "Usage: %s [options]\n"
+            "Options:\n"
+            " -i <count>: Number of interfaces (default 100)\n"
+            " -b <count>: Events raised per interface in each burst (default 8)\n"
+            " -r <count>: Number of bursts (default 10000)\n"
+            "\n",
+            progname);
+}
+
+int
+main(int const argc, char * * const argv)
+{
+    int ch;
+
+    benchmark.num_interfaces = 100;
+    benchmark.burst = 8;
+    benchmark.rounds = 10000;
+
+    while ((ch = getopt(argc, argv, "i:b:r:")) != -1)
+    {
+        switch (ch)
+        {
+        case 'i':
+            benchmark.num_interfaces = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'b':
+            benchmark.burst = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'r':
+            benchmark.rounds = strtoul(optarg, NULL, 0);
+            break;
+
+        default:
+            usage(stderr, argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    benchmark.interfaces = calloc(benchmark.num_interfaces, sizeof(*benchmark.interfaces));
+    if (benchmark.num_interfaces == 0 || benchmark.burst == 0 || benchmark.rounds == 0
+        || benchmark.interfaces == NULL)
+    {
+        usage(stderr, argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uloop_init();
+
+    for (unsigned i = 0; i < benchmark.num_interfaces; i++)
+    {
+        event_queue_init(&benchmark.interfaces[i].event_queue);
+    }
+    timer_init(&benchmark.round_timer, "round_timer", round_timer_expired);
+    timer_start(&benchmark.round_timer, 0);
+
+    uint64_t const start = now_usecs();
+
+    uloop_run();
+
+    uint64_t const elapsed_usecs = now_usecs() - start;
+    uint64_t handled = 0;
+    uint64_t dropped = 0;
+    uint64_t total_latency_usecs = 0;
+    uint64_t max_latency_usecs = 0;
+    size_t high_water = 0;
+
+    for (unsigned i = 0; i < benchmark.num_interfaces; i++)
+    {
+        event_q_st * const event_queue = &benchmark.interfaces[i].event_queue;
+        event_queue_stats_st const * const stats = event_queue_stats(event_queue);
+
+        handled += benchmark.interfaces[i].handled;
+        dropped += stats->dropped;
+        total_latency_usecs += stats->total_latency_usecs;
+        if (stats->max_latency_usecs > max_latency_usecs)
+        {
+            max_latency_usecs = stats->max_latency_usecs;
+        }
+        if (stats->high_water > high_water)
+        {
+            high_water = stats->high_water;
+        }
+        event_queue_cleanup(event_queue);
+    }
+
+    printf("%u interfaces, %u bursts of %u events\n",
+           benchmark.num_interfaces, benchmark.rounds, benchmark.burst);
+    printf("events handled:            %" PRIu64 " (%" PRIu64 " dropped)\n", handled, dropped);
+    printf("events/sec:                %.0f\n", (double)handled * 1000000 / elapsed_usecs);
+    printf("events/sec per interface:  %.0f\n",
+           (double)handled * 1000000 / elapsed_usecs / benchmark.num_interfaces);
+    printf("mean latency usecs:        %.1f\n", (double)total_latency_usecs / handled);
+    printf("max latency usecs:         %" PRIu64 "\n", max_latency_usecs);
+    printf("queue high water:          %zu\n", high_water);
+
+    uloop_done();
+    free(benchmark.interfaces);
+
+    return EXIT_SUCCESS;
+}
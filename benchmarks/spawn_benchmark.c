@@ -0,0 +1,237 @@
+/*
+ * Compare the cost to the daemon of starting test processes with each of the
+ * available spawn methods.
+ * The daemon's memory is simulated by a ballast allocation that is written to
+ * after each spawn, just as the daemon carries on running while the child
+ * process execs. With fork() those writes take copy-on-write faults for as
+ * long as the child shares the parent's pages.
+ */
+#include "spawner.h"
+
+#include <libubox/utils.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct spawn_results_st
+{
+    uint64_t spawn_usecs_total;
+    uint64_t spawn_usecs_min;
+    uint64_t spawn_usecs_max;
+    uint64_t exit_usecs_total;
+    long minor_faults;
+    long rss_kb_delta;
+    unsigned failures;
+} spawn_results_st;
+
+static uint64_t
+now_usecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static long
+rss_kb(void)
+{
+    long rss = -1;
+    char line[128];
+    FILE * const fp = fopen("/proc/self/status", "r");
+
+    if (fp == NULL)
+    {
+        goto done;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        if (sscanf(line, "VmRSS: %ld kB", &rss) == 1)
+        {
+            break;
+        }
+    }
+
+    fclose(fp);
+
+done:
+    return rss;
+}
+
+static void
+touch_ballast(char * const ballast, size_t const ballast_size, unsigned const pass)
+{
+    long const page_size = sysconf(_SC_PAGESIZE);
+
+    for (size_t offset = 0; offset < ballast_size; offset += page_size)
+    {
+        ballast[offset] = (char)pass;
+    }
+}
+
+static void
+run_method(
+    spawn_method_t const method,
+    char * const * const argv,
+    unsigned const iterations,
+    char * const ballast,
+    size_t const ballast_size,
+    spawn_results_st * const results)
+{
+    struct rusage before;
+    struct rusage after;
+    long const rss_before = rss_kb();
+
+    memset(results, 0, sizeof(*results));
+    results->spawn_usecs_min = UINT64_MAX;
+
+    getrusage(RUSAGE_SELF, &before);
+
+    for (unsigned i = 0; i < iterations; i++)
+    {
+        uint64_t const start = now_usecs();
+        int pidfd;
+        pid_t const pid = spawn_process(method, argv, -1, -1, -1, &pidfd);
+        uint64_t const spawned = now_usecs();
+
+        if (pid < 0)
+        {
+            results->failures++;
+            continue;
+        }
+
+        touch_ballast(ballast, ballast_size, i);
+
+        int status;
+
+        /* __WALL because the child doesn't signal SIGCHLD when it exits. */
+        waitpid(pid, &status, __WALL);
+        close(pidfd);
+
+        uint64_t const exited = now_usecs();
+        uint64_t const spawn_usecs = spawned - start;
+
+        results->spawn_usecs_total += spawn_usecs;
+        if (spawn_usecs < results->spawn_usecs_min)
+        {
+            results->spawn_usecs_min = spawn_usecs;
+        }
+        if (spawn_usecs > results->spawn_usecs_max)
+        {
+            results->spawn_usecs_max = spawn_usecs;
+        }
+        results->exit_usecs_total += exited - start;
+    }
+
+    getrusage(RUSAGE_SELF, &after);
+
+    results->minor_faults = after.ru_minflt - before.ru_minflt;
+    results->rss_kb_delta = rss_kb() - rss_before;
+}
+
+static void
+print_results(
+    spawn_method_t const method,
+    unsigned const iterations,
+    spawn_results_st const * const results)
+{
+    unsigned const completed = iterations - results->failures;
+
+    if (completed == 0)
+    {
+        printf("%-12s all %u spawns failed\n", spawn_method_to_str(method), iterations);
+        goto done;
+    }
+
+    printf("%-12s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %14" PRIu64 " %14.1f %12ld\n",
+           spawn_method_to_str(method),
+           results->spawn_usecs_total / completed,
+           results->spawn_usecs_min,
+           results->spawn_usecs_max,
+           results->exit_usecs_total / completed,
+           (double)results->minor_faults / completed,
+           results->rss_kb_delta);
+
+done:
+    return;
+}
+
+static void
+usage(FILE * const fp, char const * const progname)
+{
+    fprintf(fp, "Usage: %s [options] [executable]\n"
+            "Options:\n"
+            " -n <count>: Number of processes to start with each method (default 1000)\n"
+            " -m <MiB>:   Size of the ballast simulating the daemon's memory (default 64)\n"
+            "The executable defaults to /bin/true\n"
+            "\n",
+            progname);
+}
+
+int
+main(int const argc, char * * const argv)
+{
+    unsigned iterations = 1000;
+    size_t ballast_mib = 64;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "n:m:")) != -1)
+    {
+        switch (ch)
+        {
+        case 'n':
+            iterations = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'm':
+            ballast_mib = strtoul(optarg, NULL, 0);
+            break;
+
+        default:
+            usage(stderr, argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    char * exe_argv[2] =
+    {
+        (optind < argc) ? argv[optind] : "/bin/true",
+        NULL,
+    };
+    size_t const ballast_size = ballast_mib * 1024 * 1024;
+    char * const ballast = malloc(ballast_size);
+
+    if (ballast == NULL && ballast_size > 0)
+    {
+        fprintf(stderr, "unable to allocate %zu MiB ballast\n", ballast_mib);
+        return EXIT_FAILURE;
+    }
+    touch_ballast(ballast, ballast_size, 0);
+
+    printf("%u spawns of %s per method, %zu MiB of touched ballast\n",
+           iterations, exe_argv[0], ballast_mib);
+    printf("%-12s %10s %10s %10s %14s %14s %12s\n",
+           "method", "spawn_us", "min_us", "max_us", "spawn_exit_us",
+           "minflt/spawn", "rss_delta_kb");
+
+    for (spawn_method_t method = 0; method < SPAWN_METHOD_COUNT__; method++)
+    {
+        spawn_results_st results;
+
+        run_method(method, exe_argv, iterations, ballast, ballast_size, &results);
+        print_results(method, iterations, &results);
+    }
+
+    free(ballast);
+
+    return EXIT_SUCCESS;
+}
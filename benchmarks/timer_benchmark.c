@@ -0,0 +1,219 @@
+/*
+ * Compare the cost of starting and stopping a large number of timers with the
+ * timing wheel behind timers.h and with a uloop_timeout per timer, as the
+ * daemon used to do. Each timer is started, restarted with a new timeout (as
+ * the interval and response timers are after each test) and then stopped.
+ */
+#include "timers.h"
+
+#include <libubox/uloop.h>
+#include <libubox/utils.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct timer_results_st
+{
+    uint64_t start_usecs;
+    uint64_t restart_usecs;
+    uint64_t stop_usecs;
+} timer_results_st;
+
+static uint64_t
+now_usecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void
+timer_expired(timer_st * const t)
+{
+    (void)t;
+}
+
+static void
+uloop_timeout_expired(struct uloop_timeout * const t)
+{
+    (void)t;
+}
+
+/* Timeouts between 1 second and 15 minutes, like the daemon's intervals. */
+static uint32_t *
+make_timeouts(unsigned const count, unsigned const seed)
+{
+    uint32_t * const timeouts = calloc(count, sizeof(*timeouts));
+
+    srand(seed);
+    for (unsigned i = 0; timeouts != NULL && i < count; i++)
+    {
+        timeouts[i] = 1000 + (uint32_t)rand() % (15 * 60 * 1000);
+    }
+
+    return timeouts;
+}
+
+static void
+run_timer_wheel(
+    unsigned const count,
+    uint32_t const * const timeouts,
+    uint32_t const * const new_timeouts,
+    timer_results_st * const results)
+{
+    timer_st * const timers = calloc(count, sizeof(*timers));
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        timer_init(&timers[i], "benchmark", timer_expired);
+    }
+
+    uint64_t const start = now_usecs();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        timer_start(&timers[i], timeouts[i]);
+    }
+
+    uint64_t const started = now_usecs();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        timer_start(&timers[i], new_timeouts[i]);
+    }
+
+    uint64_t const restarted = now_usecs();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        timer_stop(&timers[i]);
+    }
+
+    uint64_t const stopped = now_usecs();
+
+    results->start_usecs = started - start;
+    results->restart_usecs = restarted - started;
+    results->stop_usecs = stopped - restarted;
+
+    free(timers);
+}
+
+static void
+run_uloop_timeouts(
+    unsigned const count,
+    uint32_t const * const timeouts,
+    uint32_t const * const new_timeouts,
+    timer_results_st * const results)
+{
+    struct uloop_timeout * const timers = calloc(count, sizeof(*timers));
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        timers[i].cb = uloop_timeout_expired;
+    }
+
+    uint64_t const start = now_usecs();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        uloop_timeout_set(&timers[i], (int)timeouts[i]);
+    }
+
+    uint64_t const started = now_usecs();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        uloop_timeout_set(&timers[i], (int)new_timeouts[i]);
+    }
+
+    uint64_t const restarted = now_usecs();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        uloop_timeout_cancel(&timers[i]);
+    }
+
+    uint64_t const stopped = now_usecs();
+
+    results->start_usecs = started - start;
+    results->restart_usecs = restarted - started;
+    results->stop_usecs = stopped - restarted;
+
+    free(timers);
+}
+
+static void
+print_results(
+    char const * const name, unsigned const count, timer_results_st const * const results)
+{
+    printf("%-14s %12.1f %12.1f %12.1f\n",
+           name,
+           (double)results->start_usecs * 1000 / count,
+           (double)results->restart_usecs * 1000 / count,
+           (double)results->stop_usecs * 1000 / count);
+}
+
+static void
+usage(FILE * const fp, char const * const progname)
+{
+    fprintf(fp, "Usage: %s [options]\n"
+            "Options:\n"
+            " -n <count>: Number of timers (default 100000)\n"
+            "\n",
+            progname);
+}
+
+int
+main(int const argc, char * * const argv)
+{
+    unsigned count = 100000;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "n:")) != -1)
+    {
+        switch (ch)
+        {
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+
+        default:
+            usage(stderr, argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    uint32_t * const timeouts = make_timeouts(count, 1);
+    uint32_t * const new_timeouts = make_timeouts(count, 2);
+
+    if (count == 0 || timeouts == NULL || new_timeouts == NULL)
+    {
+        fprintf(stderr, "unable to allocate %u timeouts\n", count);
+        return EXIT_FAILURE;
+    }
+
+    uloop_init();
+
+    printf("%u timers\n", count);
+    printf("%-14s %12s %12s %12s\n", "timers", "start_ns", "restart_ns", "stop_ns");
+
+    timer_results_st results;
+
+    run_timer_wheel(count, timeouts, new_timeouts, &results);
+    print_results("timing wheel", count, &results);
+
+    run_uloop_timeouts(count, timeouts, new_timeouts, &results);
+    print_results("uloop_timeout", count, &results);
+
+    uloop_done();
+    free(timeouts);
+    free(new_timeouts);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,302 @@
+/*
+ * Drive metrics_adjuster.c against the simulator's virtual clock and a
+ * stand-in for netifd that answers only when told to, and check that
+ * adjustments are coalesced, retried with a doubling delay, given up on, and
+ * timed out as described in metrics_adjuster.h, and that netifd's object is
+ * looked up again once it has gone.
+ */
+#include "simulator.h"
+#include "metrics_adjuster.h"
+#include "ubus.h"
+#include "utils.h"
+
+#include <libubox/utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: %s: check failed: %s\n", \
+                    __FILE__, __LINE__, __func__, #condition); \
+            return false; \
+        } \
+    } while (0)
+
+/* Must match the values in metrics_adjuster.c. */
+#define RESPONSE_TIMEOUT_MSECS 5000
+#define INITIAL_RETRY_DELAY_MSECS 1000
+
+/* The requests netifd has been sent and not yet answered. */
+typedef struct fake_netifd_st
+{
+    unsigned int lookups; /* Of the interface's object, whose id is 1. */
+    unsigned int requests;
+    unsigned int aborts;
+    uint32_t last_amount;
+    uint64_t last_request_msecs;
+    struct ubus_request * req;
+    ubus_complete_handler_t complete_cb;
+} fake_netifd_st;
+
+static fake_netifd_st netifd;
+
+bool
+ubus_send_metrics_adjust_request(
+    struct ubus_context * const ubus,
+    char const * const interface_name,
+    uint32_t * const object_id,
+    uint32_t const amount,
+    struct ubus_request * const req,
+    ubus_complete_handler_t const complete_cb,
+    void * const priv)
+{
+    UNUSED(ubus);
+    UNUSED(interface_name);
+    UNUSED(priv);
+
+    if (*object_id == 0)
+    {
+        netifd.lookups++;
+        *object_id = 1;
+    }
+    netifd.requests++;
+    netifd.last_amount = amount;
+    netifd.last_request_msecs = sim_timers_now_msecs();
+    netifd.req = req;
+    netifd.complete_cb = complete_cb;
+
+    return true;
+}
+
+void
+ubus_abort_request(struct ubus_context * const ubus, struct ubus_request * const req)
+{
+    UNUSED(ubus);
+
+    if (req == netifd.req)
+    {
+        netifd.req = NULL;
+        netifd.complete_cb = NULL;
+    }
+    netifd.aborts++;
+}
+
+/* Answer the outstanding request. Returns false if there isn't one. */
+static bool
+netifd_reply(int const status)
+{
+    struct ubus_request * const req = netifd.req;
+    ubus_complete_handler_t const complete_cb = netifd.complete_cb;
+
+    if (req == NULL || complete_cb == NULL)
+    {
+        return false;
+    }
+    netifd.req = NULL;
+    netifd.complete_cb = NULL;
+    complete_cb(req, status);
+
+    return true;
+}
+
+static unsigned int changes;
+
+static void
+adjuster_changed(metrics_adjuster_st * const adjuster)
+{
+    UNUSED(adjuster);
+
+    changes++;
+}
+
+static void
+adjuster_init(metrics_adjuster_st * const adjuster)
+{
+    netifd = (fake_netifd_st){ 0 };
+    changes = 0;
+    metrics_adjuster_init(adjuster, NULL, "wan", adjuster_changed);
+}
+
+static void
+run_for(uint64_t const msecs)
+{
+    sim_timers_run_until(sim_timers_now_msecs() + msecs);
+}
+
+/* Adjustments asked for while a request is outstanding replace one another. */
+static bool
+test_coalescing(metrics_adjuster_st * const adjuster)
+{
+    uint32_t applied;
+
+    metrics_adjuster_set(adjuster, 10);
+    CHECK(netifd.requests == 1);
+    CHECK(netifd.last_amount == 10);
+
+    metrics_adjuster_set(adjuster, 20);
+    metrics_adjuster_set(adjuster, 30);
+    CHECK(netifd.requests == 1);
+    CHECK(metrics_adjuster_stats(adjuster)->coalesced == 1);
+
+    /* Only the latest adjustment is sent once the first has been applied. */
+    CHECK(netifd_reply(UBUS_STATUS_OK));
+    CHECK(metrics_adjuster_applied(adjuster, &applied) && applied == 10);
+    CHECK(netifd.requests == 2);
+    CHECK(netifd.last_amount == 30);
+
+    CHECK(netifd_reply(UBUS_STATUS_OK));
+    CHECK(metrics_adjuster_applied(adjuster, &applied) && applied == 30);
+    CHECK(!metrics_adjuster_is_pending(adjuster));
+    CHECK(metrics_adjuster_stats(adjuster)->requests == 2);
+    CHECK(changes == 2);
+
+    /* Asking for what has been applied already sends nothing. */
+    metrics_adjuster_set(adjuster, 30);
+    CHECK(netifd.requests == 2);
+
+    return true;
+}
+
+/* A failed request is retried after a delay that doubles each time. */
+static bool
+test_retry_backoff(metrics_adjuster_st * const adjuster)
+{
+    uint32_t delay_msecs = INITIAL_RETRY_DELAY_MSECS;
+
+    metrics_adjuster_set(adjuster, 10);
+    for (unsigned int retry = 1; retry <= METRICS_ADJUSTER_MAX_RETRIES; retry++)
+    {
+        uint64_t const failed_msecs = sim_timers_now_msecs();
+
+        CHECK(netifd_reply(UBUS_STATUS_UNKNOWN_ERROR));
+        CHECK(metrics_adjuster_retries(adjuster) == retry);
+
+        run_for(delay_msecs - 1);
+        CHECK(netifd.requests == retry);
+        run_for(1);
+        CHECK(netifd.requests == retry + 1);
+        CHECK(netifd.last_request_msecs == failed_msecs + delay_msecs);
+        CHECK(netifd.last_amount == 10);
+
+        delay_msecs *= 2;
+    }
+
+    /* Success resets the retries. */
+    CHECK(netifd_reply(UBUS_STATUS_OK));
+    CHECK(metrics_adjuster_retries(adjuster) == 0);
+    CHECK(!metrics_adjuster_is_pending(adjuster));
+
+    return true;
+}
+
+/* The adjustment is given up on once the retries have all failed. */
+static bool
+test_give_up(metrics_adjuster_st * const adjuster)
+{
+    metrics_adjuster_set(adjuster, 10);
+    for (unsigned int retry = 0; retry < METRICS_ADJUSTER_MAX_RETRIES; retry++)
+    {
+        CHECK(netifd_reply(UBUS_STATUS_UNKNOWN_ERROR));
+        run_for(INITIAL_RETRY_DELAY_MSECS << retry);
+    }
+    CHECK(netifd.requests == METRICS_ADJUSTER_MAX_RETRIES + 1);
+
+    CHECK(netifd_reply(UBUS_STATUS_UNKNOWN_ERROR));
+    run_for(INITIAL_RETRY_DELAY_MSECS << METRICS_ADJUSTER_MAX_RETRIES);
+    CHECK(netifd.requests == METRICS_ADJUSTER_MAX_RETRIES + 1);
+    CHECK(!metrics_adjuster_is_pending(adjuster));
+    CHECK(metrics_adjuster_stats(adjuster)->failures == METRICS_ADJUSTER_MAX_RETRIES + 1);
+
+    /* A new adjustment is sent straight away. */
+    metrics_adjuster_set(adjuster, 20);
+    CHECK(netifd.requests == METRICS_ADJUSTER_MAX_RETRIES + 2);
+    CHECK(metrics_adjuster_retries(adjuster) == 0);
+
+    return true;
+}
+
+/* A request that isn't answered is abandoned and retried. */
+static bool
+test_response_timeout(metrics_adjuster_st * const adjuster)
+{
+    metrics_adjuster_set(adjuster, 10);
+    run_for(RESPONSE_TIMEOUT_MSECS - 1);
+    CHECK(netifd.aborts == 0);
+    CHECK(metrics_adjuster_retries(adjuster) == 0);
+
+    run_for(1);
+    CHECK(netifd.aborts == 1);
+    CHECK(metrics_adjuster_retries(adjuster) == 1);
+    CHECK(metrics_adjuster_stats(adjuster)->failures == 1);
+
+    run_for(INITIAL_RETRY_DELAY_MSECS);
+    CHECK(netifd.requests == 2);
+    CHECK(netifd.last_amount == 10);
+
+    return true;
+}
+
+/* The object is looked up again after netifd says it doesn't exist, but not otherwise. */
+static bool
+test_not_found_clears_object_id(metrics_adjuster_st * const adjuster)
+{
+    metrics_adjuster_set(adjuster, 10);
+    CHECK(netifd.lookups == 1);
+
+    CHECK(netifd_reply(UBUS_STATUS_UNKNOWN_ERROR));
+    run_for(INITIAL_RETRY_DELAY_MSECS);
+    CHECK(netifd.requests == 2);
+    CHECK(netifd.lookups == 1);
+
+    CHECK(netifd_reply(UBUS_STATUS_NOT_FOUND));
+    run_for(INITIAL_RETRY_DELAY_MSECS * 2);
+    CHECK(netifd.requests == 3);
+    CHECK(netifd.lookups == 2);
+
+    return true;
+}
+
+typedef struct test_st
+{
+    char const * name;
+    bool (*fn)(metrics_adjuster_st * adjuster);
+} test_st;
+
+static test_st const tests[] =
+{
+    { "coalescing", test_coalescing },
+    { "retry_backoff", test_retry_backoff },
+    { "give_up", test_give_up },
+    { "response_timeout", test_response_timeout },
+    { "not_found_clears_object_id", test_not_found_clears_object_id },
+};
+
+int
+main(void)
+{
+    unsigned int failures = 0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(tests); i++)
+    {
+        metrics_adjuster_st adjuster;
+
+        adjuster_init(&adjuster);
+
+        bool const passed = tests[i].fn(&adjuster);
+
+        /* Stops the adjuster's timer whether or not the test got to the end. */
+        metrics_adjuster_cleanup(&adjuster);
+
+        printf("%-28s %s\n", tests[i].name, passed ? "passed" : "FAILED");
+        if (!passed)
+        {
+            failures++;
+        }
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
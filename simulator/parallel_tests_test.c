@@ -0,0 +1,246 @@
+/*
+ * Run the tester state machine against the simulator's virtual clock with two
+ * tests run in parallel that exit at the same time, one passing and one
+ * failing, and check that the test run is decided by both results whichever
+ * of them is handled first, and that neither result is counted in a later run.
+ */
+#include "simulator.h"
+#include "interface_connection.h"
+#include "interface_tester.h"
+#include "strings.h"
+#include "tester_common.h"
+
+#include <libubox/blobmsg.h>
+#include <libubox/ulog.h>
+#include <libubox/utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: %s: check failed: %s\n", \
+                    __FILE__, __LINE__, __func__, #condition); \
+            return false; \
+        } \
+    } while (0)
+
+#define SETTLING_DELAY_SECS 5
+#define TEST_INTERVAL_SECS 10
+#define TEST_LATENCY_MSECS 200
+
+static sim_script_st const scripts[] =
+{
+    {
+        .name = "sim_pass",
+        .latency_msecs = TEST_LATENCY_MSECS,
+    },
+    {
+        .name = "sim_fail",
+        .latency_msecs = TEST_LATENCY_MSECS,
+        .fail_percent = 100,
+    },
+};
+
+static const success_condition_st all_tests_must_pass =
+{
+    .name = "all_tests_must_pass",
+    .condition = test_run_success_condition_all,
+};
+
+static const success_condition_st one_test_must_pass =
+{
+    .name = "one_test_must_pass",
+    .condition = test_run_success_condition_one,
+};
+
+static interface_tester_shared_st ctx;
+
+/* Both tests are started together, so exit in the order they are listed. */
+static bool
+config_init(
+    interface_config_st * const config,
+    success_condition_st const * const success_condition,
+    char const * const first_test,
+    char const * const second_test)
+{
+    char const * const executable_names[] = { first_test, second_test };
+    bool success;
+    struct blob_buf b = { 0 };
+
+    blob_buf_init(&b, 0);
+    blobmsg_close_table(&b, blobmsg_open_table(&b, Sparams));
+
+    config->success_condition = success_condition;
+    config->settling_delay_secs = SETTLING_DELAY_SECS;
+    config->test_passing_interval_secs = TEST_INTERVAL_SECS;
+    config->test_failing_interval_secs = TEST_INTERVAL_SECS;
+    config->pass_threshold = 1;
+    config->fail_threshold = 1;
+    config->response_timeout_secs = 5;
+    config->parallel_tests = true;
+
+    config->tests = calloc(ARRAY_SIZE(executable_names), sizeof(*config->tests));
+    config->test_stats = calloc(ARRAY_SIZE(executable_names), sizeof(*config->test_stats));
+    if (config->tests == NULL || config->test_stats == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    for (; config->num_tests < ARRAY_SIZE(executable_names); config->num_tests++)
+    {
+        test_config_st const test =
+        {
+            .type = TEST_TYPE_EXECUTABLE,
+            .executable_name = executable_names[config->num_tests],
+            .label = executable_names[config->num_tests],
+            .params = blobmsg_data(b.head),
+        };
+
+        config->tests[config->num_tests] = config_definitions_get_test(&ctx.definitions, &test);
+        if (config->tests[config->num_tests] == NULL)
+        {
+            success = false;
+            goto done;
+        }
+    }
+
+    success = true;
+
+done:
+    blob_buf_free(&b);
+
+    return success;
+}
+
+static void
+run_for(uint64_t const msecs)
+{
+    sim_timers_run_until(sim_timers_now_msecs() + msecs);
+}
+
+/*
+ * Connects an interface with the given tests and lets two test runs complete,
+ * then checks that both were decided as expected.
+ */
+static bool
+check_test_runs(
+    success_condition_st const * const success_condition,
+    char const * const first_test,
+    char const * const second_test,
+    bool const expect_pass)
+{
+    sim_ubus_stats_st const * const ubus = sim_ubus_stats();
+    uint64_t const passed_before = ubus->test_runs_passed;
+    uint64_t const failed_before = ubus->test_runs_failed;
+    interface_st * const iface = interface_tester_alloc(&ctx, "sim0");
+    bool success;
+
+    if (iface == NULL || !config_init(&iface->config, success_condition, first_test, second_test))
+    {
+        fprintf(stderr, "%s: unable to create the interface\n", __func__);
+        success = false;
+        goto done;
+    }
+
+    interface_tester_begin(iface);
+    interface_connection_connected(&iface->connection);
+
+    /* Just after the first test run. */
+    run_for(SETTLING_DELAY_SECS * 1000 + TEST_LATENCY_MSECS + 1);
+    success = ubus->test_runs_passed - passed_before == (expect_pass ? 1 : 0)
+        && ubus->test_runs_failed - failed_before == (expect_pass ? 0 : 1)
+        && iface->tester.state == TESTER_STATE_SLEEPING;
+    if (!success)
+    {
+        fprintf(stderr, "%s: first test run: %s\n", __func__, first_test);
+        goto done;
+    }
+
+    /* Just after the second. */
+    run_for(TEST_INTERVAL_SECS * 1000 + TEST_LATENCY_MSECS);
+    success = ubus->test_runs_passed - passed_before == (expect_pass ? 2 : 0)
+        && ubus->test_runs_failed - failed_before == (expect_pass ? 0 : 2)
+        && iface->tester.state == TESTER_STATE_SLEEPING;
+    if (!success)
+    {
+        fprintf(stderr, "%s: second test run: %s\n", __func__, first_test);
+        goto done;
+    }
+
+done:
+    if (iface != NULL)
+    {
+        interface_tester_free(iface);
+    }
+
+    return success;
+}
+
+/* The test that fails decides the run whether or not its result comes first. */
+static bool
+test_all_must_pass(void)
+{
+    bool const expect_pass = false;
+
+    CHECK(check_test_runs(&all_tests_must_pass, "sim_pass", "sim_fail", expect_pass));
+    CHECK(check_test_runs(&all_tests_must_pass, "sim_fail", "sim_pass", expect_pass));
+
+    return true;
+}
+
+/* The test that passes decides the run whether or not its result comes first. */
+static bool
+test_one_must_pass(void)
+{
+    bool const expect_pass = true;
+
+    CHECK(check_test_runs(&one_test_must_pass, "sim_fail", "sim_pass", expect_pass));
+    CHECK(check_test_runs(&one_test_must_pass, "sim_pass", "sim_fail", expect_pass));
+
+    return true;
+}
+
+typedef struct test_st
+{
+    char const * name;
+    bool (*fn)(void);
+} test_st;
+
+static test_st const tests[] =
+{
+    { "all_must_pass", test_all_must_pass },
+    { "one_must_pass", test_one_must_pass },
+};
+
+int
+main(void)
+{
+    unsigned int failures = 0;
+
+    sim_random_seed(1);
+    sim_process_set_scripts(scripts, ARRAY_SIZE(scripts));
+    scheduler_init(&ctx.scheduler);
+    config_definitions_init(&ctx.definitions, NULL);
+    ulog_threshold(LOG_WARNING);
+
+    for (size_t i = 0; i < ARRAY_SIZE(tests); i++)
+    {
+        bool const passed = tests[i].fn();
+
+        printf("%-28s %s\n", tests[i].name, passed ? "passed" : "FAILED");
+        if (!passed)
+        {
+            failures++;
+        }
+    }
+
+    scheduler_cleanup(&ctx.scheduler);
+    sim_process_cleanup();
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,239 @@
+/*
+ * Stands in for process.c. Rather than starting a child process, each "process"
+ * is a timer that expires after the latency scripted for its executable,
+ * whereupon it exits with a scripted status.
+ */
+#include "simulator.h"
+#include "process.h"
+#include "timers.h"
+#include "utils.h"
+
+#include <libubox/utils.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+/* Long enough to outlast any sensible response timeout. */
+#define SIM_HANG_MSECS (24 * 60 * 60 * 1000)
+
+typedef struct sim_process_st
+{
+    timer_st exit_timer;
+    tester_process_st * proc;
+    pid_t pid;
+    int status;
+    uint32_t runtime_msecs;
+} sim_process_st;
+
+typedef struct sim_processes_st
+{
+    sim_script_st const * scripts;
+    size_t num_scripts;
+
+    /* Indexed by pid - 1. Entries are reused once their process exits. */
+    sim_process_st * * processes;
+    size_t num_processes;
+    pid_t * free_pids;
+    size_t num_free_pids;
+
+    sim_process_stats_st stats;
+} sim_processes_st;
+
+static sim_processes_st sim_processes;
+
+static sim_script_st const default_script =
+{
+    .name = "default",
+    .latency_msecs = 100,
+};
+
+static sim_script_st const *
+script_lookup(char const * const name)
+{
+    sim_script_st const * script = &default_script;
+
+    for (size_t i = 0; i < sim_processes.num_scripts; i++)
+    {
+        if (strcmp(sim_processes.scripts[i].name, name) == 0)
+        {
+            script = &sim_processes.scripts[i];
+            break;
+        }
+    }
+
+    return script;
+}
+
+static void
+sim_process_release(sim_process_st * const sim_proc)
+{
+    sim_processes_st * const processes = &sim_processes;
+
+    timer_stop(&sim_proc->exit_timer);
+    sim_proc->proc->pid_ = 0;
+    sim_proc->proc = NULL;
+    processes->free_pids[processes->num_free_pids++] = sim_proc->pid;
+    processes->stats.running--;
+}
+
+static void
+exit_timer_expired(timer_st * const t)
+{
+    sim_process_st * const sim_proc = container_of(t, sim_process_st, exit_timer);
+    tester_process_st * const proc = sim_proc->proc;
+    process_usage_st const usage =
+    {
+        .wall_usecs = (uint64_t)sim_proc->runtime_msecs * 1000,
+    };
+    int const status = sim_proc->status;
+
+    sim_processes.stats.exited++;
+    sim_process_release(sim_proc);
+    if (proc->cb != NULL)
+    {
+        proc->cb(proc, status, &usage);
+    }
+}
+
+static sim_process_st *
+sim_process_alloc(void)
+{
+    sim_processes_st * const processes = &sim_processes;
+    sim_process_st * sim_proc = NULL;
+
+    if (processes->num_free_pids > 0)
+    {
+        pid_t const pid = processes->free_pids[--processes->num_free_pids];
+
+        sim_proc = processes->processes[pid - 1];
+        goto done;
+    }
+
+    size_t const num_processes = processes->num_processes + 1;
+    sim_process_st * * const process_list =
+        realloc(processes->processes, num_processes * sizeof(*process_list));
+    pid_t * const free_pids =
+        realloc(processes->free_pids, num_processes * sizeof(*free_pids));
+
+    if (process_list != NULL)
+    {
+        processes->processes = process_list;
+    }
+    if (free_pids != NULL)
+    {
+        processes->free_pids = free_pids;
+    }
+    if (process_list == NULL || free_pids == NULL)
+    {
+        goto done;
+    }
+
+    sim_proc = calloc(1, sizeof(*sim_proc));
+    if (sim_proc == NULL)
+    {
+        goto done;
+    }
+    sim_proc->pid = num_processes;
+    timer_init(&sim_proc->exit_timer, "sim_process_exit_timer", exit_timer_expired);
+    processes->processes[processes->num_processes] = sim_proc;
+    processes->num_processes = num_processes;
+
+done:
+    return sim_proc;
+}
+
+bool
+interface_tester_process_is_running(tester_process_st const * const proc)
+{
+    return proc->pid_ > 0;
+}
+
+pid_t
+interface_tester_process_pid(tester_process_st const * const proc)
+{
+    return proc->pid_;
+}
+
+void
+interface_tester_kill_process(tester_process_st * const proc)
+{
+    if (!interface_tester_process_is_running(proc))
+    {
+        goto done;
+    }
+
+    sim_processes.stats.killed++;
+    sim_process_release(sim_processes.processes[proc->pid_ - 1]);
+
+done:
+    return;
+}
+
+bool
+interface_tester_start_process(
+    tester_process_st * const proc, char * * const argv, int const dir_fd, int const exec_fd)
+{
+    UNUSED(dir_fd);
+    UNUSED(exec_fd);
+    sim_processes_st * const processes = &sim_processes;
+    sim_script_st const * const script = script_lookup(argv[0]);
+    sim_process_st * const sim_proc = sim_process_alloc();
+    bool success;
+
+    if (sim_proc == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    bool const hangs = sim_random_percent(script->hang_percent);
+    bool const fails = sim_random_percent(script->fail_percent);
+
+    sim_proc->proc = proc;
+    sim_proc->status = W_EXITCODE(fails ? EXIT_FAILURE : EXIT_SUCCESS, 0);
+    sim_proc->runtime_msecs =
+        hangs
+        ? SIM_HANG_MSECS
+        : sim_random_around(script->latency_msecs, script->latency_jitter_msecs);
+    proc->pid_ = sim_proc->pid;
+    timer_start(&sim_proc->exit_timer, sim_proc->runtime_msecs);
+
+    processes->stats.started++;
+    processes->stats.running++;
+    if (processes->stats.running > processes->stats.max_running)
+    {
+        processes->stats.max_running = processes->stats.running;
+    }
+    success = true;
+
+done:
+    return success;
+}
+
+void
+sim_process_set_scripts(sim_script_st const * const scripts, size_t const num_scripts)
+{
+    sim_processes.scripts = scripts;
+    sim_processes.num_scripts = num_scripts;
+}
+
+sim_process_stats_st const *
+sim_process_stats(void)
+{
+    return &sim_processes.stats;
+}
+
+void
+sim_process_cleanup(void)
+{
+    sim_processes_st * const processes = &sim_processes;
+
+    for (size_t i = 0; i < processes->num_processes; i++)
+    {
+        free(processes->processes[i]);
+    }
+    free(processes->processes);
+    free(processes->free_pids);
+    *processes = (sim_processes_st){0};
+}
@@ -0,0 +1,38 @@
+/*
+ * A deterministic source of pseudo-random numbers (xorshift64*), so that the
+ * same seed always gives the same simulation.
+ */
+#include "simulator.h"
+
+static uint64_t sim_random_state;
+
+void
+sim_random_seed(uint64_t const seed)
+{
+    /* xorshift64* must not be seeded with 0. */
+    sim_random_state = seed != 0 ? seed : 1;
+}
+
+uint32_t
+sim_random(void)
+{
+    sim_random_state ^= sim_random_state >> 12;
+    sim_random_state ^= sim_random_state << 25;
+    sim_random_state ^= sim_random_state >> 27;
+
+    return (sim_random_state * UINT64_C(0x2545F4914F6CDD1D)) >> 32;
+}
+
+uint32_t
+sim_random_around(uint32_t const mean, uint32_t const jitter)
+{
+    uint32_t const spread = jitter < mean ? jitter : mean;
+
+    return mean - spread + sim_random() % (2 * (uint64_t)spread + 1);
+}
+
+bool
+sim_random_percent(uint32_t const percent)
+{
+    return sim_random() % 100 < percent;
+}
@@ -0,0 +1,230 @@
+/*
+ * Stand-ins for the parts of the daemon that talk to the outside world: ubus,
+ * the executable cache and ICMP probes. Events that would have been sent over
+ * ubus are counted instead.
+ */
+#include "simulator.h"
+#include "exec_cache.h"
+#include "icmp_probe.h"
+#include "ubus.h"
+#include "utils.h"
+
+#include <libubox/utils.h>
+
+#include <stdio.h>
+
+static sim_ubus_stats_st sim_ubus;
+
+sim_ubus_stats_st const *
+sim_ubus_stats(void)
+{
+    return &sim_ubus;
+}
+
+void
+ubus_send_interface_operational_event(
+    struct ubus_context * const ubus, char const * const interface_name, bool const is_operational)
+{
+    UNUSED(ubus);
+    UNUSED(interface_name);
+    UNUSED(is_operational);
+
+    sim_ubus.operational_changes++;
+}
+
+void
+ubus_send_interface_test_run_event(
+    struct ubus_context * const ubus, char const * const interface_name, bool const test_run_passed)
+{
+    UNUSED(ubus);
+    UNUSED(interface_name);
+
+    if (test_run_passed)
+    {
+        sim_ubus.test_runs_passed++;
+    }
+    else
+    {
+        sim_ubus.test_runs_failed++;
+    }
+}
+
+void
+ubus_notify_interface_state(
+    interface_st * const iface, interface_notification_t const type, char const * const state)
+{
+    UNUSED(iface);
+    UNUSED(type);
+    UNUSED(state);
+}
+
+void
+ubus_notify_interface_test_run(interface_st * const iface, bool const test_run_passed)
+{
+    UNUSED(iface);
+    UNUSED(test_run_passed);
+}
+
+bool
+interface_request_current_state(
+    struct ubus_context * const ubus,
+    char const * const interface_name,
+    struct ubus_request * const req,
+    ubus_data_handler_t const data_cb,
+    ubus_complete_handler_t const complete_cb,
+    void * const priv)
+{
+    UNUSED(ubus);
+    UNUSED(interface_name);
+    UNUSED(req);
+    UNUSED(data_cb);
+    UNUSED(complete_cb);
+    UNUSED(priv);
+
+    /* The simulator connects the interfaces itself. */
+    return false;
+}
+
+bool
+interface_state_from_status(
+    struct blob_attr * const msg, char * const device, size_t const device_size)
+{
+    UNUSED(msg);
+
+    snprintf(device, device_size, "%s", "");
+
+    return false;
+}
+
+void
+ubus_abort_request(struct ubus_context * const ubus, struct ubus_request * const req)
+{
+    UNUSED(ubus);
+    UNUSED(req);
+}
+
+/* Only logged, by DEBUG builds. libubus isn't linked. */
+const char *
+ubus_strerror(int const error)
+{
+    UNUSED(error);
+
+    return "simulated ubus error";
+}
+
+void
+interface_state_request_failed(struct ubus_context * const ubus, int const status)
+{
+    UNUSED(ubus);
+    UNUSED(status);
+}
+
+#if WITH_METRICS_ADJUSTMENT
+bool
+ubus_send_metrics_adjust_request(
+    struct ubus_context * const ubus,
+    char const * const interface_name,
+    uint32_t * const object_id,
+    uint32_t const amount,
+    struct ubus_request * const req,
+    ubus_complete_handler_t const complete_cb,
+    void * const priv)
+{
+    UNUSED(ubus);
+    UNUSED(interface_name);
+    UNUSED(object_id);
+    UNUSED(amount);
+    UNUSED(priv);
+
+    /* netifd accepts every adjustment straight away. */
+    if (complete_cb != NULL)
+    {
+        complete_cb(req, UBUS_STATUS_OK);
+    }
+
+    return true;
+}
+#endif
+
+void
+ubus_remove_interface_object(interface_st * const iface)
+{
+    UNUSED(iface);
+}
+
+/* Simulated executables always resolve, and are never exec'd. */
+static exec_entry_st sim_exec_entry;
+
+exec_entry_st *
+exec_cache_get(exec_cache_st * const cache, exec_dir_t const dir, char const * const name)
+{
+    UNUSED(cache);
+    UNUSED(dir);
+    UNUSED(name);
+
+    return &sim_exec_entry;
+}
+
+void
+exec_entry_put(exec_entry_st * const entry)
+{
+    UNUSED(entry);
+}
+
+bool
+exec_entry_is_resolved(exec_entry_st const * const entry)
+{
+    UNUSED(entry);
+
+    return true;
+}
+
+int
+exec_entry_fd(exec_entry_st const * const entry)
+{
+    UNUSED(entry);
+
+    return -1;
+}
+
+int
+exec_entry_dir_fd(exec_entry_st const * const entry)
+{
+    UNUSED(entry);
+
+    return -1;
+}
+
+/* ICMP tests aren't simulated. They fail to start, so count as failures. */
+void
+icmp_probe_init(icmp_probe_st * const probe)
+{
+    UNUSED(probe);
+}
+
+bool
+icmp_probe_is_running(icmp_probe_st const * const probe)
+{
+    UNUSED(probe);
+
+    return false;
+}
+
+bool
+icmp_probe_start(
+    icmp_probe_st * const probe,
+    icmp_probe_config_st const * const config,
+    char const * const default_device)
+{
+    UNUSED(probe);
+    UNUSED(config);
+    UNUSED(default_device);
+
+    return false;
+}
+
+void
+icmp_probe_stop(icmp_probe_st * const probe)
+{
+    UNUSED(probe);
+}
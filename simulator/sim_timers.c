@@ -0,0 +1,226 @@
+/*
+ * An implementation of the timers.h API driven by a virtual clock rather than
+ * by uloop. Timers are kept in a hashed timing wheel of one millisecond slots,
+ * with a bitmap of the occupied slots so that the clock can skip straight to
+ * the next slot holding a timer. A slot may also hold timers that expire on a
+ * later revolution of the wheel; they are left where they are until then.
+ * Timers that expire at the same time do so in the order they were started.
+ */
+#include "simulator.h"
+#include "timers.h"
+
+#include <libubox/utils.h>
+
+#define SIM_TIMER_SLOT_BITS 16
+#define SIM_TIMER_SLOTS (1u << SIM_TIMER_SLOT_BITS)
+#define SIM_TIMER_SLOT_MASK (SIM_TIMER_SLOTS - 1)
+#define SIM_TIMER_WORDS (SIM_TIMER_SLOTS / 64)
+
+typedef struct sim_timers_st
+{
+    bool initialised;
+    uint64_t now_msecs;
+    size_t pending;
+    struct list_head slots[SIM_TIMER_SLOTS];
+    uint64_t occupied[SIM_TIMER_WORDS];
+} sim_timers_st;
+
+static sim_timers_st sim_timers;
+
+static void
+sim_timers_init(sim_timers_st * const timers)
+{
+    for (size_t slot = 0; slot < SIM_TIMER_SLOTS; slot++)
+    {
+        INIT_LIST_HEAD(&timers->slots[slot]);
+    }
+    timers->initialised = true;
+}
+
+static void
+slot_set_occupied(sim_timers_st * const timers, unsigned int const slot)
+{
+    timers->occupied[slot / 64] |= UINT64_C(1) << (slot % 64);
+}
+
+static void
+slot_update_occupied(sim_timers_st * const timers, unsigned int const slot)
+{
+    if (list_empty(&timers->slots[slot]))
+    {
+        timers->occupied[slot / 64] &= ~(UINT64_C(1) << (slot % 64));
+    }
+}
+
+/*
+ * Returns the first time at or after the current time whose slot holds a
+ * timer. There must be at least one timer pending.
+ */
+static uint64_t
+next_occupied_msecs(sim_timers_st const * const timers)
+{
+    unsigned int const start_slot = timers->now_msecs & SIM_TIMER_SLOT_MASK;
+    unsigned int word = start_slot / 64;
+    uint64_t bits = timers->occupied[word] & (~UINT64_C(0) << (start_slot % 64));
+
+    /* Wrapping back round to the start word finds the bits before the start. */
+    while (bits == 0)
+    {
+        word = (word + 1) % SIM_TIMER_WORDS;
+        bits = timers->occupied[word];
+    }
+
+    unsigned int const slot = word * 64 + __builtin_ctzll(bits);
+    unsigned int const distance = (slot - start_slot) & SIM_TIMER_SLOT_MASK;
+
+    return timers->now_msecs + distance;
+}
+
+void
+sim_timers_run_until(uint64_t const end_msecs)
+{
+    sim_timers_st * const timers = &sim_timers;
+
+    while (timers->pending > 0)
+    {
+        uint64_t const next_msecs = next_occupied_msecs(timers);
+
+        if (next_msecs > end_msecs)
+        {
+            break;
+        }
+        timers->now_msecs = next_msecs;
+
+        unsigned int const slot = next_msecs & SIM_TIMER_SLOT_MASK;
+        struct list_head due;
+        timer_st * t;
+        timer_st * tmp;
+
+        /*
+         * Timers started by the callbacks that expire now are found on the
+         * next pass, as they would be on the next uloop iteration.
+         */
+        INIT_LIST_HEAD(&due);
+        list_for_each_entry_safe(t, tmp, &timers->slots[slot], list_)
+        {
+            if (t->expires_msecs_ == next_msecs)
+            {
+                list_move_tail(&t->list_, &due);
+            }
+        }
+        slot_update_occupied(timers, slot);
+
+        if (list_empty(&due))
+        {
+            /* The slot only holds timers for a later revolution. */
+            timers->now_msecs++;
+            continue;
+        }
+
+        while (!list_empty(&due))
+        {
+            t = list_first_entry(&due, timer_st, list_);
+            list_del_init(&t->list_);
+            t->pending_ = false;
+            timers->pending--;
+            t->cb_(t);
+        }
+    }
+
+    if (timers->now_msecs < end_msecs)
+    {
+        timers->now_msecs = end_msecs;
+    }
+}
+
+uint64_t
+sim_timers_now_msecs(void)
+{
+    return sim_timers.now_msecs;
+}
+
+size_t
+sim_timers_pending(void)
+{
+    return sim_timers.pending;
+}
+
+void
+timer_stop(timer_st * const t)
+{
+    sim_timers_st * const timers = &sim_timers;
+
+    if (!t->pending_)
+    {
+        goto done;
+    }
+
+    list_del_init(&t->list_);
+    slot_update_occupied(timers, t->expires_msecs_ & SIM_TIMER_SLOT_MASK);
+    t->pending_ = false;
+    timers->pending--;
+
+done:
+    return;
+}
+
+void
+timer_start(timer_st * const t, uint32_t const timeout_msecs)
+{
+    sim_timers_st * const timers = &sim_timers;
+
+    if (!timers->initialised)
+    {
+        sim_timers_init(timers);
+    }
+
+    timer_stop(t);
+
+    t->expires_msecs_ = timers->now_msecs + timeout_msecs;
+
+    unsigned int const slot = t->expires_msecs_ & SIM_TIMER_SLOT_MASK;
+
+    list_add_tail(&t->list_, &timers->slots[slot]);
+    slot_set_occupied(timers, slot);
+    t->pending_ = true;
+    timers->pending++;
+}
+
+bool
+timer_is_running(timer_st const * const t)
+{
+    return t->pending_;
+}
+
+uint64_t
+timer_remaining(timer_st const * const t)
+{
+    uint64_t remaining;
+
+    if (!t->pending_)
+    {
+        remaining = (uint64_t)-1;
+        goto done;
+    }
+
+    remaining = t->expires_msecs_ - sim_timers.now_msecs;
+
+done:
+    return remaining;
+}
+
+char const *
+timer_label(timer_st const * const t)
+{
+    return t->label_;
+}
+
+void
+timer_init(
+    timer_st * const t, char const * const label, timer_expired_fn const expired_timer_cb)
+{
+    INIT_LIST_HEAD(&t->list_);
+    t->pending_ = false;
+    t->label_ = label;
+    t->cb_ = expired_timer_cb;
+}
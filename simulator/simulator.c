@@ -0,0 +1,474 @@
+/*
+ * A discrete-event simulation of many interfaces being tested by the real
+ * tester state machine (interface_tester.c and friends). Time is virtual, test
+ * and recovery "processes" exit after scripted latencies with scripted
+ * results, and the interfaces flap up and down at random, so hours of
+ * operation can be simulated in seconds. The same seed always gives the same
+ * simulation.
+ */
+#include "simulator.h"
+#include "interface_connection.h"
+#include "interface_tester.h"
+#include "strings.h"
+#include "tester_common.h"
+
+#include <libubox/blobmsg.h>
+#include <libubox/ulog.h>
+#include <libubox/utils.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct sim_options_st
+{
+    unsigned int num_interfaces;
+    unsigned int num_tests;
+    uint32_t duration_secs;
+    uint32_t passing_interval_secs;
+    uint32_t failing_interval_secs;
+    uint32_t flap_interval_secs; /* Mean time an interface stays up. 0 for never. */
+    uint32_t down_secs; /* Mean time an interface stays down. */
+    uint32_t test_latency_msecs;
+    uint32_t test_fail_percent;
+    uint32_t test_hang_percent;
+    unsigned int max_processes;
+    uint32_t interval_jitter_percent;
+    bool phase_spreading;
+    bool parallel_tests;
+    uint64_t seed;
+} sim_options_st;
+
+/* An interface, and the link that the simulator brings up and down under it. */
+typedef struct sim_link_st
+{
+    interface_st * iface;
+    timer_st flap_timer;
+    bool is_up;
+    uint64_t flaps;
+} sim_link_st;
+
+typedef struct sim_st
+{
+    sim_options_st options;
+    interface_tester_shared_st ctx;
+    sim_link_st * links;
+} sim_st;
+
+static sim_st sim;
+
+static const success_condition_st all_tests_must_pass =
+{
+    .name = "all_tests_must_pass",
+    .condition = test_run_success_condition_all,
+};
+
+static uint64_t
+timeval_usecs(struct timeval const * const tv)
+{
+    return (uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static uint64_t
+monotonic_usecs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* All of the interfaces share the same test and recovery task definitions. */
+static bool
+sim_config_init(
+    config_definitions_st * const definitions,
+    interface_config_st * const config,
+    sim_options_st const * const options)
+{
+    bool success;
+    struct blob_buf b = { 0 };
+
+    blob_buf_init(&b, 0);
+    blobmsg_close_table(&b, blobmsg_open_table(&b, Sparams));
+
+    test_config_st const test =
+    {
+        .type = TEST_TYPE_EXECUTABLE,
+        .executable_name = "sim_test",
+        .label = "Simulated test",
+        .params = blobmsg_data(b.head),
+    };
+    recovery_config_st const recovery =
+    {
+        .executable_name = "sim_recovery",
+        .label = "Simulated recovery task",
+        .params = blobmsg_data(b.head),
+    };
+
+    config->success_condition = &all_tests_must_pass;
+    config->settling_delay_secs = 5;
+    config->test_passing_interval_secs = options->passing_interval_secs;
+    config->test_failing_interval_secs = options->failing_interval_secs;
+    config->pass_threshold = 3;
+    config->fail_threshold = 3;
+    config->response_timeout_secs = 5;
+    config->parallel_tests = options->parallel_tests;
+    config->interval_jitter_percent = options->interval_jitter_percent;
+    config->phase_spreading = options->phase_spreading;
+
+    config->tests = calloc(options->num_tests, sizeof(*config->tests));
+    config->test_stats = calloc(options->num_tests, sizeof(*config->test_stats));
+    config->recoverys = calloc(1, sizeof(*config->recoverys));
+    config->recovery_stats = calloc(1, sizeof(*config->recovery_stats));
+    if (config->tests == NULL || config->test_stats == NULL
+        || config->recoverys == NULL || config->recovery_stats == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    for (; config->num_tests < options->num_tests; config->num_tests++)
+    {
+        config->tests[config->num_tests] = config_definitions_get_test(definitions, &test);
+        if (config->tests[config->num_tests] == NULL)
+        {
+            success = false;
+            goto done;
+        }
+    }
+
+    config->recoverys[0] = config_definitions_get_recovery(definitions, &recovery);
+    if (config->recoverys[0] == NULL)
+    {
+        success = false;
+        goto done;
+    }
+    config->num_recoverys = 1;
+
+    success = true;
+
+done:
+    blob_buf_free(&b);
+
+    return success;
+}
+
+static void
+flap_timer_expired(timer_st * const t)
+{
+    sim_link_st * const link = container_of(t, sim_link_st, flap_timer);
+    sim_options_st const * const options = &sim.options;
+    interface_connection_st * const connection = &link->iface->connection;
+    uint32_t next_secs;
+
+    link->is_up = !link->is_up;
+    if (link->is_up)
+    {
+        interface_connection_connected(connection);
+        next_secs = sim_random_around(options->flap_interval_secs, options->flap_interval_secs);
+    }
+    else
+    {
+        link->flaps++;
+        interface_connection_disconnected(connection);
+        next_secs = sim_random_around(options->down_secs, options->down_secs);
+    }
+
+    if (link->is_up && options->flap_interval_secs == 0)
+    {
+        /* The link stays up from now on. */
+        goto done;
+    }
+
+    timer_start(t, next_secs * 1000 + sim_random() % 1000);
+
+done:
+    return;
+}
+
+static bool
+sim_interfaces_create(sim_st * const s)
+{
+    sim_options_st const * const options = &s->options;
+    bool success;
+
+    s->links = calloc(options->num_interfaces, sizeof(*s->links));
+    if (s->links == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    for (unsigned int i = 0; i < options->num_interfaces; i++)
+    {
+        sim_link_st * const link = &s->links[i];
+        char name[32];
+
+        snprintf(name, sizeof(name), "sim%u", i);
+        link->iface = interface_tester_alloc(&s->ctx, name);
+        if (link->iface == NULL || !sim_config_init(&s->ctx.definitions, &link->iface->config, options))
+        {
+            success = false;
+            goto done;
+        }
+
+        interface_tester_begin(link->iface);
+
+        /* The links come up at random during the first ten seconds. */
+        timer_init(&link->flap_timer, "sim_flap_timer", flap_timer_expired);
+        timer_start(&link->flap_timer, sim_random() % 10000);
+    }
+
+    success = true;
+
+done:
+    return success;
+}
+
+static void
+sim_interfaces_free(sim_st * const s)
+{
+    if (s->links == NULL)
+    {
+        goto done;
+    }
+
+    for (unsigned int i = 0; i < s->options.num_interfaces; i++)
+    {
+        timer_stop(&s->links[i].flap_timer);
+        interface_tester_free(s->links[i].iface);
+    }
+    free(s->links);
+    s->links = NULL;
+
+done:
+    return;
+}
+
+static void
+sim_report(sim_st const * const s, uint64_t const wall_usecs)
+{
+    sim_options_st const * const options = &s->options;
+    sim_ubus_stats_st const * const ubus = sim_ubus_stats();
+    sim_process_stats_st const * const processes = sim_process_stats();
+    uint64_t const test_runs = ubus->test_runs_passed + ubus->test_runs_failed;
+    uint64_t events = 0;
+    uint64_t max_event_queue = 0;
+    uint64_t flaps = 0;
+    struct rusage usage;
+
+    for (unsigned int i = 0; i < options->num_interfaces; i++)
+    {
+        event_queue_stats_st const * const stats =
+            event_queue_stats(&s->links[i].iface->event_queue);
+
+        events += stats->handled;
+        if (stats->high_water > max_event_queue)
+        {
+            max_event_queue = stats->high_water;
+        }
+        flaps += s->links[i].flaps;
+    }
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    uint64_t const cpu_usecs = timeval_usecs(&usage.ru_utime) + timeval_usecs(&usage.ru_stime);
+
+    printf("interfaces:                %u (%u tests each)\n",
+           options->num_interfaces, options->num_tests);
+    printf("simulated time:            %" PRIu32 " secs\n", options->duration_secs);
+    printf("wall time:                 %.3f secs (%.0fx real time)\n",
+           wall_usecs / 1e6, options->duration_secs * 1e6 / (wall_usecs > 0 ? wall_usecs : 1));
+    printf("cpu time:                  %.3f secs\n", cpu_usecs / 1e6);
+    printf("link flaps:                %" PRIu64 "\n", flaps);
+    printf("test runs:                 %" PRIu64 " (%" PRIu64 " passed, %" PRIu64 " failed)\n",
+           test_runs, ubus->test_runs_passed, ubus->test_runs_failed);
+    printf("operational state changes: %" PRIu64 "\n", ubus->operational_changes);
+    printf("processes:                 %" PRIu64 " started, %" PRIu64 " killed, %zu at once\n",
+           processes->started, processes->killed, processes->max_running);
+    printf("events handled:            %" PRIu64 " (at most %" PRIu64 " queued)\n",
+           events, max_event_queue);
+    printf("cpu usecs per test run:    %.2f\n", test_runs > 0 ? (double)cpu_usecs / test_runs : 0.0);
+    printf("events per cpu second:     %.0f\n", cpu_usecs > 0 ? events * 1e6 / cpu_usecs : 0.0);
+    printf("peak rss:                  %ld KB\n", usage.ru_maxrss);
+}
+
+static void
+usage(FILE * const fp, char const * const progname)
+{
+    fprintf(fp, "Usage: %s [options]\n"
+            "Options:\n"
+            " -i <count>:   Number of interfaces (default 1000)\n"
+            " -t <count>:   Number of tests per interface (default 2)\n"
+            " -d <secs>:    Simulated time (default 3600)\n"
+            " -I <secs>:    Test interval while the tests pass (default 60)\n"
+            " -f <secs>:    Test interval while the tests fail (default 10)\n"
+            " -F <secs>:    Mean time a link stays up (default 600, 0 - never goes down)\n"
+            " -D <secs>:    Mean time a link stays down (default 30)\n"
+            " -l <msecs>:   Mean test latency (default 200)\n"
+            " -p <percent>: Tests that fail (default 5)\n"
+            " -x <percent>: Tests that hang until they time out (default 1)\n"
+            " -j <count>:   Maximum number of processes to run at once (default 0 - no limit)\n"
+            " -J <percent>: Test interval jitter (default 10)\n"
+            " -P:           Spread the first test runs across the interval\n"
+            " -T:           Run the tests in parallel\n"
+            " -s <seed>:    Random number seed (default 1)\n"
+            "\n",
+            progname);
+}
+
+int
+main(int const argc, char * * const argv)
+{
+    sim_options_st * const options = &sim.options;
+    int exit_code = EXIT_FAILURE;
+    int ch;
+
+    scheduler_init(&sim.ctx.scheduler);
+    config_definitions_init(&sim.ctx.definitions, NULL);
+
+    *options = (sim_options_st)
+    {
+        .num_interfaces = 1000,
+        .num_tests = 2,
+        .duration_secs = 3600,
+        .passing_interval_secs = 60,
+        .failing_interval_secs = 10,
+        .flap_interval_secs = 600,
+        .down_secs = 30,
+        .test_latency_msecs = 200,
+        .test_fail_percent = 5,
+        .test_hang_percent = 1,
+        .interval_jitter_percent = 10,
+        .seed = 1,
+    };
+
+    while ((ch = getopt(argc, argv, "i:t:d:I:f:F:D:l:p:x:j:J:PTs:")) != -1)
+    {
+        switch (ch)
+        {
+        case 'i':
+            options->num_interfaces = strtoul(optarg, NULL, 0);
+            break;
+
+        case 't':
+            options->num_tests = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'd':
+            options->duration_secs = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'I':
+            options->passing_interval_secs = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'f':
+            options->failing_interval_secs = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'F':
+            options->flap_interval_secs = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'D':
+            options->down_secs = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'l':
+            options->test_latency_msecs = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'p':
+            options->test_fail_percent = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'x':
+            options->test_hang_percent = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'j':
+            options->max_processes = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'J':
+            options->interval_jitter_percent = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'P':
+            options->phase_spreading = true;
+            break;
+
+        case 'T':
+            options->parallel_tests = true;
+            break;
+
+        case 's':
+            options->seed = strtoull(optarg, NULL, 0);
+            break;
+
+        default:
+            usage(stderr, argv[0]);
+            goto done;
+        }
+    }
+
+    if (options->num_interfaces == 0 || options->num_tests == 0
+        || options->passing_interval_secs == 0 || options->failing_interval_secs == 0
+        || options->interval_jitter_percent > 100)
+    {
+        usage(stderr, argv[0]);
+        goto done;
+    }
+
+    sim_script_st const scripts[] =
+    {
+        {
+            .name = "sim_test",
+            .latency_msecs = options->test_latency_msecs,
+            .latency_jitter_msecs = options->test_latency_msecs / 2,
+            .fail_percent = options->test_fail_percent,
+            .hang_percent = options->test_hang_percent,
+        },
+        {
+            .name = "sim_recovery",
+            .latency_msecs = 2000,
+            .latency_jitter_msecs = 1000,
+        },
+    };
+
+    /* The tester's interval jitter uses random(), so seed that too. */
+    sim_random_seed(options->seed);
+    srandom(options->seed);
+    sim_process_set_scripts(scripts, ARRAY_SIZE(scripts));
+
+    /* The tester logs every test run, which would swamp the results. */
+    ulog_threshold(LOG_WARNING);
+
+    scheduler_set_limit(&sim.ctx.scheduler, options->max_processes);
+
+    uint64_t const start_usecs = monotonic_usecs();
+
+    if (!sim_interfaces_create(&sim))
+    {
+        fprintf(stderr, "unable to create %u interfaces\n", options->num_interfaces);
+        goto done;
+    }
+
+    sim_timers_run_until((uint64_t)options->duration_secs * 1000);
+
+    sim_report(&sim, monotonic_usecs() - start_usecs);
+    exit_code = EXIT_SUCCESS;
+
+done:
+    sim_interfaces_free(&sim);
+    scheduler_cleanup(&sim.ctx.scheduler);
+    sim_process_cleanup();
+
+    return exit_code;
+}
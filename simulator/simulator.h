@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The pieces the simulator substitutes for the event loop, the clock, child
+ * processes and ubus so that the tester state machine can be run
+ * deterministically and much faster than real time.
+ */
+
+/* The virtual clock, in milliseconds since the simulation started. */
+uint64_t
+sim_timers_now_msecs(void);
+
+/*
+ * Expire timers in order of expiry, advancing the virtual clock to each
+ * expiry time in turn, until the clock reaches end_msecs.
+ */
+void
+sim_timers_run_until(uint64_t end_msecs);
+
+size_t
+sim_timers_pending(void);
+
+/* A deterministic source of pseudo-random numbers. */
+void
+sim_random_seed(uint64_t seed);
+
+uint32_t
+sim_random(void);
+
+/* A value spread uniformly over mean +/- jitter. */
+uint32_t
+sim_random_around(uint32_t mean, uint32_t jitter);
+
+bool
+sim_random_percent(uint32_t percent);
+
+/* How a simulated test or recovery task executable behaves. */
+typedef struct sim_script_st
+{
+    char const * name;
+    uint32_t latency_msecs;
+    uint32_t latency_jitter_msecs;
+    uint32_t fail_percent;
+    /* Runs far longer than any response timeout, so is killed. */
+    uint32_t hang_percent;
+} sim_script_st;
+
+void
+sim_process_set_scripts(sim_script_st const * scripts, size_t num_scripts);
+
+typedef struct sim_process_stats_st
+{
+    uint64_t started;
+    uint64_t exited;
+    uint64_t killed;
+    size_t running;
+    size_t max_running;
+} sim_process_stats_st;
+
+sim_process_stats_st const *
+sim_process_stats(void);
+
+void
+sim_process_cleanup(void);
+
+typedef struct sim_ubus_stats_st
+{
+    uint64_t test_runs_passed;
+    uint64_t test_runs_failed;
+    uint64_t operational_changes;
+} sim_ubus_stats_st;
+
+sim_ubus_stats_st const *
+sim_ubus_stats(void);
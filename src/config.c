@@ -20,21 +20,252 @@ ubus_publish_interface_object(interface_st * const iface)
 {
     DLOG("%s: %s", __func__, iface->name);
 
-    return ubus_add_interface_object(iface);
+    /* Otherwise the interface is only reached through the main object. */
+    return !iface->ctx->interface_objects || ubus_add_interface_object(iface);
+}
+
+/* A source's definition of an interface. */
+typedef struct config_source_definition_st
+{
+    struct avl_node node; /* Keyed by the interface name. */
+    uint32_t generation; /* The generation of the source that last defined it. */
+    struct blob_attr * config;
+    struct blob_attr * profile; /* NULL if the interface doesn't use one. */
+} config_source_definition_st;
+
+static int
+interface_handle_config(
+    interface_tester_shared_st * ctx,
+    struct blob_attr * profile,
+    char const * iface_name,
+    struct blob_attr * msg);
+
+static config_source_definition_st *
+config_source_definition_find(config_source_st * const source, char const * const name)
+{
+    config_source_definition_st * definition;
+
+    return avl_find_element(&source->definitions, name, definition, node);
+}
+
+/* Returns true if a source with higher precedence than this one defines the interface. */
+static bool
+config_source_is_overridden(
+    interface_tester_shared_st * const ctx,
+    config_source_st const * const source,
+    char const * const name)
+{
+    config_source_st * other;
+
+    list_for_each_entry(other, &ctx->config_sources, node)
+    {
+        if (other == source)
+        {
+            break;
+        }
+        if (config_source_definition_find(other, name) != NULL)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Configure the interface from the definition with the highest precedence, or
+ * remove it if no source defines it any more.
+ */
+static void
+interface_resolve(interface_tester_shared_st * const ctx, char const * const name)
+{
+    config_source_st * source;
+    config_source_definition_st * definition = NULL;
+
+    list_for_each_entry(source, &ctx->config_sources, node)
+    {
+        definition = config_source_definition_find(source, name);
+        if (definition != NULL)
+        {
+            break;
+        }
+    }
+
+    if (definition != NULL
+        && interface_handle_config(ctx, definition->profile, name, definition->config)
+           == UBUS_STATUS_OK)
+    {
+        goto done;
+    }
+
+    interface_st * const iface = interface_tester_lookup_by_name(ctx, name);
+
+    if (iface != NULL)
+    {
+        if (definition != NULL)
+        {
+            ILOG("%s: %s: the remaining configuration is invalid", __func__, name);
+        }
+        vlist_delete(&ctx->interfaces, &iface->node);
+    }
+
+done:
+    return;
+}
+
+/* Forget the source's definition, and configure the interface from what remains. */
+static void
+config_source_definition_remove(
+    interface_tester_shared_st * const ctx,
+    config_source_st * const source,
+    config_source_definition_st * const definition,
+    bool const resolve)
+{
+    avl_delete(&source->definitions, &definition->node);
+    if (resolve)
+    {
+        interface_resolve(ctx, definition->node.key);
+    }
+    free(definition);
+}
+
+/* Keep the source's definition of the interface, replacing any it had before. */
+static bool
+config_source_definition_set(
+    config_source_st * const source,
+    char const * const name,
+    struct blob_attr * const config,
+    struct blob_attr * const profile)
+{
+    bool success;
+    config_source_definition_st * const existing = config_source_definition_find(source, name);
+
+    if (existing != NULL
+        && blob_attr_equal(existing->config, config)
+        && blob_attr_equal(existing->profile, profile))
+    {
+        existing->generation = source->generation;
+        success = true;
+        goto done;
+    }
+
+    config_source_definition_st * definition;
+    char * definition_name;
+    struct blob_attr * definition_config;
+    struct blob_attr * definition_profile;
+
+    definition = calloc_a(sizeof(*definition),
+                          &definition_name, strlen(name) + 1,
+                          &definition_config, blob_pad_len(config),
+                          &definition_profile, profile != NULL ? blob_pad_len(profile) : 0);
+    if (definition == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    definition->node.key = strcpy(definition_name, name);
+    definition->generation = source->generation;
+    definition->config = memcpy(definition_config, config, blob_pad_len(config));
+    definition->profile =
+        profile != NULL ? memcpy(definition_profile, profile, blob_pad_len(profile)) : NULL;
+
+    if (existing != NULL)
+    {
+        avl_delete(&source->definitions, &existing->node);
+        free(existing);
+    }
+    avl_insert(&source->definitions, &definition->node);
+
+    success = true;
+
+done:
+    return success;
+}
+
+/* Forget the interfaces the source didn't define when it was last loaded. */
+static void
+config_source_remove_stale(
+    interface_tester_shared_st * const ctx, config_source_st * const source)
+{
+    config_source_definition_st * definition;
+    config_source_definition_st * tmp;
+    bool const resolve = true;
+
+    avl_for_each_element_safe(&source->definitions, definition, node, tmp)
+    {
+        if (definition->generation != source->generation)
+        {
+            config_source_definition_remove(ctx, source, definition, resolve);
+        }
+    }
+}
+
+static int
+config_source_cmp(config_source_st const * const a, config_source_st const * const b)
+{
+    if (a->precedence != b->precedence)
+    {
+        return a->precedence < b->precedence ? -1 : 1;
+    }
+
+    return strcmp(a->name != NULL ? a->name : "", b->name != NULL ? b->name : "");
 }
 
 void
-interface_update(interface_tester_shared_st * const ctx)
+config_source_add(interface_tester_shared_st * const ctx, config_source_st * const source)
 {
-    vlist_update(&ctx->interfaces);
+    config_source_st * other;
+
+    /* Keep the sources in order, highest precedence first. */
+    list_for_each_entry(other, &ctx->config_sources, node)
+    {
+        if (config_source_cmp(source, other) > 0)
+        {
+            break;
+        }
+    }
+    list_add_tail(&source->node, &other->node);
 }
 
 void
-interface_flush_old(interface_tester_shared_st * const ctx)
+config_source_remove(interface_tester_shared_st * const ctx, config_source_st * const source)
+{
+    config_unload_source(ctx, source);
+    list_del_init(&source->node);
+}
+
+void
+config_source_cleanup(config_source_st * const source)
+{
+    config_source_definition_st * definition;
+    config_source_definition_st * tmp;
+
+    avl_for_each_element_safe(&source->definitions, definition, node, tmp)
+    {
+        avl_delete(&source->definitions, &definition->node);
+        free(definition);
+    }
+    list_del_init(&source->node);
+}
+
+/*
+ * Returns true if the interface already has the configuration with this hash,
+ * or is waiting to apply it.
+ */
+static bool
+interface_config_is_unchanged(interface_st const * const iface, uint64_t const hash)
 {
-    vlist_flush(&ctx->interfaces);
+    interface_config_st const * const latest_config =
+        iface->pending_config_changes != 0 ? &iface->pending_config : &iface->config;
+
+    return latest_config->content_hash == hash;
 }
 
+/*
+ * The tests and recovery tasks are shared definitions, so they are unchanged
+ * if they are the same definitions.
+ */
 static bool interface_tester_config_tests_changed(
     interface_config_st const * const existing_config,
     interface_config_st const * const new_config)
@@ -49,13 +280,7 @@ static bool interface_tester_config_tests_changed(
 
     for (size_t i = 0; i < existing_config->num_tests; i++)
     {
-        test_config_st const * const existing_test = &existing_config->tests[i];
-        test_config_st const * const new_test = &new_config->tests[i];
-
-        if (strcmp(existing_test->executable_name, new_test->executable_name) != 0
-            || strcmp(existing_test->label, new_test->label) != 0
-            || existing_test->response_timeout_secs != new_test->response_timeout_secs
-            || !blob_attr_equal(existing_test->params, new_test->params))
+        if (existing_config->tests[i] != new_config->tests[i])
         {
             changed = true;
             goto done;
@@ -81,13 +306,7 @@ static bool interface_tester_config_recoverys_changed(
     }
     for (size_t i = 0; i < existing_config->num_recoverys; i++)
     {
-        recovery_config_st const * const existing_recovery = &existing_config->recoverys[i];
-        recovery_config_st const * const new_recovery = &new_config->recoverys[i];
-
-        if (strcmp(existing_recovery->executable_name, new_recovery->executable_name) != 0
-            || strcmp(existing_recovery->label, new_recovery->label) != 0
-            || existing_recovery->response_timeout_secs != new_recovery->response_timeout_secs
-            || !blob_attr_equal(existing_recovery->params, new_recovery->params))
+        if (existing_config->recoverys[i] != new_config->recoverys[i])
         {
             changed = true;
             goto done;
@@ -100,48 +319,76 @@ done:
     return changed;
 }
 
-static void
-config_update(interface_st * const existing_iface, interface_st * const new_iface)
+static unsigned int
+interface_config_changes(
+    interface_config_st const * const existing_config,
+    interface_config_st const * const new_config)
 {
-    /*
-     * Update any of the configuration that has changed.
-     * If anything has changed, restart the tester.
-     */
-    interface_config_st * const existing_config = &existing_iface->config;
-    interface_config_st * const new_config = &new_iface->config;
-
-    ILOG("%s: %s", __func__, existing_iface->name);
-
-    bool changed =
-        existing_config->success_condition != new_config->success_condition
-        || existing_config->settling_delay_secs != new_config->settling_delay_secs
-        || existing_config->test_passing_interval_secs
-        != new_config->test_passing_interval_secs
-        || existing_config->test_failing_interval_secs
-        != new_config->test_failing_interval_secs
-        || existing_config->pass_threshold != new_config->pass_threshold
-        || existing_config->fail_threshold != new_config->fail_threshold
+    unsigned int changes = 0;
+
+    if (existing_config->test_passing_interval_secs != new_config->test_passing_interval_secs
+        || existing_config->test_failing_interval_secs != new_config->test_failing_interval_secs
+        || existing_config->interval_jitter_percent != new_config->interval_jitter_percent)
+    {
+        changes |= INTERFACE_CONFIG_CHANGE_INTERVALS;
+    }
+
+    if (existing_config->pass_threshold != new_config->pass_threshold
+        || existing_config->fail_threshold != new_config->fail_threshold)
+    {
+        changes |= INTERFACE_CONFIG_CHANGE_THRESHOLDS;
+    }
+
+    /* Anything that affects how a test run is carried out. */
+    if (existing_config->success_condition != new_config->success_condition
         || existing_config->response_timeout_secs != new_config->response_timeout_secs
+        || existing_config->parallel_tests != new_config->parallel_tests
+        || interface_tester_config_tests_changed(existing_config, new_config))
+    {
+        changes |= INTERFACE_CONFIG_CHANGE_TESTS;
+    }
+
+    if (interface_tester_config_recoverys_changed(existing_config, new_config))
+    {
+        changes |= INTERFACE_CONFIG_CHANGE_RECOVERYS;
+    }
+
+    if (existing_config->scheduler_priority != new_config->scheduler_priority)
+    {
+        changes |= INTERFACE_CONFIG_CHANGE_SCHEDULER_PRIORITY;
+    }
+
 #if WITH_METRICS_ADJUSTMENT
-        || existing_config->failing_tests_metrics_increase != new_config->failing_tests_metrics_increase
+    if (existing_config->failing_tests_metrics_increase != new_config->failing_tests_metrics_increase)
+    {
+        changes |= INTERFACE_CONFIG_CHANGE_METRICS;
+    }
 #endif
-        || existing_config->num_tests != new_config->num_tests
-        || interface_tester_config_tests_changed(existing_config, new_config)
-        || interface_tester_config_recoverys_changed(existing_config, new_config);
 
-    if (changed)
+    if (existing_config->settling_delay_secs != new_config->settling_delay_secs
+        || existing_config->phase_spreading != new_config->phase_spreading)
     {
-        /*
-         * Replace the old config with the new_config and ensure the new config
-         * is cleared from the new interface to ensure that any memory allocated
-         * by it isn't freed when the new instance is freed.
-         */
-        interface_tester_stop(existing_iface);
-        interface_tester_config_free(existing_config);
-        *existing_config = *new_config;
-        memset(new_config, 0, sizeof(*new_config));
-        interface_tester_start(existing_iface);
+        changes |= INTERFACE_CONFIG_CHANGE_OTHER;
     }
+
+    return changes;
+}
+
+static void
+config_update(interface_st * const existing_iface, interface_st * const new_iface)
+{
+    /*
+     * Update any of the configuration that has changed. The tester only acts on
+     * the parts that have changed, rather than being restarted.
+     * Whatever the existing interface no longer needs is left in the new
+     * interface, to be freed along with it.
+     */
+    unsigned int const changes =
+        interface_config_changes(&existing_iface->config, &new_iface->config);
+
+    ILOG("%s: %s: changes: 0x%x", __func__, existing_iface->name, changes);
+
+    interface_tester_reconfigure(existing_iface, &new_iface->config, changes);
 }
 
 static void
@@ -151,6 +398,7 @@ config_add(interface_st * const iface)
 
     ubus_publish_interface_object(iface);
     interface_tester_begin(iface);
+    iface->ctx->membership_generation = iface->state_generation;
 }
 
 static void
@@ -158,7 +406,10 @@ config_remove(interface_st * const iface)
 {
     ILOG("%s: %s", __func__, iface->name);
 
+    interface_tester_shared_st * const ctx = iface->ctx;
+
     interface_tester_free(iface);
+    ctx->membership_generation = ++ctx->state_generation;
 }
 
 static void
@@ -208,6 +459,7 @@ interface_update_cb(
 
 typedef enum interface_test_config_policy_t
 {
+    INTERFACE_TEST_CONFIG_TYPE,
     INTERFACE_TEST_CONFIG_EXECUTABLE,
     INTERFACE_TEST_CONFIG_LABEL,
     INTERFACE_TEST_CONFIG_RESPONSE_TIMEOUT,
@@ -217,67 +469,107 @@ typedef enum interface_test_config_policy_t
 
 static const struct blobmsg_policy interface_test_config_policy[INTERFACE_TEST_CONFIG_COUNT] =
 {
+    [INTERFACE_TEST_CONFIG_TYPE] = {.name = Stype, .type = BLOBMSG_TYPE_STRING },
     [INTERFACE_TEST_CONFIG_EXECUTABLE] = {.name = Sexecutable, .type = BLOBMSG_TYPE_STRING },
     [INTERFACE_TEST_CONFIG_LABEL] = {.name = Slabel, .type = BLOBMSG_TYPE_STRING },
     [INTERFACE_TEST_CONFIG_RESPONSE_TIMEOUT] = {.name = Sresponse_timeout_secs, .type = BLOBMSG_TYPE_INT32 },
     [INTERFACE_TEST_CONFIG_PARAMS] = {.name = Sparams, .type = BLOBMSG_TYPE_TABLE },
 };
 
-static bool add_test_configuration(
-    test_config_st * const config, struct blob_attr * const test, size_t const index)
+static bool
+test_type_from_name(char const * const name, test_type_t * const type)
 {
-    bool success;
+    for (size_t i = 0; i < TEST_TYPE_COUNT__; i++)
+    {
+        if (strcmp(name, test_type_to_str(i)) == 0)
+        {
+            *type = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Tests and recovery tasks without params are given an empty "params" object
+ * just so it isn't NULL.
+ */
+static struct blob_attr *
+empty_params(struct blob_buf * const b)
+{
+    blob_buf_init(b, 0);
+    blobmsg_close_table(b, blobmsg_open_table(b, Sparams));
+
+    return blobmsg_data(b->head);
+}
+
+static test_config_st *
+get_test_configuration(config_definitions_st * const definitions, struct blob_attr * const test)
+{
+    test_config_st * definition = NULL;
     struct blob_attr * tb[INTERFACE_TEST_CONFIG_COUNT];
+    test_config_st config = { .type = TEST_TYPE_EXECUTABLE };
+    struct blob_buf b = { 0 };
 
     blobmsg_parse(interface_test_config_policy, ARRAY_SIZE(tb), tb,
                   blobmsg_data(test), blobmsg_data_len(test));
 
-    if (tb[INTERFACE_TEST_CONFIG_EXECUTABLE] == NULL)
+    if (tb[INTERFACE_TEST_CONFIG_TYPE] != NULL
+        && !test_type_from_name(blobmsg_get_string(tb[INTERFACE_TEST_CONFIG_TYPE]), &config.type))
     {
-        success = false;
+        DLOG("unknown test type: %s", blobmsg_get_string(tb[INTERFACE_TEST_CONFIG_TYPE]));
+
         goto done;
     }
 
-    char const * const label =
-        tb[INTERFACE_TEST_CONFIG_LABEL] == NULL
-        ? ""
-        : blobmsg_get_string(tb[INTERFACE_TEST_CONFIG_LABEL]);
-
-    config->index = index;
-    config->executable_name = strdup(blobmsg_get_string(tb[INTERFACE_TEST_CONFIG_EXECUTABLE]));
-    config->label = strdup(label);
-    if (tb[INTERFACE_TEST_CONFIG_RESPONSE_TIMEOUT] != NULL)
-    {
-        config->response_timeout_secs = blobmsg_get_u32(tb[INTERFACE_TEST_CONFIG_RESPONSE_TIMEOUT]);
-    }
-    else
+    if (config.type == TEST_TYPE_EXECUTABLE && tb[INTERFACE_TEST_CONFIG_EXECUTABLE] == NULL)
     {
-        config->response_timeout_secs = 0;
+        goto done;
     }
-    if (tb[INTERFACE_TEST_CONFIG_PARAMS] != NULL)
+
+    if (config.type == TEST_TYPE_ICMP
+        && (tb[INTERFACE_TEST_CONFIG_PARAMS] == NULL
+            || !icmp_probe_config_parse(&config.icmp, tb[INTERFACE_TEST_CONFIG_PARAMS])))
     {
-        config->params = blob_memdup(tb[INTERFACE_TEST_CONFIG_PARAMS]);
+        goto done;
     }
-    else
-    {
-        /* Add an empty "params" object just so it isn't NULL. */
-        struct blob_buf b = { 0 };
 
-        blob_buf_init(&b, 0);
-        blobmsg_close_table(&b, blobmsg_open_table(&b, Sparams));
-        config->params = blob_memdup(blobmsg_data(b.head));
-        blob_buf_free(&b);
+    config.label =
+        tb[INTERFACE_TEST_CONFIG_LABEL] == NULL
+        ? ""
+        : blobmsg_get_string(tb[INTERFACE_TEST_CONFIG_LABEL]);
+    config.executable_name =
+        config.type == TEST_TYPE_EXECUTABLE
+        ? blobmsg_get_string(tb[INTERFACE_TEST_CONFIG_EXECUTABLE])
+        : "";
+    if (tb[INTERFACE_TEST_CONFIG_RESPONSE_TIMEOUT] != NULL)
+    {
+        config.response_timeout_secs = blobmsg_get_u32(tb[INTERFACE_TEST_CONFIG_RESPONSE_TIMEOUT]);
     }
+    config.params =
+        tb[INTERFACE_TEST_CONFIG_PARAMS] != NULL
+        ? tb[INTERFACE_TEST_CONFIG_PARAMS]
+        : empty_params(&b);
 
-    success = true;
+    /*
+     * An executable that can't be resolved doesn't invalidate the
+     * configuration. It may turn up later, and in the meantime it is reported
+     * in the configuration dump, and treated as failing if it is run.
+     */
+    definition = config_definitions_get_test(definitions, &config);
 
 done:
-    return success;
+    blob_buf_free(&b);
+
+    return definition;
 }
 
 static bool
 add_test_configurations(
-    interface_config_st * const config, struct blob_attr * const tests)
+    config_definitions_st * const definitions,
+    interface_config_st * const config,
+    struct blob_attr * const tests)
 {
     bool success;
 
@@ -302,16 +594,25 @@ add_test_configurations(
 
     config->num_tests = 0;
     config->tests = calloc(num_tests, sizeof(*config->tests));
+    config->test_stats = calloc(num_tests, sizeof(*config->test_stats));
+    if (config->tests == NULL || config->test_stats == NULL)
+    {
+        success = false;
+        goto done;
+    }
 
     blobmsg_for_each_attr(cur, tests, rem)
     {
-        if (!add_test_configuration(&config->tests[config->num_tests], cur, config->num_tests))
+        test_config_st * const test = get_test_configuration(definitions, cur);
+
+        if (test == NULL)
         {
             DLOG("failed to add test %zu", config->num_tests);
 
             success = false;
             goto done;
         }
+        config->tests[config->num_tests] = test;
         config->num_tests++;
     }
 
@@ -338,60 +639,49 @@ static const struct blobmsg_policy interface_recovery_config_policy[INTERFACE_RE
     [INTERFACE_RECOVERY_CONFIG_PARAMS] = { .name = Sparams, .type = BLOBMSG_TYPE_TABLE },
 };
 
-static bool add_recovery_configuration(
-    recovery_config_st * const config, struct blob_attr * const recovery, size_t const index)
+static recovery_config_st *
+get_recovery_configuration(
+    config_definitions_st * const definitions, struct blob_attr * const recovery)
 {
-    bool success;
+    recovery_config_st * definition = NULL;
     struct blob_attr * tb[INTERFACE_RECOVERY_CONFIG_COUNT];
+    recovery_config_st config = { 0 };
+    struct blob_buf b = { 0 };
 
     blobmsg_parse(interface_recovery_config_policy, ARRAY_SIZE(tb), tb,
                   blobmsg_data(recovery), blobmsg_data_len(recovery));
 
     if (tb[INTERFACE_RECOVERY_CONFIG_EXECUTABLE] == NULL)
     {
-        success = false;
         goto done;
     }
 
-    char const * const label = tb[INTERFACE_RECOVERY_CONFIG_LABEL] == NULL
+    config.label = tb[INTERFACE_RECOVERY_CONFIG_LABEL] == NULL
         ? ""
         : blobmsg_get_string(tb[INTERFACE_RECOVERY_CONFIG_LABEL]);
-
-    config->index = index;
-    config->executable_name = strdup(blobmsg_get_string(tb[INTERFACE_RECOVERY_CONFIG_EXECUTABLE]));
-    config->label = strdup(label);
+    config.executable_name = blobmsg_get_string(tb[INTERFACE_RECOVERY_CONFIG_EXECUTABLE]);
     if (tb[INTERFACE_RECOVERY_CONFIG_RESPONSE_TIMEOUT] != NULL)
     {
-        config->response_timeout_secs = blobmsg_get_u32(tb[INTERFACE_RECOVERY_CONFIG_RESPONSE_TIMEOUT]);
-    }
-    else
-    {
-        config->response_timeout_secs = 0;
-    }
-    if (tb[INTERFACE_RECOVERY_CONFIG_PARAMS] != NULL)
-    {
-        config->params = blob_memdup(tb[INTERFACE_RECOVERY_CONFIG_PARAMS]);
-    }
-    else
-    {
-        /* Add an empty "params" object just so it isn't NULL. */
-        struct blob_buf b = { 0 };
-
-        blob_buf_init(&b, 0);
-        blobmsg_close_table(&b, blobmsg_open_table(&b, Sparams));
-        config->params = blob_memdup(blobmsg_data(b.head));
-        blob_buf_free(&b);
+        config.response_timeout_secs = blobmsg_get_u32(tb[INTERFACE_RECOVERY_CONFIG_RESPONSE_TIMEOUT]);
     }
+    config.params =
+        tb[INTERFACE_RECOVERY_CONFIG_PARAMS] != NULL
+        ? tb[INTERFACE_RECOVERY_CONFIG_PARAMS]
+        : empty_params(&b);
 
-    success = true;
+    definition = config_definitions_get_recovery(definitions, &config);
 
 done:
-    return success;
+    blob_buf_free(&b);
+
+    return definition;
 }
 
 static bool
 add_recovery_configurations(
-    interface_config_st * const config, struct blob_attr * const recoverys)
+    config_definitions_st * const definitions,
+    interface_config_st * const config,
+    struct blob_attr * const recoverys)
 {
     bool success;
 
@@ -415,16 +705,25 @@ add_recovery_configurations(
 
     config->num_recoverys = 0;
     config->recoverys = calloc(num_recoverys, sizeof(*config->recoverys));
+    config->recovery_stats = calloc(num_recoverys, sizeof(*config->recovery_stats));
+    if (num_recoverys > 0 && (config->recoverys == NULL || config->recovery_stats == NULL))
+    {
+        success = false;
+        goto done;
+    }
 
     blobmsg_for_each_attr(cur, recoverys, rem)
     {
-        if (!add_recovery_configuration(&config->recoverys[config->num_recoverys], cur, config->num_recoverys))
+        recovery_config_st * const recovery = get_recovery_configuration(definitions, cur);
+
+        if (recovery == NULL)
         {
             DLOG("failed to add recovery %zu", config->num_recoverys);
 
             success = false;
             goto done;
         }
+        config->recoverys[config->num_recoverys] = recovery;
         config->num_recoverys++;
     }
 
@@ -473,7 +772,8 @@ interface_config_validate(interface_config_st const * const config)
         && config->test_passing_interval_secs > 0
         && config->test_failing_interval_secs > 0
         && config->pass_threshold > 0
-        && config->fail_threshold > 0;
+        && config->fail_threshold > 0
+        && config->interval_jitter_percent <= 100;
 
     return is_valid;
 }
@@ -492,6 +792,12 @@ typedef enum interface_config_policy_t
 #if WITH_METRICS_ADJUSTMENT
     INTERFACE_CONFIG_FAILING_TESTS_METRICS_INCREASE,
 #endif
+    INTERFACE_CONFIG_REQUIRED_COUNT, /* Any entries after this are optional. */
+    INTERFACE_CONFIG_PARALLEL_TESTS = INTERFACE_CONFIG_REQUIRED_COUNT,
+    INTERFACE_CONFIG_SCHEDULER_PRIORITY,
+    INTERFACE_CONFIG_INTERVAL_JITTER_PERCENT,
+    INTERFACE_CONFIG_PHASE_SPREADING,
+    INTERFACE_CONFIG_PROFILE,
     INTERFACE_CONFIG_COUNT,
 } interface_config_policy_t;
 
@@ -519,23 +825,90 @@ static const struct blobmsg_policy interface_config_policy[INTERFACE_CONFIG_COUN
     [INTERFACE_CONFIG_FAILING_TESTS_METRICS_INCREASE] =
         {.name = Sfailing_tests_metrics_increase, .type = BLOBMSG_TYPE_INT32 },
 #endif
+    [INTERFACE_CONFIG_PARALLEL_TESTS] =
+        {.name = Sparallel_tests, .type = BLOBMSG_TYPE_BOOL },
+    [INTERFACE_CONFIG_SCHEDULER_PRIORITY] =
+        {.name = Sscheduler_priority, .type = BLOBMSG_TYPE_INT32 },
+    [INTERFACE_CONFIG_INTERVAL_JITTER_PERCENT] =
+        {.name = Sinterval_jitter_percent, .type = BLOBMSG_TYPE_INT32 },
+    [INTERFACE_CONFIG_PHASE_SPREADING] =
+        {.name = Sphase_spreading, .type = BLOBMSG_TYPE_BOOL },
+    [INTERFACE_CONFIG_PROFILE] =
+        {.name = Sprofile, .type = BLOBMSG_TYPE_STRING },
 };
 
-static int
-interface_handle_config(
-    interface_tester_shared_st * const ctx, struct blob_attr * const msg)
+static struct blob_attr *
+profile_lookup(struct blob_attr * const profiles, char const * const name)
 {
-    int res = UBUS_STATUS_INVALID_ARGUMENT;
-    interface_st * iface = NULL;
-    char const * const iface_name = blobmsg_name(msg);
+    struct blob_attr * profile = NULL;
+    struct blob_attr * cur;
+    size_t rem;
 
-    if (iface_name == NULL)
+    blobmsg_for_each_attr(cur, profiles, rem)
     {
-        DLOG("%s: failed to get interface name", __func__);
+        if (blobmsg_type(cur) == BLOBMSG_TYPE_TABLE && strcmp(blobmsg_name(cur), name) == 0)
+        {
+            profile = cur;
+            break;
+        }
+    }
+
+    return profile;
+}
+
+/*
+ * An interface may name a profile, from the same configuration, that supplies
+ * any parameters the interface doesn't set itself. Returns false if the
+ * profile it names doesn't exist.
+ */
+static bool
+interface_config_profile(
+    struct blob_attr * const profiles,
+    char const * const iface_name,
+    struct blob_attr * const msg,
+    struct blob_attr * * const profile)
+{
+    static const struct blobmsg_policy profile_policy =
+        { .name = Sprofile, .type = BLOBMSG_TYPE_STRING };
+    bool success;
+    struct blob_attr * profile_name_attr;
 
+    *profile = NULL;
+    blobmsg_parse(&profile_policy, 1, &profile_name_attr, blobmsg_data(msg), blobmsg_data_len(msg));
+    if (profile_name_attr == NULL)
+    {
+        success = true;
+        goto done;
+    }
+
+    char const * const profile_name = blobmsg_get_string(profile_name_attr);
+
+    *profile = profiles != NULL ? profile_lookup(profiles, profile_name) : NULL;
+    if (*profile == NULL)
+    {
+        ILOG("%s: %s: unknown profile: %s", __func__, iface_name, profile_name);
+
+        success = false;
         goto done;
     }
 
+    success = true;
+
+done:
+    return success;
+}
+
+/* Configure the interface. profile is the one it names, if any. */
+static int
+interface_handle_config(
+    interface_tester_shared_st * const ctx,
+    struct blob_attr * const profile,
+    char const * const iface_name,
+    struct blob_attr * const msg)
+{
+    int res = UBUS_STATUS_INVALID_ARGUMENT;
+    interface_st * iface = NULL;
+
     struct blob_attr * tb[INTERFACE_CONFIG_COUNT];
     res = blobmsg_parse(interface_config_policy, INTERFACE_CONFIG_COUNT,
                         tb, blobmsg_data(msg), blobmsg_data_len(msg));
@@ -546,7 +919,37 @@ interface_handle_config(
         goto done;
     }
 
-    for (size_t i = 0; i < ARRAY_SIZE(tb); i++)
+    uint64_t hash = config_content_hash(blobmsg_data(msg), blobmsg_data_len(msg));
+
+    if (profile != NULL)
+    {
+        struct blob_attr * profile_tb[INTERFACE_CONFIG_COUNT];
+
+        blobmsg_parse(interface_config_policy, INTERFACE_CONFIG_COUNT,
+                      profile_tb, blobmsg_data(profile), blobmsg_data_len(profile));
+        for (size_t i = 0; i < INTERFACE_CONFIG_COUNT; i++)
+        {
+            if (tb[i] == NULL)
+            {
+                tb[i] = profile_tb[i];
+            }
+        }
+
+        /* The interface changes if its profile does. */
+        hash = config_content_hash_update(hash, blobmsg_data(profile), blobmsg_data_len(profile));
+    }
+
+    interface_st * const existing_iface = interface_tester_lookup_by_name(ctx, iface_name);
+
+    if (existing_iface != NULL && interface_config_is_unchanged(existing_iface, hash))
+    {
+        DLOG("%s: %s: configuration unchanged", __func__, iface_name);
+
+        res = UBUS_STATUS_OK;
+        goto done;
+    }
+
+    for (size_t i = 0; i < INTERFACE_CONFIG_REQUIRED_COUNT; i++)
     {
         if (tb[i] == NULL)
         {
@@ -559,6 +962,8 @@ interface_handle_config(
     iface = interface_tester_alloc(ctx, iface_name);
     interface_config_st * const config = &iface->config;
 
+    config->content_hash = hash;
+
     config->success_condition =
         success_condition_from_name(blobmsg_get_string(tb[INTERFACE_CONFIG_SUCCESS_CONDITION]));
 
@@ -571,15 +976,30 @@ interface_handle_config(
 #if WITH_METRICS_ADJUSTMENT
     config->failing_tests_metrics_increase = blobmsg_get_u32(tb[INTERFACE_CONFIG_FAILING_TESTS_METRICS_INCREASE]);
 #endif
-
-    if (!add_test_configurations(config, tb[INTERFACE_CONFIG_TESTS]))
+    config->parallel_tests =
+        tb[INTERFACE_CONFIG_PARALLEL_TESTS] != NULL
+        && blobmsg_get_bool(tb[INTERFACE_CONFIG_PARALLEL_TESTS]);
+    config->scheduler_priority =
+        tb[INTERFACE_CONFIG_SCHEDULER_PRIORITY] != NULL
+        ? blobmsg_get_u32(tb[INTERFACE_CONFIG_SCHEDULER_PRIORITY])
+        : 0;
+    config->interval_jitter_percent =
+        tb[INTERFACE_CONFIG_INTERVAL_JITTER_PERCENT] != NULL
+        ? blobmsg_get_u32(tb[INTERFACE_CONFIG_INTERVAL_JITTER_PERCENT])
+        : ctx->interval_jitter_percent;
+    config->phase_spreading =
+        tb[INTERFACE_CONFIG_PHASE_SPREADING] != NULL
+        ? blobmsg_get_bool(tb[INTERFACE_CONFIG_PHASE_SPREADING])
+        : ctx->phase_spreading;
+
+    if (!add_test_configurations(&ctx->definitions, config, tb[INTERFACE_CONFIG_TESTS]))
     {
         DLOG("failed to add test configuration");
 
         goto done;
     }
 
-    if (!add_recovery_configurations(config, tb[INTERFACE_CONFIG_RECOVERY]))
+    if (!add_recovery_configurations(&ctx->definitions, config, tb[INTERFACE_CONFIG_RECOVERY]))
     {
         DLOG("failed to add recovery configuration");
 
@@ -593,9 +1013,13 @@ interface_handle_config(
         goto done;
     }
 
+    /*
+     * If the interface already exists the new instance is freed once its
+     * configuration has been taken over.
+     */
     vlist_add(&ctx->interfaces, &iface->node, iface->name);
-
     iface = NULL;
+
     res = UBUS_STATUS_OK;
 
 done:
@@ -606,6 +1030,7 @@ done:
 typedef enum interface_tester_config_policy_t
 {
     INTERFACE_TESTER_CONFIG,
+    INTERFACE_TESTER_PROFILES,
     INTERFACE_TESTER_COUNT,
 } interface_tester_config_policy_t;
 
@@ -613,11 +1038,65 @@ static const struct blobmsg_policy
     interface_tester_config_policy[INTERFACE_TESTER_COUNT] =
 {
     [INTERFACE_TESTER_CONFIG] = { .name = "interfaces", .type = BLOBMSG_TYPE_TABLE },
+    [INTERFACE_TESTER_PROFILES] = { .name = Sprofiles, .type = BLOBMSG_TYPE_TABLE },
 };
 
+/*
+ * Keep the source's definition of the interface, and configure the interface
+ * from it unless a source with higher precedence also defines the interface.
+ * A definition that is used but invalid isn't kept.
+ */
+static int
+config_source_define(
+    interface_tester_shared_st * const ctx,
+    config_source_st * const source,
+    struct blob_attr * const profiles,
+    char const * const iface_name,
+    struct blob_attr * const msg)
+{
+    int res;
+    struct blob_attr * profile;
+
+    if (iface_name == NULL || iface_name[0] == '\0')
+    {
+        DLOG("%s: failed to get interface name", __func__);
+
+        res = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    if (!interface_config_profile(profiles, iface_name, msg, &profile))
+    {
+        res = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    if (config_source_is_overridden(ctx, source, iface_name))
+    {
+        DLOG("%s: %s: overridden by another source", __func__, iface_name);
+    }
+    else
+    {
+        res = interface_handle_config(ctx, profile, iface_name, msg);
+        if (res != UBUS_STATUS_OK)
+        {
+            goto done;
+        }
+    }
+
+    res = config_source_definition_set(source, iface_name, msg, profile)
+        ? UBUS_STATUS_OK
+        : UBUS_STATUS_UNKNOWN_ERROR;
+
+done:
+    return res;
+}
+
 bool
-config_load_config(
-    interface_tester_shared_st * const ctx, struct blob_attr * const config)
+config_load_source(
+    interface_tester_shared_st * const ctx,
+    config_source_st * const source,
+    struct blob_attr * const config)
 {
     bool success;
     struct blob_attr * cur;
@@ -633,11 +1112,12 @@ config_load_config(
     if (tb[INTERFACE_TESTER_CONFIG] == NULL
         || blobmsg_type(tb[INTERFACE_TESTER_CONFIG]) != BLOBMSG_TYPE_TABLE)
     {
+        /* Leave the interfaces as they are. */
         success = false;
         goto done;
     }
 
-    interface_update(ctx);
+    source->generation++;
 
     blobmsg_for_each_attr(cur, tb[INTERFACE_TESTER_CONFIG], rem)
     {
@@ -645,7 +1125,7 @@ config_load_config(
             || !blobmsg_check_attr(cur, true))
         {
             success = false;
-            goto done;
+            goto remove_stale;
         }
         /*
          * Individual interfaces are not added if their configuration is
@@ -653,46 +1133,87 @@ config_load_config(
          * This is not enough to prevent other interfaces from being added
          * though.
          */
-        interface_handle_config(ctx, cur);
+        config_source_define(
+            ctx, source, tb[INTERFACE_TESTER_PROFILES], blobmsg_name(cur), cur);
     }
 
     success = true;
 
-done:
-    interface_flush_old(ctx);
+remove_stale:
+    config_source_remove_stale(ctx, source);
 
+done:
     return success;
 }
 
 void
-config_load_from_file_check(interface_tester_shared_st * const ctx)
+config_unload_source(interface_tester_shared_st * const ctx, config_source_st * const source)
 {
-    char const * const config_file = ctx->config_file;
+    DLOG("%s", __func__);
 
-    DLOG("Config file: %s", config_file);
+    source->generation++;
+    config_source_remove_stale(ctx, source);
+}
 
-    if (config_file == NULL)
-    {
-        goto done;
-    }
+int
+config_set_interface(
+    interface_tester_shared_st * const ctx,
+    config_source_st * const source,
+    struct blob_attr * const profiles,
+    char const * const name,
+    struct blob_attr * const config)
+{
+    DLOG("%s: %s", __func__, name);
 
-    struct blob_buf b = { 0 };
+    return config_source_define(ctx, source, profiles, name, config);
+}
+
+int
+config_delete_interface(interface_tester_shared_st * const ctx, char const * const name)
+{
+    int res;
+    interface_st * const iface = interface_tester_lookup_by_name(ctx, name);
+    config_source_st * source;
+    bool const resolve = false;
 
-    blob_buf_init(&b, 0);
+    DLOG("%s: %s", __func__, name);
 
-    if (!blobmsg_add_json_from_file(&b, config_file))
+    list_for_each_entry(source, &ctx->config_sources, node)
     {
-        DLOG("Failed to load config from: %s", config_file);
+        config_source_definition_st * const definition =
+            config_source_definition_find(source, name);
+
+        if (definition != NULL)
+        {
+            config_source_definition_remove(ctx, source, definition, resolve);
+        }
     }
-    else if (!config_load_config(ctx, b.head))
+
+    if (iface == NULL)
     {
-        DLOG("Failed to load config blob");
+        res = UBUS_STATUS_NOT_FOUND;
+        goto done;
     }
 
-    blob_buf_free(&b);
+    vlist_delete(&ctx->interfaces, &iface->node);
+    res = UBUS_STATUS_OK;
 
 done:
-    return;
+    return res;
+}
+
+bool
+config_load_config(
+    interface_tester_shared_st * const ctx, struct blob_attr * const config)
+{
+    return config_load_source(ctx, &ctx->config_source, config);
+}
+
+void
+config_cleanup(interface_tester_shared_st * const ctx)
+{
+    config_source_cleanup(&ctx->config_source);
+    config_source_cleanup(&ctx->ubus_source);
 }
 
 void
@@ -702,5 +1223,9 @@ config_init(interface_tester_shared_st * const ctx)
 
     vlist_init(interfaces, avl_strcmp, interface_update_cb);
     interfaces->keep_old = true;
+    INIT_LIST_HEAD(&ctx->config_sources);
+    config_source_init(&ctx->config_source, CONFIG_SOURCE_PRECEDENCE_FILE, NULL);
+    config_source_add(ctx, &ctx->config_source);
+    config_source_init(&ctx->ubus_source, CONFIG_SOURCE_PRECEDENCE_UBUS, NULL);
+    config_source_add(ctx, &ctx->ubus_source);
 }
-
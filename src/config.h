@@ -1,24 +1,68 @@
 #pragma once
 
+#include "config_hash.h"
+#include "config_source.h"
 #include "shared.h"
 
 #include <libubox/blob.h>
 
+#include <stddef.h>
+#include <stdint.h>
+
+/* Add the source to the sources the interfaces are configured from. */
+void
+config_source_add(interface_tester_shared_st * ctx, config_source_st * source);
+
+/*
+ * Remove the source, along with its definitions. The interfaces it defined
+ * are configured from the definitions that remain, if any.
+ */
 void
-interface_update(interface_tester_shared_st * ctx);
+config_source_remove(interface_tester_shared_st * ctx, config_source_st * source);
 
+/* Forget the source's definitions without touching the interfaces. */
 void
-interface_flush_old(interface_tester_shared_st * ctx);
+config_source_cleanup(config_source_st * source);
 
+/*
+ * Load the interfaces defined by the configuration into the source. The
+ * interfaces the source defined last time but no longer does are configured
+ * from the definitions of other sources, or removed if there are none.
+ */
 bool
-config_load_config(interface_tester_shared_st * ctx, struct blob_attr * config);
+config_load_source(
+    interface_tester_shared_st * ctx, config_source_st * source, struct blob_attr * config);
 
+/* Forget all of the source's definitions, as though it were loaded empty. */
 void
-config_load_from_file_check(interface_tester_shared_st * ctx);
+config_unload_source(interface_tester_shared_st * ctx, config_source_st * source);
+
+/*
+ * Add or update the source's definition of a single interface without
+ * affecting any of the others. profiles holds the profiles the interface may
+ * refer to, and may be NULL. Returns a ubus status code.
+ */
+int
+config_set_interface(
+    interface_tester_shared_st * ctx,
+    config_source_st * source,
+    struct blob_attr * profiles,
+    char const * name,
+    struct blob_attr * config);
+
+/*
+ * Remove a single interface, along with the definitions of every source that
+ * defines it. Returns a ubus status code.
+ */
+int
+config_delete_interface(interface_tester_shared_st * ctx, char const * name);
+
+/* Load the configuration file, or its replacement sent over ubus. */
+bool
+config_load_config(interface_tester_shared_st * ctx, struct blob_attr * config);
 
 void
-config_init(interface_tester_shared_st * ctx);
+config_cleanup(interface_tester_shared_st * ctx);
 
 void
 config_init(interface_tester_shared_st * ctx);
-
@@ -0,0 +1,224 @@
+#include "config_cache.h"
+#include "debug.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define CONFIG_CACHE_MAGIC 0x49544342 /* "ITCB" */
+/* Incremented whenever the layout of the cache changes. */
+#define CONFIG_CACHE_VERSION 1
+
+static char const cache_suffix[] = ".cache";
+
+/* The blob follows the header, which keeps it aligned. */
+typedef struct config_cache_header_st
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    int64_t mtime_secs;
+    int64_t mtime_nsecs;
+    uint64_t content_hash;
+    uint64_t blob_len;
+} config_cache_header_st;
+
+static bool
+cache_path(char * const path, size_t const path_size, char const * const config_file)
+{
+    int const len = snprintf(path, path_size, "%s%s", config_file, cache_suffix);
+
+    return len > 0 && (size_t)len < path_size;
+}
+
+static bool
+cache_header_matches(
+    config_cache_header_st const * const header,
+    size_t const map_size,
+    struct stat const * const st,
+    uint64_t const hash)
+{
+    return header->magic == CONFIG_CACHE_MAGIC
+        && header->version == CONFIG_CACHE_VERSION
+        && header->size == (uint64_t)st->st_size
+        && header->mtime_secs == (int64_t)st->st_mtim.tv_sec
+        && header->mtime_nsecs == (int64_t)st->st_mtim.tv_nsec
+        && header->content_hash == hash
+        && header->blob_len >= sizeof(struct blob_attr)
+        && header->blob_len <= map_size - sizeof(*header);
+}
+
+bool
+config_cache_open(
+    config_cache_st * const cache,
+    char const * const config_file,
+    struct stat const * const st,
+    uint64_t const hash)
+{
+    bool success;
+    char path[PATH_MAX];
+    int fd = -1;
+    struct stat cache_st;
+
+    cache->map_ = NULL;
+    cache->map_size_ = 0;
+
+    if (!cache_path(path, sizeof(path), config_file))
+    {
+        success = false;
+        goto done;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &cache_st) < 0
+        || (size_t)cache_st.st_size < sizeof(config_cache_header_st))
+    {
+        success = false;
+        goto done;
+    }
+
+    void * const map = mmap(NULL, cache_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (map == MAP_FAILED)
+    {
+        DLOG("%s: can't map %s: %s", __func__, path, strerror(errno));
+
+        success = false;
+        goto done;
+    }
+
+    cache->map_ = map;
+    cache->map_size_ = cache_st.st_size;
+
+    config_cache_header_st const * const header = map;
+
+    if (!cache_header_matches(header, cache->map_size_, st, hash)
+        || blob_pad_len(config_cache_blob(cache)) != header->blob_len)
+    {
+        DLOG("%s: %s doesn't match %s", __func__, path, config_file);
+
+        config_cache_close(cache);
+        success = false;
+        goto done;
+    }
+
+    success = true;
+
+done:
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return success;
+}
+
+struct blob_attr *
+config_cache_blob(config_cache_st const * const cache)
+{
+    return (struct blob_attr *)((char *)cache->map_ + sizeof(config_cache_header_st));
+}
+
+void
+config_cache_close(config_cache_st * const cache)
+{
+    if (cache->map_ != NULL)
+    {
+        munmap(cache->map_, cache->map_size_);
+        cache->map_ = NULL;
+        cache->map_size_ = 0;
+    }
+}
+
+static bool
+write_all(int const fd, void const * const data, size_t const len)
+{
+    char const * p = data;
+    size_t remaining = len;
+
+    while (remaining > 0)
+    {
+        ssize_t const written = TEMP_FAILURE_RETRY(write(fd, p, remaining));
+
+        if (written <= 0)
+        {
+            break;
+        }
+        p += written;
+        remaining -= written;
+    }
+
+    return remaining == 0;
+}
+
+bool
+config_cache_write(
+    char const * const config_file,
+    struct stat const * const st,
+    uint64_t const hash,
+    struct blob_attr const * const blob)
+{
+    bool success;
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX];
+
+    if (!cache_path(path, sizeof(path), config_file)
+        || snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path))
+    {
+        success = false;
+        goto done;
+    }
+
+    config_cache_header_st const header =
+    {
+        .magic = CONFIG_CACHE_MAGIC,
+        .version = CONFIG_CACHE_VERSION,
+        .size = st->st_size,
+        .mtime_secs = st->st_mtim.tv_sec,
+        .mtime_nsecs = st->st_mtim.tv_nsec,
+        .content_hash = hash,
+        .blob_len = blob_pad_len(blob),
+    };
+
+    /* Write a new file and rename it so that a partial cache is never seen. */
+    int const fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        DLOG("%s: can't create %s: %s", __func__, tmp_path, strerror(errno));
+
+        success = false;
+        goto done;
+    }
+
+    bool const written =
+        write_all(fd, &header, sizeof(header)) && write_all(fd, blob, header.blob_len);
+
+    if (close(fd) < 0 || !written)
+    {
+        DLOG("%s: can't write %s", __func__, tmp_path);
+
+        unlink(tmp_path);
+        success = false;
+        goto done;
+    }
+
+    if (rename(tmp_path, path) < 0)
+    {
+        DLOG("%s: can't rename %s: %s", __func__, tmp_path, strerror(errno));
+
+        unlink(tmp_path);
+        success = false;
+        goto done;
+    }
+
+    success = true;
+
+done:
+    return success;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <libubox/blob.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/*
+ * A cache of the configuration file, as the blob it is converted to, kept next
+ * to the file with a .cache suffix. When the configuration file hasn't
+ * changed since the cache was written the cache is mapped into memory and its
+ * blob used directly, so that the JSON needn't be parsed again. The cache is
+ * only used if the size, modification time and content hash of the file all
+ * match those of the file it was made from.
+ */
+
+typedef struct config_cache_st
+{
+    /* Users should not access these fields directly. */
+    void * map_;
+    size_t map_size_;
+} config_cache_st;
+
+/*
+ * Map the cache for the configuration file, whose current status and content
+ * hash are given. Returns false if there is no cache, or it doesn't match.
+ */
+bool
+config_cache_open(
+    config_cache_st * cache, char const * config_file, struct stat const * st, uint64_t hash);
+
+/* The blob held by an open cache. */
+struct blob_attr *
+config_cache_blob(config_cache_st const * cache);
+
+void
+config_cache_close(config_cache_st * cache);
+
+/*
+ * Write the blob converted from the configuration file to its cache.
+ * Returns false if the cache couldn't be written, which isn't an error as far
+ * as loading the configuration is concerned.
+ */
+bool
+config_cache_write(
+    char const * config_file,
+    struct stat const * st,
+    uint64_t hash,
+    struct blob_attr const * blob);
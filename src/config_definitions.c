@@ -0,0 +1,252 @@
+#include "config_definitions.h"
+#include "debug.h"
+#include "utils.h"
+
+#include <libubox/utils.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static int
+uint32_cmp(uint32_t const a, uint32_t const b)
+{
+    return a < b ? -1 : a > b;
+}
+
+static int
+params_cmp(struct blob_attr const * const a, struct blob_attr const * const b)
+{
+    size_t const a_len = blob_pad_len(a);
+    size_t const b_len = blob_pad_len(b);
+
+    if (a_len != b_len)
+    {
+        return a_len < b_len ? -1 : 1;
+    }
+
+    return memcmp(a, b, a_len);
+}
+
+/*
+ * The icmp configuration is parsed from the params, so it is the same if the
+ * type and params are.
+ */
+static int
+test_config_cmp(void const * const k1, void const * const k2, void * const ptr)
+{
+    UNUSED(ptr);
+    test_config_st const * const a = k1;
+    test_config_st const * const b = k2;
+    int result;
+
+    result = uint32_cmp(a->type, b->type);
+    if (result != 0)
+    {
+        goto done;
+    }
+    result = uint32_cmp(a->response_timeout_secs, b->response_timeout_secs);
+    if (result != 0)
+    {
+        goto done;
+    }
+    result = strcmp(a->executable_name, b->executable_name);
+    if (result != 0)
+    {
+        goto done;
+    }
+    result = strcmp(a->label, b->label);
+    if (result != 0)
+    {
+        goto done;
+    }
+    result = params_cmp(a->params, b->params);
+
+done:
+    return result;
+}
+
+static int
+recovery_config_cmp(void const * const k1, void const * const k2, void * const ptr)
+{
+    UNUSED(ptr);
+    recovery_config_st const * const a = k1;
+    recovery_config_st const * const b = k2;
+    int result;
+
+    result = uint32_cmp(a->response_timeout_secs, b->response_timeout_secs);
+    if (result != 0)
+    {
+        goto done;
+    }
+    result = strcmp(a->executable_name, b->executable_name);
+    if (result != 0)
+    {
+        goto done;
+    }
+    result = strcmp(a->label, b->label);
+    if (result != 0)
+    {
+        goto done;
+    }
+    result = params_cmp(a->params, b->params);
+
+done:
+    return result;
+}
+
+test_config_st *
+config_definitions_get_test(
+    config_definitions_st * const definitions, test_config_st const * const test)
+{
+    test_config_st * definition =
+        avl_find_element(&definitions->tests_, test, definition, node_);
+
+    if (definition != NULL)
+    {
+        definition->refs_++;
+        goto done;
+    }
+
+    char * executable_name;
+    char * label;
+    struct blob_attr * params;
+
+    definition = calloc_a(sizeof(*definition),
+                          &executable_name, strlen(test->executable_name) + 1,
+                          &label, strlen(test->label) + 1,
+                          &params, blob_pad_len(test->params));
+    if (definition == NULL)
+    {
+        goto done;
+    }
+
+    definition->type = test->type;
+    definition->executable_name = strcpy(executable_name, test->executable_name);
+    definition->label = strcpy(label, test->label);
+    definition->response_timeout_secs = test->response_timeout_secs;
+    definition->params = memcpy(params, test->params, blob_pad_len(test->params));
+    definition->icmp = test->icmp;
+
+    if (definition->type == TEST_TYPE_EXECUTABLE)
+    {
+        definition->exec = exec_cache_get(
+            definitions->exec_cache_, EXEC_DIR_TESTS, definition->executable_name);
+        if (definition->exec == NULL)
+        {
+            free(definition);
+            definition = NULL;
+            goto done;
+        }
+    }
+
+    definition->tree_ = &definitions->tests_;
+    definition->refs_ = 1;
+    definition->node_.key = definition;
+    avl_insert(definition->tree_, &definition->node_);
+
+    DLOG("%s: added test %s (%s)", __func__, definition->label, definition->executable_name);
+
+done:
+    return definition;
+}
+
+void
+test_config_put(test_config_st * const test)
+{
+    if (test == NULL)
+    {
+        goto done;
+    }
+
+    test->refs_--;
+    if (test->refs_ == 0)
+    {
+        avl_delete(test->tree_, &test->node_);
+        exec_entry_put(test->exec);
+        free(test);
+    }
+
+done:
+    return;
+}
+
+recovery_config_st *
+config_definitions_get_recovery(
+    config_definitions_st * const definitions, recovery_config_st const * const recovery)
+{
+    recovery_config_st * definition =
+        avl_find_element(&definitions->recoverys_, recovery, definition, node_);
+
+    if (definition != NULL)
+    {
+        definition->refs_++;
+        goto done;
+    }
+
+    char * executable_name;
+    char * label;
+    struct blob_attr * params;
+
+    definition = calloc_a(sizeof(*definition),
+                          &executable_name, strlen(recovery->executable_name) + 1,
+                          &label, strlen(recovery->label) + 1,
+                          &params, blob_pad_len(recovery->params));
+    if (definition == NULL)
+    {
+        goto done;
+    }
+
+    definition->executable_name = strcpy(executable_name, recovery->executable_name);
+    definition->label = strcpy(label, recovery->label);
+    definition->response_timeout_secs = recovery->response_timeout_secs;
+    definition->params = memcpy(params, recovery->params, blob_pad_len(recovery->params));
+
+    definition->exec = exec_cache_get(
+        definitions->exec_cache_, EXEC_DIR_RECOVERY, definition->executable_name);
+    if (definition->exec == NULL)
+    {
+        free(definition);
+        definition = NULL;
+        goto done;
+    }
+
+    definition->tree_ = &definitions->recoverys_;
+    definition->refs_ = 1;
+    definition->node_.key = definition;
+    avl_insert(definition->tree_, &definition->node_);
+
+    DLOG("%s: added recovery task %s (%s)",
+         __func__, definition->label, definition->executable_name);
+
+done:
+    return definition;
+}
+
+void
+recovery_config_put(recovery_config_st * const recovery)
+{
+    if (recovery == NULL)
+    {
+        goto done;
+    }
+
+    recovery->refs_--;
+    if (recovery->refs_ == 0)
+    {
+        avl_delete(recovery->tree_, &recovery->node_);
+        exec_entry_put(recovery->exec);
+        free(recovery);
+    }
+
+done:
+    return;
+}
+
+void
+config_definitions_init(
+    config_definitions_st * const definitions, exec_cache_st * const exec_cache)
+{
+    definitions->exec_cache_ = exec_cache;
+    avl_init(&definitions->tests_, test_config_cmp, false, NULL);
+    avl_init(&definitions->recoverys_, recovery_config_cmp, false, NULL);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "exec_cache.h"
+#include "icmp_probe.h"
+
+#include <libubox/avl.h>
+#include <libubox/blob.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The test and recovery task definitions of all of the interfaces. Identical
+ * definitions are only kept once, and are shared by all of the interfaces
+ * that use them, so an interface's tests and recovery tasks are references to
+ * immutable, reference counted definitions. Two interfaces have the same test
+ * if they refer to the same definition.
+ */
+
+typedef enum test_type_t
+{
+    TEST_TYPE_EXECUTABLE, /* Run an executable in the tests directory. */
+    TEST_TYPE_ICMP, /* Send ICMP echo requests from within the daemon. */
+    TEST_TYPE_COUNT__,
+} test_type_t;
+
+typedef struct test_config_st
+{
+    test_type_t type;
+    /*
+     * The name of the executable that will be called to execute the configured
+     * test. Empty for icmp tests.
+     */
+    char const * executable_name;
+    exec_entry_st * exec; /* NULL for icmp tests. */
+    char const * label;
+
+    /*
+     * The default maximum time to wait for an individual test to complete.
+     * This overrides the default response timeout.
+     */
+    uint32_t response_timeout_secs;
+    struct blob_attr * params;
+
+    /* Parsed from the params of icmp tests. */
+    icmp_probe_config_st icmp;
+
+    /* Users should not access these fields directly. */
+    struct avl_node node_;
+    struct avl_tree * tree_;
+    unsigned int refs_;
+} test_config_st;
+
+typedef struct recovery_config_st
+{
+    /*
+     * The name of the executable that will be called to execute the configured
+     * recovery task.
+     */
+    char const * executable_name;
+    exec_entry_st * exec;
+    char const * label;
+
+    /*
+     * The default maximum time to wait for an individual test to complete.
+     * This overrides the default response timeout.
+     */
+    uint32_t response_timeout_secs;
+    struct blob_attr * params;
+
+    /* Users should not access these fields directly. */
+    struct avl_node node_;
+    struct avl_tree * tree_;
+    unsigned int refs_;
+} recovery_config_st;
+
+typedef struct config_definitions_st
+{
+    /* Users should not access these fields directly. */
+    exec_cache_st * exec_cache_;
+    struct avl_tree tests_;
+    struct avl_tree recoverys_;
+} config_definitions_st;
+
+void
+config_definitions_init(config_definitions_st * definitions, exec_cache_st * exec_cache);
+
+/*
+ * Returns a reference to the definition of the test described by the type,
+ * executable_name, label, response_timeout_secs, params and icmp fields of
+ * test, adding it if there isn't one already. The strings and params are
+ * copied into a new definition, and its executable is looked up.
+ * Returns NULL only if memory couldn't be allocated.
+ */
+test_config_st *
+config_definitions_get_test(config_definitions_st * definitions, test_config_st const * test);
+
+/* Release a reference returned by config_definitions_get_test(). test may be NULL. */
+void
+test_config_put(test_config_st * test);
+
+/*
+ * As config_definitions_get_test(), for the executable_name, label,
+ * response_timeout_secs and params fields of recovery.
+ */
+recovery_config_st *
+config_definitions_get_recovery(
+    config_definitions_st * definitions, recovery_config_st const * recovery);
+
+/* Release a reference returned by config_definitions_get_recovery(). recovery may be NULL. */
+void
+recovery_config_put(recovery_config_st * recovery);
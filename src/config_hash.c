@@ -0,0 +1,22 @@
+#include "config_hash.h"
+
+/* FNV-1a */
+uint64_t
+config_content_hash_update(uint64_t hash, void const * const data, size_t const len)
+{
+    uint8_t const * const bytes = data;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= bytes[i];
+        hash *= UINT64_C(0x100000001b3);
+    }
+
+    return hash;
+}
+
+uint64_t
+config_content_hash(void const * const data, size_t const len)
+{
+    return config_content_hash_update(UINT64_C(0xcbf29ce484222325), data, len);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A hash of configuration content, used to tell whether it has changed. */
+uint64_t
+config_content_hash(void const * data, size_t len);
+
+/* Continue a hash returned by config_content_hash() over more data. */
+uint64_t
+config_content_hash_update(uint64_t hash, void const * data, size_t len);
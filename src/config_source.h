@@ -0,0 +1,47 @@
+#pragma once
+
+#include <libubox/avl.h>
+#include <libubox/avl-cmp.h>
+#include <libubox/list.h>
+
+#include <stdint.h>
+
+/*
+ * Somewhere interfaces are configured from: the configuration file (and the
+ * configuration sent over ubus, which replaces it), a single file in the
+ * configuration fragment directory, or the interfaces set one at a time over
+ * ubus. Each source keeps its own definition of every interface it defines.
+ * When more than one source defines an interface, the definition from the
+ * source with the highest precedence is used, and if that source stops
+ * defining it the definition from the next source takes over. Loading a source
+ * leaves the interfaces defined only by other sources alone.
+ */
+typedef enum config_source_precedence_t
+{
+    CONFIG_SOURCE_PRECEDENCE_FILE,
+    /* Fragments with the same precedence are ordered by name, the last winning. */
+    CONFIG_SOURCE_PRECEDENCE_FRAGMENT,
+    CONFIG_SOURCE_PRECEDENCE_UBUS,
+} config_source_precedence_t;
+
+typedef struct config_source_st
+{
+    struct list_head node; /* In the shared list of sources, highest precedence first. */
+    struct avl_tree definitions; /* The interfaces the source defines, by name. */
+    config_source_precedence_t precedence;
+    char const * name; /* Orders sources with the same precedence. May be NULL. */
+    uint32_t generation; /* Incremented each time the source is loaded. */
+} config_source_st;
+
+static inline void
+config_source_init(
+    config_source_st * const source,
+    config_source_precedence_t const precedence,
+    char const * const name)
+{
+    INIT_LIST_HEAD(&source->node);
+    avl_init(&source->definitions, avl_strcmp, false, NULL);
+    source->precedence = precedence;
+    source->name = name;
+    source->generation = 0;
+}
@@ -0,0 +1,577 @@
+#include "config_watcher.h"
+#include "config.h"
+#include "config_cache.h"
+#include "debug.h"
+#include "shared.h"
+#include "utils.h"
+
+#include <libubox/avl-cmp.h>
+#include <libubox/blobmsg_json.h>
+#include <libubox/utils.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* How long the files must be left alone before the changes are loaded. */
+#define CONFIG_WATCHER_SETTLE_MSECS 250
+
+/*
+ * Changes to a directory that may leave a file in it with a new
+ * configuration. Editors often write a new file and rename it over the old
+ * one, so it's the directory rather than the file that is watched.
+ */
+#define CONFIG_WATCHER_WATCH_MASK \
+    (IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+static char const fragment_suffix[] = ".json";
+
+/*
+ * Returns the contents of the file as a string, or NULL, with errno set, if it
+ * can't be read or isn't a regular file. The caller must free the string.
+ */
+static char *
+read_file(char const * const path, struct stat * const st)
+{
+    char * contents = NULL;
+    int const fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        goto done;
+    }
+
+    if (fstat(fd, st) < 0)
+    {
+        goto done;
+    }
+    if (!S_ISREG(st->st_mode))
+    {
+        errno = EINVAL;
+        goto done;
+    }
+
+    contents = malloc(st->st_size + 1);
+    if (contents == NULL)
+    {
+        goto done;
+    }
+
+    size_t total = 0;
+    ssize_t len;
+
+    while (total < (size_t)st->st_size
+           && (len = TEMP_FAILURE_RETRY(read(fd, contents + total, st->st_size - total))) > 0)
+    {
+        total += len;
+    }
+    contents[total] = '\0';
+
+done:
+    if (fd >= 0)
+    {
+        /* Leave errno describing why the file couldn't be read. */
+        int const saved_errno = errno;
+
+        close(fd);
+        errno = saved_errno;
+    }
+
+    return contents;
+}
+
+/*
+ * Load the blob from the file's cache, if it has one that matches the file.
+ * Returns false if the JSON needs to be parsed.
+ */
+static bool
+config_file_load_cache(
+    interface_tester_shared_st * const ctx,
+    config_source_st * const source,
+    char const * const path,
+    struct stat const * const st,
+    uint64_t const hash)
+{
+    bool success;
+    config_cache_st cache;
+
+    if (!config_cache_open(&cache, path, st, hash))
+    {
+        success = false;
+        goto done;
+    }
+
+    DLOG("%s: loading %s from its cache", __func__, path);
+
+    if (!config_load_source(ctx, source, config_cache_blob(&cache)))
+    {
+        DLOG("Failed to load config blob");
+    }
+    config_cache_close(&cache);
+
+    success = true;
+
+done:
+    return success;
+}
+
+/*
+ * Load the file into the source, unless its contents are the same as they
+ * were the last time it was loaded and force isn't set.
+ * Returns false if the file couldn't be read.
+ */
+static bool
+config_file_load(
+    interface_tester_shared_st * const ctx,
+    config_source_st * const source,
+    char const * const path,
+    uint64_t * const content_hash,
+    bool const force,
+    bool const use_cache)
+{
+    bool success;
+    struct stat st;
+    char * const contents = read_file(path, &st);
+
+    if (contents == NULL)
+    {
+        DLOG("%s: can't read %s: %s", __func__, path, strerror(errno));
+
+        success = false;
+        goto done;
+    }
+
+    uint64_t const hash = config_content_hash(contents, strlen(contents));
+
+    if (!force && hash == *content_hash)
+    {
+        DLOG("%s: %s is unchanged", __func__, path);
+
+        success = true;
+        goto done;
+    }
+    *content_hash = hash;
+
+    if (use_cache && config_file_load_cache(ctx, source, path, &st, hash))
+    {
+        success = true;
+        goto done;
+    }
+
+    struct blob_buf b = { 0 };
+
+    blob_buf_init(&b, 0);
+
+    if (!blobmsg_add_json_from_string(&b, contents))
+    {
+        DLOG("Failed to load config from: %s", path);
+    }
+    else if (!config_load_source(ctx, source, b.head))
+    {
+        DLOG("Failed to load config blob");
+    }
+    else if (use_cache)
+    {
+        /* Only a configuration that loaded is worth keeping. */
+        config_cache_write(path, &st, hash, b.head);
+    }
+
+    blob_buf_free(&b);
+
+    success = true;
+
+done:
+    free(contents);
+
+    return success;
+}
+
+static bool
+fragment_name_is_valid(char const * const name)
+{
+    size_t const len = strlen(name);
+    size_t const suffix_len = sizeof(fragment_suffix) - 1;
+
+    /* Ignore hidden files, which editors often use for temporary copies. */
+    return name[0] != '.'
+        && len > suffix_len
+        && strcmp(name + len - suffix_len, fragment_suffix) == 0;
+}
+
+static config_fragment_st *
+fragment_get(config_watcher_st * const watcher, char const * const name)
+{
+    interface_tester_shared_st * const ctx =
+        container_of(watcher, interface_tester_shared_st, config_watcher);
+    config_fragment_st * fragment =
+        avl_find_element(&watcher->fragments_, name, fragment, node_);
+
+    if (fragment == NULL)
+    {
+        char * fragment_name;
+
+        fragment = calloc_a(sizeof(*fragment), &fragment_name, strlen(name) + 1);
+        if (fragment == NULL)
+        {
+            goto done;
+        }
+        fragment->name_ = strcpy(fragment_name, name);
+        fragment->node_.key = fragment->name_;
+        config_source_init(&fragment->source_, CONFIG_SOURCE_PRECEDENCE_FRAGMENT, fragment->name_);
+        config_source_add(ctx, &fragment->source_);
+        avl_insert(&watcher->fragments_, &fragment->node_);
+    }
+
+done:
+    return fragment;
+}
+
+static void
+fragment_free(config_watcher_st * const watcher, config_fragment_st * const fragment)
+{
+    config_source_cleanup(&fragment->source_);
+    avl_delete(&watcher->fragments_, &fragment->node_);
+    free(fragment);
+}
+
+static void
+fragment_load(
+    config_watcher_st * const watcher, config_fragment_st * const fragment, bool const force)
+{
+    interface_tester_shared_st * const ctx =
+        container_of(watcher, interface_tester_shared_st, config_watcher);
+    char path[PATH_MAX];
+
+    fragment->changed_ = false;
+    snprintf(path, sizeof(path), "%s/%s", watcher->fragment_dir_, fragment->name_);
+
+    /* Fragments are small, and a cache for each would clutter the directory. */
+    bool const use_cache = false;
+
+    if (!config_file_load(
+            ctx, &fragment->source_, path, &fragment->content_hash_, force, use_cache))
+    {
+        /*
+         * The file has gone, and its interfaces go with it, unless another
+         * source defines them too.
+         */
+        config_source_remove(ctx, &fragment->source_);
+        fragment_free(watcher, fragment);
+    }
+}
+
+static void
+fragments_mark_all_changed(config_watcher_st * const watcher)
+{
+    config_fragment_st * fragment;
+
+    avl_for_each_element(&watcher->fragments_, fragment, node_)
+    {
+        fragment->changed_ = true;
+    }
+}
+
+/* Pick up every fragment in the directory, including any not seen before. */
+static void
+fragments_scan(config_watcher_st * const watcher)
+{
+    DIR * const dir =
+        watcher->fragment_dir_ != NULL ? opendir(watcher->fragment_dir_) : NULL;
+    struct dirent * entry;
+
+    if (dir == NULL)
+    {
+        goto done;
+    }
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!fragment_name_is_valid(entry->d_name))
+        {
+            continue;
+        }
+
+        config_fragment_st * const fragment = fragment_get(watcher, entry->d_name);
+
+        if (fragment != NULL)
+        {
+            fragment->changed_ = true;
+        }
+    }
+
+    closedir(dir);
+
+done:
+    return;
+}
+
+static void
+config_watcher_load_changes(config_watcher_st * const watcher, bool const force)
+{
+    interface_tester_shared_st * const ctx =
+        container_of(watcher, interface_tester_shared_st, config_watcher);
+    config_fragment_st * fragment;
+    config_fragment_st * tmp;
+
+    if (watcher->config_file_changed_ && watcher->config_file_ != NULL)
+    {
+        bool const use_cache = true;
+
+        config_file_load(
+            ctx,
+            &ctx->config_source,
+            watcher->config_file_,
+            &watcher->config_file_hash_,
+            force,
+            use_cache);
+    }
+    watcher->config_file_changed_ = false;
+
+    avl_for_each_element_safe(&watcher->fragments_, fragment, node_, tmp)
+    {
+        if (fragment->changed_)
+        {
+            fragment_load(watcher, fragment, force);
+        }
+    }
+}
+
+static void
+settle_timer_expired(timer_st * const t)
+{
+    config_watcher_st * const watcher = container_of(t, config_watcher_st, settle_timer_);
+    bool const force = false;
+
+    DLOG("%s", __func__);
+
+    config_watcher_load_changes(watcher, force);
+}
+
+/* Returns true if the event may mean the configuration has changed. */
+static bool
+config_watcher_handle_event(
+    config_watcher_st * const watcher, struct inotify_event const * const event)
+{
+    bool changed = false;
+
+    if ((event->mask & IN_Q_OVERFLOW) != 0)
+    {
+        /* Some events have been lost, so check everything. */
+        watcher->config_file_changed_ = true;
+        fragments_mark_all_changed(watcher);
+        fragments_scan(watcher);
+        changed = true;
+        goto done;
+    }
+
+    if (event->len == 0)
+    {
+        goto done;
+    }
+
+    /* The watches are the same if the file is in the fragment directory. */
+    if (event->wd == watcher->config_file_watch_
+        && strcmp(event->name, watcher->config_file_name_) == 0)
+    {
+        watcher->config_file_changed_ = true;
+        changed = true;
+    }
+    else if (event->wd == watcher->fragment_dir_watch_ && fragment_name_is_valid(event->name))
+    {
+        config_fragment_st * const fragment = fragment_get(watcher, event->name);
+
+        if (fragment != NULL)
+        {
+            fragment->changed_ = true;
+            changed = true;
+        }
+    }
+
+done:
+    return changed;
+}
+
+static void
+config_watcher_inotify_cb(struct uloop_fd * const fd, unsigned int const events)
+{
+    UNUSED(events);
+    config_watcher_st * const watcher = container_of(fd, config_watcher_st, inotify_);
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    bool changed = false;
+
+    while ((len = TEMP_FAILURE_RETRY(read(fd->fd, buf, sizeof(buf)))) > 0)
+    {
+        for (char const * p = buf; p < buf + len; )
+        {
+            struct inotify_event const * const event = (struct inotify_event const *)p;
+
+            if (config_watcher_handle_event(watcher, event))
+            {
+                changed = true;
+            }
+            p += sizeof(*event) + event->len;
+        }
+    }
+
+    /*
+     * Wait for a burst of writes to finish before loading anything. Nothing is
+     * loaded until everything has been loaded for the first time.
+     */
+    if (changed && watcher->active_)
+    {
+        timer_start(&watcher->settle_timer_, CONFIG_WATCHER_SETTLE_MSECS);
+    }
+}
+
+static int
+watch_directory(int const inotify_fd, char const * const path)
+{
+    int const watch = inotify_add_watch(inotify_fd, path, CONFIG_WATCHER_WATCH_MASK);
+
+    if (watch < 0)
+    {
+        DLOG("%s: can't watch %s: %s", __func__, path, strerror(errno));
+    }
+
+    return watch;
+}
+
+/* Watch the directory holding the configuration file. */
+static int
+watch_config_file_directory(int const inotify_fd, char const * const config_file)
+{
+    char const * const slash = strrchr(config_file, '/');
+    int watch;
+
+    if (slash == NULL)
+    {
+        watch = watch_directory(inotify_fd, ".");
+        goto done;
+    }
+
+    size_t const dir_len = slash > config_file ? (size_t)(slash - config_file) : 1;
+    char * const dir = strndup(config_file, dir_len);
+
+    if (dir == NULL)
+    {
+        watch = -1;
+        goto done;
+    }
+
+    watch = watch_directory(inotify_fd, dir);
+    free(dir);
+
+done:
+    return watch;
+}
+
+void
+config_watcher_load_all(config_watcher_st * const watcher)
+{
+    bool const force = true;
+
+    DLOG("%s", __func__);
+
+    timer_stop(&watcher->settle_timer_);
+    watcher->config_file_changed_ = true;
+    fragments_mark_all_changed(watcher);
+    fragments_scan(watcher);
+    watcher->active_ = true;
+
+    config_watcher_load_changes(watcher, force);
+}
+
+void
+config_watcher_cleanup(config_watcher_st * const watcher)
+{
+    config_fragment_st * fragment;
+    config_fragment_st * tmp;
+
+    timer_stop(&watcher->settle_timer_);
+
+    avl_for_each_element_safe(&watcher->fragments_, fragment, node_, tmp)
+    {
+        fragment_free(watcher, fragment);
+    }
+
+    if (watcher->inotify_.fd >= 0)
+    {
+        if (watcher->config_file_watch_ >= 0)
+        {
+            inotify_rm_watch(watcher->inotify_.fd, watcher->config_file_watch_);
+        }
+        /* inotify hands out the same watch for the same directory. */
+        if (watcher->fragment_dir_watch_ >= 0
+            && watcher->fragment_dir_watch_ != watcher->config_file_watch_)
+        {
+            inotify_rm_watch(watcher->inotify_.fd, watcher->fragment_dir_watch_);
+        }
+        uloop_fd_delete(&watcher->inotify_);
+        close(watcher->inotify_.fd);
+        watcher->inotify_.fd = -1;
+    }
+    watcher->config_file_watch_ = -1;
+    watcher->fragment_dir_watch_ = -1;
+}
+
+void
+config_watcher_init(
+    config_watcher_st * const watcher,
+    char const * const config_file,
+    char const * const fragment_dir)
+{
+    watcher->config_file_ = config_file;
+    watcher->config_file_name_ = NULL;
+    watcher->config_file_watch_ = -1;
+    watcher->config_file_hash_ = 0;
+    watcher->config_file_changed_ = false;
+    watcher->fragment_dir_ = fragment_dir;
+    watcher->fragment_dir_watch_ = -1;
+    watcher->active_ = false;
+    watcher->inotify_.fd = -1;
+    avl_init(&watcher->fragments_, avl_strcmp, false, NULL);
+    timer_init(&watcher->settle_timer_, "config_settle_timer", settle_timer_expired);
+
+    if (config_file != NULL)
+    {
+        char const * const slash = strrchr(config_file, '/');
+
+        watcher->config_file_name_ = slash != NULL ? slash + 1 : config_file;
+    }
+
+    if (config_file == NULL && fragment_dir == NULL)
+    {
+        goto done;
+    }
+
+    watcher->inotify_.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->inotify_.fd < 0)
+    {
+        /* Changes won't be noticed until the configuration is reloaded. */
+        DLOG("%s: inotify unavailable: %s", __func__, strerror(errno));
+        goto done;
+    }
+    watcher->inotify_.cb = config_watcher_inotify_cb;
+    uloop_fd_add(&watcher->inotify_, ULOOP_READ);
+
+    if (config_file != NULL)
+    {
+        watcher->config_file_watch_ =
+            watch_config_file_directory(watcher->inotify_.fd, config_file);
+    }
+    if (fragment_dir != NULL)
+    {
+        watcher->fragment_dir_watch_ = watch_directory(watcher->inotify_.fd, fragment_dir);
+    }
+
+done:
+    return;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "config_source.h"
+#include "timers.h"
+
+#include <libubox/avl.h>
+#include <libubox/uloop.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Watches the configuration file, and the optional directory of configuration
+ * fragments, with inotify. Each file in the fragment directory with a .json
+ * extension holds the configuration of one or more interfaces, in the same
+ * format as the configuration file.
+ * Changes are gathered up until the files have been quiet for a short time,
+ * and then only the files whose contents have changed are loaded again, so
+ * that editing the file for one interface doesn't reload all of the others.
+ */
+
+typedef struct config_fragment_st
+{
+    /* Users should not access these fields directly. */
+    struct avl_node node_;
+    char const * name_;
+    config_source_st source_;
+    uint64_t content_hash_; /* 0 if the file hasn't been loaded. */
+    bool changed_;
+} config_fragment_st;
+
+typedef struct config_watcher_st
+{
+    /* Users should not access these fields directly. */
+    struct uloop_fd inotify_;
+    char const * config_file_;
+    char const * config_file_name_; /* The last component of config_file_. */
+    int config_file_watch_; /* A watch on the directory holding the file, or -1. */
+    uint64_t config_file_hash_;
+    bool config_file_changed_;
+    char const * fragment_dir_;
+    int fragment_dir_watch_;
+    struct avl_tree fragments_;
+    timer_st settle_timer_;
+    bool active_; /* Set once everything has been loaded for the first time. */
+} config_watcher_st;
+
+/* A NULL path means there is no configuration file, or fragment directory. */
+void
+config_watcher_init(
+    config_watcher_st * watcher, char const * config_file, char const * fragment_dir);
+
+void
+config_watcher_cleanup(config_watcher_st * watcher);
+
+/*
+ * Load the configuration file and every fragment, whether or not they have
+ * changed.
+ */
+void
+config_watcher_load_all(config_watcher_st * watcher);
@@ -1,9 +1,65 @@
 #include "dump.h"
+#include "flight_recorder.h"
 #include "interface_connection.h"
 #include "interface_tester.h"
 #include "strings.h"
 #include "utils.h"
 
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef void (*dump_fn)(struct blob_buf * b, interface_st const * iface);
+
+/*
+ * Add what dump adds, reusing what it added last time unless the generation
+ * or executable cache generation it depends on has changed since.
+ */
+static void
+dump_snapshot(
+    struct blob_buf * const b,
+    interface_st const * const iface,
+    state_snapshot_st * const snapshot,
+    uint64_t const generation,
+    unsigned int const exec_generation,
+    dump_fn const dump)
+{
+    if (snapshot->blob == NULL
+        || snapshot->generation != generation
+        || snapshot->exec_generation != exec_generation)
+    {
+        struct blob_buf snapshot_b = { 0 };
+
+        blob_buf_init(&snapshot_b, 0);
+        dump(&snapshot_b, iface);
+
+        free(snapshot->blob);
+        snapshot->blob = blob_memdup(snapshot_b.head);
+        snapshot->generation = generation;
+        snapshot->exec_generation = exec_generation;
+
+        blob_buf_free(&snapshot_b);
+    }
+
+    if (snapshot->blob == NULL)
+    {
+        dump(b, iface);
+        goto done;
+    }
+
+    struct blob_attr * cur;
+    size_t rem;
+
+    blob_for_each_attr(cur, snapshot->blob, rem)
+    {
+        blobmsg_add_blob(b, cur);
+    }
+
+done:
+    return;
+}
+
 static void
 dump_timer_state(struct blob_buf * const b, timer_st const * const t)
 {
@@ -26,6 +82,15 @@ dump_connection_state(struct blob_buf * const b, interface_st const * const ifac
     blobmsg_add_string(
         b, "state", interface_connection_state_to_str(connection->state));
     dump_timer_state(b, &connection->settling_delay_timer);
+    if (connection->device[0] != '\0')
+    {
+        blobmsg_add_string(b, "device", connection->device);
+    }
+    blobmsg_add_u8(b, "state_discovery_pending", connection->state_request_pending);
+    if (connection->state_discovery_msecs >= 0)
+    {
+        blobmsg_add_u64(b, "state_discovery_msecs", connection->state_discovery_msecs);
+    }
 
     blobmsg_close_table(b, cky);
 }
@@ -76,19 +141,228 @@ static void dump_recovery_statistics(
 }
 
 static void
-dump_tester_stats(struct blob_buf * const b, interface_tester_st const * const tester)
+dump_execution_statistics(
+    struct blob_buf * const b,
+    char const * const executable_name,
+    char const * const label,
+    execution_stats_st const * const stats)
+{
+    void * const cky = blobmsg_open_table(b, NULL);
+
+    blobmsg_add_string(b, Sexecutable, executable_name);
+    blobmsg_add_string(b, Slabel, label);
+    blobmsg_add_u64(b, "executions", stats->executions);
+    blobmsg_add_u64(b, "total_wall_msecs", stats->total_wall_usecs / 1000);
+    blobmsg_add_u64(b, "max_wall_msecs", stats->max_wall_usecs / 1000);
+    blobmsg_add_u64(b, "total_user_cpu_msecs", stats->total_user_usecs / 1000);
+    blobmsg_add_u64(b, "total_system_cpu_msecs", stats->total_system_usecs / 1000);
+    blobmsg_add_u64(b, "max_rss_kb", stats->max_rss_kb);
+
+    /* Only the buckets that have been used, keyed by their upper bound. */
+    void * const histogram_cky = blobmsg_open_table(b, "wall_msecs_histogram");
+
+    for (size_t i = 0; i < EXECUTION_STATS_HISTOGRAM_BUCKETS; i++)
+    {
+        if (stats->wall_msecs_histogram[i] == 0)
+        {
+            continue;
+        }
+
+        char bucket_name[24];
+        uint64_t const limit_msecs = execution_stats_bucket_limit_msecs(i);
+
+        if (limit_msecs > 0)
+        {
+            snprintf(bucket_name, sizeof(bucket_name), "lt_%" PRIu64, limit_msecs);
+        }
+        else
+        {
+            snprintf(bucket_name, sizeof(bucket_name), "longer");
+        }
+        blobmsg_add_u64(b, bucket_name, stats->wall_msecs_histogram[i]);
+    }
+
+    blobmsg_close_table(b, histogram_cky);
+
+    blobmsg_close_table(b, cky);
+}
+
+static void
+dump_executions_statistics(struct blob_buf * const b, interface_config_st const * const config)
 {
+    void * const tests_cky = blobmsg_open_array(b, "test_executions");
+
+    for (size_t i = 0; i < config->num_tests; i++)
+    {
+        test_config_st const * const test = config->tests[i];
+
+        if (test->type == TEST_TYPE_EXECUTABLE)
+        {
+            dump_execution_statistics(
+                b, test->executable_name, test->label, &config->test_stats[i]);
+        }
+    }
+
+    blobmsg_close_array(b, tests_cky);
+
+    void * const recoverys_cky = blobmsg_open_array(b, "recovery_task_executions");
+
+    for (size_t i = 0; i < config->num_recoverys; i++)
+    {
+        recovery_config_st const * const recovery = config->recoverys[i];
+
+        dump_execution_statistics(
+            b, recovery->executable_name, recovery->label, &config->recovery_stats[i]);
+    }
+
+    blobmsg_close_array(b, recoverys_cky);
+}
+
+static void
+dump_tester_stats(struct blob_buf * const b, interface_st const * const iface)
+{
+    interface_tester_st const * const tester = &iface->tester;
     void * const stats_cky = blobmsg_open_table(b, "stats");
 
     dump_test_run_statistics(b, &tester->stats.test_runs);
     dump_test_statistics(b, &tester->stats.tests);
     dump_recovery_statistics(b, &tester->stats.recovery);
+    dump_executions_statistics(b, &iface->config);
 
     blobmsg_close_table(b, stats_cky);
 }
 
 static void
-dump_tester_state(struct blob_buf * const b, interface_st const * const iface)
+dump_wait_stats(struct blob_buf * const b, scheduler_wait_stats_st const * const stats)
+{
+    blobmsg_add_u64(b, "total_waits", stats->waits);
+    blobmsg_add_u64(b, "total_wait_msecs", stats->total_wait_msecs);
+    blobmsg_add_u64(b, "max_wait_msecs", stats->max_wait_msecs);
+}
+
+static void
+dump_scheduler_state(struct blob_buf * const b, interface_st const * const iface)
+{
+    scheduler_client_st const * const client = &iface->scheduler_client;
+    scheduler_st const * const scheduler = &iface->ctx->scheduler;
+    void * const cky = blobmsg_open_table(b, "scheduler");
+
+    blobmsg_add_u32(b, "priority", scheduler_client_priority(client));
+    for (size_t i = 0; i < SCHEDULER_CLASS_COUNT__; i++)
+    {
+        blobmsg_add_u32(
+            b, scheduler_class_to_str(i), scheduler_client_queued(client, i));
+    }
+    dump_wait_stats(b, scheduler_client_wait_stats(client));
+
+    /* The state of the scheduler shared by all interfaces. */
+    void * const global_cky = blobmsg_open_table(b, "global");
+
+    blobmsg_add_u32(b, "max_running", scheduler_limit(scheduler));
+    for (size_t i = 0; i < SCHEDULER_CLASS_COUNT__; i++)
+    {
+        void * const class_cky = blobmsg_open_table(b, scheduler_class_to_str(i));
+
+        blobmsg_add_u32(b, "max_running", scheduler_class_limit(scheduler, i));
+        blobmsg_add_u32(b, "running", scheduler_class_running(scheduler, i));
+        blobmsg_add_u32(b, "queued", scheduler_class_queued(scheduler, i));
+
+        blobmsg_close_table(b, class_cky);
+    }
+    dump_wait_stats(b, scheduler_wait_stats(scheduler));
+
+    blobmsg_close_table(b, global_cky);
+
+    blobmsg_close_table(b, cky);
+}
+
+static void
+dump_event_queue_state(struct blob_buf * const b, interface_st const * const iface)
+{
+    event_q_st const * const event_queue = &iface->event_queue;
+    event_queue_stats_st const * const stats = event_queue_stats(event_queue);
+    void * const cky = blobmsg_open_table(b, "event_queue");
+
+    blobmsg_add_u32(b, "size", event_queue_size(event_queue));
+    blobmsg_add_u32(b, "pending", event_queue_pending(event_queue));
+    blobmsg_add_u32(b, "high_water", stats->high_water);
+    blobmsg_add_u64(b, "queued", stats->queued);
+    blobmsg_add_u64(b, "handled", stats->handled);
+    blobmsg_add_u64(b, "dropped", stats->dropped);
+    blobmsg_add_u64(b, "total_latency_usecs", stats->total_latency_usecs);
+    blobmsg_add_u64(b, "max_latency_usecs", stats->max_latency_usecs);
+
+    blobmsg_close_table(b, cky);
+}
+
+static void
+dump_running_tests(struct blob_buf * const b, interface_st const * const iface)
+{
+    interface_tester_st const * const tester = &iface->tester;
+    bool test_process_running = false;
+    void * const cky = blobmsg_open_array(b, "running_tests");
+
+    for (size_t i = 0; i < tester->num_test_slots; i++)
+    {
+        test_slot_st const * const slot = &tester->test_slots[i];
+        bool const process_running = interface_tester_process_is_running(&slot->proc);
+        bool const is_queued = scheduler_request_is_queued(&slot->scheduler_request);
+
+        if (!process_running && !is_queued && !icmp_probe_is_running(&slot->probe))
+        {
+            continue;
+        }
+
+        test_config_st const * const test = iface->config.tests[i];
+        void * const slot_cky = blobmsg_open_table(b, NULL);
+
+        blobmsg_add_u32(b, "index", i);
+        blobmsg_add_string(b, Stype, test_type_to_str(test->type));
+        blobmsg_add_string(b, Slabel, test->label);
+        blobmsg_add_u8(b, "queued", is_queued);
+        if (process_running)
+        {
+            blobmsg_add_u32(
+                b, "test_process_pid", interface_tester_process_pid(&slot->proc));
+        }
+        dump_timer_state(b, &slot->response_timeout_timer);
+
+        blobmsg_close_table(b, slot_cky);
+
+        test_process_running = test_process_running || process_running;
+    }
+
+    blobmsg_close_array(b, cky);
+
+    blobmsg_add_u8(b, "test_process_running", test_process_running);
+}
+
+#if WITH_METRICS_ADJUSTMENT
+static void
+dump_metrics_adjuster_state(
+    struct blob_buf * const b, metrics_adjuster_st const * const adjuster)
+{
+    metrics_adjuster_stats_st const * const stats = metrics_adjuster_stats(adjuster);
+    void * const cky = blobmsg_open_table(b, "metrics_adjustment");
+    uint32_t applied;
+
+    blobmsg_add_u32(b, "desired", metrics_adjuster_desired(adjuster));
+    if (metrics_adjuster_applied(adjuster, &applied))
+    {
+        blobmsg_add_u32(b, "applied", applied);
+    }
+    blobmsg_add_u8(b, "pending", metrics_adjuster_is_pending(adjuster));
+    blobmsg_add_u32(b, "retries", metrics_adjuster_retries(adjuster));
+    blobmsg_add_u64(b, "requests", stats->requests);
+    blobmsg_add_u64(b, "failures", stats->failures);
+    blobmsg_add_u64(b, "coalesced", stats->coalesced);
+
+    blobmsg_close_table(b, cky);
+}
+#endif
+
+static void
+dump_tester_state(struct blob_buf * const b, interface_st * const iface)
 {
     interface_tester_st const * const tester = &iface->tester;
     interface_recovery_st const * const recovery = &iface->recovery;
@@ -105,9 +379,9 @@ dump_tester_state(struct blob_buf * const b, interface_st const * const iface)
 
 #if WITH_METRICS_ADJUSTMENT
     blobmsg_add_u8(b, "metrics_are_adjusted", recovery->metrics_are_adjusted);
+    dump_metrics_adjuster_state(b, &recovery->metrics_adjuster);
 #endif
 
-    dump_timer_state(b, &tester->test_response_timeout_timer);
     dump_timer_state(b, &tester->test_interval_timer);
     dump_timer_state(b, &recovery->response_timeout_timer);
 
@@ -115,32 +389,32 @@ dump_tester_state(struct blob_buf * const b, interface_st const * const iface)
     {
         blobmsg_add_u32(b, "next_recovery_task", recovery->recovery_index);
         blobmsg_add_string(
-            b, "next_recovery_label", config->recoverys[recovery->recovery_index].label);
+            b, "next_recovery_label", config->recoverys[recovery->recovery_index]->label);
     }
 
-    blobmsg_add_u8(
-        b, "test_process_running", tester->test_proc.uloop.pending);
-    if (tester->test_proc.uloop.pending)
-    {
-        blobmsg_add_u32(b, "test_process_pid", tester->test_proc.uloop.pid);
-    }
+    dump_running_tests(b, iface);
     blobmsg_add_u32(b, "last_test_exit_code", tester->last_test_exit_code);
     blobmsg_add_u8(b, "last_test_passed", tester->last_test_passed);
 
-    blobmsg_add_u8(
-        b, "recovery_task_running", recovery->proc.uloop.pending);
-    if (recovery->proc.uloop.pending)
+    bool const recovery_task_running =
+        interface_tester_process_is_running(&recovery->proc);
+
+    blobmsg_add_u8(b, "recovery_task_running", recovery_task_running);
+    if (recovery_task_running)
     {
-        blobmsg_add_u32(b, "recovery_task_process_pid", recovery->proc.uloop.pid);
+        blobmsg_add_u32(
+            b, "recovery_task_process_pid", interface_tester_process_pid(&recovery->proc));
     }
 
-    dump_tester_stats(b, tester);
+    dump_snapshot(b, iface, &iface->stats_snapshot, iface->state_generation, 0, dump_tester_stats);
+    dump_scheduler_state(b, iface);
+    dump_event_queue_state(b, iface);
 
     blobmsg_close_table(b, cky);
 }
 
 static void
-interface_dump_state(interface_st const * const iface, struct blob_buf * const b)
+interface_dump_state(interface_st * const iface, struct blob_buf * const b)
 {
     void * const cky = blobmsg_open_table(b, "state");
 
@@ -150,6 +424,18 @@ interface_dump_state(interface_st const * const iface, struct blob_buf * const b
     blobmsg_close_table(b, cky);
 }
 
+static void
+dump_exec_entry(struct blob_buf * const b, exec_entry_st const * const exec)
+{
+    bool const resolved = exec != NULL && exec_entry_is_resolved(exec);
+
+    blobmsg_add_u8(b, "executable_resolved", resolved);
+    if (!resolved && exec != NULL)
+    {
+        blobmsg_add_string(b, "executable_error", strerror(exec_entry_error(exec)));
+    }
+}
+
 static void
 interface_dump_test_config(
     interface_config_st const * const config, struct blob_buf * const b)
@@ -158,10 +444,15 @@ interface_dump_test_config(
 
     for (size_t i = 0; i < config->num_tests; i++)
     {
-        test_config_st const * const test = &config->tests[i];
+        test_config_st const * const test = config->tests[i];
         void * const test_cky = blobmsg_open_table(b, NULL);
 
-        blobmsg_add_string(b, Sexecutable, test->executable_name);
+        blobmsg_add_string(b, Stype, test_type_to_str(test->type));
+        if (test->type == TEST_TYPE_EXECUTABLE)
+        {
+            blobmsg_add_string(b, Sexecutable, test->executable_name);
+            dump_exec_entry(b, test->exec);
+        }
         blobmsg_add_string(b, Slabel, test->label);
         blobmsg_add_u32(b, Sresponse_timeout_secs, test->response_timeout_secs);
         blobmsg_add_blob(b, test->params);
@@ -180,10 +471,11 @@ interface_dump_recovery_config(
 
     for (size_t i = 0; i < config->num_recoverys; i++)
     {
-        recovery_config_st const * const recovery = &config->recoverys[i];
+        recovery_config_st const * const recovery = config->recoverys[i];
         void * const recoverys_cky = blobmsg_open_table(b, NULL);
 
         blobmsg_add_string(b, Sexecutable, recovery->executable_name);
+        dump_exec_entry(b, recovery->exec);
         blobmsg_add_string(b, Slabel, recovery->label);
         blobmsg_add_u32(b, Sresponse_timeout_secs, recovery->response_timeout_secs);
         blobmsg_add_blob(b, recovery->params);
@@ -194,25 +486,36 @@ interface_dump_recovery_config(
     blobmsg_close_array(b, cky);
 }
 
-static void
-interface_dump_config(interface_st * const iface, struct blob_buf * const b)
+void
+interface_config_dump(interface_st const * const iface, struct blob_buf * const b)
 {
     interface_config_st const * const config = &iface->config;
-    void * const cky = blobmsg_open_table(b, Sconfig);
 
     blobmsg_add_string(b, Ssuccess_condition, config->success_condition->name);
     blobmsg_add_u32(b, Ssettling_delay_secs, config->settling_delay_secs);
     blobmsg_add_u32(b, Spassing_interval_secs, config->test_passing_interval_secs);
     blobmsg_add_u32(b, Sfailing_interval_secs, config->test_failing_interval_secs);
-    blobmsg_add_u32(b, Spass_threshold, config->fail_threshold);
-    blobmsg_add_u32(b, Sfail_threshold, config->pass_threshold);
+    blobmsg_add_u32(b, Spass_threshold, config->pass_threshold);
+    blobmsg_add_u32(b, Sfail_threshold, config->fail_threshold);
     blobmsg_add_u32(b, Sresponse_timeout_secs, config->response_timeout_secs);
+    blobmsg_add_u8(b, Sparallel_tests, config->parallel_tests);
+    blobmsg_add_u32(b, Sscheduler_priority, config->scheduler_priority);
+    blobmsg_add_u32(b, Sinterval_jitter_percent, config->interval_jitter_percent);
+    blobmsg_add_u8(b, Sphase_spreading, config->phase_spreading);
 #if WITH_METRICS_ADJUSTMENT
     blobmsg_add_u32(b, Sfailing_tests_metrics_increase, config->failing_tests_metrics_increase);
 #endif
 
     interface_dump_test_config(config, b);
     interface_dump_recovery_config(config, b);
+}
+
+static void
+interface_dump_config(struct blob_buf * const b, interface_st const * const iface)
+{
+    void * const cky = blobmsg_open_table(b, Sconfig);
+
+    interface_config_dump(iface, b);
 
     blobmsg_close_table(b, cky);
 }
@@ -220,18 +523,49 @@ interface_dump_config(interface_st * const iface, struct blob_buf * const b)
 void
 interface_state_dump(interface_st * const iface, struct blob_buf * const b)
 {
+    blobmsg_add_u64(b, "generation", iface->state_generation);
     interface_dump_state(iface, b);
-    interface_dump_config(iface, b);
+    dump_snapshot(
+        b,
+        iface,
+        &iface->config_snapshot,
+        iface->config_changed_generation,
+        exec_cache_generation(&iface->ctx->exec_cache),
+        interface_dump_config);
 }
 
 void
-interface_states_dump(
-    interface_tester_shared_st * const ctx, struct blob_buf * const b)
+interface_output_dump(interface_st const * const iface, struct blob_buf * const b)
+{
+    output_buffer_st const * const output = &iface->output;
+
+    blobmsg_add_u64(b, "buffer_size", output_buffer_size(output));
+    blobmsg_add_u64(b, "total_bytes", output_buffer_total_bytes(output));
+    blobmsg_add_u64(b, "truncated_bytes", output_buffer_truncated_bytes(output));
+
+    char * const text =
+        blobmsg_alloc_string_buffer(b, "output", output_buffer_used(output) + 1);
+
+    if (text != NULL)
+    {
+        output_buffer_copy(output, text);
+        blobmsg_add_string_buffer(b);
+    }
+}
+
+static void
+dump_interface_states(
+    interface_tester_shared_st * const ctx, struct blob_buf * const b, uint64_t const since)
 {
     interface_st * iface;
 
     vlist_for_each_element(&ctx->interfaces, iface, node)
     {
+        if (iface->state_generation <= since)
+        {
+            continue;
+        }
+
         void * const iface_cky = blobmsg_open_table(b, iface->name);
 
         interface_state_dump(iface, b);
@@ -240,3 +574,316 @@ interface_states_dump(
     }
 }
 
+void
+interface_states_dump(
+    interface_tester_shared_st * const ctx, struct blob_buf * const b)
+{
+    dump_interface_states(ctx, b, 0);
+}
+
+void
+interface_states_dump_since(
+    interface_tester_shared_st * const ctx, struct blob_buf * const b, uint64_t const since)
+{
+    blobmsg_add_u64(b, "generation", ctx->state_generation);
+    blobmsg_add_u64(b, "membership_generation", ctx->membership_generation);
+
+    void * const cky = blobmsg_open_table(b, "interfaces");
+
+    dump_interface_states(ctx, b, since);
+
+    blobmsg_close_table(b, cky);
+}
+
+
+typedef struct trace_record_st
+{
+    flight_record_st const * record;
+    size_t index; /* Age order in the flight recorder. */
+} trace_record_st;
+
+static uint32_t
+trace_track_id(flight_record_st const * const record)
+{
+    /* Perfetto shows each thread id as a separate track. */
+    return record->interface_id * FLIGHT_RECORDER_MACHINE_COUNT__ + record->machine + 1;
+}
+
+static int
+trace_record_compare(void const * const a, void const * const b)
+{
+    trace_record_st const * const lhs = a;
+    trace_record_st const * const rhs = b;
+    uint32_t const lhs_track = trace_track_id(lhs->record);
+    uint32_t const rhs_track = trace_track_id(rhs->record);
+
+    int result;
+
+    if (lhs_track != rhs_track)
+    {
+        result = lhs_track < rhs_track ? -1 : 1;
+    }
+    else
+    {
+        result = lhs->index < rhs->index ? -1 : lhs->index > rhs->index;
+    }
+
+    return result;
+}
+
+static char const *
+trace_state_to_str(unsigned int const machine, unsigned int const state)
+{
+    char const * name;
+
+    switch (machine)
+    {
+    case FLIGHT_RECORDER_MACHINE_CONNECTION:
+        name = interface_connection_state_to_str(state);
+        break;
+
+    case FLIGHT_RECORDER_MACHINE_TESTER:
+        name = interface_tester_state_to_str(state);
+        break;
+
+    case FLIGHT_RECORDER_MACHINE_RECOVERY:
+        name = interface_recovery_state_to_str(state);
+        break;
+
+    default:
+        name = "unknown";
+        break;
+    }
+
+    return name;
+}
+
+typedef struct trace_interface_st
+{
+    uint32_t id;
+    char const * name;
+} trace_interface_st;
+
+static int
+trace_interface_compare(void const * const a, void const * const b)
+{
+    trace_interface_st const * const lhs = a;
+    trace_interface_st const * const rhs = b;
+
+    return lhs->id < rhs->id ? -1 : lhs->id > rhs->id;
+}
+
+/*
+ * The interfaces are listed by name, so collect their ids once rather than
+ * walking the list for each track.
+ */
+static trace_interface_st *
+trace_interfaces_collect(interface_tester_shared_st * const ctx, size_t * const num_interfaces)
+{
+    size_t const count = ctx->interfaces.avl.count;
+    trace_interface_st * const interfaces = calloc(count > 0 ? count : 1, sizeof(*interfaces));
+    interface_st * iface;
+    size_t i = 0;
+
+    if (interfaces == NULL)
+    {
+        *num_interfaces = 0;
+        goto done;
+    }
+
+    vlist_for_each_element(&ctx->interfaces, iface, node)
+    {
+        interfaces[i].id = iface->id;
+        interfaces[i].name = iface->name;
+        i++;
+    }
+    qsort(interfaces, i, sizeof(*interfaces), trace_interface_compare);
+    *num_interfaces = i;
+
+done:
+    return interfaces;
+}
+
+static char const *
+trace_interface_name(
+    trace_interface_st const * const interfaces,
+    size_t const num_interfaces,
+    uint32_t const interface_id)
+{
+    trace_interface_st const key = { .id = interface_id };
+    trace_interface_st const * const found =
+        interfaces != NULL
+        ? bsearch(&key, interfaces, num_interfaces, sizeof(*interfaces), trace_interface_compare)
+        : NULL;
+
+    return found != NULL ? found->name : NULL;
+}
+
+static void
+trace_add_track_name(
+    struct blob_buf * const b,
+    char const * const iface_name,
+    flight_record_st const * const record)
+{
+    char const * const machine_name = flight_recorder_machine_to_str(record->machine);
+    char track_name[64];
+
+    if (iface_name != NULL)
+    {
+        snprintf(track_name, sizeof(track_name), "%s %s", iface_name, machine_name);
+    }
+    else
+    {
+        /* The interface has since been removed from the configuration. */
+        snprintf(track_name,
+                 sizeof(track_name),
+                 "interface %" PRIu32 " %s",
+                 record->interface_id,
+                 machine_name);
+    }
+
+    void * const cky = blobmsg_open_table(b, NULL);
+
+    blobmsg_add_string(b, "name", "thread_name");
+    blobmsg_add_string(b, "ph", "M");
+    blobmsg_add_u32(b, "pid", 1);
+    blobmsg_add_u32(b, "tid", trace_track_id(record));
+
+    void * const args_cky = blobmsg_open_table(b, "args");
+
+    blobmsg_add_string(b, "name", track_name);
+    blobmsg_close_table(b, args_cky);
+
+    blobmsg_close_table(b, cky);
+}
+
+static void
+trace_add_span(
+    struct blob_buf * const b,
+    flight_record_st const * const record,
+    uint64_t const end_nsecs)
+{
+    void * const cky = blobmsg_open_table(b, NULL);
+
+    blobmsg_add_string(b, "name", trace_state_to_str(record->machine, record->new_state));
+    blobmsg_add_string(b, "cat", flight_recorder_machine_to_str(record->machine));
+    blobmsg_add_string(b, "ph", "X");
+    blobmsg_add_double(b, "ts", record->timestamp_nsecs / 1000.0);
+    blobmsg_add_double(b, "dur", (end_nsecs - record->timestamp_nsecs) / 1000.0);
+    blobmsg_add_u32(b, "pid", 1);
+    blobmsg_add_u32(b, "tid", trace_track_id(record));
+
+    void * const args_cky = blobmsg_open_table(b, "args");
+
+    blobmsg_add_string(b, "from", trace_state_to_str(record->machine, record->old_state));
+    if (record->event != FLIGHT_RECORDER_NO_EVENT)
+    {
+        blobmsg_add_string(b, "event", tester_event_to_str(record->event));
+    }
+    blobmsg_close_table(b, args_cky);
+
+    blobmsg_close_table(b, cky);
+}
+
+void
+flight_recorder_trace_dump(
+    interface_tester_shared_st * const ctx,
+    struct blob_buf * const b,
+    uint64_t const since,
+    size_t const limit)
+{
+    size_t const used = flight_recorder_used();
+    uint64_t const total = flight_recorder_total();
+    uint64_t const oldest = total - used;
+    uint64_t const first = since > oldest ? (since < total ? since : total) : oldest;
+    size_t const first_index = first - oldest;
+    size_t const max_records = limit < FLIGHT_RECORDER_TRACE_MAX_RECORDS
+        ? limit
+        : FLIGHT_RECORDER_TRACE_MAX_RECORDS;
+    size_t const num_records =
+        used - first_index < max_records ? used - first_index : max_records;
+    /*
+     * The records after those dumped are needed too, as they show when the
+     * last state dumped for each state machine ended.
+     */
+    size_t const num_sorted = used - first_index;
+    uint64_t const now_nsecs = flight_recorder_now_nsecs();
+    trace_record_st * const records = calloc(num_sorted > 0 ? num_sorted : 1, sizeof(*records));
+    size_t num_interfaces;
+    trace_interface_st * const interfaces = trace_interfaces_collect(ctx, &num_interfaces);
+
+    if (records == NULL)
+    {
+        goto done;
+    }
+
+    for (size_t i = 0; i < num_sorted; i++)
+    {
+        records[i].record = flight_recorder_get(first_index + i);
+        records[i].index = i;
+    }
+
+    /*
+     * Each state lasts until the next transition of the same state machine,
+     * so group the records by state machine to find where each state ends.
+     */
+    qsort(records, num_sorted, sizeof(*records), trace_record_compare);
+
+    void * const events_cky = blobmsg_open_array(b, "traceEvents");
+    void * const process_cky = blobmsg_open_table(b, NULL);
+
+    blobmsg_add_string(b, "name", "process_name");
+    blobmsg_add_string(b, "ph", "M");
+    blobmsg_add_u32(b, "pid", 1);
+
+    void * const process_args_cky = blobmsg_open_table(b, "args");
+
+    blobmsg_add_string(b, "name", "interface_tester");
+    blobmsg_close_table(b, process_args_cky);
+    blobmsg_close_table(b, process_cky);
+
+    bool track_named = false;
+
+    for (size_t i = 0; i < num_sorted; i++)
+    {
+        flight_record_st const * const record = records[i].record;
+        bool const is_first_on_track =
+            i == 0 || trace_track_id(records[i - 1].record) != trace_track_id(record);
+        bool const is_last_on_track =
+            i + 1 == num_sorted || trace_track_id(records[i + 1].record) != trace_track_id(record);
+
+        if (is_first_on_track)
+        {
+            track_named = false;
+        }
+        if (records[i].index >= num_records)
+        {
+            continue;
+        }
+        if (!track_named)
+        {
+            trace_add_track_name(
+                b, trace_interface_name(interfaces, num_interfaces, record->interface_id), record);
+            track_named = true;
+        }
+        /* The most recent state of each state machine lasts until now. */
+        trace_add_span(
+            b, record, is_last_on_track ? now_nsecs : records[i + 1].record->timestamp_nsecs);
+    }
+
+    blobmsg_close_array(b, events_cky);
+
+    blobmsg_add_string(b, "displayTimeUnit", "ms");
+
+    void * const other_cky = blobmsg_open_table(b, "otherData");
+
+    blobmsg_add_u64(b, "transitions_recorded", total);
+    blobmsg_add_u64(b, "transitions_held", used);
+    blobmsg_add_u64(b, "first", first);
+    blobmsg_add_u64(b, "next", first + num_records);
+    blobmsg_close_table(b, other_cky);
+
+done:
+    free(interfaces);
+    free(records);
+}
@@ -7,7 +7,43 @@
 void
 interface_state_dump(interface_st * iface, struct blob_buf * b);
 
+/*
+ * The interface's configuration, in the form accepted by the config_set ubus
+ * method.
+ */
+void
+interface_config_dump(interface_st const * iface, struct blob_buf * b);
+
+/* The recent output from the interface's tests and recovery tasks. */
+void
+interface_output_dump(interface_st const * iface, struct blob_buf * b);
+
+/*
+ * A full flight recorder would make a reply close to the largest ubus message,
+ * so a trace holds no more than this many transitions.
+ */
+#define FLIGHT_RECORDER_TRACE_MAX_RECORDS 1024
+
+/*
+ * Up to limit of the flight recorder's state transitions, starting with
+ * transition number since (counting from 0 as they are recorded), in the
+ * Chrome trace event format, which can be loaded into Perfetto
+ * (ui.perfetto.dev) or chrome://tracing. The number of the transition after
+ * the last one dumped is returned in otherData's "next".
+ */
+void
+flight_recorder_trace_dump(
+    interface_tester_shared_st * ctx, struct blob_buf * b, uint64_t since, size_t limit);
+
 void
 interface_states_dump(
     interface_tester_shared_st * const ctx, struct blob_buf * const b);
 
+/*
+ * The current state generation, and the states of only the interfaces that
+ * have changed since the state generation given.
+ */
+void
+interface_states_dump_since(
+    interface_tester_shared_st * ctx, struct blob_buf * b, uint64_t since);
+
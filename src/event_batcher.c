@@ -0,0 +1,95 @@
+#include "event_batcher.h"
+#include "debug.h"
+
+#include <libubox/utils.h>
+
+static char const batch_event_id[] = "interface.tester.batch";
+
+static void
+batch_start(event_batcher_st * const batcher)
+{
+    blob_buf_init(&batcher->buf_, 0);
+    batcher->events_cky_ = blobmsg_open_array(&batcher->buf_, "events");
+    batcher->count_ = 0;
+}
+
+void
+event_batcher_flush(event_batcher_st * const batcher)
+{
+    timer_stop(&batcher->timer_);
+
+    if (batcher->count_ == 0)
+    {
+        goto done;
+    }
+
+    blobmsg_close_array(&batcher->buf_, batcher->events_cky_);
+    if (batcher->ubus_->sock.fd >= 0)
+    {
+        ubus_send_event(batcher->ubus_, batch_event_id, batcher->buf_.head);
+    }
+    else
+    {
+        DLOG("%s: dropped %u events while disconnected from ubus", __func__, batcher->count_);
+    }
+    batch_start(batcher);
+
+done:
+    return;
+}
+
+static void
+timer_expired(timer_st * const t)
+{
+    event_batcher_st * const batcher = container_of(t, event_batcher_st, timer_);
+
+    event_batcher_flush(batcher);
+}
+
+void
+event_batcher_add(
+    event_batcher_st * const batcher, char const * const event, struct blob_attr * const data)
+{
+    /* Each event is held as it would be shown by "ubus listen". */
+    void * const cky = blobmsg_open_table(&batcher->buf_, NULL);
+
+    blobmsg_add_field(
+        &batcher->buf_, BLOBMSG_TYPE_TABLE, event, blob_data(data), blob_len(data));
+    blobmsg_close_table(&batcher->buf_, cky);
+    batcher->count_++;
+
+    if (batcher->count_ >= EVENT_BATCHER_MAX_EVENTS)
+    {
+        event_batcher_flush(batcher);
+    }
+    else if (!timer_is_running(&batcher->timer_))
+    {
+        timer_start(&batcher->timer_, batcher->window_msecs_);
+    }
+}
+
+bool
+event_batcher_is_enabled(event_batcher_st const * const batcher)
+{
+    return batcher->window_msecs_ > 0;
+}
+
+void
+event_batcher_cleanup(event_batcher_st * const batcher)
+{
+    event_batcher_flush(batcher);
+    blob_buf_free(&batcher->buf_);
+}
+
+void
+event_batcher_init(
+    event_batcher_st * const batcher,
+    struct ubus_context * const ubus,
+    uint32_t const window_msecs)
+{
+    *batcher = (event_batcher_st){ 0 };
+    batcher->ubus_ = ubus;
+    batcher->window_msecs_ = window_msecs;
+    timer_init(&batcher->timer_, "event_batch_timer", timer_expired);
+    batch_start(batcher);
+}
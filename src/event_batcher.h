@@ -0,0 +1,47 @@
+#pragma once
+
+#include "timers.h"
+
+#include <libubox/blobmsg.h>
+#include <libubus.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Events are collected for a short window and then sent together as a single
+ * interface.tester.batch event, rather than one ubus message each. The batch is
+ * sent early if it holds EVENT_BATCHER_MAX_EVENTS events, so it stays well
+ * within the largest message ubusd will accept.
+ */
+
+#define EVENT_BATCHER_MAX_EVENTS 256
+
+typedef struct event_batcher_st
+{
+    /* Users should not access these fields directly. */
+    struct ubus_context * ubus_;
+    uint32_t window_msecs_; /* 0 if events aren't batched. */
+    struct blob_buf buf_;
+    void * events_cky_;
+    unsigned int count_; /* The number of events in buf_. */
+    timer_st timer_;
+} event_batcher_st;
+
+void
+event_batcher_init(
+    event_batcher_st * batcher, struct ubus_context * ubus, uint32_t window_msecs);
+
+bool
+event_batcher_is_enabled(event_batcher_st const * batcher);
+
+/* Add an event with the given data, which must be a blobmsg table. */
+void
+event_batcher_add(event_batcher_st * batcher, char const * event, struct blob_attr * data);
+
+/* Send any events that have been collected without waiting for the window to end. */
+void
+event_batcher_flush(event_batcher_st * batcher);
+
+void
+event_batcher_cleanup(event_batcher_st * batcher);
@@ -1,34 +1,92 @@
 #include "event_queue.h"
 #include "debug.h"
-#include "tester_common.h"
 
 #include <libubox/utils.h>
 
-static void
-handle_events(event_q_st * const event_queue)
+#include <stdlib.h>
+#include <time.h>
+
+static uint64_t
+monotonic_usecs(void)
 {
-    if (event_queue->num_events > 1)
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static bool
+event_queue_grow(event_q_st * const event_queue)
+{
+    bool success;
+    size_t const new_size =
+        event_queue->size_ > 0 ? event_queue->size_ * 2 : EVENT_QUEUE_INITIAL_SIZE;
+    event_st * const events = realloc(event_queue->events_, new_size * sizeof(*events));
+
+    if (events == NULL)
     {
-        /*
-         * If there is more than one event on the queue then that means that
-         * this call to handle events isn't necessary as all existing events on
-         * the queue will be processed by the caller that added the first
-         * message to the queue.
-         */
+        success = false;
         goto done;
     }
 
-    for (size_t event_index = 0; event_index < event_queue->num_events; event_index++)
-    {
-        event_st const * const e = &event_queue->events[event_index];
+    /*
+     * The ring is full, so the events that wrapped around to the start of the
+     * old buffer are moved up to follow on from the end of it.
+     */
+    size_t const wrapped = event_queue->head_;
 
-        e->handler(e->event_ctx, e->event);
+    for (size_t i = 0; i < wrapped; i++)
+    {
+        events[event_queue->size_ + i] = events[i];
+    }
+    if (event_queue->num_events_ == 0)
+    {
+        event_queue->head_ = 0;
     }
 
-    event_queue->num_events = 0;
+    event_queue->events_ = events;
+    event_queue->size_ = new_size;
+    success = true;
 
 done:
-    return;
+    return success;
+}
+
+static void
+handle_events(event_q_st * const event_queue)
+{
+    event_queue_stats_st * const stats = &event_queue->stats_;
+
+    /*
+     * Events added by the handlers are handled in this pass too, just as they
+     * would have been had they been queued before it started.
+     */
+    while (event_queue->num_events_ > 0)
+    {
+        event_st const e = event_queue->events_[event_queue->head_];
+        uint64_t const latency_usecs = monotonic_usecs() - e.queued_usecs;
+
+        event_queue->head_ = (event_queue->head_ + 1) % event_queue->size_;
+        event_queue->num_events_--;
+
+        stats->handled++;
+        stats->total_latency_usecs += latency_usecs;
+        if (latency_usecs > stats->max_latency_usecs)
+        {
+            stats->max_latency_usecs = latency_usecs;
+        }
+
+        e.handler(e.event_ctx, e.event);
+    }
+}
+
+static void
+dispatch_timer_expired(timer_st * const t)
+{
+    event_q_st * const event_queue = container_of(t, event_q_st, dispatch_timer_);
+
+    handle_events(event_queue);
 }
 
 void
@@ -38,28 +96,71 @@ event_queue_add_event(
     void * const event_ctx,
     tester_event_t const event)
 {
-    if (event_queue->num_events >= ARRAY_SIZE(event_queue->events))
+    if (event_queue->num_events_ == event_queue->size_ && !event_queue_grow(event_queue))
     {
-        DLOG("unable to stack the next event (%s)", tester_event_to_str(event));
+        ILOG("unable to grow the event queue; dropping event %d", event);
+        event_queue->stats_.dropped++;
 
         goto done;
     }
 
-    event_st * const e = &event_queue->events[event_queue->num_events];
+    size_t const tail = (event_queue->head_ + event_queue->num_events_) % event_queue->size_;
+    event_st * const e = &event_queue->events_[tail];
 
     e->handler = handler;
     e->event_ctx = event_ctx;
     e->event = event;
-    event_queue->num_events++;
+    e->queued_usecs = monotonic_usecs();
+    event_queue->num_events_++;
 
-    handle_events(event_queue);
+    event_queue->stats_.queued++;
+    if (event_queue->num_events_ > event_queue->stats_.high_water)
+    {
+        event_queue->stats_.high_water = event_queue->num_events_;
+    }
+
+    if (!timer_is_running(&event_queue->dispatch_timer_))
+    {
+        timer_start(&event_queue->dispatch_timer_, 0);
+    }
 
 done:
     return;
 }
 
+size_t
+event_queue_pending(event_q_st const * const event_queue)
+{
+    return event_queue->num_events_;
+}
+
+size_t
+event_queue_size(event_q_st const * const event_queue)
+{
+    return event_queue->size_;
+}
+
+event_queue_stats_st const *
+event_queue_stats(event_q_st const * const event_queue)
+{
+    return &event_queue->stats_;
+}
+
+void
+event_queue_cleanup(event_q_st * const event_queue)
+{
+    timer_stop(&event_queue->dispatch_timer_);
+    free(event_queue->events_);
+    event_queue->events_ = NULL;
+    event_queue->size_ = 0;
+    event_queue->head_ = 0;
+    event_queue->num_events_ = 0;
+}
+
 void
 event_queue_init(event_q_st * const event_queue)
 {
-    event_queue->num_events = 0;
+    *event_queue = (event_q_st){0};
+    timer_init(&event_queue->dispatch_timer_, "event_dispatch_timer", dispatch_timer_expired);
+    event_queue_grow(event_queue);
 }
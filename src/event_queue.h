@@ -1,28 +1,51 @@
 #pragma once
 
 #include "interface_tester_events.h"
-
-#include <libubox/uloop.h>
+#include "timers.h"
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
-/* Maximum number of events expected to be stacked at any one time. */
-#define MAX_EVENTS 3
+/*
+ * Events are held in a ring buffer that grows as required, and are handled
+ * from a zero length timer rather than from within the call that adds them, so
+ * an event raised while another is being handled is never lost, and is handled
+ * in the order it was raised.
+ */
+
+/* The number of events the queue can hold before it first has to grow. */
+#define EVENT_QUEUE_INITIAL_SIZE 4
 
 typedef void (*event_handler_fn)(void * state_ctx, tester_event_t event);
 
 typedef struct event_st
 {
-    struct list_head entry;
     event_handler_fn handler;
     void * event_ctx;
     tester_event_t event;
+    uint64_t queued_usecs;
 } event_st;
 
+typedef struct event_queue_stats_st
+{
+    uint64_t queued;
+    uint64_t handled;
+    uint64_t dropped; /* Only if the queue couldn't grow. */
+    size_t high_water; /* The most events that have been waiting at once. */
+    uint64_t total_latency_usecs; /* From being queued until being handled. */
+    uint64_t max_latency_usecs;
+} event_queue_stats_st;
+
 typedef struct event_q_st
 {
-    size_t num_events;
-    event_st events[MAX_EVENTS];
+    /* Users should not access these fields directly. */
+    event_st * events_;
+    size_t size_;
+    size_t head_;
+    size_t num_events_;
+    timer_st dispatch_timer_;
+    event_queue_stats_st stats_;
 } event_q_st;
 
 
@@ -31,8 +54,8 @@ void
 event_queue_init(event_q_st * event_queue);
 
 /*
- * Add an event onto the queue and handle the events on it if not already doing
- * so.
+ * Add an event onto the queue. The event is handled once control returns to
+ * the event loop.
  */
 void
 event_queue_add_event(
@@ -45,3 +68,12 @@ event_queue_add_event(
 void
 event_queue_cleanup(event_q_st * event_queue);
 
+size_t
+event_queue_pending(event_q_st const * event_queue);
+
+size_t
+event_queue_size(event_q_st const * event_queue);
+
+event_queue_stats_st const *
+event_queue_stats(event_q_st const * event_queue);
+
@@ -0,0 +1,409 @@
+#include "exec_cache.h"
+#include "debug.h"
+#include "utils.h"
+
+#include <libubox/avl-cmp.h>
+#include <libubox/utils.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef DEBUG
+#include <assert.h>
+#endif
+
+/* Changes to a directory that may affect the executables within it. */
+#define EXEC_DIRECTORY_WATCH_MASK \
+    (IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO \
+     | IN_DELETE_SELF | IN_MOVE_SELF)
+
+char const *
+exec_dir_to_str(exec_dir_t const dir)
+{
+    static char const * dirs[EXEC_DIR_COUNT__] =
+    {
+    [EXEC_DIR_TESTS] = "tests",
+    [EXEC_DIR_RECOVERY] = "recovery",
+    };
+
+#ifdef DEBUG
+    assert(dir < ARRAY_SIZE(dirs));
+    assert(dirs[dir] != NULL);
+#endif
+
+    return dirs[dir];
+}
+
+static char const *
+exec_directory_path(exec_directory_st const * const dir)
+{
+    return dir->path_ != NULL ? dir->path_ : ".";
+}
+
+static void
+exec_entry_unresolve(exec_entry_st * const entry)
+{
+    if (entry->fd_ >= 0)
+    {
+        close(entry->fd_);
+        entry->fd_ = -1;
+    }
+}
+
+static void
+exec_entry_resolve(exec_entry_st * const entry)
+{
+    exec_directory_st const * const dir = entry->dir_;
+    struct stat st;
+
+    exec_entry_unresolve(entry);
+    dir->cache_->generation_++;
+
+    if (dir->fd_ < 0)
+    {
+        entry->error_ = dir->error_;
+        goto done;
+    }
+
+    /*
+     * O_PATH is enough to exec the file, and doesn't require read permission
+     * or update the access time.
+     */
+    int const fd = openat(dir->fd_, entry->name_, O_PATH | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        entry->error_ = errno;
+        goto done;
+    }
+
+    if (fstat(fd, &st) < 0)
+    {
+        entry->error_ = errno;
+        close(fd);
+        goto done;
+    }
+
+    /* The same checks that execve() would make. */
+    if (!S_ISREG(st.st_mode) || (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) == 0)
+    {
+        entry->error_ = EACCES;
+        close(fd);
+        goto done;
+    }
+
+    entry->fd_ = fd;
+    entry->error_ = 0;
+
+done:
+    if (entry->error_ != 0)
+    {
+        ILOG("%s: can't resolve %s/%s: %s",
+             __func__, exec_directory_path(dir), entry->name_, strerror(entry->error_));
+    }
+}
+
+static void
+exec_directory_resolve_all(exec_directory_st * const dir)
+{
+    exec_entry_st * entry;
+
+    avl_for_each_element(&dir->entries_, entry, node_)
+    {
+        exec_entry_resolve(entry);
+    }
+}
+
+static bool
+exec_directory_watch_is_shared(exec_directory_st const * const dir)
+{
+    exec_cache_st const * const cache = dir->cache_;
+    bool is_shared = false;
+
+    /* inotify hands out the same watch for the same directory. */
+    for (size_t i = 0; i < ARRAY_SIZE(cache->dirs_); i++)
+    {
+        exec_directory_st const * const other = &cache->dirs_[i];
+
+        if (other != dir && other->watch_ == dir->watch_)
+        {
+            is_shared = true;
+            break;
+        }
+    }
+
+    return is_shared;
+}
+
+static void
+exec_directory_close(exec_directory_st * const dir)
+{
+    if (dir->watch_ >= 0)
+    {
+        if (!exec_directory_watch_is_shared(dir))
+        {
+            inotify_rm_watch(dir->cache_->inotify_.fd, dir->watch_);
+        }
+        dir->watch_ = -1;
+    }
+    if (dir->fd_ >= 0)
+    {
+        close(dir->fd_);
+        dir->fd_ = -1;
+    }
+}
+
+static void
+exec_directory_open(exec_directory_st * const dir)
+{
+    char const * const path = exec_directory_path(dir);
+
+    exec_directory_close(dir);
+
+    dir->fd_ = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (dir->fd_ < 0)
+    {
+        dir->error_ = errno;
+        ILOG("%s: can't open %s: %s", __func__, path, strerror(dir->error_));
+        goto done;
+    }
+    dir->error_ = 0;
+
+    if (dir->cache_->inotify_.fd >= 0)
+    {
+        dir->watch_ =
+            inotify_add_watch(dir->cache_->inotify_.fd, path, EXEC_DIRECTORY_WATCH_MASK);
+        if (dir->watch_ < 0)
+        {
+            DLOG("%s: can't watch %s: %s", __func__, path, strerror(errno));
+        }
+    }
+
+done:
+    return;
+}
+
+static void
+exec_directory_handle_event(
+    exec_directory_st * const dir, struct inotify_event const * const event)
+{
+    if ((event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) != 0)
+    {
+        /* Whatever is now at the path is the directory to use. */
+        exec_directory_open(dir);
+        exec_directory_resolve_all(dir);
+    }
+    else if (event->len > 0)
+    {
+        exec_entry_st * const entry =
+            avl_find_element(&dir->entries_, event->name, entry, node_);
+
+        if (entry != NULL)
+        {
+            exec_entry_resolve(entry);
+        }
+    }
+}
+
+static void
+exec_cache_handle_event(exec_cache_st * const cache, struct inotify_event const * const event)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(cache->dirs_); i++)
+    {
+        exec_directory_st * const dir = &cache->dirs_[i];
+
+        if ((event->mask & IN_Q_OVERFLOW) != 0)
+        {
+            /* Some events have been lost, so check everything. */
+            exec_directory_resolve_all(dir);
+        }
+        else if (dir->watch_ >= 0 && dir->watch_ == event->wd)
+        {
+            exec_directory_handle_event(dir, event);
+        }
+    }
+}
+
+static void
+exec_cache_inotify_cb(struct uloop_fd * const fd, unsigned int const events)
+{
+    UNUSED(events);
+    exec_cache_st * const cache = container_of(fd, exec_cache_st, inotify_);
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+
+    while ((len = TEMP_FAILURE_RETRY(read(fd->fd, buf, sizeof(buf)))) > 0)
+    {
+        for (char const * p = buf; p < buf + len; )
+        {
+            struct inotify_event const * const event = (struct inotify_event const *)p;
+
+            exec_cache_handle_event(cache, event);
+            p += sizeof(*event) + event->len;
+        }
+    }
+}
+
+exec_entry_st *
+exec_cache_get(exec_cache_st * const cache, exec_dir_t const dir_type, char const * const name)
+{
+    exec_directory_st * const dir = &cache->dirs_[dir_type];
+    exec_entry_st * entry = avl_find_element(&dir->entries_, name, entry, node_);
+
+    if (dir->fd_ < 0)
+    {
+        /* The directory may have been created since it was last opened. */
+        exec_directory_open(dir);
+    }
+
+    if (entry == NULL)
+    {
+        char * entry_name;
+
+        entry = calloc_a(sizeof(*entry), &entry_name, strlen(name) + 1);
+        if (entry == NULL)
+        {
+            goto done;
+        }
+        entry->dir_ = dir;
+        entry->name_ = strcpy(entry_name, name);
+        entry->fd_ = -1;
+        entry->node_.key = entry->name_;
+        avl_insert(&dir->entries_, &entry->node_);
+    }
+
+    /* Loading the configuration is also a chance to pick up any changes. */
+    entry->refs_++;
+    exec_entry_resolve(entry);
+
+done:
+    return entry;
+}
+
+static void
+exec_entry_free(exec_entry_st * const entry)
+{
+    exec_entry_unresolve(entry);
+    avl_delete(&entry->dir_->entries_, &entry->node_);
+    free(entry);
+}
+
+void
+exec_entry_put(exec_entry_st * const entry)
+{
+    if (entry == NULL)
+    {
+        goto done;
+    }
+
+    entry->refs_--;
+    if (entry->refs_ == 0)
+    {
+        exec_entry_free(entry);
+    }
+
+done:
+    return;
+}
+
+unsigned int
+exec_cache_generation(exec_cache_st const * const cache)
+{
+    return cache->generation_;
+}
+
+bool
+exec_entry_is_resolved(exec_entry_st const * const entry)
+{
+    return entry->fd_ >= 0;
+}
+
+int
+exec_entry_error(exec_entry_st const * const entry)
+{
+    return entry->error_;
+}
+
+char const *
+exec_entry_name(exec_entry_st const * const entry)
+{
+    return entry->name_;
+}
+
+int
+exec_entry_fd(exec_entry_st const * const entry)
+{
+    return entry->fd_;
+}
+
+int
+exec_entry_dir_fd(exec_entry_st const * const entry)
+{
+    return entry->dir_->fd_;
+}
+
+void
+exec_cache_cleanup(exec_cache_st * const cache)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(cache->dirs_); i++)
+    {
+        exec_directory_st * const dir = &cache->dirs_[i];
+        exec_entry_st * entry;
+        exec_entry_st * tmp;
+
+        avl_for_each_element_safe(&dir->entries_, entry, node_, tmp)
+        {
+            exec_entry_free(entry);
+        }
+        exec_directory_close(dir);
+    }
+
+    if (cache->inotify_.fd >= 0)
+    {
+        uloop_fd_delete(&cache->inotify_);
+        close(cache->inotify_.fd);
+        cache->inotify_.fd = -1;
+    }
+}
+
+void
+exec_cache_init(
+    exec_cache_st * const cache,
+    char const * const test_directory,
+    char const * const recovery_directory)
+{
+    char const * const paths[EXEC_DIR_COUNT__] =
+    {
+    [EXEC_DIR_TESTS] = test_directory,
+    [EXEC_DIR_RECOVERY] = recovery_directory,
+    };
+
+    cache->inotify_.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cache->inotify_.fd >= 0)
+    {
+        cache->inotify_.cb = exec_cache_inotify_cb;
+        uloop_fd_add(&cache->inotify_, ULOOP_READ);
+    }
+    else
+    {
+        /* Changes won't be noticed until the configuration is next loaded. */
+        DLOG("%s: inotify unavailable: %s", __func__, strerror(errno));
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(cache->dirs_); i++)
+    {
+        exec_directory_st * const dir = &cache->dirs_[i];
+
+        dir->cache_ = cache;
+        dir->path_ = paths[i];
+        dir->fd_ = -1;
+        dir->watch_ = -1;
+        avl_init(&dir->entries_, avl_strcmp, false, NULL);
+        exec_directory_open(dir);
+    }
+}
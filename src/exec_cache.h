@@ -0,0 +1,102 @@
+#pragma once
+
+#include <libubox/avl.h>
+#include <libubox/uloop.h>
+
+#include <stdbool.h>
+
+/*
+ * A cache of the test and recovery task executables.
+ * Each directory is opened once, and each configured executable is resolved
+ * (opened and checked to be an executable file) when the configuration is
+ * loaded, rather than by the child each time it is run. The directories are
+ * watched with inotify so that an executable is resolved again if it is
+ * replaced, removed, or has its permissions changed.
+ */
+
+typedef enum exec_dir_t
+{
+    EXEC_DIR_TESTS,
+    EXEC_DIR_RECOVERY,
+    EXEC_DIR_COUNT__, /* Must be last in the list. */
+} exec_dir_t;
+
+typedef struct exec_cache_st exec_cache_st;
+
+typedef struct exec_directory_st
+{
+    /* Users should not access these fields directly. */
+    exec_cache_st * cache_;
+    char const * path_;
+    int fd_; /* O_PATH descriptor for the directory, or -1. */
+    int error_; /* The errno from the last attempt to open the directory. */
+    int watch_; /* inotify watch descriptor, or -1. */
+    struct avl_tree entries_;
+} exec_directory_st;
+
+typedef struct exec_entry_st
+{
+    /* Users should not access these fields directly. */
+    struct avl_node node_;
+    exec_directory_st * dir_;
+    char const * name_;
+    unsigned int refs_;
+    int fd_; /* O_PATH descriptor for the executable, or -1. */
+    int error_; /* The errno from the last attempt to resolve the executable. */
+} exec_entry_st;
+
+struct exec_cache_st
+{
+    /* Users should not access these fields directly. */
+    struct uloop_fd inotify_;
+    exec_directory_st dirs_[EXEC_DIR_COUNT__];
+    unsigned int generation_; /* Incremented each time an executable is resolved. */
+};
+
+/*
+ * A NULL directory path refers to the current working directory.
+ */
+void
+exec_cache_init(
+    exec_cache_st * cache, char const * test_directory, char const * recovery_directory);
+
+void
+exec_cache_cleanup(exec_cache_st * cache);
+
+/*
+ * Returns a reference to the entry for the named executable, resolving it
+ * again if it is already in the cache. The entry is returned even if the
+ * executable can't be resolved (see exec_entry_is_resolved()).
+ * Returns NULL only if memory couldn't be allocated.
+ */
+exec_entry_st *
+exec_cache_get(exec_cache_st * cache, exec_dir_t dir, char const * name);
+
+/* Release a reference returned by exec_cache_get(). entry may be NULL. */
+void
+exec_entry_put(exec_entry_st * entry);
+
+/* Changes whenever an executable may have been resolved differently. */
+unsigned int
+exec_cache_generation(exec_cache_st const * cache);
+
+bool
+exec_entry_is_resolved(exec_entry_st const * entry);
+
+/* Returns the reason the executable couldn't be resolved, or 0. */
+int
+exec_entry_error(exec_entry_st const * entry);
+
+char const *
+exec_entry_name(exec_entry_st const * entry);
+
+/* The descriptor to exec, or -1 if the executable isn't resolved. */
+int
+exec_entry_fd(exec_entry_st const * entry);
+
+/* The directory containing the executable, or -1 if it couldn't be opened. */
+int
+exec_entry_dir_fd(exec_entry_st const * entry);
+
+char const *
+exec_dir_to_str(exec_dir_t dir);
@@ -0,0 +1,41 @@
+#include "execution_stats.h"
+
+static size_t
+wall_msecs_to_bucket(uint64_t const wall_msecs)
+{
+    size_t bucket = 0;
+
+    /* The number of significant bits is the log2 bucket. */
+    for (uint64_t msecs = wall_msecs;
+         msecs > 0 && bucket < EXECUTION_STATS_HISTOGRAM_BUCKETS - 1;
+         msecs >>= 1)
+    {
+        bucket++;
+    }
+
+    return bucket;
+}
+
+uint64_t
+execution_stats_bucket_limit_msecs(size_t const bucket)
+{
+    return bucket < EXECUTION_STATS_HISTOGRAM_BUCKETS - 1 ? UINT64_C(1) << bucket : 0;
+}
+
+void
+execution_stats_record(execution_stats_st * const stats, process_usage_st const * const usage)
+{
+    stats->executions++;
+    stats->total_wall_usecs += usage->wall_usecs;
+    if (usage->wall_usecs > stats->max_wall_usecs)
+    {
+        stats->max_wall_usecs = usage->wall_usecs;
+    }
+    stats->total_user_usecs += usage->user_usecs;
+    stats->total_system_usecs += usage->system_usecs;
+    if (usage->max_rss_kb > stats->max_rss_kb)
+    {
+        stats->max_rss_kb = usage->max_rss_kb;
+    }
+    stats->wall_msecs_histogram[wall_msecs_to_bucket(usage->wall_usecs / 1000)]++;
+}
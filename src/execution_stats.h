@@ -0,0 +1,35 @@
+#pragma once
+
+#include "process.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The number of buckets in the wall time histogram. Bucket 0 counts
+ * executions that took less than 1ms, bucket n (n > 0) those that took at
+ * least 2^(n-1)ms but less than 2^n ms, and the last bucket everything longer.
+ */
+#define EXECUTION_STATS_HISTOGRAM_BUCKETS 20
+
+/* The resources used by the executions of a test or recovery task. */
+typedef struct execution_stats_st
+{
+    uint64_t executions;
+    uint64_t total_wall_usecs;
+    uint64_t max_wall_usecs;
+    uint64_t total_user_usecs;
+    uint64_t total_system_usecs;
+    uint64_t max_rss_kb;
+    uint64_t wall_msecs_histogram[EXECUTION_STATS_HISTOGRAM_BUCKETS];
+} execution_stats_st;
+
+void
+execution_stats_record(execution_stats_st * stats, process_usage_st const * usage);
+
+/*
+ * The exclusive upper bound (in milliseconds) of a histogram bucket, or 0 for
+ * the last bucket, which has no upper bound.
+ */
+uint64_t
+execution_stats_bucket_limit_msecs(size_t bucket);
@@ -0,0 +1,97 @@
+#include "flight_recorder.h"
+#include "debug.h"
+
+#include <libubox/utils.h>
+
+#include <time.h>
+
+#ifdef DEBUG
+#include <assert.h>
+#endif
+
+#define FLIGHT_RECORDER_MASK (FLIGHT_RECORDER_RECORDS - 1)
+
+_Static_assert((FLIGHT_RECORDER_RECORDS & FLIGHT_RECORDER_MASK) == 0,
+               "FLIGHT_RECORDER_RECORDS must be a power of 2");
+
+typedef struct flight_recorder_st
+{
+    uint64_t next; /* The total recorded. The next record goes at next & mask. */
+    flight_record_st records[FLIGHT_RECORDER_RECORDS];
+} flight_recorder_st;
+
+/*
+ * There is one recorder for the whole daemon. Everything runs in the one
+ * thread, so the ring needs no locking.
+ */
+static flight_recorder_st flight_recorder;
+
+char const *
+flight_recorder_machine_to_str(flight_recorder_machine_t const machine)
+{
+    static char const * machines[FLIGHT_RECORDER_MACHINE_COUNT__] =
+    {
+    [FLIGHT_RECORDER_MACHINE_CONNECTION] = "connection",
+    [FLIGHT_RECORDER_MACHINE_TESTER] = "tester",
+    [FLIGHT_RECORDER_MACHINE_RECOVERY] = "recovery",
+    };
+
+#ifdef DEBUG
+    assert(machine < ARRAY_SIZE(machines));
+    assert(machines[machine] != NULL);
+#endif
+
+    return machines[machine];
+}
+
+uint64_t
+flight_recorder_now_nsecs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void
+flight_recorder_record(
+    uint32_t const interface_id,
+    flight_recorder_machine_t const machine,
+    unsigned int const old_state,
+    unsigned int const new_state,
+    unsigned int const event)
+{
+    flight_record_st * const record =
+        &flight_recorder.records[flight_recorder.next & FLIGHT_RECORDER_MASK];
+
+    record->timestamp_nsecs = flight_recorder_now_nsecs();
+    record->interface_id = interface_id;
+    record->machine = machine;
+    record->old_state = old_state;
+    record->new_state = new_state;
+    record->event = event;
+    flight_recorder.next++;
+}
+
+size_t
+flight_recorder_used(void)
+{
+    return flight_recorder.next < FLIGHT_RECORDER_RECORDS
+        ? flight_recorder.next
+        : FLIGHT_RECORDER_RECORDS;
+}
+
+uint64_t
+flight_recorder_total(void)
+{
+    return flight_recorder.next;
+}
+
+flight_record_st const *
+flight_recorder_get(size_t const index)
+{
+    uint64_t const oldest = flight_recorder.next - flight_recorder_used();
+
+    return &flight_recorder.records[(oldest + index) & FLIGHT_RECORDER_MASK];
+}
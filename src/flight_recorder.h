@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * An always-on record of the state machine transitions of every interface.
+ * The most recent FLIGHT_RECORDER_RECORDS transitions are kept in a fixed
+ * size ring of binary records, so recording a transition costs no more than
+ * reading the clock and a few stores, and nothing is formatted until the
+ * records are dumped.
+ */
+
+/* Must be a power of 2. */
+#define FLIGHT_RECORDER_RECORDS 4096
+
+/* Recorded in place of an event for transitions not caused by one. */
+#define FLIGHT_RECORDER_NO_EVENT UINT8_MAX
+
+typedef enum flight_recorder_machine_t
+{
+    FLIGHT_RECORDER_MACHINE_CONNECTION,
+    FLIGHT_RECORDER_MACHINE_TESTER,
+    FLIGHT_RECORDER_MACHINE_RECOVERY,
+    FLIGHT_RECORDER_MACHINE_COUNT__, /* Must be last. */
+} flight_recorder_machine_t;
+
+typedef struct flight_record_st
+{
+    uint64_t timestamp_nsecs; /* CLOCK_MONOTONIC */
+    uint32_t interface_id;
+    uint8_t machine;
+    uint8_t old_state;
+    uint8_t new_state;
+    uint8_t event;
+} flight_record_st;
+
+void
+flight_recorder_record(
+    uint32_t interface_id,
+    flight_recorder_machine_t machine,
+    unsigned int old_state,
+    unsigned int new_state,
+    unsigned int event);
+
+/* The number of records held, at most FLIGHT_RECORDER_RECORDS. */
+size_t
+flight_recorder_used(void);
+
+/* The total number of transitions recorded, including those overwritten. */
+uint64_t
+flight_recorder_total(void);
+
+/* Index 0 is the oldest record held. index must be < flight_recorder_used(). */
+flight_record_st const *
+flight_recorder_get(size_t index);
+
+uint64_t
+flight_recorder_now_nsecs(void);
+
+char const *
+flight_recorder_machine_to_str(flight_recorder_machine_t machine);
+
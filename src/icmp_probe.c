@@ -0,0 +1,399 @@
+#include "icmp_probe.h"
+#include "debug.h"
+#include "utils.h"
+
+#include <libubox/blobmsg.h>
+
+#include <arpa/inet.h>
+#include <netinet/icmp6.h>
+#include <netinet/in.h>
+#include <netinet/ip_icmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The time between echo requests, and to wait for a reply to the last one. */
+static uint32_t const icmp_probe_interval_msecs = 1000;
+
+typedef enum icmp_probe_params_policy_t
+{
+    ICMP_PROBE_PARAMS_HOSTNAME,
+    ICMP_PROBE_PARAMS_COUNT,
+    ICMP_PROBE_PARAMS_DEVICE,
+    ICMP_PROBE_PARAMS_COUNT__,
+} icmp_probe_params_policy_t;
+
+static const struct blobmsg_policy icmp_probe_params_policy[ICMP_PROBE_PARAMS_COUNT__] =
+{
+    [ICMP_PROBE_PARAMS_HOSTNAME] = { .name = "hostname", .type = BLOBMSG_TYPE_STRING },
+    /* May be a string (as when passed to a ping executable) or a number. */
+    [ICMP_PROBE_PARAMS_COUNT] = { .name = "count", .type = BLOBMSG_TYPE_UNSPEC },
+    [ICMP_PROBE_PARAMS_DEVICE] = { .name = "device", .type = BLOBMSG_TYPE_STRING },
+};
+
+static bool
+parse_target(icmp_probe_config_st * const config, char const * const hostname)
+{
+    bool success;
+    struct sockaddr_in * const sin = (struct sockaddr_in *)&config->target;
+    struct sockaddr_in6 * const sin6 = (struct sockaddr_in6 *)&config->target;
+
+    memset(&config->target, 0, sizeof(config->target));
+
+    if (inet_pton(AF_INET, hostname, &sin->sin_addr) == 1)
+    {
+        sin->sin_family = AF_INET;
+        config->target_len = sizeof(*sin);
+    }
+    else if (inet_pton(AF_INET6, hostname, &sin6->sin6_addr) == 1)
+    {
+        sin6->sin6_family = AF_INET6;
+        config->target_len = sizeof(*sin6);
+    }
+    else
+    {
+        DLOG("icmp hostname must be an IP address: %s", hostname);
+
+        success = false;
+        goto done;
+    }
+
+    success = true;
+
+done:
+    return success;
+}
+
+static bool
+parse_count(icmp_probe_config_st * const config, struct blob_attr * const count)
+{
+    bool success;
+
+    if (count == NULL)
+    {
+        config->count = 1;
+    }
+    else if (blobmsg_type(count) == BLOBMSG_TYPE_INT32)
+    {
+        config->count = blobmsg_get_u32(count);
+    }
+    else if (blobmsg_type(count) == BLOBMSG_TYPE_STRING)
+    {
+        config->count = strtoul(blobmsg_get_string(count), NULL, 0);
+    }
+    else
+    {
+        success = false;
+        goto done;
+    }
+
+    success = config->count > 0;
+
+done:
+    return success;
+}
+
+bool
+icmp_probe_config_parse(
+    icmp_probe_config_st * const config, struct blob_attr * const params)
+{
+    bool success;
+    struct blob_attr * tb[ICMP_PROBE_PARAMS_COUNT__];
+
+    blobmsg_parse(icmp_probe_params_policy, ARRAY_SIZE(tb), tb,
+                  blobmsg_data(params), blobmsg_data_len(params));
+
+    if (tb[ICMP_PROBE_PARAMS_HOSTNAME] == NULL)
+    {
+        DLOG("icmp test has no hostname");
+
+        success = false;
+        goto done;
+    }
+
+    if (!parse_target(config, blobmsg_get_string(tb[ICMP_PROBE_PARAMS_HOSTNAME])))
+    {
+        success = false;
+        goto done;
+    }
+
+    if (!parse_count(config, tb[ICMP_PROBE_PARAMS_COUNT]))
+    {
+        DLOG("invalid icmp count");
+
+        success = false;
+        goto done;
+    }
+
+    config->device[0] = '\0';
+    if (tb[ICMP_PROBE_PARAMS_DEVICE] != NULL)
+    {
+        char const * const device = blobmsg_get_string(tb[ICMP_PROBE_PARAMS_DEVICE]);
+
+        if (strlen(device) >= sizeof(config->device))
+        {
+            DLOG("icmp device name too long: %s", device);
+
+            success = false;
+            goto done;
+        }
+        strcpy(config->device, device);
+    }
+
+    success = true;
+
+done:
+    return success;
+}
+
+bool
+icmp_probe_config_equal(
+    icmp_probe_config_st const * const a, icmp_probe_config_st const * const b)
+{
+    return a->target_len == b->target_len
+        && memcmp(&a->target, &b->target, a->target_len) == 0
+        && a->count == b->count
+        && strcmp(a->device, b->device) == 0;
+}
+
+static void
+icmp_probe_finish(icmp_probe_st * const probe, bool const passed)
+{
+    icmp_probe_stop(probe);
+
+    if (probe->cb != NULL)
+    {
+        probe->cb(probe, passed);
+    }
+}
+
+static bool
+icmp_probe_send_request(icmp_probe_st * const probe, struct sockaddr const * const target, socklen_t const target_len)
+{
+    /*
+     * The echo request headers for both families share the same layout. With
+     * ping sockets the kernel fills in the identifier and the checksum.
+     */
+    struct icmphdr request = { 0 };
+
+    request.type = target->sa_family == AF_INET6 ? ICMP6_ECHO_REQUEST : ICMP_ECHO;
+    request.un.echo.sequence = htons(probe->sequence_);
+
+    ssize_t const sent = TEMP_FAILURE_RETRY(
+        sendto(probe->sock_.fd, &request, sizeof(request), 0, target, target_len));
+
+    if (sent < 0)
+    {
+        DLOG("failed to send echo request: %s", strerror(errno));
+    }
+
+    probe->sequence_++;
+    probe->sent_++;
+
+    return sent == sizeof(request);
+}
+
+static bool
+is_reply_to_probe(
+    icmp_probe_st const * const probe,
+    int const family,
+    uint8_t const * const reply,
+    size_t const reply_len)
+{
+    bool is_reply;
+    uint8_t const expected_type = family == AF_INET6 ? ICMP6_ECHO_REPLY : ICMP_ECHOREPLY;
+    struct icmphdr header;
+
+    if (reply_len < sizeof(header))
+    {
+        is_reply = false;
+        goto done;
+    }
+
+    memcpy(&header, reply, sizeof(header));
+
+    /* Only replies to the requests sent by this run of the probe count. */
+    uint16_t const sequence_offset =
+        (uint16_t)(ntohs(header.un.echo.sequence) - probe->first_sequence_);
+
+    is_reply = header.type == expected_type && sequence_offset < probe->sent_;
+
+done:
+    return is_reply;
+}
+
+static void
+icmp_probe_read_cb(struct uloop_fd * const sock, unsigned int const events)
+{
+    UNUSED(events);
+    icmp_probe_st * const probe = container_of(sock, icmp_probe_st, sock_);
+    struct sockaddr_storage from;
+    uint8_t reply[128];
+    bool passed = false;
+
+    for (;;)
+    {
+        socklen_t from_len = sizeof(from);
+        ssize_t const received = TEMP_FAILURE_RETRY(
+            recvfrom(sock->fd, reply, sizeof(reply), 0, (struct sockaddr *)&from, &from_len));
+
+        if (received < 0)
+        {
+            /* EAGAIN once all pending replies have been read. */
+            break;
+        }
+
+        if (is_reply_to_probe(probe, from.ss_family, reply, received))
+        {
+            passed = true;
+            break;
+        }
+    }
+
+    if (passed)
+    {
+        icmp_probe_finish(probe, passed);
+    }
+}
+
+static void
+icmp_probe_send_timer_expired(timer_st * const t)
+{
+    icmp_probe_st * const probe = container_of(t, icmp_probe_st, send_timer_);
+    struct sockaddr_storage target;
+    socklen_t target_len = sizeof(target);
+
+    if (probe->sent_ >= probe->count_)
+    {
+        /* No reply to any of the requests. */
+        bool const passed = false;
+
+        icmp_probe_finish(probe, passed);
+        goto done;
+    }
+
+    if (getpeername(probe->sock_.fd, (struct sockaddr *)&target, &target_len) < 0)
+    {
+        bool const passed = false;
+
+        icmp_probe_finish(probe, passed);
+        goto done;
+    }
+
+    icmp_probe_send_request(probe, (struct sockaddr *)&target, target_len);
+    timer_start(&probe->send_timer_, icmp_probe_interval_msecs);
+
+done:
+    return;
+}
+
+static int
+icmp_probe_open_socket(
+    icmp_probe_config_st const * const config, char const * const default_device)
+{
+    int const family = config->target.ss_family;
+    int const protocol = family == AF_INET6 ? IPPROTO_ICMPV6 : IPPROTO_ICMP;
+    char const * const device =
+        config->device[0] != '\0' ? config->device : default_device;
+    int sock = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+
+    if (sock < 0)
+    {
+        /* Requires the daemon's group to be within net.ipv4.ping_group_range. */
+        DLOG("failed to open ping socket: %s", strerror(errno));
+
+        goto done;
+    }
+
+    if (device != NULL && device[0] != '\0'
+        && setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, device, strlen(device) + 1) < 0)
+    {
+        DLOG("failed to bind ping socket to: %s: %s", device, strerror(errno));
+
+        close(sock);
+        sock = -1;
+        goto done;
+    }
+
+    /*
+     * Connecting the socket means that only replies from the target are
+     * received.
+     */
+    if (connect(sock, (struct sockaddr const *)&config->target, config->target_len) < 0)
+    {
+        DLOG("failed to connect ping socket: %s", strerror(errno));
+
+        close(sock);
+        sock = -1;
+        goto done;
+    }
+
+done:
+    return sock;
+}
+
+bool
+icmp_probe_is_running(icmp_probe_st const * const probe)
+{
+    return probe->sock_.fd >= 0;
+}
+
+bool
+icmp_probe_start(
+    icmp_probe_st * const probe,
+    icmp_probe_config_st const * const config,
+    char const * const default_device)
+{
+    bool success;
+
+    icmp_probe_stop(probe);
+
+    int const sock = icmp_probe_open_socket(config, default_device);
+
+    if (sock < 0)
+    {
+        success = false;
+        goto done;
+    }
+
+    probe->sock_.fd = sock;
+    probe->sock_.cb = icmp_probe_read_cb;
+    uloop_fd_add(&probe->sock_, ULOOP_READ);
+
+    probe->first_sequence_ = probe->sequence_;
+    probe->sent_ = 0;
+    probe->count_ = config->count;
+
+    icmp_probe_send_request(
+        probe, (struct sockaddr const *)&config->target, config->target_len);
+    timer_start(&probe->send_timer_, icmp_probe_interval_msecs);
+
+    success = true;
+
+done:
+    return success;
+}
+
+void
+icmp_probe_stop(icmp_probe_st * const probe)
+{
+    if (!icmp_probe_is_running(probe))
+    {
+        goto done;
+    }
+
+    timer_stop(&probe->send_timer_);
+    uloop_fd_delete(&probe->sock_);
+    close(probe->sock_.fd);
+    probe->sock_.fd = -1;
+
+done:
+    return;
+}
+
+void
+icmp_probe_init(icmp_probe_st * const probe)
+{
+    probe->sock_.fd = -1;
+    timer_init(&probe->send_timer_, "icmp_send_timer", icmp_probe_send_timer_expired);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "timers.h"
+
+#include <libubox/blob.h>
+#include <libubox/uloop.h>
+
+#include <net/if.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+typedef struct icmp_probe_config_st
+{
+    /* The address to send echo requests to. */
+    struct sockaddr_storage target;
+    socklen_t target_len;
+
+    /*
+     * The number of echo requests to send. The probe passes as soon as a reply
+     * to any of them is received.
+     */
+    uint32_t count;
+
+    /*
+     * The device to bind to. If empty, the device that netifd reports for the
+     * interface is used.
+     */
+    char device[IFNAMSIZ];
+} icmp_probe_config_st;
+
+typedef struct icmp_probe_st icmp_probe_st;
+
+typedef void (*icmp_probe_cb)(icmp_probe_st * probe, bool passed);
+
+struct icmp_probe_st
+{
+    /* Users should not access these fields directly. */
+    struct uloop_fd sock_;
+    timer_st send_timer_;
+    uint16_t first_sequence_;
+    uint16_t sequence_;
+    uint32_t sent_;
+    uint32_t count_;
+
+    icmp_probe_cb cb; /* Called when the probe passes or fails. */
+};
+
+/*
+ * Parse the params of an icmp test.
+ * e.g. { "hostname": "8.8.8.8", "count": "1", "device": "eth0" }
+ * The hostname must be a numeric IPv4 or IPv6 address.
+ */
+bool
+icmp_probe_config_parse(icmp_probe_config_st * config, struct blob_attr * params);
+
+bool
+icmp_probe_config_equal(icmp_probe_config_st const * a, icmp_probe_config_st const * b);
+
+void
+icmp_probe_init(icmp_probe_st * probe);
+
+bool
+icmp_probe_is_running(icmp_probe_st const * probe);
+
+/*
+ * Start sending echo requests. default_device (if not NULL or empty) is used
+ * if the configuration doesn't specify a device.
+ */
+bool
+icmp_probe_start(
+    icmp_probe_st * probe,
+    icmp_probe_config_st const * config,
+    char const * default_device);
+
+/* Stop the probe. The callback isn't called. */
+void
+icmp_probe_stop(icmp_probe_st * probe);
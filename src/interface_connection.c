@@ -1,6 +1,7 @@
 #include "interface_connection.h"
 #include "debug.h"
 #include "event_queue.h"
+#include "flight_recorder.h"
 #include "interface_tester.h"
 #include "timers.h"
 #include "ubus.h"
@@ -10,6 +11,21 @@
 #include <assert.h>
 #endif
 
+#include <inttypes.h>
+#include <time.h>
+
+static uint32_t const state_request_timeout_msecs = 5000;
+
+static uint64_t
+monotonic_msecs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
 char const *
 interface_connection_state_to_str(interface_connection_state_t const state)
 {
@@ -33,16 +49,24 @@ connection_state_transition(
     interface_connection_st * const connection,
     interface_connection_state_t const new_state)
 {
-#ifdef DEBUG
     interface_st * const iface = container_of(connection, interface_st, connection);
-#endif
-    ILOG("%s: %s: change state from %s -> %s",
+
+    DLOG("%s: %s: change state from %s -> %s",
          __func__,
          iface->name,
          interface_connection_state_to_str(connection->state),
          interface_connection_state_to_str(new_state));
 
+    flight_recorder_record(
+        iface->id,
+        FLIGHT_RECORDER_MACHINE_CONNECTION,
+        connection->state,
+        new_state,
+        FLIGHT_RECORDER_NO_EVENT);
     connection->state = new_state;
+    interface_state_changed(iface);
+    ubus_notify_interface_state(
+        iface, INTERFACE_NOTIFICATION_CONNECTION, interface_connection_state_to_str(new_state));
 }
 
 static void
@@ -69,6 +93,7 @@ settling_delay_timer_expired(timer_st * const t)
 
     if (connection->state == CONNECTION_STATE_SETTLING)
     {
+        connection->settle_sequence = iface->ctx->settle_sequence++;
         connection_state_transition(connection, CONNECTION_STATE_CONNECTED);
         interface_tester_send_event(iface, TESTER_EVENT_INTERFACE_SETTLED);
     }
@@ -87,6 +112,92 @@ settling_delay_timer_start(interface_connection_st * const connection)
     timer_start(t, settling_delay_msecs);
 }
 
+/*
+ * Stop waiting for the reply to the state request, because it has arrived, or
+ * because an interface event has made it out of date.
+ */
+static void
+state_request_finish(interface_connection_st * const connection, bool const abort)
+{
+    interface_st * const iface = container_of(connection, interface_st, connection);
+
+    if (!connection->state_request_pending)
+    {
+        goto done;
+    }
+
+    if (abort)
+    {
+        ubus_abort_request(&iface->ctx->ubus_conn.ctx, &connection->state_request);
+    }
+    timer_stop(&connection->state_request_timer);
+    connection->state_request_pending = false;
+    connection->state_discovery_msecs =
+        (int64_t)(monotonic_msecs() - connection->state_request_started_msecs);
+    interface_state_changed(iface);
+
+    DLOG("%s: %s: state known after %" PRId64 " msecs",
+         __func__, iface->name, connection->state_discovery_msecs);
+
+done:
+    return;
+}
+
+static void
+state_request_data_cb(
+    struct ubus_request * const req, int const type, struct blob_attr * const msg)
+{
+    UNUSED(type);
+    interface_connection_st * const connection =
+        container_of(req, interface_connection_st, state_request);
+
+    connection->state_request_is_up =
+        interface_state_from_status(msg, connection->device, sizeof(connection->device));
+}
+
+static void
+state_request_complete_cb(struct ubus_request * const req, int const ret)
+{
+    interface_connection_st * const connection =
+        container_of(req, interface_connection_st, state_request);
+    interface_st * const iface = container_of(connection, interface_st, connection);
+
+    if (ret != UBUS_STATUS_OK)
+    {
+        DLOG("%s: %s: %s", __func__, iface->name, ubus_strerror(ret));
+        interface_state_request_failed(&iface->ctx->ubus_conn.ctx, ret);
+        connection->state_request_is_up = false;
+    }
+
+    /* Already finished if an interface event arrived first. */
+    if (!connection->state_request_pending)
+    {
+        goto done;
+    }
+
+    state_request_finish(connection, false);
+    connection->state_request_is_up
+        ? interface_connection_connected(connection)
+        : interface_connection_disconnected(connection);
+
+done:
+    return;
+}
+
+static void
+state_request_timer_expired(timer_st * const t)
+{
+    interface_connection_st * const connection =
+        container_of(t, interface_connection_st, state_request_timer);
+    interface_st * const iface = container_of(connection, interface_st, connection);
+
+    ILOG("%s: %s: no reply from netifd", __func__, iface->name);
+
+    ubus_abort_request(&iface->ctx->ubus_conn.ctx, &connection->state_request);
+    connection->state_request_pending = false;
+    interface_connection_disconnected(connection);
+}
+
 void
 interface_connection_init(interface_connection_st * const connection)
 {
@@ -97,6 +208,10 @@ interface_connection_init(interface_connection_st * const connection)
     DLOG("%s: %s", __func__, iface->name);
     timer_init(
         &connection->settling_delay_timer, "settling_delay_timer", settling_delay_timer_expired);
+    timer_init(
+        &connection->state_request_timer, "state_request_timer", state_request_timer_expired);
+    connection->state_request_pending = false;
+    connection->state_discovery_msecs = -1;
     connection_state_transition(connection, CONNECTION_STATE_DISCONNECTED);
 }
 
@@ -104,12 +219,34 @@ void
 interface_connection_begin(interface_connection_st * const connection)
 {
     interface_st * const iface = container_of(connection, interface_st, connection);
-    bool const is_connected =
-        interface_get_current_state(&iface->ctx->ubus_conn.ctx, iface->name);
 
-    is_connected
-        ? interface_connection_connected(connection)
-        : interface_connection_disconnected(connection);
+    /*
+     * The interface stays disconnected until netifd replies, and the tester
+     * carries on with the other interfaces in the meantime.
+     */
+    state_request_finish(connection, true);
+    connection->state_request_is_up = false;
+    connection->state_request_started_msecs = monotonic_msecs();
+    connection->state_discovery_msecs = -1;
+
+    if (!interface_request_current_state(
+            &iface->ctx->ubus_conn.ctx,
+            iface->name,
+            &connection->state_request,
+            state_request_data_cb,
+            state_request_complete_cb,
+            NULL))
+    {
+        DLOG("%s: %s: unable to request the state", __func__, iface->name);
+        interface_connection_disconnected(connection);
+        goto done;
+    }
+
+    connection->state_request_pending = true;
+    timer_start(&connection->state_request_timer, state_request_timeout_msecs);
+
+done:
+    return;
 }
 
 void
@@ -121,6 +258,7 @@ interface_connection_cleanup(interface_connection_st * const connection)
 
     DLOG("%s: %s", __func__, iface->name);
 
+    state_request_finish(connection, true);
     settling_delay_timer_stop(connection);
 }
 
@@ -133,6 +271,7 @@ interface_connection_connected(interface_connection_st * const connection)
 
     ILOG("%s, %s", __func__, iface->name);
 
+    state_request_finish(connection, true);
     if (connection->state == CONNECTION_STATE_DISCONNECTED)
     {
         settling_delay_timer_start(connection);
@@ -147,6 +286,7 @@ interface_connection_disconnected(interface_connection_st * const connection)
 
     ILOG("%s: %s", __func__, iface->name);
 
+    state_request_finish(connection, true);
     if (connection->state != CONNECTION_STATE_DISCONNECTED)
     {
         bool const was_connected =
@@ -161,3 +301,27 @@ interface_connection_disconnected(interface_connection_st * const connection)
     }
 }
 
+uint32_t
+interface_connection_phase_offset_msecs(
+    interface_connection_st const * const connection, uint32_t const interval_msecs)
+{
+    /*
+     * Multiples of the golden ratio, taken as a fraction of 2^32, land in the
+     * largest remaining gap between those that came before.
+     */
+    uint32_t const fraction = connection->settle_sequence * UINT32_C(0x9E3779B9);
+
+    return (uint32_t)(((uint64_t)interval_msecs * fraction) >> 32);
+}
+
+void
+interface_connection_set_device(
+    interface_connection_st * const connection, char const * const device)
+{
+    interface_st * const iface = container_of(connection, interface_st, connection);
+
+    DLOG("%s: %s: %s", __func__, iface->name, device);
+
+    snprintf(connection->device, sizeof(connection->device), "%s", device);
+    interface_state_changed(iface);
+}
@@ -20,3 +20,17 @@ interface_connection_connected(interface_connection_st * connection);
 void
 interface_connection_disconnected(interface_connection_st * connection);
 
+/*
+ * Returns this interface's share of the interval, based on the order in which
+ * the interfaces settled. Successive interfaces are placed in the largest gaps
+ * left by those before them, so any number of interfaces end up roughly evenly
+ * spread.
+ */
+uint32_t
+interface_connection_phase_offset_msecs(
+    interface_connection_st const * connection, uint32_t interval_msecs);
+
+void
+interface_connection_set_device(
+    interface_connection_st * connection, char const * device);
+
@@ -1,11 +1,15 @@
 #include "interface_tester.h"
 #include "debug.h"
+#include "flight_recorder.h"
 #include "interface_connection.h"
 #include "ubus.h"
 #include "utils.h"
 
 #include <libubox/blobmsg_json.h>
 
+#include <stdlib.h>
+#include <sys/wait.h>
+
 #ifdef DEBUG
 #include <assert.h>
 #endif
@@ -82,43 +86,62 @@ next_recovery_task_index(interface_recovery_st * const recovery)
 static void
 interface_adjust_route_metrics(interface_st * const iface, uint32_t const amount)
 {
-    ubus_send_metrics_adjust_request(
-        &iface->ctx->ubus_conn.ctx, iface->name, amount);
+    metrics_adjuster_set(&iface->recovery.metrics_adjuster, amount);
 }
 #endif
 
+static unsigned int
+tester_current_event(interface_tester_st const * const tester)
+{
+    return tester->current_event < TESTER_EVENT_COUNT__
+        ? (unsigned int)tester->current_event
+        : FLIGHT_RECORDER_NO_EVENT;
+}
+
 static void
 recovery_state_transition(
     interface_recovery_st * const recovery, interface_recovery_state_t const new_state)
 {
-#ifdef DEBUG
     interface_st * const iface = container_of(recovery, interface_st, recovery);
-#endif
 
-    ILOG("%s: %s: change state from %s -> %s",
+    DLOG("%s: %s: change state from %s -> %s",
          __func__,
          iface->name,
          interface_recovery_state_to_str(recovery->state),
          interface_recovery_state_to_str(new_state));
 
+    flight_recorder_record(
+        iface->id,
+        FLIGHT_RECORDER_MACHINE_RECOVERY,
+        recovery->state,
+        new_state,
+        tester_current_event(&iface->tester));
     recovery->state = new_state;
+    ubus_notify_interface_state(
+        iface, INTERFACE_NOTIFICATION_RECOVERY, interface_recovery_state_to_str(new_state));
 }
 
 static void
 tester_state_transition(
     interface_tester_st * const tester, interface_tester_state_t const new_state)
 {
-#ifdef DEBUG
     interface_st * const iface = container_of(tester, interface_st, tester);
-#endif
 
-    ILOG("%s: %s: change state from %s -> %s",
+    DLOG("%s: %s: change state from %s -> %s",
          __func__,
          iface->name,
          interface_tester_state_to_str(tester->state),
          interface_tester_state_to_str(new_state));
 
+    flight_recorder_record(
+        iface->id,
+        FLIGHT_RECORDER_MACHINE_TESTER,
+        tester->state,
+        new_state,
+        tester_current_event(tester));
     tester->state = new_state;
+    ubus_notify_interface_state(
+        iface, INTERFACE_NOTIFICATION_TESTER, interface_tester_state_to_str(new_state));
 }
 
 static void
@@ -161,37 +184,66 @@ tester_interval_timer_stop(interface_tester_st * const tester)
 }
 
 static void
-tester_response_timer_stop(interface_tester_st * const tester)
+test_response_timer_stop(test_slot_st * const slot)
 {
-    timer_st * const t = &tester->test_response_timeout_timer;
+    timer_st * const t = &slot->response_timeout_timer;
 #if DEBUG
-    interface_st * const iface = container_of(tester, interface_st, tester);
+    interface_st * const iface = container_of(slot->tester, interface_st, tester);
 #endif
 
-    DLOG("%s: %s", __func__, iface->name);
+    DLOG("%s: %s: test %zu", __func__, iface->name, slot->test_index);
 
     timer_stop(t);
 }
 
 static void
-test_response_timer_expired(timer_st * const t)
+test_slot_cancel(test_slot_st * const slot)
+{
+    interface_tester_kill_process(&slot->proc);
+    icmp_probe_stop(&slot->probe);
+    scheduler_release(&slot->scheduler_request);
+    test_response_timer_stop(slot);
+}
+
+/*
+ * Results are counted as they are queued so that those of tests cancelled
+ * before their result was handled can be told apart from those of later runs.
+ */
+static void
+test_result_send(interface_tester_st * const tester, tester_event_t const event)
 {
-    interface_tester_st * const tester =
-        container_of(t, interface_tester_st, test_response_timeout_timer);
     interface_st * const iface = container_of(tester, interface_st, tester);
 
-    DLOG("%s: %s", __func__, iface->name);
+    tester->results_queued++;
+    interface_tester_send_event(iface, event);
+}
 
-    interface_tester_send_event(iface, TESTER_EVENT_TEST_TIMED_OUT);
+static void
+test_response_timer_expired(timer_st * const t)
+{
+    test_slot_st * const slot =
+        container_of(t, test_slot_st, response_timeout_timer);
+#if DEBUG
+    interface_st * const iface = container_of(slot->tester, interface_st, tester);
+#endif
+
+    DLOG("%s: %s: test %zu", __func__, iface->name, slot->test_index);
+
+    /*
+     * Stop the test here, as the event doesn't say which test timed out when
+     * tests are run in parallel.
+     */
+    test_slot_cancel(slot);
+    test_result_send(slot->tester, TESTER_EVENT_TEST_TIMED_OUT);
 }
 
 static void
 test_response_timer_start(
-    interface_tester_st * const tester, uint32_t const timeout_secs)
+    test_slot_st * const slot, uint32_t const timeout_secs)
 {
-    timer_st * const tmr = &tester->test_response_timeout_timer;
+    timer_st * const tmr = &slot->response_timeout_timer;
 #if DEBUG
-    interface_st * const iface = container_of(tester, interface_st, tester);
+    interface_st * const iface = container_of(slot->tester, interface_st, tester);
 #endif
     uint32_t const timeout_msecs = timeout_secs * msecs_per_sec;
 
@@ -200,6 +252,19 @@ test_response_timer_start(
     timer_start(tmr, timeout_msecs);
 }
 
+static void
+test_slot_response_timer_start(test_slot_st * const slot)
+{
+    interface_st * const iface = container_of(slot->tester, interface_st, tester);
+    interface_config_st const * const iface_config = &iface->config;
+    test_config_st const * const test_config = iface_config->tests[slot->test_index];
+    uint32_t const timeout_secs = test_config->response_timeout_secs > 0
+        ? test_config->response_timeout_secs
+        : iface_config->response_timeout_secs;
+
+    test_response_timer_start(slot, timeout_secs);
+}
+
 static bool
 get_test_result_from_exit_status(int const exit_status)
 {
@@ -210,88 +275,422 @@ get_test_result_from_exit_status(int const exit_status)
 }
 
 static void
-test_completed(tester_process_st * const tester_proc, int const status)
+test_slot_completed(test_slot_st * const slot, int const status, bool const test_passed)
 {
-    interface_tester_st * const tester =
-        container_of(tester_proc, interface_tester_st, test_proc);
+    interface_tester_st * const tester = slot->tester;
     interface_st * const iface = container_of(tester, interface_st, tester);
-    bool const test_passed = get_test_result_from_exit_status(status);
 
-    ILOG("%s: %s", __func__, iface->name);
+    ILOG("%s: %s: test %zu", __func__, iface->name, slot->test_index);
 
+    test_response_timer_stop(slot);
     tester->last_test_exit_code = status;
     tester->last_test_passed = test_passed;
 
     tester_event_t const event =
         test_passed ? TESTER_EVENT_TEST_PASSED : TESTER_EVENT_TEST_FAILED;
 
-    interface_tester_send_event(iface, event);
+    test_result_send(tester, event);
+}
+
+static void
+test_completed(
+    tester_process_st * const tester_proc,
+    int const status,
+    process_usage_st const * const usage)
+{
+    test_slot_st * const slot = container_of(tester_proc, test_slot_st, proc);
+    interface_st * const iface = container_of(slot->tester, interface_st, tester);
+    bool const test_passed = get_test_result_from_exit_status(status);
+
+    execution_stats_record(&iface->config.test_stats[slot->test_index], usage);
+
+    scheduler_release(&slot->scheduler_request);
+    output_buffer_printf(
+        tester_proc->output, "--- test %zu exited: status %d ---\n", slot->test_index, status);
+    test_slot_completed(slot, status, test_passed);
+}
+
+static void
+icmp_test_completed(icmp_probe_st * const probe, bool const passed)
+{
+    test_slot_st * const slot = container_of(probe, test_slot_st, probe);
+
+    /* Report an exit code as though ping had been run. */
+    test_slot_completed(
+        slot, W_EXITCODE(passed ? EXIT_SUCCESS : EXIT_FAILURE, 0), passed);
+}
+
+static void
+test_start_failure_record(interface_tester_st * const tester)
+{
+    interface_st * const iface = container_of(tester, interface_st, tester);
+
+    ILOG("%s: %s", __func__, iface->name);
+
+    tester->last_test_exit_code = W_EXITCODE(127, 0);
+    tester->last_test_passed = false;
+}
+
+static void
+test_start_failed(interface_tester_st * const tester)
+{
+    /*
+     * Treat a test that couldn't be started (e.g. the process limit has been
+     * reached) as a failed test so that the test run doesn't stall waiting for
+     * a process that doesn't exist.
+     */
+    test_start_failure_record(tester);
+    test_result_send(tester, TESTER_EVENT_TEST_FAILED);
+}
+
+/*
+ * The tests and the recovery task share the interface's output buffer, so each
+ * keeps no more than its share.
+ */
+static size_t
+process_output_limit(interface_st const * const iface)
+{
+    return output_buffer_size(&iface->output) / (iface->tester.num_test_slots + 1);
 }
 
 static bool
-run_test(
-    interface_tester_st * const tester,
-    char const * const interface_name,
-    char const * const working_dir,
-    interface_config_st const * const iface_config,
-    size_t const test_index)
-{
-    test_config_st const * const test_config = &iface_config->tests[test_index];
+spawn_executable_test(test_slot_st * const slot)
+{
+    interface_st * const iface = container_of(slot->tester, interface_st, tester);
+    test_config_st const * const test_config = iface->config.tests[slot->test_index];
+    exec_entry_st const * const exec = test_config->exec;
     bool started_test;
     int argc = 0;
     char * argv[10];
-    char * const params = blobmsg_format_json(test_config->params, true);
-    char * exe_name = NULL;
+    char * params = NULL;
 
-    if (asprintf(&exe_name, "./%s", test_config->executable_name) < 0)
+    /* There's no point starting a process just to have it fail with 127. */
+    if (exec == NULL || !exec_entry_is_resolved(exec))
     {
+        DLOG("%s: %s: test %s isn't runnable", __func__, iface->name, test_config->executable_name);
+
         started_test = false;
         goto done;
     }
-    argv[argc++] = exe_name;
-    argv[argc++] = (char *)interface_name;
+
+    params = blobmsg_format_json(test_config->params, true);
+    argv[argc++] = (char *)test_config->executable_name;
+    argv[argc++] = (char *)iface->name;
     argv[argc++] = (char *)test_config->executable_name;
     argv[argc++] = params;
     argv[argc++] = NULL;
 
     DLOG("running %s: test: %s (%zu)",
-         test_config->label, test_config->executable_name, test_config->index);
+         test_config->label, test_config->executable_name, slot->test_index);
+
+    slot->proc.cb = test_completed;
+    slot->proc.output = &iface->output;
+    slot->proc.output_limit = process_output_limit(iface);
+    started_test = interface_tester_start_process(
+        &slot->proc, argv, exec_entry_dir_fd(exec), exec_entry_fd(exec));
+    if (started_test)
+    {
+        output_buffer_printf(
+            &iface->output,
+            "--- test %zu: %s (pid %d) ---\n",
+            slot->test_index,
+            test_config->label,
+            (int)interface_tester_process_pid(&slot->proc));
+    }
+
+done:
+    free(params);
 
-    tester->test_proc.cb = test_completed;
-    if (!interface_tester_start_process(&tester->test_proc, argv, working_dir))
+    return started_test;
+}
+
+static void
+executable_test_dispatched(scheduler_request_st * const request)
+{
+    test_slot_st * const slot = container_of(request, test_slot_st, scheduler_request);
+
+    interface_st * const iface = container_of(slot->tester, interface_st, tester);
+
+    interface_state_changed(iface);
+    if (!spawn_executable_test(slot))
     {
-        DLOG("%s: failed to run test", interface_name);
+        scheduler_release(request);
+        test_start_failed(slot->tester);
+        goto done;
+    }
 
-        started_test = false;
+    test_slot_response_timer_start(slot);
+
+done:
+    return;
+}
+
+static bool
+start_executable_test(test_slot_st * const slot)
+{
+    bool started_test;
+
+    if (!scheduler_acquire(&slot->scheduler_request))
+    {
+#if DEBUG
+        interface_st * const iface = container_of(slot->tester, interface_st, tester);
+#endif
+
+        /* The response timer is started once the test actually starts. */
+        DLOG("%s: test %zu queued", iface->name, slot->test_index);
+
+        started_test = true;
         goto done;
     }
 
-    uint32_t const timeout_secs = test_config->response_timeout_secs > 0
-        ? test_config->response_timeout_secs
-        : iface_config->response_timeout_secs;
+    started_test = spawn_executable_test(slot);
+    if (!started_test)
+    {
+        scheduler_release(&slot->scheduler_request);
+        goto done;
+    }
 
-    test_response_timer_start(tester, timeout_secs);
-    started_test = true;
+    test_slot_response_timer_start(slot);
 
 done:
-    free(exe_name);
-    free(params);
+    return started_test;
+}
+
+static bool
+start_icmp_test(test_slot_st * const slot)
+{
+    interface_st * const iface = container_of(slot->tester, interface_st, tester);
+    test_config_st const * const test_config = iface->config.tests[slot->test_index];
+
+    DLOG("running %s: icmp test (%zu)", test_config->label, slot->test_index);
+
+    slot->probe.cb = icmp_test_completed;
+
+    bool const started_test =
+        icmp_probe_start(&slot->probe, &test_config->icmp, iface->connection.device);
+
+    if (started_test)
+    {
+        test_slot_response_timer_start(slot);
+    }
+
+    return started_test;
+}
+
+static bool
+start_test(test_slot_st * const slot)
+{
+    interface_st * const iface = container_of(slot->tester, interface_st, tester);
+    test_config_st const * const test_config = iface->config.tests[slot->test_index];
+    bool started_test;
+
+    switch (test_config->type)
+    {
+    case TEST_TYPE_EXECUTABLE:
+        started_test = start_executable_test(slot);
+        break;
+
+    case TEST_TYPE_ICMP:
+        started_test = start_icmp_test(slot);
+        break;
+
+    default:
+        started_test = false;
+        break;
+    }
+
+    if (!started_test)
+    {
+        DLOG("%s: failed to run test", iface->name);
+    }
+
+    return started_test;
+}
+
+static bool
+run_test(interface_tester_st * const tester, size_t const test_index)
+{
+    bool const started_test = start_test(&tester->test_slots[test_index]);
+
+    if (!started_test)
+    {
+        test_start_failed(tester);
+    }
 
     return started_test;
 }
 
 static void
-tester_sleep(interface_tester_st * const tester)
+run_tests_in_parallel(interface_tester_st * const tester)
 {
     interface_st * const iface = container_of(tester, interface_st, tester);
-    interface_config_st * const config = &iface->config;
-    interface_recovery_st * const recovery = &iface->recovery;
+    size_t failed_to_start = 0;
+
+    tester->results_outstanding = iface->config.num_tests;
+    for (size_t i = 0; i < iface->config.num_tests; i++)
+    {
+        if (!start_test(&tester->test_slots[i]))
+        {
+            failed_to_start++;
+        }
+    }
+
+    /*
+     * Tests that couldn't be started are failures. These are handled here
+     * rather than with an event for each as there may be more of them than
+     * the event queue can hold. Stop once the result of the test run is known.
+     */
+    for (size_t i = 0; i < failed_to_start && tester->state == TESTER_STATE_TESTING; i++)
+    {
+        test_start_failure_record(tester);
+        interface_test_failed(tester);
+    }
+}
+
+static void
+test_slots_cancel(interface_tester_st * const tester)
+{
+    for (size_t i = 0; i < tester->num_test_slots; i++)
+    {
+        test_slot_cancel(&tester->test_slots[i]);
+    }
+    /* Any results still queued are from the tests just cancelled. */
+    tester->results_outstanding = 0;
+    tester->stale_results = tester->results_queued;
+}
+
+static void
+test_slots_free(interface_tester_st * const tester)
+{
+    test_slots_cancel(tester);
+    free(tester->test_slots);
+    tester->test_slots = NULL;
+    tester->num_test_slots = 0;
+}
+
+static bool
+test_slots_allocate(interface_tester_st * const tester, size_t const num_tests)
+{
+    interface_st * const iface = container_of(tester, interface_st, tester);
+    bool success;
+
+    /* The slots are only reallocated when the number of tests changes. */
+    if (tester->num_test_slots == num_tests)
+    {
+        success = true;
+        goto done;
+    }
+
+    test_slots_free(tester);
+
+    tester->test_slots = calloc(num_tests, sizeof(*tester->test_slots));
+    if (tester->test_slots == NULL)
+    {
+        success = false;
+        goto done;
+    }
+    tester->num_test_slots = num_tests;
+
+    for (size_t i = 0; i < num_tests; i++)
+    {
+        test_slot_st * const slot = &tester->test_slots[i];
+
+        slot->tester = tester;
+        slot->test_index = i;
+        icmp_probe_init(&slot->probe);
+        scheduler_request_init(
+            &slot->scheduler_request,
+            &iface->scheduler_client,
+            SCHEDULER_CLASS_TEST,
+            executable_test_dispatched);
+        timer_init(
+            &slot->response_timeout_timer, "test_response_timer", test_response_timer_expired);
+    }
+
+    success = true;
+
+done:
+    return success;
+}
+
+static bool
+test_run_continues(interface_tester_st * const tester)
+{
+    interface_st * const iface = container_of(tester, interface_st, tester);
+    bool continues;
+
+    if (iface->config.parallel_tests)
+    {
+        /* Wait for the results of the other tests. */
+        if (tester->results_outstanding > 0)
+        {
+            tester->results_outstanding--;
+        }
+        continues = tester->results_outstanding > 0;
+        goto done;
+    }
+
+    tester->test_index++;
+
+    if (tester->test_index >= iface->config.num_tests)
+    {
+        continues = false;
+        goto done;
+    }
+
+    run_test(tester, tester->test_index);
+    continues = true;
+
+done:
+    return continues;
+}
+
+static uint32_t
+tester_interval_msecs(interface_tester_st const * const tester)
+{
+    interface_st const * const iface = container_of(tester, interface_st, tester);
+    interface_config_st const * const config = &iface->config;
+    interface_recovery_st const * const recovery = &iface->recovery;
     uint32_t const interval_secs =
         (recovery->state == RECOVERY_STATE_OPERATIONAL
          && tester->stats.test_runs.consecutive_failures == 0)
             ? config->test_passing_interval_secs
             : config->test_failing_interval_secs;
-    uint32_t const timeout_msecs = interval_secs * msecs_per_sec;
+
+    return interval_secs * msecs_per_sec;
+}
+
+static uint32_t
+apply_interval_jitter(uint32_t const interval_msecs, uint32_t const jitter_percent)
+{
+    uint64_t const spread = (uint64_t)interval_msecs * jitter_percent / 100;
+    /*
+     * A large jitter percentage could otherwise shorten the interval to (close
+     * to) nothing, and test runs would follow one another without a break.
+     */
+    uint64_t const min_msecs = interval_msecs < msecs_per_sec ? interval_msecs : msecs_per_sec;
+    uint64_t jittered = interval_msecs;
+
+    if (spread > 0)
+    {
+        /* Uniform over [interval - spread, interval + spread]. */
+        jittered = interval_msecs - spread + (uint64_t)random() % (2 * spread + 1);
+    }
+    if (jittered < min_msecs)
+    {
+        jittered = min_msecs;
+    }
+
+    return jittered < UINT32_MAX ? (uint32_t)jittered : UINT32_MAX;
+}
+
+static void
+tester_sleep(interface_tester_st * const tester)
+{
+    interface_st * const iface = container_of(tester, interface_st, tester);
+    uint32_t const timeout_msecs =
+        apply_interval_jitter(
+            tester_interval_msecs(tester), iface->config.interval_jitter_percent);
 
     tester_state_transition(tester, TESTER_STATE_SLEEPING);
     tester_interval_timer_start(tester, timeout_msecs);
@@ -331,54 +730,95 @@ recovery_response_timer_start(
 }
 
 static void
-recovery_task_completed(tester_process_st * const tester_proc, int const status)
+recovery_task_completed(
+    tester_process_st * const tester_proc,
+    int const status,
+    process_usage_st const * const usage)
 {
-    UNUSED(status);
     interface_recovery_st * const recovery =
         container_of(tester_proc, interface_recovery_st, proc);
     interface_st * const iface = container_of(recovery, interface_st, recovery);
 
     ILOG("%s: %s:", __func__, iface->name);
 
+    /* The configuration may have changed while the task was running. */
+    if (recovery->task_index < iface->config.num_recoverys)
+    {
+        execution_stats_record(&iface->config.recovery_stats[recovery->task_index], usage);
+    }
+    scheduler_release(&recovery->scheduler_request);
+    output_buffer_printf(
+        &iface->output,
+        "--- recovery task %zu exited: status %d ---\n",
+        recovery->task_index,
+        status);
     interface_tester_send_event(iface, TESTER_EVENT_RECOVERY_TASK_ENDED);
 }
 
+static void
+recovery_task_stop(interface_recovery_st * const recovery)
+{
+    interface_tester_kill_process(&recovery->proc);
+    scheduler_release(&recovery->scheduler_request);
+    recovery_response_timer_stop(recovery);
+}
+
 static bool
-run_recovery_task(
-    interface_recovery_st * const recovery,
-    char const * const interface_name,
-    char const * const working_dir,
-    interface_config_st const * const iface_config,
-    size_t const recovery_index)
+spawn_recovery_task(interface_recovery_st * const recovery)
 {
-    recovery_config_st const * const recovery_config
-        = &iface_config->recoverys[recovery_index];
+    interface_st * const iface = container_of(recovery, interface_st, recovery);
+    interface_config_st const * const iface_config = &iface->config;
     bool started_recovery;
     int argc = 0;
     char * argv[10];
-    char * const params = blobmsg_format_json(recovery_config->params, true);
-    char * exe_name = NULL;
+    char * params = NULL;
+
+    /* The configuration may have changed while the task was queued. */
+    if (recovery->task_index >= iface_config->num_recoverys)
+    {
+        started_recovery = false;
+        goto done;
+    }
 
-    if (asprintf(&exe_name, "./%s", recovery_config->executable_name) < 0)
+    recovery_config_st const * const recovery_config
+        = iface_config->recoverys[recovery->task_index];
+
+    exec_entry_st const * const exec = recovery_config->exec;
+
+    if (exec == NULL || !exec_entry_is_resolved(exec))
     {
+        DLOG("%s: %s: recovery task %s isn't runnable",
+             __func__, iface->name, recovery_config->executable_name);
+
         started_recovery = false;
         goto done;
     }
-    argv[argc++] = exe_name;
-    argv[argc++] = (char *)interface_name;
+
+    params = blobmsg_format_json(recovery_config->params, true);
+    argv[argc++] = (char *)recovery_config->executable_name;
+    argv[argc++] = (char *)iface->name;
     argv[argc++] = (char *)recovery_config->executable_name;
     argv[argc++] = params;
     argv[argc++] = NULL;
 
     DLOG("running %s: task: %s (%zu)",
-         recovery_config->label, recovery_config->executable_name, recovery_config->index);
+         recovery_config->label, recovery_config->executable_name, recovery->task_index);
 
     recovery->proc.cb = recovery_task_completed;
-    if (!interface_tester_start_process(&recovery->proc, argv, working_dir))
+    recovery->proc.output = &iface->output;
+    recovery->proc.output_limit = process_output_limit(iface);
+    if (!interface_tester_start_process(
+            &recovery->proc, argv, exec_entry_dir_fd(exec), exec_entry_fd(exec)))
     {
         started_recovery = false;
         goto done;
     }
+    output_buffer_printf(
+        &iface->output,
+        "--- recovery task %zu: %s (pid %d) ---\n",
+        recovery->task_index,
+        recovery_config->label,
+        (int)interface_tester_process_pid(&recovery->proc));
 
     uint32_t const timeout_secs = recovery_config->response_timeout_secs > 0
         ? recovery_config->response_timeout_secs
@@ -388,12 +828,57 @@ run_recovery_task(
     started_recovery = true;
 
 done:
-    free(exe_name);
     free(params);
 
     return started_recovery;
 }
 
+static void
+recovery_task_dispatched(scheduler_request_st * const request)
+{
+    interface_recovery_st * const recovery =
+        container_of(request, interface_recovery_st, scheduler_request);
+    interface_st * const iface = container_of(recovery, interface_st, recovery);
+
+    interface_state_changed(iface);
+    if (!spawn_recovery_task(recovery))
+    {
+        scheduler_release(request);
+        interface_tester_send_event(iface, TESTER_EVENT_RECOVERY_TASK_ENDED);
+    }
+}
+
+static bool
+run_recovery_task(interface_recovery_st * const recovery, size_t const recovery_index)
+{
+    bool started_recovery;
+
+    recovery_task_stop(recovery);
+    recovery->task_index = recovery_index;
+
+    if (!scheduler_acquire(&recovery->scheduler_request))
+    {
+#if DEBUG
+        interface_st * const iface = container_of(recovery, interface_st, recovery);
+#endif
+
+        /* The response timer is started once the task actually starts. */
+        DLOG("%s: recovery task %zu queued", iface->name, recovery_index);
+
+        started_recovery = true;
+        goto done;
+    }
+
+    started_recovery = spawn_recovery_task(recovery);
+    if (!started_recovery)
+    {
+        scheduler_release(&recovery->scheduler_request);
+    }
+
+done:
+    return started_recovery;
+}
+
 static void
 transition_to_operational_state(interface_st * const iface)
 {
@@ -442,12 +927,68 @@ transition_to_broken_state(interface_st * const iface)
         &iface->ctx->ubus_conn.ctx, iface->name, are_operational);
 }
 
+/*
+ * Passes beyond the threshold count too, as the threshold may have been lowered
+ * below the passes already seen.
+ */
+static bool
+pass_threshold_is_reached(interface_st const * const iface)
+{
+    test_run_statistics_st const * const stats = &iface->tester.stats.test_runs;
+
+    return stats->consecutive_passes > 0
+        && stats->consecutive_passes >= iface->config.pass_threshold;
+}
+
+/* Reached again every fail_threshold consecutive failures. */
+static bool
+fail_threshold_is_reached(interface_st const * const iface)
+{
+    test_run_statistics_st const * const stats = &iface->tester.stats.test_runs;
+    uint32_t const fail_threshold = iface->config.fail_threshold;
+
+    return stats->consecutive_failures > 0
+        && (fail_threshold == 0 || (stats->consecutive_failures % fail_threshold) == 0);
+}
+
+static void
+fail_threshold_reached(interface_recovery_st * const recovery)
+{
+    interface_st * const iface = container_of(recovery, interface_st, recovery);
+    interface_tester_st * const tester = &iface->tester;
+
+    if (recovery->state == RECOVERY_STATE_OPERATIONAL)
+    {
+        ILOG("%s: Failure threshold reached", iface->name);
+        transition_to_broken_state(iface);
+    }
+
+    /* Perform the next recovery action if any have been configured. */
+    if (iface->config.num_recoverys > 0)
+    {
+        size_t const recovery_task_index = next_recovery_task_index(recovery);
+
+        bool const have_started_recovery_task =
+            run_recovery_task(recovery, recovery_task_index);
+
+        if (have_started_recovery_task)
+        {
+            test_recovery_statistics_st * const recovery_stats =
+                &tester->stats.recovery;
+
+            recovery_stats->total_this_connection++;
+            recovery_stats->total++;
+
+            tester_state_transition(tester, TESTER_STATE_RECOVERING);
+        }
+    }
+}
+
 static void
 interface_test_run_passed(interface_recovery_st * const recovery)
 {
     interface_st * const iface = container_of(recovery, interface_st, recovery);
     interface_tester_st * const tester = &iface->tester;
-    interface_config_st * const config = &iface->config;
     test_run_statistics_st * const stats = &tester->stats.test_runs;
 
     stats->consecutive_failures = 0;
@@ -458,8 +999,7 @@ interface_test_run_passed(interface_recovery_st * const recovery)
     ILOG("%s: %s: consecutive test run passes: %"PRIu64,
          __func__, iface->name, tester->stats.test_runs.consecutive_passes);
 
-    if (recovery->state == RECOVERY_STATE_BROKEN
-        && tester->stats.test_runs.consecutive_passes == config->pass_threshold)
+    if (recovery->state == RECOVERY_STATE_BROKEN && pass_threshold_is_reached(iface))
     {
         ILOG("%s: Pass threshold reached", iface->name);
         transition_to_operational_state(iface);
@@ -471,7 +1011,6 @@ interface_test_run_failed(interface_recovery_st * const recovery)
 {
     interface_st * const iface = container_of(recovery, interface_st, recovery);
     interface_tester_st * const tester = &iface->tester;
-    interface_config_st * const config = &iface->config;
     test_run_statistics_st * const stats = &tester->stats.test_runs;
 
     stats->consecutive_passes = 0;
@@ -482,44 +1021,187 @@ interface_test_run_failed(interface_recovery_st * const recovery)
     ILOG("%s: %s: consecutive test run failures: %"PRIu64,
          __func__, iface->name, tester->stats.test_runs.consecutive_failures);
 
-    bool have_reached_failure_threshold =
-        config->fail_threshold == 0
-        ||(tester->stats.test_runs.consecutive_failures > 0
-           && (tester->stats.test_runs.consecutive_failures % config->fail_threshold) == 0);
+    if (fail_threshold_is_reached(iface))
+    {
+        fail_threshold_reached(recovery);
+    }
+}
+
+static void
+interface_config_swap(interface_config_st * const a, interface_config_st * const b)
+{
+    interface_config_st const temp = *a;
+
+    *a = *b;
+    *b = temp;
+}
+
+/*
+ * Take over new_config, leaving the configuration it replaces in its place for
+ * the caller to free. The tests and recovery tasks are only taken over if they
+ * have changed, so that the execution statistics of unchanged ones are kept.
+ */
+static void
+interface_config_take(
+    interface_config_st * const config,
+    interface_config_st * const new_config,
+    unsigned int const changes)
+{
+    interface_config_st const previous = *config;
+
+    *config = *new_config;
+    *new_config = previous;
+
+    if ((changes & INTERFACE_CONFIG_CHANGE_TESTS) == 0)
+    {
+        new_config->num_tests = config->num_tests;
+        new_config->tests = config->tests;
+        new_config->test_stats = config->test_stats;
+        config->num_tests = previous.num_tests;
+        config->tests = previous.tests;
+        config->test_stats = previous.test_stats;
+    }
+    if ((changes & INTERFACE_CONFIG_CHANGE_RECOVERYS) == 0)
+    {
+        new_config->num_recoverys = config->num_recoverys;
+        new_config->recoverys = config->recoverys;
+        new_config->recovery_stats = config->recovery_stats;
+        config->num_recoverys = previous.num_recoverys;
+        config->recoverys = previous.recoverys;
+        config->recovery_stats = previous.recovery_stats;
+    }
+}
+
+static void
+pending_config_discard(interface_st * const iface)
+{
+    interface_tester_config_free(&iface->pending_config);
+    memset(&iface->pending_config, 0, sizeof(iface->pending_config));
+    iface->pending_config_changes = 0;
+}
 
-    if (have_reached_failure_threshold)
+/*
+ * The thresholds are otherwise only checked as each test run ends. Check the
+ * counters against new thresholds straight away, by the same rules, so that
+ * for instance lowering the pass threshold to or below the number of passes
+ * already seen doesn't leave the interface broken until the next test run.
+ */
+static void
+recovery_thresholds_evaluate(interface_st * const iface)
+{
+    interface_tester_st * const tester = &iface->tester;
+    interface_recovery_st * const recovery = &iface->recovery;
+
+    if (recovery->state == RECOVERY_STATE_BROKEN && pass_threshold_is_reached(iface))
     {
-        if (recovery->state == RECOVERY_STATE_OPERATIONAL)
+        ILOG("%s: Pass threshold reached", iface->name);
+        transition_to_operational_state(iface);
+    }
+    else if (recovery->state == RECOVERY_STATE_OPERATIONAL && fail_threshold_is_reached(iface))
+    {
+        if (tester->state == TESTER_STATE_SLEEPING)
+        {
+            /* Recover as a failed test run would, testing again once it's done. */
+            fail_threshold_reached(recovery);
+            if (tester->state == TESTER_STATE_RECOVERING)
+            {
+                tester_interval_timer_stop(tester);
+            }
+        }
+        else
         {
+            /* Anything else running is left to finish first. */
             ILOG("%s: Failure threshold reached", iface->name);
             transition_to_broken_state(iface);
         }
+    }
+}
 
-        /* Perform the next recovery action if any have been configured. */
-        if (iface->config.num_recoverys > 0)
-        {
-            size_t const recovery_task_index = next_recovery_task_index(recovery);
+static void
+tester_interval_timer_rearm(interface_tester_st * const tester)
+{
+    interface_st * const iface = container_of(tester, interface_st, tester);
+    uint32_t const timeout_msecs =
+        apply_interval_jitter(
+            tester_interval_msecs(tester), iface->config.interval_jitter_percent);
 
-            bool const have_started_recovery_task =
-                run_recovery_task(
-                    recovery,
-                    iface->name,
-                    iface->ctx->recovery_directory,
-                    &iface->config,
-                    recovery_task_index);
+    /*
+     * Don't wait any longer than the new interval would from now. A longer
+     * interval takes effect from the next test run.
+     */
+    if (timer_remaining(&tester->test_interval_timer) > timeout_msecs)
+    {
+        tester_interval_timer_start(tester, timeout_msecs);
+    }
+}
 
-            if (have_started_recovery_task)
-            {
-                test_recovery_statistics_st * const recovery_stats =
-                    &tester->stats.recovery;
+static void
+interface_config_apply(
+    interface_st * const iface,
+    interface_config_st * const new_config,
+    unsigned int const changes)
+{
+    interface_tester_st * const tester = &iface->tester;
+    interface_recovery_st * const recovery = &iface->recovery;
 
-                recovery_stats->total_this_connection++;
-                recovery_stats->total++;
+    ILOG("%s: %s: changes: 0x%x", __func__, iface->name, changes);
 
-                tester_state_transition(tester, TESTER_STATE_RECOVERING);
-            }
-        }
+    interface_config_take(&iface->config, new_config, changes);
+    interface_config_changed(iface);
+
+    if ((changes & INTERFACE_CONFIG_CHANGE_RECOVERYS) != 0)
+    {
+        recovery->recovery_index = 0;
+    }
+
+    if ((changes & INTERFACE_CONFIG_CHANGE_SCHEDULER_PRIORITY) != 0)
+    {
+        scheduler_client_set_priority(&iface->scheduler_client, iface->config.scheduler_priority);
+    }
+
+#if WITH_METRICS_ADJUSTMENT
+    if ((changes & INTERFACE_CONFIG_CHANGE_METRICS) != 0
+        && recovery->state == RECOVERY_STATE_BROKEN
+        && (recovery->metrics_are_adjusted || iface->config.failing_tests_metrics_increase > 0))
+    {
+        interface_adjust_route_metrics(iface, iface->config.failing_tests_metrics_increase);
+        recovery->metrics_are_adjusted = iface->config.failing_tests_metrics_increase > 0;
+    }
+#endif
+
+    if ((changes & INTERFACE_CONFIG_CHANGE_THRESHOLDS) != 0)
+    {
+        recovery_thresholds_evaluate(iface);
+    }
+
+    if ((changes & INTERFACE_CONFIG_CHANGE_INTERVALS) != 0
+        && tester->state == TESTER_STATE_SLEEPING)
+    {
+        tester_interval_timer_rearm(tester);
+    }
+}
+
+static void
+tester_apply_pending_config(interface_tester_st * const tester)
+{
+    interface_st * const iface = container_of(tester, interface_st, tester);
+
+    if (iface->pending_config_changes == 0)
+    {
+        goto done;
     }
+
+    unsigned int const changes = iface->pending_config_changes;
+    interface_config_st new_config = iface->pending_config;
+
+    memset(&iface->pending_config, 0, sizeof(iface->pending_config));
+    iface->pending_config_changes = 0;
+
+    interface_config_apply(iface, &new_config, changes);
+    interface_tester_config_free(&new_config);
+
+done:
+    return;
 }
 
 static void
@@ -530,7 +1212,10 @@ interface_test_run_completed(interface_tester_st * const tester, bool const pass
 
     ILOG("%s: %s", __func__, iface->name);
 
+    /* Stop any tests that are still running now that the result is known. */
+    test_slots_cancel(tester);
     tester->test_index = 0;
+    tester_apply_pending_config(tester);
     ubus_send_interface_test_run_event(
         &iface->ctx->ubus_conn.ctx, iface->name, passed);
 
@@ -542,6 +1227,7 @@ interface_test_run_completed(interface_tester_st * const tester, bool const pass
     {
         interface_test_run_failed(recovery);
     }
+    ubus_notify_interface_test_run(iface, passed);
     if (tester->state != TESTER_STATE_RECOVERING)
     {
         tester_sleep(tester);
@@ -572,9 +1258,7 @@ interface_test_passed(interface_tester_st * const tester)
     }
     else if (iface->config.success_condition->condition == test_run_success_condition_all)
     {
-        tester->test_index++;
-
-        if (tester->test_index >= iface->config.num_tests)
+        if (!test_run_continues(tester))
         {
             /*
              * All test must pass, and the last test in the list passed.
@@ -584,15 +1268,6 @@ interface_test_passed(interface_tester_st * const tester)
 
             interface_test_run_completed(tester, test_run_passed);
         }
-        else
-        {
-            run_test(
-                tester,
-                iface->name,
-                iface->ctx->test_directory,
-                &iface->config,
-                tester->test_index);
-        }
     }
     else
     {
@@ -619,9 +1294,7 @@ interface_test_failed(interface_tester_st * const tester)
 
     if (iface->config.success_condition->condition == test_run_success_condition_one)
     {
-        tester->test_index++;
-
-        if (tester->test_index >= iface->config.num_tests)
+        if (!test_run_continues(tester))
         {
             /*
              * One test must pass, but the last test in the list has failed.
@@ -631,15 +1304,6 @@ interface_test_failed(interface_tester_st * const tester)
 
             interface_test_run_completed(tester, test_run_passed);
         }
-        else
-        {
-            run_test(
-                tester,
-                iface->name,
-                iface->ctx->test_directory,
-                &iface->config,
-                tester->test_index);
-        }
     }
     else if (iface->config.success_condition->condition == test_run_success_condition_all)
     {
@@ -682,10 +1346,10 @@ static void
 tester_stop(interface_tester_st * const tester)
 {
     tester_state_transition(tester, TESTER_STATE_STOPPED);
-    interface_tester_kill_process(&tester->test_proc);
-    tester_response_timer_stop(tester);
+    test_slots_cancel(tester);
     tester_interval_timer_stop(tester);
     tester->test_index = 0;
+    tester_apply_pending_config(tester);
     /*
      * Note that the recovery task isn't stopped (if one was running).
      * It may be that the interface disconnects as a normal part of the recovery
@@ -720,8 +1384,22 @@ static void tester_start_connected(interface_tester_st * const tester)
      * This allows the tester to cycle through all recovery tasks across many
      * connection instances.
      */
-    run_test(
-        tester, iface->name, iface->ctx->test_directory, &iface->config, tester->test_index);
+    if (!test_slots_allocate(tester, iface->config.num_tests))
+    {
+        DLOG("%s: failed to allocate test slots", iface->name);
+
+        bool const test_run_passed = false;
+
+        interface_test_run_completed(tester, test_run_passed);
+    }
+    else if (iface->config.parallel_tests)
+    {
+        run_tests_in_parallel(tester);
+    }
+    else
+    {
+        run_test(tester, tester->test_index);
+    }
 }
 
 static void
@@ -733,8 +1411,7 @@ tester_start(interface_tester_st * const tester)
 static void
 recovery_cleanup(interface_recovery_st * const recovery)
 {
-    interface_tester_kill_process(&recovery->proc);
-    recovery_response_timer_stop(recovery);
+    recovery_task_stop(recovery);
 #if WITH_METRICS_ADJUSTMENT
     {
     interface_st * const iface = container_of(recovery, interface_st, recovery);
@@ -743,25 +1420,50 @@ recovery_cleanup(interface_recovery_st * const recovery)
     {
         interface_adjust_route_metrics(iface, 0);
     }
+    metrics_adjuster_cleanup(&recovery->metrics_adjuster);
     }
 #endif
     recovery->recovery_index = 0;
 }
 
+#if WITH_METRICS_ADJUSTMENT
+static void
+metrics_adjuster_changed(metrics_adjuster_st * const adjuster)
+{
+    interface_recovery_st * const recovery =
+        container_of(adjuster, interface_recovery_st, metrics_adjuster);
+
+    interface_state_changed(container_of(recovery, interface_st, recovery));
+}
+#endif
+
 static void
 recovery_init(interface_recovery_st * const recovery)
 {
+    interface_st * const iface = container_of(recovery, interface_st, recovery);
+
     timer_init(
         &recovery->response_timeout_timer, "recovery_task_timer", recovery_task_timer_expired);
+    scheduler_request_init(
+        &recovery->scheduler_request,
+        &iface->scheduler_client,
+        SCHEDULER_CLASS_RECOVERY,
+        recovery_task_dispatched);
+#if WITH_METRICS_ADJUSTMENT
+    metrics_adjuster_init(
+        &recovery->metrics_adjuster,
+        &iface->ctx->ubus_conn.ctx,
+        iface->name,
+        metrics_adjuster_changed);
+#endif
 }
 
 static void tester_init(interface_tester_st * const tester)
 {
     tester->starter = tester_start_disconnected;
+    tester->current_event = TESTER_EVENT_COUNT__;
     timer_init(
         &tester->test_interval_timer, "test_interval_timer", test_interval_timer_expired);
-    timer_init(
-        &tester->test_response_timeout_timer, "test_response_timer", test_response_timer_expired);
     tester_state_transition(tester, TESTER_STATE_STOPPED);
 }
 
@@ -771,6 +1473,8 @@ interface_tester_initialise(interface_st * const iface)
     DLOG("%s: %s", __func__, iface->name);
 
     event_queue_init(&iface->event_queue);
+    output_buffer_init(&iface->output, iface->ctx->output_buffer_size);
+    scheduler_client_init(&iface->scheduler_client, &iface->ctx->scheduler);
     interface_connection_init(&iface->connection);
     tester_init(&iface->tester);
     recovery_init(&iface->recovery);
@@ -781,6 +1485,8 @@ interface_tester_begin(interface_st * const iface)
 {
     DLOG("%s: %s", __func__, iface->name);
 
+    interface_config_changed(iface);
+    scheduler_client_set_priority(&iface->scheduler_client, iface->config.scheduler_priority);
     transition_to_operational_state(iface);
     interface_connection_begin(&iface->connection);
 }
@@ -790,36 +1496,45 @@ interface_tester_cleanup(interface_st * const iface)
 {
     DLOG("%s: %s", __func__, iface->name);
 
+    pending_config_discard(iface);
     recovery_cleanup(&iface->recovery);
     interface_connection_cleanup(&iface->connection);
     tester_stop(&iface->tester);
+    test_slots_free(&iface->tester);
+    scheduler_client_cleanup(&iface->scheduler_client);
+    output_buffer_free(&iface->output);
+    event_queue_cleanup(&iface->event_queue);
 }
 
 void
-interface_tester_stop(interface_st * const iface)
-{
-    /* Occurs with a context configuration change. */
-    interface_tester_st * const tester = &iface->tester;
-
-    ILOG("%s: %s", __func__, iface->name);
-
-    tester_stop(tester);
-}
-
-void
-interface_tester_start(interface_st * const iface)
+interface_tester_reconfigure(
+    interface_st * const iface, interface_config_st * const new_config, unsigned int const changes)
 {
     /*
-     * Occurs with a context configuration change.
-     * As the configuration has changed the number of recovery tasks may have
-     * changed, so ensure recoverys start afresh.
+     * Occurs with a configuration change. Only the parts of the configuration
+     * that have changed are acted on, and the tester carries on from where it
+     * was, but a test run in progress is left to finish with the tests it was
+     * started with. new_config is left holding whatever the interface no longer
+     * needs.
      */
     interface_tester_st * const tester = &iface->tester;
 
     ILOG("%s: %s", __func__, iface->name);
 
-    iface->recovery.recovery_index = 0;
-    tester_start(tester);
+    /* This configuration replaces any that was waiting to be applied. */
+    pending_config_discard(iface);
+
+    if ((changes & INTERFACE_CONFIG_CHANGE_TESTS) != 0 && tester->state == TESTER_STATE_TESTING)
+    {
+        DLOG("%s: %s: waiting for the test run to end", __func__, iface->name);
+
+        interface_config_swap(&iface->pending_config, new_config);
+        iface->pending_config_changes = changes;
+    }
+    else
+    {
+        interface_config_apply(iface, new_config, changes);
+    }
 }
 
 static void
@@ -832,9 +1547,28 @@ tester_disconnected_handler(interface_tester_st * const tester)
 static void
 tester_connected_handler(interface_tester_st * const tester)
 {
+    interface_st * const iface = container_of(tester, interface_st, tester);
+
     tester->starter = tester_start_connected;
     tester_initialise_per_connection_statistics(tester);
-    tester_start(tester);
+
+    uint32_t const offset_msecs =
+        iface->config.phase_spreading
+        ? interface_connection_phase_offset_msecs(
+            &iface->connection, tester_interval_msecs(tester))
+        : 0;
+
+    if (offset_msecs > 0)
+    {
+        /* Wait for this interface's turn in the interval before the first run. */
+        DLOG("%s: %s: first run in %" PRIu32 " msecs", __func__, iface->name, offset_msecs);
+        tester_state_transition(tester, TESTER_STATE_SLEEPING);
+        tester_interval_timer_start(tester, offset_msecs);
+    }
+    else
+    {
+        tester_start(tester);
+    }
 }
 
 static bool
@@ -905,18 +1639,18 @@ testing_state_event_handler(
     switch (event)
     {
     case TESTER_EVENT_TEST_PASSED:
-        tester_response_timer_stop(tester);
         interface_test_passed(tester);
         break;
 
     case TESTER_EVENT_TEST_FAILED:
-        tester_response_timer_stop(tester);
         interface_test_failed(tester);
         break;
 
     case TESTER_EVENT_TEST_TIMED_OUT:
-        /* The test took too long to complete. Call this a failure. */
-        interface_tester_kill_process(&tester->test_proc);
+        /*
+         * The test took too long to complete, and has already been stopped.
+         * Call this a failure.
+         */
         interface_test_failed(tester);
         break;
 
@@ -943,7 +1677,7 @@ recovering_state_event_handler(
     switch (event)
     {
     case TESTER_EVENT_RECOVERY_TASK_TIMED_OUT:
-        interface_tester_kill_process(&recovery->proc);
+        recovery_task_stop(recovery);
         tester_sleep(tester);
         break;
 
@@ -975,14 +1709,36 @@ static const tester_event_handler_fn tester_event_handler_fns[] =
     [TESTER_STATE_RECOVERING] = recovering_state_event_handler,
 };
 
+static bool
+test_result_is_stale(interface_tester_st * const tester, tester_event_t const event)
+{
+    bool is_stale;
+
+    if (event != TESTER_EVENT_TEST_PASSED
+        && event != TESTER_EVENT_TEST_FAILED
+        && event != TESTER_EVENT_TEST_TIMED_OUT)
+    {
+        is_stale = false;
+        goto done;
+    }
+
+    tester->results_queued--;
+    is_stale = tester->stale_results > 0;
+    if (is_stale)
+    {
+        tester->stale_results--;
+    }
+
+done:
+    return is_stale;
+}
+
 static void
 tester_event_handler(void * const event_ctx, tester_event_t const event)
 {
     interface_tester_st * const tester = event_ctx;
     bool handled_event = false;
-#if DEBUG
     interface_st * const iface = container_of(tester, interface_st, tester);
-#endif
 
     DLOG("%s: handling event: %s in state %s",
          iface->name,
@@ -994,7 +1750,16 @@ tester_event_handler(void * const event_ctx, tester_event_t const event)
     assert(tester_event_handler_fns[tester->state] != NULL);
 #endif
 
+    if (test_result_is_stale(tester, event))
+    {
+        DLOG("%s: ignoring the result of a cancelled test", iface->name);
+        goto done;
+    }
+
+    tester->current_event = event;
     handled_event = tester_event_handler_fns[tester->state](tester, event);
+    tester->current_event = TESTER_EVENT_COUNT__;
+    interface_state_changed(iface);
 
     if (handled_event)
     {
@@ -1010,6 +1775,9 @@ tester_event_handler(void * const event_ctx, tester_event_t const event)
              tester_event_to_str(event),
              interface_tester_state_to_str(tester->state));
     }
+
+done:
+    return;
 }
 
 void
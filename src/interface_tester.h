@@ -21,8 +21,6 @@ void
 interface_tester_cleanup(interface_st * iface);
 
 void
-interface_tester_stop(interface_st * iface);
-
-void
-interface_tester_start(interface_st * iface);
+interface_tester_reconfigure(
+    interface_st * iface, interface_config_st * new_config, unsigned int changes);
 
@@ -7,6 +7,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 
 static void
 logging_init(
@@ -35,6 +37,7 @@ publish_objects(interface_tester_shared_st * const ctx)
 
     ubus_subscribe_to_interface_events(&ctx->ubus_conn.ctx, &ctx->interface_events);
     ubus_subscribe_to_interface_state_events(&ctx->ubus_conn.ctx, &ctx->interface_state_events);
+    ubus_subscribe_to_object_events(&ctx->ubus_conn.ctx, &ctx->object_events);
 
     success = true;
 
@@ -53,7 +56,7 @@ ubus_connect_handler(struct ubus_context * const ubus)
     DLOG("connected to ubus");
 
     publish_objects(ctx);
-    config_load_from_file_check(ctx);
+    config_watcher_load_all(&ctx->config_watcher);
 
     bool const are_connected = true;
 
@@ -67,8 +70,15 @@ context_shutdown(interface_tester_shared_st * const ctx)
     struct ubus_context * const ubus = &ctx->ubus_conn.ctx;
     bool const are_connected = false;
 
+    /* Send any batched events before telling the system that the tester is down. */
+    event_batcher_flush(&ctx->event_batcher);
     interface_tester_send_up_down_event(ubus, are_connected);
     interface_testers_free(interfaces);
+    event_batcher_cleanup(&ctx->event_batcher);
+    config_watcher_cleanup(&ctx->config_watcher);
+    config_cleanup(ctx);
+    scheduler_cleanup(&ctx->scheduler);
+    exec_cache_cleanup(&ctx->exec_cache);
 }
 
 static void
@@ -76,12 +86,30 @@ context_init(
     interface_tester_shared_st * const ctx,
     char const * const test_directory,
     char const * const recovery_directory,
-    char const * const config_file)
+    char const * const config_file,
+    char const * const fragment_dir,
+    unsigned int const max_processes,
+    unsigned int const max_tests,
+    unsigned int const max_recovery_tasks,
+    size_t const output_buffer_size,
+    uint32_t const interval_jitter_percent,
+    bool const phase_spreading,
+    bool const interface_objects,
+    uint32_t const event_batch_msecs)
 {
-    ctx->test_directory = test_directory;
-    ctx->recovery_directory = recovery_directory;
-    ctx->config_file = config_file;
+    ctx->output_buffer_size = output_buffer_size;
+    ctx->interval_jitter_percent = interval_jitter_percent;
+    ctx->phase_spreading = phase_spreading;
+    ctx->interface_objects = interface_objects;
+    event_batcher_init(&ctx->event_batcher, &ctx->ubus_conn.ctx, event_batch_msecs);
+    exec_cache_init(&ctx->exec_cache, test_directory, recovery_directory);
+    config_definitions_init(&ctx->definitions, &ctx->exec_cache);
+    scheduler_init(&ctx->scheduler);
+    scheduler_set_limit(&ctx->scheduler, max_processes);
+    scheduler_set_class_limit(&ctx->scheduler, SCHEDULER_CLASS_TEST, max_tests);
+    scheduler_set_class_limit(&ctx->scheduler, SCHEDULER_CLASS_RECOVERY, max_recovery_tasks);
     config_init(ctx);
+    config_watcher_init(&ctx->config_watcher, config_file, fragment_dir);
 }
 
 static void
@@ -90,10 +118,27 @@ usage(FILE * const fp, const char * const progname)
     fprintf(fp, "Usage: %s [options]\n"
             "Options:\n"
             " -c <path>:              Path to the configuration file\n"
+            " -d <path>:              Path to a directory of configuration fragments\n"
             " -s <path>:              Path to the ubus socket\n"
             " -S <path>:              Path to the test executable directory\n"
             " -r <path>:              Path to the recovery executable directory\n"
             " -t <logging threshold>: Logging threshold (default %d)\n"
+            " -j <count>:             Maximum number of tests and recovery tasks to run at once\n"
+            "                         (default 0 - no limit)\n"
+            " -T <count>:             Maximum number of tests to run at once (default 0 - no limit)\n"
+            " -R <count>:             Maximum number of recovery tasks to run at once\n"
+            "                         (default 0 - no limit)\n"
+            " -O <bytes>:             Size of the buffer that holds the recent output of each\n"
+            "                         interface's tests and recovery tasks\n"
+            "                         (default 0 - output is discarded)\n"
+            " -J <percent>:           Vary test intervals at random by up to this percentage\n"
+            "                         (0-100, default 0)\n"
+            " -P:                     Spread the first test runs of interfaces that connect\n"
+            "                         together across the test interval\n"
+            " -N:                     Don't publish a ubus object for each interface\n"
+            " -b <msecs>:             Collect operational and test run events for this long and\n"
+            "                         send them as a single interface.tester.batch event\n"
+            "                         (default 0 - each event is sent at once)\n"
             "\n",
             progname, LOG_DEBUG);
 }
@@ -106,13 +151,22 @@ main(int const argc, char * * const argv)
     const char * test_directory = NULL;
     const char * recovery_directory = NULL;
     const char * config_file = NULL;
+    const char * fragment_dir = NULL;
+    unsigned int max_processes = 0;
+    unsigned int max_tests = 0;
+    unsigned int max_recovery_tasks = 0;
+    size_t output_buffer_size = 0;
+    unsigned long interval_jitter_percent = 0;
+    bool phase_spreading = false;
+    bool interface_objects = true;
+    uint32_t event_batch_msecs = 0;
     int ch;
     int logging_threshold = LOG_DEBUG;
     int logging_channels = ULOG_SYSLOG;
     int logging_facility = LOG_DAEMON;
     char const * const logging_id = "interface_tester";
 
-    while ((ch = getopt(argc, argv, "s:S:r:c:t:")) != -1)
+    while ((ch = getopt(argc, argv, "s:S:r:c:d:t:j:T:R:O:J:PNb:")) != -1)
     {
         switch(ch)
         {
@@ -120,6 +174,10 @@ main(int const argc, char * * const argv)
             config_file = optarg;
             break;
 
+        case 'd':
+            fragment_dir = optarg;
+            break;
+
         case 's':
             ubus_path = optarg;
             break;
@@ -136,6 +194,43 @@ main(int const argc, char * * const argv)
             logging_threshold = strtoul(optarg, NULL, 0);
             break;
 
+        case 'j':
+            max_processes = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'T':
+            max_tests = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'R':
+            max_recovery_tasks = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'O':
+            output_buffer_size = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'J':
+            interval_jitter_percent = strtoul(optarg, NULL, 0);
+            if (interval_jitter_percent > 100)
+            {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case 'P':
+            phase_spreading = true;
+            break;
+
+        case 'N':
+            interface_objects = false;
+            break;
+
+        case 'b':
+            event_batch_msecs = strtoul(optarg, NULL, 0);
+            break;
+
         default:
             usage(stderr, argv[0]);
             return EXIT_FAILURE;
@@ -144,8 +239,22 @@ main(int const argc, char * * const argv)
 
     logging_init(logging_threshold, logging_channels, logging_facility, logging_id);
     uloop_init();
-
-    context_init(&ctx, test_directory, recovery_directory, config_file);
+    srandom(time(NULL) ^ getpid());
+
+    context_init(
+        &ctx,
+        test_directory,
+        recovery_directory,
+        config_file,
+        fragment_dir,
+        max_processes,
+        max_tests,
+        max_recovery_tasks,
+        output_buffer_size,
+        interval_jitter_percent,
+        phase_spreading,
+        interface_objects,
+        event_batch_msecs);
     ubus_init(&ctx.ubus_conn, ubus_path, ubus_connect_handler);
 
     ILOG("Interface tester started");
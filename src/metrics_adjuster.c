@@ -0,0 +1,242 @@
+#include "metrics_adjuster.h"
+
+#if WITH_METRICS_ADJUSTMENT
+
+#include "debug.h"
+#include "ubus.h"
+#include "utils.h"
+
+#include <libubox/utils.h>
+
+#include <inttypes.h>
+
+static uint32_t const response_timeout_msecs = 5000;
+static uint32_t const initial_retry_delay_msecs = 1000;
+
+static void
+send_desired(metrics_adjuster_st * adjuster);
+
+static void
+request_done(metrics_adjuster_st * const adjuster, bool const success)
+{
+    adjuster->request_pending_ = false;
+    timer_stop(&adjuster->timer_);
+
+    if (success)
+    {
+        adjuster->applied_ = adjuster->requested_;
+        adjuster->applied_is_known_ = true;
+        adjuster->retries_ = 0;
+        if (adjuster->update_waiting_)
+        {
+            send_desired(adjuster);
+        }
+        goto done;
+    }
+
+    adjuster->stats_.failures++;
+    /* Whatever is desired now still has to be sent. */
+    adjuster->update_waiting_ = true;
+
+    if (adjuster->retries_ >= METRICS_ADJUSTER_MAX_RETRIES)
+    {
+        ILOG("%s: giving up setting metrics adjustment to %" PRIu32,
+             adjuster->interface_name_, adjuster->desired_);
+        adjuster->update_waiting_ = false;
+        goto done;
+    }
+
+    uint32_t const delay_msecs = initial_retry_delay_msecs << adjuster->retries_;
+
+    adjuster->retries_++;
+    DLOG("%s: retrying metrics adjustment in %" PRIu32 " msecs",
+         adjuster->interface_name_, delay_msecs);
+    timer_start(&adjuster->timer_, delay_msecs);
+
+done:
+    adjuster->changed_cb_(adjuster);
+}
+
+static void
+request_complete_cb(struct ubus_request * const req, int const ret)
+{
+    metrics_adjuster_st * const adjuster =
+        container_of(req, metrics_adjuster_st, request_);
+
+    if (ret != UBUS_STATUS_OK)
+    {
+        DLOG("%s: failed to set metrics adjustment to %" PRIu32 ": %s",
+             adjuster->interface_name_, adjuster->requested_, ubus_strerror(ret));
+    }
+    /* netifd may have restarted, so look its object up again next time. */
+    if (ret == UBUS_STATUS_NOT_FOUND)
+    {
+        adjuster->object_id_ = 0;
+    }
+
+    request_done(adjuster, ret == UBUS_STATUS_OK);
+}
+
+static void
+send_desired(metrics_adjuster_st * const adjuster)
+{
+    adjuster->update_waiting_ = false;
+    adjuster->requested_ = adjuster->desired_;
+    adjuster->request_pending_ = true;
+    adjuster->stats_.requests++;
+    timer_start(&adjuster->timer_, response_timeout_msecs);
+
+    if (!ubus_send_metrics_adjust_request(
+            adjuster->ubus_,
+            adjuster->interface_name_,
+            &adjuster->object_id_,
+            adjuster->requested_,
+            &adjuster->request_,
+            request_complete_cb,
+            NULL))
+    {
+        request_done(adjuster, false);
+    }
+}
+
+static void
+timer_expired(timer_st * const t)
+{
+    metrics_adjuster_st * const adjuster = container_of(t, metrics_adjuster_st, timer_);
+
+    if (adjuster->request_pending_)
+    {
+        DLOG("%s: no reply to metrics adjustment", adjuster->interface_name_);
+        ubus_abort_request(adjuster->ubus_, &adjuster->request_);
+        request_done(adjuster, false);
+    }
+    else if (adjuster->update_waiting_)
+    {
+        send_desired(adjuster);
+    }
+}
+
+void
+metrics_adjuster_set(metrics_adjuster_st * const adjuster, uint32_t const amount)
+{
+    bool const already_applied =
+        adjuster->applied_is_known_ && adjuster->applied_ == amount;
+
+    if (adjuster->update_waiting_ && amount != adjuster->desired_)
+    {
+        adjuster->stats_.coalesced++;
+    }
+    adjuster->desired_ = amount;
+
+    if (adjuster->request_pending_)
+    {
+        /* Sent once the reply to the outstanding request arrives. */
+        adjuster->update_waiting_ = amount != adjuster->requested_;
+        goto done;
+    }
+
+    if (timer_is_running(&adjuster->timer_))
+    {
+        /* Waiting to retry. Sent when the timer expires, unless not needed now. */
+        adjuster->update_waiting_ = !already_applied;
+        if (already_applied)
+        {
+            timer_stop(&adjuster->timer_);
+            adjuster->retries_ = 0;
+        }
+        goto done;
+    }
+
+    if (already_applied)
+    {
+        adjuster->update_waiting_ = false;
+        goto done;
+    }
+
+    adjuster->retries_ = 0;
+    send_desired(adjuster);
+
+done:
+    return;
+}
+
+void
+metrics_adjuster_cleanup(metrics_adjuster_st * const adjuster)
+{
+    /* An outstanding request has already been sent, so only its reply is lost. */
+    if (adjuster->request_pending_)
+    {
+        ubus_abort_request(adjuster->ubus_, &adjuster->request_);
+        adjuster->request_pending_ = false;
+    }
+    timer_stop(&adjuster->timer_);
+
+    if (adjuster->update_waiting_)
+    {
+        struct ubus_request req;
+
+        ubus_send_metrics_adjust_request(
+            adjuster->ubus_,
+            adjuster->interface_name_,
+            &adjuster->object_id_,
+            adjuster->desired_,
+            &req,
+            NULL,
+            NULL);
+        adjuster->update_waiting_ = false;
+    }
+}
+
+void
+metrics_adjuster_set_object_id(metrics_adjuster_st * const adjuster, uint32_t const id)
+{
+    adjuster->object_id_ = id;
+}
+
+uint32_t
+metrics_adjuster_desired(metrics_adjuster_st const * const adjuster)
+{
+    return adjuster->desired_;
+}
+
+bool
+metrics_adjuster_applied(metrics_adjuster_st const * const adjuster, uint32_t * const amount)
+{
+    *amount = adjuster->applied_;
+
+    return adjuster->applied_is_known_;
+}
+
+bool
+metrics_adjuster_is_pending(metrics_adjuster_st const * const adjuster)
+{
+    return adjuster->request_pending_ || adjuster->update_waiting_;
+}
+
+unsigned int
+metrics_adjuster_retries(metrics_adjuster_st const * const adjuster)
+{
+    return adjuster->retries_;
+}
+
+metrics_adjuster_stats_st const *
+metrics_adjuster_stats(metrics_adjuster_st const * const adjuster)
+{
+    return &adjuster->stats_;
+}
+
+void
+metrics_adjuster_init(
+    metrics_adjuster_st * const adjuster,
+    struct ubus_context * const ubus,
+    char const * const interface_name,
+    metrics_adjuster_changed_fn const changed_cb)
+{
+    *adjuster = (metrics_adjuster_st){ 0 };
+    adjuster->ubus_ = ubus;
+    adjuster->interface_name_ = interface_name;
+    adjuster->changed_cb_ = changed_cb;
+    timer_init(&adjuster->timer_, "metrics_adjust_timer", timer_expired);
+}
+
+#endif
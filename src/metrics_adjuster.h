@@ -0,0 +1,97 @@
+#pragma once
+
+#include "configure.h"
+
+#if WITH_METRICS_ADJUSTMENT
+
+#include "timers.h"
+
+#include <libubus.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Route metric adjustments are sent to netifd without waiting for the reply.
+ * Only the latest adjustment that has been asked for is kept, so at most one
+ * request per interface is outstanding, and an adjustment asked for while one
+ * is outstanding replaces any other that is waiting to be sent. A request that
+ * fails is retried after a delay that doubles each time, up to
+ * METRICS_ADJUSTER_MAX_RETRIES times. The id of netifd's object for the
+ * interface is kept, so it is only looked up when it isn't known.
+ */
+
+#define METRICS_ADJUSTER_MAX_RETRIES 5
+
+typedef struct metrics_adjuster_st metrics_adjuster_st;
+
+/* Called when the adjustment that netifd has applied, or the retries, change. */
+typedef void (*metrics_adjuster_changed_fn)(metrics_adjuster_st * adjuster);
+
+typedef struct metrics_adjuster_stats_st
+{
+    uint64_t requests;
+    uint64_t failures;
+    uint64_t coalesced; /* Adjustments replaced before they were sent. */
+} metrics_adjuster_stats_st;
+
+struct metrics_adjuster_st
+{
+    /* Users should not access these fields directly. */
+    struct ubus_context * ubus_;
+    char const * interface_name_;
+    uint32_t object_id_; /* netifd's network.interface.<name> object. 0 if unknown. */
+    metrics_adjuster_changed_fn changed_cb_;
+    uint32_t desired_;
+    uint32_t applied_;
+    bool applied_is_known_; /* False until netifd has accepted an adjustment. */
+    bool request_pending_;
+    bool update_waiting_; /* desired_ hasn't been sent yet. */
+    uint32_t requested_; /* The adjustment in the outstanding request. */
+    unsigned int retries_;
+    /* The response timeout while a request is outstanding, else the retry delay. */
+    timer_st timer_;
+    struct ubus_request request_;
+    metrics_adjuster_stats_st stats_;
+};
+
+/* interface_name must outlive the adjuster. */
+void
+metrics_adjuster_init(
+    metrics_adjuster_st * adjuster,
+    struct ubus_context * ubus,
+    char const * interface_name,
+    metrics_adjuster_changed_fn changed_cb);
+
+/* Ask for the route metrics of the interface to be adjusted by amount. */
+void
+metrics_adjuster_set(metrics_adjuster_st * adjuster, uint32_t amount);
+
+/*
+ * Stop waiting for replies and retries. If the latest adjustment may not have
+ * been applied it is sent once more, without waiting for the reply.
+ */
+void
+metrics_adjuster_cleanup(metrics_adjuster_st * adjuster);
+
+/* Called when netifd's object for the interface is added (id) or removed (0). */
+void
+metrics_adjuster_set_object_id(metrics_adjuster_st * adjuster, uint32_t id);
+
+uint32_t
+metrics_adjuster_desired(metrics_adjuster_st const * adjuster);
+
+/* Returns false if netifd hasn't accepted an adjustment yet. */
+bool
+metrics_adjuster_applied(metrics_adjuster_st const * adjuster, uint32_t * amount);
+
+bool
+metrics_adjuster_is_pending(metrics_adjuster_st const * adjuster);
+
+unsigned int
+metrics_adjuster_retries(metrics_adjuster_st const * adjuster);
+
+metrics_adjuster_stats_st const *
+metrics_adjuster_stats(metrics_adjuster_st const * adjuster);
+
+#endif
@@ -0,0 +1,153 @@
+#include "output_buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool
+output_buffer_init(output_buffer_st * const buf, size_t const size)
+{
+    bool success;
+
+    memset(buf, 0, sizeof(*buf));
+
+    if (size == 0)
+    {
+        success = true;
+        goto done;
+    }
+
+    buf->data_ = malloc(size);
+    if (buf->data_ == NULL)
+    {
+        success = false;
+        goto done;
+    }
+    buf->size_ = size;
+
+    success = true;
+
+done:
+    return success;
+}
+
+void
+output_buffer_free(output_buffer_st * const buf)
+{
+    free(buf->data_);
+    memset(buf, 0, sizeof(*buf));
+}
+
+bool
+output_buffer_is_enabled(output_buffer_st const * const buf)
+{
+    return buf->size_ > 0;
+}
+
+size_t
+output_buffer_size(output_buffer_st const * const buf)
+{
+    return buf->size_;
+}
+
+size_t
+output_buffer_used(output_buffer_st const * const buf)
+{
+    return buf->used_;
+}
+
+uint64_t
+output_buffer_total_bytes(output_buffer_st const * const buf)
+{
+    return buf->total_bytes_;
+}
+
+uint64_t
+output_buffer_truncated_bytes(output_buffer_st const * const buf)
+{
+    return buf->truncated_bytes_;
+}
+
+void
+output_buffer_write(output_buffer_st * const buf, void const * const data, size_t const len)
+{
+    char const * src = data;
+    size_t remaining = len;
+
+    if (!output_buffer_is_enabled(buf))
+    {
+        goto done;
+    }
+
+    buf->total_bytes_ += len;
+
+    /* Only the last size_ bytes of a large write would survive anyway. */
+    if (remaining > buf->size_)
+    {
+        src += remaining - buf->size_;
+        remaining = buf->size_;
+    }
+
+    while (remaining > 0)
+    {
+        size_t const space_to_end = buf->size_ - buf->head_;
+        size_t const chunk = remaining < space_to_end ? remaining : space_to_end;
+
+        memcpy(buf->data_ + buf->head_, src, chunk);
+        buf->head_ = (buf->head_ + chunk) % buf->size_;
+        src += chunk;
+        remaining -= chunk;
+        buf->used_ = (buf->used_ + chunk) > buf->size_ ? buf->size_ : buf->used_ + chunk;
+    }
+
+done:
+    return;
+}
+
+void
+output_buffer_printf(output_buffer_st * const buf, char const * const format, ...)
+{
+    char line[256];
+    va_list args;
+
+    if (!output_buffer_is_enabled(buf))
+    {
+        goto done;
+    }
+
+    va_start(args, format);
+    int const len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (len > 0)
+    {
+        size_t const written = (size_t)len < sizeof(line) ? (size_t)len : sizeof(line) - 1;
+
+        output_buffer_write(buf, line, written);
+    }
+
+done:
+    return;
+}
+
+void
+output_buffer_record_truncation(output_buffer_st * const buf, size_t const len)
+{
+    buf->truncated_bytes_ += len;
+}
+
+void
+output_buffer_copy(output_buffer_st const * const buf, char * const dest)
+{
+    if (buf->used_ > 0)
+    {
+        /* The oldest byte is used_ bytes behind the head. */
+        size_t const oldest = (buf->head_ + buf->size_ - buf->used_) % buf->size_;
+        size_t const space_to_end = buf->size_ - oldest;
+        size_t const first = buf->used_ < space_to_end ? buf->used_ : space_to_end;
+
+        memcpy(dest, buf->data_ + oldest, first);
+        memcpy(dest + first, buf->data_, buf->used_ - first);
+    }
+    dest[buf->used_] = '\0';
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A fixed size ring buffer holding the most recent output of the tests and
+ * recovery tasks run for an interface. The buffer is allocated once and never
+ * grows. Once full, the oldest output is overwritten.
+ */
+typedef struct output_buffer_st
+{
+    /* Users should not access these fields directly. */
+    char * data_;
+    size_t size_;
+    size_t head_; /* Where the next byte will be written. */
+    size_t used_;
+    uint64_t total_bytes_;
+    uint64_t truncated_bytes_;
+} output_buffer_st;
+
+/* A size of 0 leaves the buffer disabled. */
+bool
+output_buffer_init(output_buffer_st * buf, size_t size);
+
+void
+output_buffer_free(output_buffer_st * buf);
+
+bool
+output_buffer_is_enabled(output_buffer_st const * buf);
+
+size_t
+output_buffer_size(output_buffer_st const * buf);
+
+size_t
+output_buffer_used(output_buffer_st const * buf);
+
+/* The number of bytes ever written, including those since overwritten. */
+uint64_t
+output_buffer_total_bytes(output_buffer_st const * buf);
+
+/* The number of bytes discarded rather than written. */
+uint64_t
+output_buffer_truncated_bytes(output_buffer_st const * buf);
+
+void
+output_buffer_write(output_buffer_st * buf, void const * data, size_t len);
+
+void
+output_buffer_printf(output_buffer_st * buf, char const * format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void
+output_buffer_record_truncation(output_buffer_st * buf, size_t len);
+
+/*
+ * Copy the contents of the buffer, oldest first, to dest, which must have
+ * room for output_buffer_used() + 1 bytes. dest is NUL terminated.
+ */
+void
+output_buffer_copy(output_buffer_st const * buf, char * dest);
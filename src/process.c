@@ -1,45 +1,329 @@
 #include "process.h"
 #include "debug.h"
+#include "spawner.h"
 #include "utils.h"
 
+#include <errno.h>
 #include <fcntl.h>
-#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * The most that is read from a process's output in one go, so that a chatty
+ * process can't hold up the loop.
+ */
+#define OUTPUT_READ_CHUNK_SIZE 1024
+
+/* The most chunks to read from a process's output once it has exited. */
+#define OUTPUT_DRAIN_MAX_CHUNKS 16
+
+/* Reaps a killed process that hadn't exited by the time it was killed. */
+typedef struct process_reaper_st
+{
+    struct uloop_fd pidfd;
+    pid_t pid;
+} process_reaper_st;
+
+static uint64_t
+monotonic_usecs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static uint64_t
+timeval_to_usecs(struct timeval const * const tv)
+{
+    return (uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+/*
+ * Returns false if the process is still running. If it can't be waited for it
+ * is reported as having failed, with no resource usage.
+ */
+static bool
+process_reap(pid_t const pid, int * const status, struct rusage * const rusage)
+{
+    /* __WALL because the child doesn't signal SIGCHLD when it exits. */
+    pid_t const res = TEMP_FAILURE_RETRY(wait4(pid, status, WNOHANG | __WALL, rusage));
+
+    if (res < 0)
+    {
+        ILOG("%s: can't wait for pid %d: %s", __func__, (int)pid, strerror(errno));
+
+        *status = W_EXITCODE(EXIT_FAILURE, 0);
+        if (rusage != NULL)
+        {
+            *rusage = (struct rusage){ 0 };
+        }
+    }
+
+    return res != 0;
+}
 
 static void
-redirect_fd(int const from, int const to, int const o_flag)
+process_reaper_cb(struct uloop_fd * const fd, unsigned int const events)
 {
-    int const fd = (from != -1) ? from : open("/dev/null", o_flag);
+    UNUSED(events);
+    process_reaper_st * const reaper = container_of(fd, process_reaper_st, pidfd);
+    int status;
 
-    if (fd > -1)
+    if (!process_reap(reaper->pid, &status, NULL))
     {
-        TEMP_FAILURE_RETRY(dup2(fd, to));
-        close(fd);
+        goto done;
     }
+
+    uloop_fd_delete(&reaper->pidfd);
+    close(reaper->pidfd.fd);
+    free(reaper);
+
+done:
+    return;
 }
 
 static void
-interface_tester_process_cb(struct uloop_process * const proc, int const ret)
+process_reap_later(int const pidfd, pid_t const pid)
 {
-    tester_process_st * const np =
-        container_of(proc, struct tester_process_st, uloop);
+    process_reaper_st * const reaper = calloc(1, sizeof(*reaper));
 
-    if (np->cb != NULL)
+    if (reaper == NULL)
     {
-        np->cb(np, ret);
+        /* The child is left as a zombie, but the pidfd mustn't leak. */
+        close(pidfd);
+        goto done;
+    }
+
+    reaper->pid = pid;
+    reaper->pidfd.fd = pidfd;
+    reaper->pidfd.cb = process_reaper_cb;
+    uloop_fd_add(&reaper->pidfd, ULOOP_READ);
+
+done:
+    return;
+}
+
+static void
+process_output_stop(tester_process_st * const proc)
+{
+    if (!proc->capturing_output_)
+    {
+        goto done;
+    }
+
+    uloop_fd_delete(&proc->output_fd_);
+    close(proc->output_fd_.fd);
+    proc->output_fd_.fd = -1;
+    proc->capturing_output_ = false;
+
+done:
+    return;
+}
+
+/* Returns false once there is nothing more to read. */
+static bool
+process_output_read(tester_process_st * const proc)
+{
+    bool more_to_read;
+    char chunk[OUTPUT_READ_CHUNK_SIZE];
+    ssize_t const len = TEMP_FAILURE_RETRY(read(proc->output_fd_.fd, chunk, sizeof(chunk)));
+
+    if (len < 0 && errno == EAGAIN)
+    {
+        more_to_read = false;
+        goto done;
+    }
+
+    if (len <= 0)
+    {
+        /* End of file (or an error). Nothing more will arrive. */
+        process_output_stop(proc);
+
+        more_to_read = false;
+        goto done;
+    }
+
+    /*
+     * Limit each process to its share of the buffer so that one process can't
+     * push out the output of all the others. Anything beyond that is still
+     * read so that the process doesn't block on a full pipe, but is
+     * discarded.
+     */
+    size_t const limit = proc->output_limit;
+    size_t const remaining =
+        proc->captured_bytes_ < limit ? limit - proc->captured_bytes_ : 0;
+    size_t const accepted = (size_t)len < remaining ? (size_t)len : remaining;
+
+    output_buffer_write(proc->output, chunk, accepted);
+    output_buffer_record_truncation(proc->output, len - accepted);
+    proc->captured_bytes_ += accepted;
+
+    more_to_read = true;
+
+done:
+    return more_to_read;
+}
+
+static void
+process_output_cb(struct uloop_fd * const fd, unsigned int const events)
+{
+    UNUSED(events);
+    tester_process_st * const proc = container_of(fd, tester_process_st, output_fd_);
+
+    /* Just the one read. The loop calls back again if there is more. */
+    process_output_read(proc);
+}
+
+static void
+process_output_drain(tester_process_st * const proc)
+{
+    /*
+     * The process has exited, but its output may not have been read yet.
+     * Anything it started may still hold the pipe open, so don't wait for end
+     * of file.
+     */
+    for (size_t i = 0; i < OUTPUT_DRAIN_MAX_CHUNKS && proc->capturing_output_; i++)
+    {
+        if (!process_output_read(proc))
+        {
+            break;
+        }
     }
+    process_output_stop(proc);
+}
+
+static bool
+process_output_start(tester_process_st * const proc, int * const child_fd)
+{
+    bool success;
+    int fds[2];
+
+    *child_fd = -1;
+
+    if (proc->output == NULL || !output_buffer_is_enabled(proc->output))
+    {
+        success = true;
+        goto done;
+    }
+
+    /* Only the daemon's end of the pipe is non-blocking. */
+    if (pipe2(fds, O_CLOEXEC) < 0)
+    {
+        DLOG("failed to create output pipe: %s", strerror(errno));
+
+        success = false;
+        goto done;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    proc->output_fd_.fd = fds[0];
+    proc->output_fd_.cb = process_output_cb;
+    proc->capturing_output_ = true;
+    proc->captured_bytes_ = 0;
+    *child_fd = fds[1];
+
+    success = true;
+
+done:
+    return success;
+}
+
+static void
+process_release(tester_process_st * const proc)
+{
+    uloop_fd_delete(&proc->pidfd_);
+    proc->pidfd_.fd = -1;
+    proc->pid_ = 0;
+}
+
+static void
+interface_tester_process_cb(struct uloop_fd * const fd, unsigned int const events)
+{
+    UNUSED(events);
+    tester_process_st * const proc = container_of(fd, tester_process_st, pidfd_);
+    int status;
+    struct rusage rusage;
+
+    if (!process_reap(proc->pid_, &status, &rusage))
+    {
+        /* Still running. */
+        goto done;
+    }
+
+    /*
+     * rusage includes any processes the child started and waited for (e.g.
+     * ping run from a shell script).
+     */
+    process_usage_st const usage =
+    {
+        .wall_usecs = monotonic_usecs() - proc->started_usecs_,
+        .user_usecs = timeval_to_usecs(&rusage.ru_utime),
+        .system_usecs = timeval_to_usecs(&rusage.ru_stime),
+        .max_rss_kb = rusage.ru_maxrss,
+    };
+
+    close(proc->pidfd_.fd);
+    process_release(proc);
+    process_output_drain(proc);
+
+    if (proc->cb != NULL)
+    {
+        proc->cb(proc, status, &usage);
+    }
+
+done:
+    return;
+}
+
+bool
+interface_tester_process_is_running(tester_process_st const * const proc)
+{
+    return proc->pid_ > 0;
+}
+
+pid_t
+interface_tester_process_pid(tester_process_st const * const proc)
+{
+    return proc->pid_;
 }
 
 void
 interface_tester_kill_process(tester_process_st * const proc)
 {
-    if (!proc->uloop.pending)
+    if (!interface_tester_process_is_running(proc))
     {
         goto done;
     }
 
-	kill(proc->uloop.pid, SIGKILL);
-	uloop_process_delete(&proc->uloop);
+    pid_t const pid = proc->pid_;
+    int const pidfd = proc->pidfd_.fd;
+    int status;
+
+    /*
+     * The process is the leader of its own process group, so this also kills
+     * anything it has started (e.g. ping run from a shell script).
+     */
+    if (kill(-pid, SIGKILL) < 0)
+    {
+        kill(pid, SIGKILL);
+    }
+    process_release(proc);
+    process_output_stop(proc);
+
+    if (process_reap(pid, &status, NULL))
+    {
+        close(pidfd);
+    }
+    else
+    {
+        process_reap_later(pidfd, pid);
+    }
 
 done:
     return;
@@ -47,48 +331,54 @@ done:
 
 bool
 interface_tester_start_process(
-    tester_process_st * const proc, char * * const argv, char const * const working_dir)
+    tester_process_st * const proc,
+    char * * const argv,
+    int const dir_fd,
+    int const exec_fd)
 {
     bool success;
+    int pidfd = -1;
 
-    interface_tester_kill_process(proc);
+    int output_fd;
 
-    int const pid = fork();
+    interface_tester_kill_process(proc);
 
-    if (pid < 0)
+    if (!process_output_start(proc, &output_fd))
     {
         success = false;
         goto done;
     }
 
-    if (!pid) /* Child process. */
-    {
-        if (working_dir != NULL)
-        {
-            if (chdir(working_dir) < 0)
-            {
-                DLOG("chdir to: %s failed: %s",
-                     working_dir, strerror(errno)); _exit(EXIT_FAILURE);
-            }
-        }
-        redirect_fd(-1, STDIN_FILENO, O_RDONLY);
-        redirect_fd(-1, STDOUT_FILENO, O_WRONLY);
-        redirect_fd(-1, STDERR_FILENO, O_WRONLY);
+    uint64_t const started_usecs = monotonic_usecs();
+    pid_t const pid =
+        spawn_process(SPAWN_METHOD_DEFAULT, argv, dir_fd, exec_fd, output_fd, &pidfd);
 
-        char * env[1] = { NULL };
+    /* The child has its own copy of the write end, if it started. */
+    if (output_fd >= 0)
+    {
+        close(output_fd);
+    }
 
-        execvpe(argv[0], (char **)argv, env);
+    if (pid < 0)
+    {
+        process_output_stop(proc);
 
-        _exit(127);
+        success = false;
+        goto done;
     }
 
-    proc->uloop.cb = interface_tester_process_cb;
-    proc->uloop.pid = pid;
-    uloop_process_add(&proc->uloop);
+    proc->pid_ = pid;
+    proc->started_usecs_ = started_usecs;
+    proc->pidfd_.fd = pidfd;
+    proc->pidfd_.cb = interface_tester_process_cb;
+    uloop_fd_add(&proc->pidfd_, ULOOP_READ);
+    if (proc->capturing_output_)
+    {
+        uloop_fd_add(&proc->output_fd_, ULOOP_READ);
+    }
 
     success = true;
 
 done:
     return success;
 }
-
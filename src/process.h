@@ -1,24 +1,68 @@
 #pragma once
 
+#include "output_buffer.h"
+
 #include <libubox/uloop.h>
 #include <libubox/blob.h>
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct tester_process_st tester_process_st;
 
-typedef void (*tester_process_cb)(tester_process_st * proc, int status);
+/* The resources used by a process that has exited. */
+typedef struct process_usage_st
+{
+    uint64_t wall_usecs; /* From when the process was started until it exited. */
+    uint64_t user_usecs;
+    uint64_t system_usecs;
+    uint64_t max_rss_kb;
+} process_usage_st;
+
+typedef void (*tester_process_cb)(
+    tester_process_st * proc, int status, process_usage_st const * usage);
 
 struct tester_process_st
 {
-    struct uloop_process uloop;
+    /* Users should not access these fields directly. */
+    struct uloop_fd pidfd_;
+    struct uloop_fd output_fd_;
+    bool capturing_output_;
+    size_t captured_bytes_;
+    uint64_t started_usecs_;
+    pid_t pid_;
+
     tester_process_cb cb; /* Called when the process exits. */
+
+    /*
+     * If not NULL (and enabled), the stdout and stderr of the process are
+     * captured to this buffer.
+     */
+    output_buffer_st * output;
+    /*
+     * The most of the process's output that is kept in the buffer, which may
+     * be shared with other processes.
+     */
+    size_t output_limit;
 };
 
+bool
+interface_tester_process_is_running(tester_process_st const * proc);
+
+pid_t
+interface_tester_process_pid(tester_process_st const * proc);
+
+/*
+ * Kill the process along with any processes it has started. The callback
+ * isn't called.
+ */
 void
 interface_tester_kill_process(tester_process_st * proc);
 
+/*
+ * Start the executable exec_fd (an O_PATH descriptor) from within the
+ * directory dir_fd.
+ */
 bool
 interface_tester_start_process(
-    tester_process_st * proc, char * * argv, char const * working_dir);
-
+    tester_process_st * proc, char * * argv, int dir_fd, int exec_fd);
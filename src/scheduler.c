@@ -0,0 +1,414 @@
+#include "scheduler.h"
+#include "debug.h"
+#include "utils.h"
+
+#include <time.h>
+
+#ifdef DEBUG
+#include <assert.h>
+#endif
+
+/*
+ * Recovery tasks are started ahead of tests as they are only run once an
+ * interface is already known to be broken.
+ */
+static scheduler_class_t const dispatch_order[SCHEDULER_CLASS_COUNT__] =
+{
+    SCHEDULER_CLASS_RECOVERY,
+    SCHEDULER_CLASS_TEST,
+};
+
+char const *
+scheduler_class_to_str(scheduler_class_t const scheduler_class)
+{
+    static char const * classes[SCHEDULER_CLASS_COUNT__] =
+    {
+    [SCHEDULER_CLASS_TEST] = "tests",
+    [SCHEDULER_CLASS_RECOVERY] = "recovery_tasks",
+    };
+
+#ifdef DEBUG
+    assert(scheduler_class < ARRAY_SIZE(classes));
+    assert(classes[scheduler_class] != NULL);
+#endif
+
+    return classes[scheduler_class];
+}
+
+static uint64_t
+monotonic_msecs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void
+wait_stats_update(scheduler_wait_stats_st * const stats, uint64_t const wait_msecs)
+{
+    stats->waits++;
+    stats->total_wait_msecs += wait_msecs;
+    if (wait_msecs > stats->max_wait_msecs)
+    {
+        stats->max_wait_msecs = wait_msecs;
+    }
+}
+
+static bool
+scheduler_has_capacity(
+    scheduler_st const * const scheduler, scheduler_class_t const scheduler_class)
+{
+    unsigned int const class_max = scheduler->class_max_running_[scheduler_class];
+
+    return (scheduler->max_running_ == 0 || scheduler->running_ < scheduler->max_running_)
+        && (class_max == 0 || scheduler->class_running_[scheduler_class] < class_max);
+}
+
+static void
+request_mark_running(scheduler_request_st * const request)
+{
+    scheduler_st * const scheduler = request->client_->scheduler_;
+
+    request->is_running_ = true;
+    scheduler->running_++;
+    scheduler->class_running_[request->class_]++;
+}
+
+static void
+request_dequeue(scheduler_request_st * const request)
+{
+    scheduler_client_st * const client = request->client_;
+    scheduler_st * const scheduler = client->scheduler_;
+    scheduler_class_t const scheduler_class = request->class_;
+
+    list_del(&request->list_);
+    request->is_queued_ = false;
+    client->queued_[scheduler_class]--;
+    scheduler->queued_[scheduler_class]--;
+
+    if (client->queued_[scheduler_class] == 0)
+    {
+        list_del_init(&client->ready_node_[scheduler_class]);
+    }
+}
+
+static scheduler_request_st *
+next_request(scheduler_st * const scheduler, scheduler_class_t const scheduler_class)
+{
+    scheduler_request_st * request = NULL;
+
+    for (size_t i = ARRAY_SIZE(scheduler->ready_[scheduler_class]); i-- > 0;)
+    {
+        struct list_head * const ready = &scheduler->ready_[scheduler_class][i];
+
+        if (list_empty(ready))
+        {
+            continue;
+        }
+
+        scheduler_client_st * const client =
+            list_first_entry(ready, scheduler_client_st, ready_node_[scheduler_class]);
+
+        request =
+            list_first_entry(&client->queue_[scheduler_class], scheduler_request_st, list_);
+        request_dequeue(request);
+
+        /* Give the other clients with this priority a turn first. */
+        if (client->queued_[scheduler_class] > 0)
+        {
+            list_move_tail(&client->ready_node_[scheduler_class], ready);
+        }
+        break;
+    }
+
+    return request;
+}
+
+static void
+dispatch_timer_expired(timer_st * const t)
+{
+    scheduler_st * const scheduler = container_of(t, scheduler_st, dispatch_timer_);
+    bool dispatched;
+
+    do
+    {
+        dispatched = false;
+
+        for (size_t i = 0; i < ARRAY_SIZE(dispatch_order); i++)
+        {
+            scheduler_class_t const scheduler_class = dispatch_order[i];
+
+            if (!scheduler_has_capacity(scheduler, scheduler_class))
+            {
+                continue;
+            }
+
+            scheduler_request_st * const request = next_request(scheduler, scheduler_class);
+
+            if (request == NULL)
+            {
+                continue;
+            }
+
+            uint64_t const wait_msecs = monotonic_msecs() - request->queued_at_msecs_;
+
+            wait_stats_update(&request->client_->wait_stats_, wait_msecs);
+            wait_stats_update(&scheduler->wait_stats_, wait_msecs);
+
+            DLOG("%s: starting queued %s request after %" PRIu64 " msecs",
+                 __func__, scheduler_class_to_str(scheduler_class), wait_msecs);
+
+            /*
+             * The start callback may release this or other requests, or queue
+             * new ones, so the loop re-checks everything after each start.
+             */
+            request_mark_running(request);
+            request->start(request);
+            dispatched = true;
+        }
+    } while (dispatched);
+}
+
+static void
+scheduler_kick(scheduler_st * const scheduler)
+{
+    bool have_queued_requests = false;
+
+    for (size_t i = 0; i < SCHEDULER_CLASS_COUNT__; i++)
+    {
+        have_queued_requests = have_queued_requests || scheduler->queued_[i] > 0;
+    }
+
+    /*
+     * Queued requests are started from a timer callback so that they never
+     * start from within the callbacks of another interface.
+     */
+    if (have_queued_requests && !timer_is_running(&scheduler->dispatch_timer_))
+    {
+        timer_start(&scheduler->dispatch_timer_, 0);
+    }
+}
+
+void
+scheduler_init(scheduler_st * const scheduler)
+{
+    for (size_t i = 0; i < SCHEDULER_CLASS_COUNT__; i++)
+    {
+        for (size_t j = 0; j < ARRAY_SIZE(scheduler->ready_[i]); j++)
+        {
+            INIT_LIST_HEAD(&scheduler->ready_[i][j]);
+        }
+    }
+    timer_init(&scheduler->dispatch_timer_, "scheduler_dispatch_timer", dispatch_timer_expired);
+}
+
+void
+scheduler_cleanup(scheduler_st * const scheduler)
+{
+    timer_stop(&scheduler->dispatch_timer_);
+}
+
+void
+scheduler_set_limit(scheduler_st * const scheduler, unsigned int const max_running)
+{
+    scheduler->max_running_ = max_running;
+    scheduler_kick(scheduler);
+}
+
+void
+scheduler_set_class_limit(
+    scheduler_st * const scheduler,
+    scheduler_class_t const scheduler_class,
+    unsigned int const max_running)
+{
+    scheduler->class_max_running_[scheduler_class] = max_running;
+    scheduler_kick(scheduler);
+}
+
+unsigned int
+scheduler_limit(scheduler_st const * const scheduler)
+{
+    return scheduler->max_running_;
+}
+
+unsigned int
+scheduler_class_limit(
+    scheduler_st const * const scheduler, scheduler_class_t const scheduler_class)
+{
+    return scheduler->class_max_running_[scheduler_class];
+}
+
+unsigned int
+scheduler_class_running(
+    scheduler_st const * const scheduler, scheduler_class_t const scheduler_class)
+{
+    return scheduler->class_running_[scheduler_class];
+}
+
+size_t
+scheduler_class_queued(
+    scheduler_st const * const scheduler, scheduler_class_t const scheduler_class)
+{
+    return scheduler->queued_[scheduler_class];
+}
+
+scheduler_wait_stats_st const *
+scheduler_wait_stats(scheduler_st const * const scheduler)
+{
+    return &scheduler->wait_stats_;
+}
+
+void
+scheduler_client_init(scheduler_client_st * const client, scheduler_st * const scheduler)
+{
+    client->scheduler_ = scheduler;
+    client->priority_ = 0;
+    for (size_t i = 0; i < SCHEDULER_CLASS_COUNT__; i++)
+    {
+        INIT_LIST_HEAD(&client->queue_[i]);
+        INIT_LIST_HEAD(&client->ready_node_[i]);
+        client->queued_[i] = 0;
+    }
+}
+
+void
+scheduler_client_cleanup(scheduler_client_st * const client)
+{
+    if (client->scheduler_ == NULL)
+    {
+        goto done;
+    }
+
+    for (size_t i = 0; i < SCHEDULER_CLASS_COUNT__; i++)
+    {
+        while (!list_empty(&client->queue_[i]))
+        {
+            request_dequeue(
+                list_first_entry(&client->queue_[i], scheduler_request_st, list_));
+        }
+    }
+
+done:
+    return;
+}
+
+void
+scheduler_client_set_priority(
+    scheduler_client_st * const client, unsigned int const priority)
+{
+    scheduler_st * const scheduler = client->scheduler_;
+
+    client->priority_ = priority > SCHEDULER_PRIORITY_MAX ? SCHEDULER_PRIORITY_MAX : priority;
+
+    for (size_t i = 0; i < SCHEDULER_CLASS_COUNT__; i++)
+    {
+        if (client->queued_[i] > 0)
+        {
+            list_move_tail(&client->ready_node_[i], &scheduler->ready_[i][client->priority_]);
+        }
+    }
+}
+
+unsigned int
+scheduler_client_priority(scheduler_client_st const * const client)
+{
+    return client->priority_;
+}
+
+size_t
+scheduler_client_queued(
+    scheduler_client_st const * const client, scheduler_class_t const scheduler_class)
+{
+    return client->queued_[scheduler_class];
+}
+
+scheduler_wait_stats_st const *
+scheduler_client_wait_stats(scheduler_client_st const * const client)
+{
+    return &client->wait_stats_;
+}
+
+void
+scheduler_request_init(
+    scheduler_request_st * const request,
+    scheduler_client_st * const client,
+    scheduler_class_t const scheduler_class,
+    scheduler_start_fn const start)
+{
+    request->client_ = client;
+    request->class_ = scheduler_class;
+    request->is_queued_ = false;
+    request->is_running_ = false;
+    request->start = start;
+}
+
+bool
+scheduler_acquire(scheduler_request_st * const request)
+{
+    scheduler_client_st * const client = request->client_;
+    scheduler_st * const scheduler = client->scheduler_;
+    scheduler_class_t const scheduler_class = request->class_;
+    bool may_start;
+
+    /* Shouldn't happen. */
+    if (request->is_queued_ || request->is_running_)
+    {
+#ifdef DEBUG
+        assert(false);
+#endif
+        may_start = request->is_running_;
+        goto done;
+    }
+
+    /* Don't jump ahead of requests that are already waiting. */
+    if (scheduler->queued_[scheduler_class] == 0
+        && scheduler_has_capacity(scheduler, scheduler_class))
+    {
+        request_mark_running(request);
+        may_start = true;
+        goto done;
+    }
+
+    request->is_queued_ = true;
+    request->queued_at_msecs_ = monotonic_msecs();
+    list_add_tail(&request->list_, &client->queue_[scheduler_class]);
+    if (client->queued_[scheduler_class] == 0)
+    {
+        list_add_tail(
+            &client->ready_node_[scheduler_class],
+            &scheduler->ready_[scheduler_class][client->priority_]);
+    }
+    client->queued_[scheduler_class]++;
+    scheduler->queued_[scheduler_class]++;
+
+    may_start = false;
+
+done:
+    return may_start;
+}
+
+void
+scheduler_release(scheduler_request_st * const request)
+{
+    if (request->is_queued_)
+    {
+        request_dequeue(request);
+    }
+    else if (request->is_running_)
+    {
+        scheduler_st * const scheduler = request->client_->scheduler_;
+
+        request->is_running_ = false;
+        scheduler->running_--;
+        scheduler->class_running_[request->class_]--;
+        scheduler_kick(scheduler);
+    }
+}
+
+bool
+scheduler_request_is_queued(scheduler_request_st const * const request)
+{
+    return request->is_queued_;
+}
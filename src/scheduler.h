@@ -0,0 +1,157 @@
+#pragma once
+
+#include "timers.h"
+
+#include <libubox/list.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Limits the number of child processes (tests and recovery tasks) that run at
+ * once. Requests that can't start straight away are queued. Each interface
+ * (client) has its own FIFO queue. Queued requests are started from the
+ * highest priority clients first, and in round-robin order among clients with
+ * the same priority.
+ */
+
+typedef enum scheduler_class_t
+{
+    SCHEDULER_CLASS_TEST,
+    SCHEDULER_CLASS_RECOVERY,
+    SCHEDULER_CLASS_COUNT__,
+} scheduler_class_t;
+
+/* Priorities run from 0 (the default) to SCHEDULER_PRIORITY_MAX (highest). */
+#define SCHEDULER_PRIORITY_MAX 7
+
+typedef struct scheduler_wait_stats_st
+{
+    uint64_t waits; /* The number of requests that had to be queued. */
+    uint64_t total_wait_msecs;
+    uint64_t max_wait_msecs;
+} scheduler_wait_stats_st;
+
+typedef struct scheduler_st scheduler_st;
+typedef struct scheduler_client_st scheduler_client_st;
+typedef struct scheduler_request_st scheduler_request_st;
+
+typedef void (*scheduler_start_fn)(scheduler_request_st * request);
+
+struct scheduler_request_st
+{
+    /* Users should not access these fields directly. */
+    struct list_head list_;
+    scheduler_client_st * client_;
+    scheduler_class_t class_;
+    bool is_queued_;
+    bool is_running_;
+    uint64_t queued_at_msecs_;
+
+    /*
+     * Called when a queued request is allowed to start. The request is already
+     * counted as running when this is called.
+     */
+    scheduler_start_fn start;
+};
+
+struct scheduler_client_st
+{
+    /* Users should not access these fields directly. */
+    scheduler_st * scheduler_;
+    unsigned int priority_;
+    struct list_head queue_[SCHEDULER_CLASS_COUNT__];
+    struct list_head ready_node_[SCHEDULER_CLASS_COUNT__];
+    size_t queued_[SCHEDULER_CLASS_COUNT__];
+    scheduler_wait_stats_st wait_stats_;
+};
+
+struct scheduler_st
+{
+    /* Users should not access these fields directly. */
+    unsigned int max_running_; /* 0 means no limit. */
+    unsigned int class_max_running_[SCHEDULER_CLASS_COUNT__];
+    unsigned int running_;
+    unsigned int class_running_[SCHEDULER_CLASS_COUNT__];
+    size_t queued_[SCHEDULER_CLASS_COUNT__];
+    struct list_head ready_[SCHEDULER_CLASS_COUNT__][SCHEDULER_PRIORITY_MAX + 1];
+    timer_st dispatch_timer_;
+    scheduler_wait_stats_st wait_stats_;
+};
+
+char const *
+scheduler_class_to_str(scheduler_class_t scheduler_class);
+
+void
+scheduler_init(scheduler_st * scheduler);
+
+void
+scheduler_cleanup(scheduler_st * scheduler);
+
+/* A limit of 0 means no limit. */
+void
+scheduler_set_limit(scheduler_st * scheduler, unsigned int max_running);
+
+void
+scheduler_set_class_limit(
+    scheduler_st * scheduler, scheduler_class_t scheduler_class, unsigned int max_running);
+
+unsigned int
+scheduler_limit(scheduler_st const * scheduler);
+
+unsigned int
+scheduler_class_limit(scheduler_st const * scheduler, scheduler_class_t scheduler_class);
+
+unsigned int
+scheduler_class_running(scheduler_st const * scheduler, scheduler_class_t scheduler_class);
+
+size_t
+scheduler_class_queued(scheduler_st const * scheduler, scheduler_class_t scheduler_class);
+
+scheduler_wait_stats_st const *
+scheduler_wait_stats(scheduler_st const * scheduler);
+
+void
+scheduler_client_init(scheduler_client_st * client, scheduler_st * scheduler);
+
+/* Cancels any queued requests. */
+void
+scheduler_client_cleanup(scheduler_client_st * client);
+
+void
+scheduler_client_set_priority(scheduler_client_st * client, unsigned int priority);
+
+unsigned int
+scheduler_client_priority(scheduler_client_st const * client);
+
+size_t
+scheduler_client_queued(
+    scheduler_client_st const * client, scheduler_class_t scheduler_class);
+
+scheduler_wait_stats_st const *
+scheduler_client_wait_stats(scheduler_client_st const * client);
+
+void
+scheduler_request_init(
+    scheduler_request_st * request,
+    scheduler_client_st * client,
+    scheduler_class_t scheduler_class,
+    scheduler_start_fn start);
+
+/*
+ * Returns true if the request may start now. Otherwise the request is queued
+ * and its start callback is called once it may start.
+ */
+bool
+scheduler_acquire(scheduler_request_st * request);
+
+/*
+ * Called once a running request has completed, or to cancel a queued request.
+ * Does nothing if the request is neither queued nor running.
+ */
+void
+scheduler_release(scheduler_request_st * request);
+
+bool
+scheduler_request_is_queued(scheduler_request_st const * request);
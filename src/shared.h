@@ -1,5 +1,12 @@
 #pragma once
 
+#include "config_definitions.h"
+#include "config_source.h"
+#include "config_watcher.h"
+#include "event_batcher.h"
+#include "exec_cache.h"
+#include "scheduler.h"
+
 #include <libubox/vlist.h>
 
 #include <libubus.h>
@@ -11,8 +18,30 @@ typedef struct interface_tester_shared_st
     struct ubus_auto_conn ubus_conn;
     struct ubus_event_handler interface_events;
     struct ubus_event_handler interface_state_events;
-    char const * test_directory;
-    char const * recovery_directory;
-    char const * config_file;
+    struct ubus_event_handler object_events;
+    uint32_t network_interface_id; /* netifd's network.interface object. 0 if unknown. */
+    event_batcher_st event_batcher; /* Operational and test run events. */
+    struct list_head config_sources; /* Highest precedence first. */
+    config_source_st config_source; /* The configuration file and ubus. */
+    config_source_st ubus_source; /* Interfaces set one at a time over ubus. */
+    config_watcher_st config_watcher;
+    size_t output_buffer_size; /* Per interface. 0 if output isn't captured. */
+    /* Defaults for interfaces that don't configure these. */
+    uint32_t interval_jitter_percent;
+    bool phase_spreading;
+    /*
+     * Whether each interface gets its own ubus object. Interfaces can always be
+     * reached through the interface argument of the main object's methods.
+     */
+    bool interface_objects;
+    uint32_t settle_sequence; /* Incremented each time an interface settles. */
+    /* Incremented each time the state of an interface changes. */
+    uint64_t state_generation;
+    /* The state generation when an interface was last added or removed. */
+    uint64_t membership_generation;
+    uint32_t next_interface_id;
+    scheduler_st scheduler;
+    exec_cache_st exec_cache;
+    config_definitions_st definitions;
 } interface_tester_shared_st;
 
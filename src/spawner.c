@@ -0,0 +1,238 @@
+#include "spawner.h"
+#include "debug.h"
+#include "utils.h"
+
+#include <linux/sched.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef DEBUG
+#include <assert.h>
+#endif
+
+/*
+ * Stack used by children started with vfork semantics. The daemon is
+ * suspended until the child execs or exits, so one stack can be reused for
+ * every child.
+ */
+#define VFORK_CHILD_STACK_SIZE (64 * 1024)
+
+typedef struct spawn_request_st
+{
+    char * const * argv;
+    int dir_fd;
+    int exec_fd;
+    int output_fd;
+    sigset_t const * sigmask;
+} spawn_request_st;
+
+static char const dev_null[] = "/dev/null";
+
+char const *
+spawn_method_to_str(spawn_method_t const method)
+{
+    static char const * methods[SPAWN_METHOD_COUNT__] =
+    {
+    [SPAWN_METHOD_FORK] = "fork",
+    [SPAWN_METHOD_VFORK] = "vfork",
+    };
+
+#ifdef DEBUG
+    assert(method < ARRAY_SIZE(methods));
+    assert(methods[method] != NULL);
+#endif
+
+    return methods[method];
+}
+
+static void
+redirect_fd(int const from, int const to, int const o_flag)
+{
+    int const fd = (from != -1) ? from : open(dev_null, o_flag);
+
+    if (fd > -1)
+    {
+        TEMP_FAILURE_RETRY(dup2(fd, to));
+        /* The caller's descriptor is closed on exec. */
+        if (from == -1)
+        {
+            close(fd);
+        }
+    }
+}
+
+static void
+reset_signal_handlers(void)
+{
+    /*
+     * Handlers installed by the daemon mustn't run in a child that shares the
+     * daemon's memory, so restore them to the default before signals are
+     * unblocked again.
+     */
+    for (int sig = 1; sig < NSIG; sig++)
+    {
+        struct sigaction sa;
+
+        if (sigaction(sig, NULL, &sa) == 0
+            && sa.sa_handler != SIG_DFL
+            && sa.sa_handler != SIG_IGN)
+        {
+            sa.sa_handler = SIG_DFL;
+            sa.sa_flags = 0;
+            sigaction(sig, &sa, NULL);
+        }
+    }
+}
+
+static int
+exec_child(void * const arg)
+{
+    /*
+     * Note that with vfork semantics this runs in the daemon's memory, so it
+     * must restrict itself to plain system calls (no logging, no allocation).
+     */
+    spawn_request_st const * const request = arg;
+
+    reset_signal_handlers();
+    sigprocmask(SIG_SETMASK, request->sigmask, NULL);
+
+    setpgid(0, 0);
+    if (request->dir_fd >= 0 && fchdir(request->dir_fd) < 0)
+    {
+        _exit(EXIT_FAILURE);
+    }
+    redirect_fd(-1, STDIN_FILENO, O_RDONLY);
+    redirect_fd(request->output_fd, STDOUT_FILENO, O_WRONLY);
+    redirect_fd(request->output_fd, STDERR_FILENO, O_WRONLY);
+
+    char * env[1] = { NULL };
+
+    if (request->exec_fd >= 0)
+    {
+        /*
+         * The interpreter of a script is passed /dev/fd/<n> as the script to
+         * run, so the descriptor mustn't be closed on exec. dup() gives a copy
+         * without O_CLOEXEC.
+         */
+        int const exec_fd = dup(request->exec_fd);
+
+        syscall(SYS_execveat, exec_fd, "", request->argv, env, AT_EMPTY_PATH);
+    }
+    else
+    {
+        execvpe(request->argv[0], request->argv, env);
+    }
+
+    _exit(127);
+}
+
+static pid_t
+spawn_with_fork(spawn_request_st const * const request, int * const pidfd)
+{
+    /*
+     * clone3() rather than fork() so that the child is created with a pidfd
+     * and without an exit signal. This keeps the child away from uloop's
+     * SIGCHLD handler, which would otherwise reap it.
+     */
+    struct clone_args args =
+    {
+        .flags = CLONE_PIDFD,
+        .pidfd = (uintptr_t)pidfd,
+        .exit_signal = 0,
+    };
+    pid_t const pid = syscall(SYS_clone3, &args, sizeof(args));
+
+    if (pid == 0) /* Child process. */
+    {
+        exec_child(UNCONST(spawn_request_st, request));
+    }
+
+    return pid;
+}
+
+static pid_t
+spawn_with_vfork(spawn_request_st const * const request, int * const pidfd)
+{
+    static char child_stack[VFORK_CHILD_STACK_SIZE] __attribute__((aligned(16)));
+
+    /* An exit signal of 0, as with spawn_with_fork(). */
+    return clone(
+        exec_child,
+        child_stack + sizeof(child_stack),
+        CLONE_VM | CLONE_VFORK | CLONE_PIDFD,
+        UNCONST(spawn_request_st, request),
+        pidfd);
+}
+
+pid_t
+spawn_process(
+    spawn_method_t const method,
+    char * const * const argv,
+    int const dir_fd,
+    int const exec_fd,
+    int const output_fd,
+    int * const pidfd)
+{
+    pid_t pid;
+    sigset_t all_signals;
+    sigset_t sigmask;
+
+    /*
+     * Block signals until the child has reset its signal handlers. The child
+     * restores the original mask before exec'ing.
+     */
+    sigfillset(&all_signals);
+    sigprocmask(SIG_SETMASK, &all_signals, &sigmask);
+
+    spawn_request_st const request =
+    {
+        .argv = argv,
+        .dir_fd = dir_fd,
+        .exec_fd = exec_fd,
+        .output_fd = output_fd,
+        .sigmask = &sigmask,
+    };
+
+    switch (method)
+    {
+    case SPAWN_METHOD_FORK:
+        pid = spawn_with_fork(&request, pidfd);
+        break;
+
+    case SPAWN_METHOD_VFORK:
+        pid = spawn_with_vfork(&request, pidfd);
+        break;
+
+    default:
+        /* Shouldn't happen. */
+#ifdef DEBUG
+        assert(false);
+#endif
+        pid = -1;
+        break;
+    }
+
+    if (pid < 0)
+    {
+        DLOG("failed to %s: %s: %s",
+             spawn_method_to_str(method), argv[0], strerror(errno));
+    }
+    else
+    {
+        /*
+         * Also set the process group from the parent so that it is in place
+         * before this returns, however the child is scheduled. This fails
+         * harmlessly if the child has already exec'd.
+         */
+        setpgid(pid, pid);
+    }
+
+    sigprocmask(SIG_SETMASK, &sigmask, NULL);
+
+    return pid;
+}
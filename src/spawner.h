@@ -0,0 +1,47 @@
+#pragma once
+
+#include "configure.h"
+
+#include <sys/types.h>
+
+typedef enum spawn_method_t
+{
+    /* fork() a copy of the daemon, then exec the executable in the child. */
+    SPAWN_METHOD_FORK,
+    /*
+     * clone(CLONE_VM | CLONE_VFORK) the child so that the daemon's page tables
+     * aren't copied. The daemon is suspended until the child has exec'd.
+     */
+    SPAWN_METHOD_VFORK,
+    SPAWN_METHOD_COUNT__, /* Must be last in the list. */
+} spawn_method_t;
+
+#if WITH_VFORK_SPAWN
+#define SPAWN_METHOD_DEFAULT SPAWN_METHOD_VFORK
+#else
+#define SPAWN_METHOD_DEFAULT SPAWN_METHOD_FORK
+#endif
+
+char const *
+spawn_method_to_str(spawn_method_t method);
+
+/*
+ * Start a child process executing exec_fd (an O_PATH descriptor), or argv[0]
+ * from the PATH if exec_fd is -1. The child runs in the directory dir_fd
+ * (if not -1), with stdin redirected to /dev/null and an empty environment. stdout
+ * and stderr are redirected to output_fd, or to /dev/null if output_fd is -1.
+ * The child is the leader of a new process group so that any processes it
+ * starts can be killed along with it.
+ * The child doesn't signal SIGCHLD when it exits. Instead, *pidfd is set to a
+ * pidfd that becomes readable when the child exits. The caller is responsible
+ * for reaping the child (waitpid() with __WALL) and closing the pidfd.
+ * Returns the pid of the child, or -1 if the child couldn't be started.
+ */
+pid_t
+spawn_process(
+    spawn_method_t method,
+    char * const * argv,
+    int dir_fd,
+    int exec_fd,
+    int output_fd,
+    int * pidfd);
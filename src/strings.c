@@ -4,6 +4,7 @@ char const Sconfig[] = "config";
 char const Stests[] = "tests";
 char const Srecovery_tasks[] = "recovery_tasks";
 char const Sexecutable[] = "executable";
+char const Stype[] = "type";
 char const Slabel[] = "label";
 char const Sresponse_timeout_secs[] = "response_timeout_secs";
 char const Sparams[] = "params";
@@ -13,6 +14,12 @@ char const Spassing_interval_secs[] = "passing_interval_secs";
 char const Sfailing_interval_secs[] = "failing_interval_secs";
 char const Spass_threshold[] = "pass_threshold";
 char const Sfail_threshold[] = "fail_threshold";
+char const Sparallel_tests[] = "parallel_tests";
+char const Sscheduler_priority[] = "scheduler_priority";
+char const Sinterval_jitter_percent[] = "interval_jitter_percent";
+char const Sphase_spreading[] = "phase_spreading";
+char const Sprofile[] = "profile";
+char const Sprofiles[] = "profiles";
 #if WITH_METRICS_ADJUSTMENT
 char const Sfailing_tests_metrics_increase[] = "failing_tests_metrics_increase";
 #endif
@@ -6,6 +6,7 @@ extern char const Sconfig[];
 extern char const Stests[];
 extern char const Srecovery_tasks[];
 extern char const Sexecutable[];
+extern char const Stype[];
 extern char const Slabel[];
 extern char const Sresponse_timeout_secs[];
 extern char const Sparams[];
@@ -15,6 +16,12 @@ extern char const Spassing_interval_secs[];
 extern char const Sfailing_interval_secs[];
 extern char const Spass_threshold[];
 extern char const Sfail_threshold[];
+extern char const Sparallel_tests[];
+extern char const Sscheduler_priority[];
+extern char const Sinterval_jitter_percent[];
+extern char const Sphase_spreading[];
+extern char const Sprofile[];
+extern char const Sprofiles[];
 #if WITH_METRICS_ADJUSTMENT
 extern char const Sfailing_tests_metrics_increase[];
 #endif
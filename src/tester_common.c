@@ -34,12 +34,21 @@ tester_event_to_str(tester_event_t const event)
     return events[event];
 }
 
-static void
-interface_tester_test_config_free(test_config_st * const test)
+char const *
+test_type_to_str(test_type_t const type)
 {
-    free_const(test->executable_name);
-    free_const(test->label);
-    free(test->params);
+    static char const * types[TEST_TYPE_COUNT__] =
+    {
+    [TEST_TYPE_EXECUTABLE] = "executable",
+    [TEST_TYPE_ICMP] = "icmp",
+    };
+
+#ifdef DEBUG
+    assert(type < ARRAY_SIZE(types));
+    assert(types[type] != NULL);
+#endif
+
+    return types[type];
 }
 
 static void
@@ -47,19 +56,13 @@ interface_tester_test_configs_free(interface_config_st * const config)
 {
     for (size_t i = 0; i < config->num_tests; i++)
     {
-        interface_tester_test_config_free(&config->tests[i]);
+        test_config_put(config->tests[i]);
     }
     config->num_tests = 0;
     free(config->tests);
     config->tests = NULL;
-}
-
-static void
-interface_tester_recovery_config_free(recovery_config_st * const recovery)
-{
-    free_const(recovery->executable_name);
-    free_const(recovery->label);
-    free(recovery->params);
+    free(config->test_stats);
+    config->test_stats = NULL;
 }
 
 static void
@@ -67,11 +70,13 @@ interface_tester_recovery_configs_free(interface_config_st * const config)
 {
     for (size_t i = 0; i < config->num_recoverys; i++)
     {
-        interface_tester_recovery_config_free(&config->recoverys[i]);
+        recovery_config_put(config->recoverys[i]);
     }
     config->num_recoverys = 0;
     free(config->recoverys);
     config->recoverys = NULL;
+    free(config->recovery_stats);
+    config->recovery_stats = NULL;
 }
 
 void
@@ -92,6 +97,8 @@ interface_tester_free(interface_st * const iface)
     ubus_remove_interface_object(iface);
     interface_tester_cleanup(iface);
     interface_tester_config_free(&iface->config);
+    free(iface->stats_snapshot.blob);
+    free(iface->config_snapshot.blob);
 
     free(iface);
 
@@ -99,6 +106,19 @@ done:
     return;
 }
 
+void
+interface_state_changed(interface_st * const iface)
+{
+    iface->state_generation = ++iface->ctx->state_generation;
+}
+
+void
+interface_config_changed(interface_st * const iface)
+{
+    interface_state_changed(iface);
+    iface->config_changed_generation = iface->state_generation;
+}
+
 struct interface_st *
 interface_tester_alloc(
     interface_tester_shared_st * const ctx, const char * const name)
@@ -109,6 +129,7 @@ interface_tester_alloc(
     iface = calloc_a(sizeof(*iface), &iface_name, strlen(name) + 1);
     iface->ctx = ctx;
     iface->name = strcpy(iface_name, name);
+    iface->id = ctx->next_interface_id++;
 
     interface_tester_initialise(iface);
 
@@ -1,9 +1,14 @@
 #pragma once
 
+#include "config_definitions.h"
 #include "configure.h"
 #include "event_queue.h"
+#include "execution_stats.h"
+#include "icmp_probe.h"
 #include "interface_tester_events.h"
+#include "metrics_adjuster.h"
 #include "process.h"
+#include "scheduler.h"
 #include "shared.h"
 #include "timers.h"
 
@@ -12,42 +17,6 @@
 
 extern const unsigned int msecs_per_sec;
 
-typedef struct test_config_st
-{
-    size_t index;
-    /*
-     * The name of the executable that will be called to execute the configured
-     * test.
-     */
-    char const * executable_name;
-    char const * label;
-
-    /*
-     * The default maximum time to wait for an individual test to complete.
-     * This overrides the default response timeout.
-     */
-    uint32_t response_timeout_secs;
-    struct blob_attr * params;
-} test_config_st;
-
-typedef struct recovery_config_st
-{
-    size_t index;
-    /*
-     * The name of the executable that will be called to execute the configured
-     * recovery task.
-     */
-    char const * executable_name;
-    char const * label;
-
-    /*
-     * The default maximum time to wait for an individual test to complete.
-     * This overrides the default response timeout.
-     */
-    uint32_t response_timeout_secs;
-    struct blob_attr * params;
-} recovery_config_st;
-
 typedef enum test_run_success_condition_t
 {
     test_run_success_condition_one, /* One test in the list of tests must pass. */
@@ -61,8 +30,37 @@ typedef struct success_condition_st
     test_run_success_condition_t condition;
 } success_condition_st;
 
+/*
+ * The ways in which a new configuration for an interface differs from the one
+ * it has, grouped by what has to be done for the change to take effect.
+ */
+typedef enum interface_config_change_t
+{
+    /* Re-arm the interval timer if the tester is sleeping. */
+    INTERFACE_CONFIG_CHANGE_INTERVALS = 1 << 0,
+    /* Check the test run counters against the new thresholds. */
+    INTERFACE_CONFIG_CHANGE_THRESHOLDS = 1 << 1,
+    /* Apply once any test run in progress has ended. */
+    INTERFACE_CONFIG_CHANGE_TESTS = 1 << 2,
+    /* Start again from the first recovery task. */
+    INTERFACE_CONFIG_CHANGE_RECOVERYS = 1 << 3,
+    INTERFACE_CONFIG_CHANGE_SCHEDULER_PRIORITY = 1 << 4,
+#if WITH_METRICS_ADJUSTMENT
+    /* Adjust the route metrics again if the interface is broken. */
+    INTERFACE_CONFIG_CHANGE_METRICS = 1 << 5,
+#endif
+    /* Nothing to do. The new value is used the next time it is needed. */
+    INTERFACE_CONFIG_CHANGE_OTHER = 1 << 6,
+} interface_config_change_t;
+
 typedef struct interface_config_st
 {
+    /*
+     * A hash of the configuration this was parsed from, so that an unchanged
+     * configuration can be recognised without parsing it again.
+     */
+    uint64_t content_hash;
+
     success_condition_st const * success_condition;
 
     /* Delay after interface connects before initiating a test run.  */
@@ -89,6 +87,30 @@ typedef struct interface_config_st
     /* The default maximum time to wait for an individual test to complete. */
     uint32_t response_timeout_secs;
 
+    /*
+     * Start all of the tests in a test run at once rather than one after
+     * another. The run ends as soon as its result is known.
+     */
+    bool parallel_tests;
+
+    /*
+     * The priority of this interface's queued tests and recovery tasks when
+     * the number of running processes is limited.
+     */
+    uint32_t scheduler_priority;
+
+    /*
+     * The test interval is varied at random by up to this percentage either
+     * way, so that interfaces don't stay in step with each other.
+     */
+    uint32_t interval_jitter_percent;
+
+    /*
+     * Delay the first test run after the interface settles so that the
+     * interfaces that settle together are spread across the test interval.
+     */
+    bool phase_spreading;
+
 #if WITH_METRICS_ADJUSTMENT
     /*
      * The amount by which to increase the metrics of routes attached to this
@@ -97,11 +119,14 @@ typedef struct interface_config_st
     uint32_t failing_tests_metrics_increase;
 #endif
 
+    /* The definitions are shared with any other interfaces that use them. */
     size_t num_tests;
-    test_config_st * tests;
+    test_config_st * * tests;
+    execution_stats_st * test_stats; /* Executable tests only. */
 
     size_t num_recoverys;
-    recovery_config_st * recoverys;
+    recovery_config_st * * recoverys;
+    execution_stats_st * recovery_stats;
 } interface_config_st;
 
 typedef enum interface_recovery_state_t
@@ -116,10 +141,13 @@ typedef struct interface_recovery_st
     interface_recovery_state_t state;
 #if WITH_METRICS_ADJUSTMENT
     bool metrics_are_adjusted;
+    metrics_adjuster_st metrics_adjuster;
 #endif
     timer_st response_timeout_timer;
     size_t recovery_index;
+    size_t task_index; /* The index of the running or queued task. */
     tester_process_st proc;
+    scheduler_request_st scheduler_request;
 } interface_recovery_st;
 
 typedef enum interface_connection_state_t
@@ -134,6 +162,25 @@ typedef struct interface_connection_st
 {
     interface_connection_state_t state;
     timer_st settling_delay_timer;
+
+    /* The order in which the interface last settled among all interfaces. */
+    uint32_t settle_sequence;
+
+    /* The L3 device reported by netifd. Empty if unknown. */
+    char device[IFNAMSIZ];
+
+    /*
+     * The request for the current state of the interface made when the tester
+     * begins. The connection state machine starts when the reply arrives, so
+     * the requests for all of the interfaces are outstanding at once.
+     */
+    struct ubus_request state_request;
+    timer_st state_request_timer;
+    bool state_request_pending;
+    bool state_request_is_up;
+    uint64_t state_request_started_msecs;
+    /* How long netifd took to reply. -1 until it has. */
+    int64_t state_discovery_msecs;
 } interface_connection_st;
 
 typedef enum interface_tester_state_t
@@ -148,6 +195,16 @@ typedef enum interface_tester_state_t
 typedef struct interface_tester_st interface_tester_st;
 typedef void (*tester_start_fn)(interface_tester_st * tester);
 
+typedef struct test_slot_st
+{
+    interface_tester_st * tester;
+    size_t test_index;
+    tester_process_st proc;
+    icmp_probe_st probe;
+    scheduler_request_st scheduler_request;
+    timer_st response_timeout_timer;
+} test_slot_st;
+
 typedef struct test_statistics_st
 {
     uint64_t total_passes_this_connection;
@@ -184,27 +241,78 @@ struct interface_tester_st
     interface_tester_state_t state;
     size_t test_index;
     tester_start_fn starter;
-    tester_process_st test_proc;
-    timer_st test_response_timeout_timer;
+
+    /*
+     * One slot for each configured test. Sequential test runs use the slot at
+     * test_index. Parallel test runs use all of them.
+     */
+    test_slot_st * test_slots;
+    size_t num_test_slots;
+
+    /*
+     * The results a parallel test run is still waiting for. A result is
+     * handled some time after its test completes, so a run can't tell from its
+     * slots alone whether results are still to come.
+     */
+    size_t results_outstanding;
+    /*
+     * Results that have been queued but not yet handled, and how many of those
+     * belong to tests that were cancelled. Those are ignored so that they
+     * aren't counted in a later run.
+     */
+    size_t results_queued;
+    size_t stale_results;
+
     timer_st test_interval_timer;
 
     int last_test_exit_code;
     bool last_test_passed;
 
+    /* The event being handled, or TESTER_EVENT_COUNT__ if none. */
+    tester_event_t current_event;
+
     tester_statistics_st stats;
 };
 
+/* A part of the state dump of an interface, kept until that part changes. */
+typedef struct state_snapshot_st
+{
+    struct blob_attr * blob; /* NULL if there isn't one. */
+    uint64_t generation; /* The generation it was built at. */
+    unsigned int exec_generation; /* Of the executable cache, for the config. */
+} state_snapshot_st;
+
 typedef struct interface_st
 {
     interface_tester_shared_st * ctx;
     struct vlist_node node;
     const char * name;
+    uint32_t id; /* Identifies the interface in the flight recorder. */
     struct ubus_object ubus_object;
     event_q_st event_queue;
+    scheduler_client_st scheduler_client;
+    output_buffer_st output; /* Recent output from tests and recovery tasks. */
     interface_config_st config;
+
+    /*
+     * A new configuration that changes the tests waits here for the test run
+     * in progress to end. pending_config_changes is 0 if there isn't one.
+     */
+    interface_config_st pending_config;
+    unsigned int pending_config_changes;
+
     interface_connection_st connection;
     interface_recovery_st recovery;
     interface_tester_st tester;
+
+    /*
+     * Taken from the shared state generation each time the state of the
+     * interface changes, other than the time left on its timers.
+     */
+    uint64_t state_generation;
+    uint64_t config_changed_generation;
+    state_snapshot_st stats_snapshot;
+    state_snapshot_st config_snapshot;
 } interface_st;
 
 void
@@ -216,6 +324,14 @@ interface_tester_free(interface_st * iface);
 interface_st *
 interface_tester_alloc(interface_tester_shared_st * ctx, const char * name);
 
+/* Record that the state of the interface has changed. */
+void
+interface_state_changed(interface_st * iface);
+
+/* As interface_state_changed(), for a change to the configuration. */
+void
+interface_config_changed(interface_st * iface);
+
 interface_st *
 interface_tester_lookup_by_name(
     interface_tester_shared_st * ctx, char const * interface_name);
@@ -226,3 +342,6 @@ interface_testers_free(struct vlist_tree * interfaces);
 char const *
 tester_event_to_str(tester_event_t event);
 
+char const *
+test_type_to_str(test_type_t type);
+
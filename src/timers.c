@@ -1,36 +1,350 @@
 #include "timers.h"
 #include "utils.h"
 
+#include <libubox/uloop.h>
+
+#include <limits.h>
+#include <time.h>
+
+/*
+ * The wheel has TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots. A slot
+ * on level 0 covers one millisecond, and a slot on each level above covers
+ * TIMER_WHEEL_SLOTS times as long as one on the level below. A timer is kept on
+ * the lowest level that can hold its expiry time, and is moved down a level
+ * (cascaded) when the wheel reaches its slot. Six levels of 64 slots cover
+ * more than the 49 days of a 32-bit millisecond timeout.
+ */
+#define TIMER_WHEEL_LEVELS 6
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+typedef struct timer_wheel_level_st
+{
+    struct list_head slots[TIMER_WHEEL_SLOTS];
+    uint64_t occupied; /* A bit for each slot that holds a timer. */
+} timer_wheel_level_st;
+
+typedef struct timer_wheel_st
+{
+    bool initialised;
+    uint64_t epoch_msecs;
+    uint64_t now; /* The last millisecond processed, relative to the epoch. */
+    timer_wheel_level_st levels[TIMER_WHEEL_LEVELS];
+    struct list_head due; /* Timers that expire before the next millisecond. */
+    struct uloop_timeout timeout;
+    uint64_t timeout_expires; /* When the uloop timeout is due, if pending. */
+} timer_wheel_st;
+
+static timer_wheel_st timer_wheel;
+
+static uint64_t
+monotonic_msecs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static uint64_t
+timer_wheel_current(timer_wheel_st const * const wheel)
+{
+    return monotonic_msecs() - wheel->epoch_msecs;
+}
+
+static unsigned int
+level_shift(unsigned int const level)
+{
+    return level * TIMER_WHEEL_SLOT_BITS;
+}
+
+static void timer_wheel_timeout_cb(struct uloop_timeout * t);
+
+static void
+timer_wheel_init(timer_wheel_st * const wheel)
+{
+    for (size_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        for (size_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+        {
+            INIT_LIST_HEAD(&wheel->levels[level].slots[slot]);
+        }
+    }
+    INIT_LIST_HEAD(&wheel->due);
+    wheel->timeout.cb = timer_wheel_timeout_cb;
+    wheel->epoch_msecs = monotonic_msecs();
+    wheel->initialised = true;
+}
+
+static void
+timer_wheel_schedule(timer_wheel_st * const wheel, uint64_t const expires)
+{
+    /*
+     * Only ever bring the uloop timeout forward. If it fires early because a
+     * timer was stopped it is simply set again.
+     */
+    if (wheel->timeout.pending && wheel->timeout_expires <= expires)
+    {
+        goto done;
+    }
+
+    uint64_t const current = timer_wheel_current(wheel);
+    uint64_t const delay = expires > current ? expires - current : 0;
+
+    wheel->timeout_expires = expires;
+    uloop_timeout_set(&wheel->timeout, delay < INT_MAX ? (int)delay : INT_MAX);
+
+done:
+    return;
+}
+
+static void
+timer_wheel_add(timer_wheel_st * const wheel, timer_st * const t)
+{
+    uint64_t const expires = t->expires_msecs_;
+
+    if (expires <= wheel->now)
+    {
+        /* Its slot has already been processed. */
+        t->level_ = -1;
+        list_add_tail(&t->list_, &wheel->due);
+        goto done;
+    }
+
+    uint64_t const delta = expires - wheel->now;
+    unsigned int level = 0;
+
+    while (level < TIMER_WHEEL_LEVELS - 1
+           && delta >= UINT64_C(1) << level_shift(level + 1))
+    {
+        level++;
+    }
+
+    timer_wheel_level_st * const wheel_level = &wheel->levels[level];
+    unsigned int const slot = (expires >> level_shift(level)) & TIMER_WHEEL_SLOT_MASK;
+
+    t->level_ = level;
+    t->slot_ = slot;
+    list_add_tail(&t->list_, &wheel_level->slots[slot]);
+    wheel_level->occupied |= UINT64_C(1) << slot;
+
+done:
+    return;
+}
+
+static void
+timer_wheel_remove(timer_wheel_st * const wheel, timer_st * const t)
+{
+    list_del_init(&t->list_);
+
+    /*
+     * A timer that has been taken off its slot to expire may still refer to
+     * it, but then the slot either has its bit cleared already, or holds other
+     * timers and keeps it.
+     */
+    if (t->level_ >= 0)
+    {
+        timer_wheel_level_st * const wheel_level = &wheel->levels[t->level_];
+
+        if (list_empty(&wheel_level->slots[t->slot_]))
+        {
+            wheel_level->occupied &= ~(UINT64_C(1) << t->slot_);
+        }
+    }
+}
+
+/*
+ * Returns the next millisecond after now at which something happens on the
+ * wheel: either a level 0 slot expires, or a slot on a higher level is
+ * cascaded. Returns false if the wheel is empty.
+ */
+static bool
+timer_wheel_next_event(timer_wheel_st const * const wheel, uint64_t * const next)
+{
+    uint64_t earliest = UINT64_MAX;
+
+    for (unsigned int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        uint64_t const occupied = wheel->levels[level].occupied;
+
+        if (occupied == 0)
+        {
+            continue;
+        }
+
+        /* Find the first occupied slot after the current one. */
+        unsigned int const shift = level_shift(level);
+        uint64_t const position = wheel->now >> shift;
+        unsigned int const current_slot = position & TIMER_WHEEL_SLOT_MASK;
+        unsigned int const rotation = (current_slot + 1) & TIMER_WHEEL_SLOT_MASK;
+        uint64_t const rotated =
+            rotation == 0 ? occupied : (occupied >> rotation) | (occupied << (64 - rotation));
+        uint64_t const event = (position + 1 + __builtin_ctzll(rotated)) << shift;
+
+        if (event < earliest)
+        {
+            earliest = event;
+        }
+    }
+
+    *next = earliest;
+
+    return earliest != UINT64_MAX;
+}
+
+static void
+timer_wheel_cascade(timer_wheel_st * const wheel, unsigned int const level)
+{
+    timer_wheel_level_st * const wheel_level = &wheel->levels[level];
+    unsigned int const slot = (wheel->now >> level_shift(level)) & TIMER_WHEEL_SLOT_MASK;
+    struct list_head timers;
+
+    INIT_LIST_HEAD(&timers);
+    list_splice_init(&wheel_level->slots[slot], &timers);
+    wheel_level->occupied &= ~(UINT64_C(1) << slot);
+
+    while (!list_empty(&timers))
+    {
+        timer_st * const t = list_first_entry(&timers, timer_st, list_);
+
+        list_del(&t->list_);
+        timer_wheel_add(wheel, t);
+    }
+}
+
+static void
+timer_wheel_expire(struct list_head * const due)
+{
+    struct list_head timers;
+
+    /*
+     * Timers started by the callbacks that are already due wait for the next
+     * loop iteration, as they would with uloop. Callbacks may also stop any of
+     * the timers still waiting to expire, so take them off one at a time.
+     */
+    INIT_LIST_HEAD(&timers);
+    list_splice_init(due, &timers);
+
+    while (!list_empty(&timers))
+    {
+        timer_st * const t = list_first_entry(&timers, timer_st, list_);
+
+        list_del_init(&t->list_);
+        t->pending_ = false;
+        t->cb_(t);
+    }
+}
+
+static void
+timer_wheel_advance(timer_wheel_st * const wheel, uint64_t const target)
+{
+    uint64_t next;
+
+    while (timer_wheel_next_event(wheel, &next) && next <= target)
+    {
+        wheel->now = next;
+
+        /* Higher levels first, as they may cascade into the slots below. */
+        for (unsigned int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+        {
+            if ((next & ((UINT64_C(1) << level_shift(level)) - 1)) == 0)
+            {
+                timer_wheel_cascade(wheel, level);
+            }
+        }
+
+        /* Whatever is in the current level 0 slot is now due. */
+        unsigned int const slot = next & TIMER_WHEEL_SLOT_MASK;
+
+        list_splice_tail_init(&wheel->levels[0].slots[slot], &wheel->due);
+        wheel->levels[0].occupied &= ~(UINT64_C(1) << slot);
+        timer_wheel_expire(&wheel->due);
+    }
+
+    if (target > wheel->now)
+    {
+        wheel->now = target;
+    }
+}
+
+static void
+timer_wheel_timeout_cb(struct uloop_timeout * const t)
+{
+    timer_wheel_st * const wheel = container_of(t, timer_wheel_st, timeout);
+    uint64_t next;
+
+    timer_wheel_expire(&wheel->due);
+    timer_wheel_advance(wheel, timer_wheel_current(wheel));
+
+    if (!list_empty(&wheel->due))
+    {
+        timer_wheel_schedule(wheel, wheel->now);
+    }
+    else if (timer_wheel_next_event(wheel, &next))
+    {
+        timer_wheel_schedule(wheel, next);
+    }
+}
+
 void
 timer_stop(timer_st * const t)
 {
-    uloop_timeout_cancel(&t->t_);
+    if (!t->pending_)
+    {
+        goto done;
+    }
+
+    timer_wheel_remove(&timer_wheel, t);
+    t->pending_ = false;
+
+done:
+    return;
 }
 
 void
 timer_start(timer_st * const t, uint32_t const timeout_msecs)
 {
-    uloop_timeout_set(&t->t_, (int)timeout_msecs);
+    timer_wheel_st * const wheel = &timer_wheel;
+
+    if (!wheel->initialised)
+    {
+        timer_wheel_init(wheel);
+    }
+
+    timer_stop(t);
+
+    t->expires_msecs_ = timer_wheel_current(wheel) + timeout_msecs;
+    t->pending_ = true;
+    timer_wheel_add(wheel, t);
+    timer_wheel_schedule(wheel, t->expires_msecs_);
 }
 
 bool
 timer_is_running(timer_st const * const t)
 {
-    return t->t_.pending;
+    return t->pending_;
 }
 
 uint64_t
 timer_remaining(timer_st const * const t)
 {
-    return uloop_timeout_remaining64(UNCONST(struct uloop_timeout, &t->t_));
-}
+    uint64_t remaining;
 
-static void
-timer_expired_cb(struct uloop_timeout * const t)
-{
-    timer_st * const timer = container_of(t, timer_st, t_);
+    if (!t->pending_)
+    {
+        /* As uloop_timeout_remaining64() reports for a timeout that isn't set. */
+        remaining = (uint64_t)-1;
+        goto done;
+    }
 
-    timer->cb_(timer);
+    uint64_t const current = timer_wheel_current(&timer_wheel);
+
+    remaining = t->expires_msecs_ > current ? t->expires_msecs_ - current : 0;
+
+done:
+    return remaining;
 }
 
 char const *
@@ -43,8 +357,8 @@ void
 timer_init(
     timer_st * const t, char const * const label, timer_expired_fn const expired_timer_cb)
 {
-    t->t_.cb = timer_expired_cb;
+    INIT_LIST_HEAD(&t->list_);
+    t->pending_ = false;
     t->label_ = label;
     t->cb_ = expired_timer_cb;
 }
-
@@ -1,16 +1,27 @@
 #pragma once
 
-#include <libubox/uloop.h>
+#include <libubox/list.h>
 
+#include <stdbool.h>
 #include <stdint.h>
 
+/*
+ * Timers are kept in a hierarchical timing wheel driven by a single uloop
+ * timeout, so starting and stopping a timer takes constant time however many
+ * timers are running.
+ */
+
 typedef struct timer_st timer_st;
 typedef void (*timer_expired_fn)(timer_st * t);
 
 struct timer_st
 {
     /* Users should not access the fields within this structure directly. */
-    struct uloop_timeout t_;
+    struct list_head list_;
+    uint64_t expires_msecs_;
+    int8_t level_; /* The wheel level holding the timer, or -1 if it is due. */
+    uint8_t slot_;
+    bool pending_;
     char const * label_;
     timer_expired_fn cb_;
 };
@@ -32,4 +43,3 @@ timer_label(timer_st const * t);
 
 void
 timer_init(timer_st * t, char const * label, timer_expired_fn expired_timer_cb);
-
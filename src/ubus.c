@@ -2,6 +2,7 @@
 #include "config.h"
 #include "debug.h"
 #include "dump.h"
+#include "flight_recorder.h"
 #include "interface_connection.h"
 #include "interface_tester.h"
 #include "tester_common.h"
@@ -13,6 +14,24 @@
 
 static int const UBUS_TIMEOUT_MS = 5000;
 
+/* Send an event about an interface, or add it to the batch being collected. */
+static void
+send_interface_event(
+    struct ubus_context * const ubus, char const * const event, struct blob_buf const * const b)
+{
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+
+    if (event_batcher_is_enabled(&ctx->event_batcher))
+    {
+        event_batcher_add(&ctx->event_batcher, event, b->head);
+    }
+    else
+    {
+        ubus_send_event(ubus, event, b->head);
+    }
+}
+
 void
 interface_tester_send_up_down_event(
     struct ubus_context * const ubus, bool const are_up)
@@ -50,7 +69,7 @@ ubus_send_interface_operational_event(
     blob_buf_init(&b, 0);
     blobmsg_add_u8(&b, "is_operational", is_operational);
     blobmsg_add_string(&b, "interface", interface_name);
-    ubus_send_event(ubus, "interface.tester.operational", b.head);
+    send_interface_event(ubus, "interface.tester.operational", &b);
     blob_buf_free(&b);
 
 done:
@@ -73,7 +92,94 @@ ubus_send_interface_test_run_event(
     blob_buf_init(&b, 0);
     blobmsg_add_string(&b, "result", test_run_passed ? "pass" : "fail");
     blobmsg_add_string(&b, "interface", interface_name);
-    ubus_send_event(ubus, "interface.tester.test_run", b.head);
+    send_interface_event(ubus, "interface.tester.test_run", &b);
+    blob_buf_free(&b);
+
+done:
+    return;
+}
+
+static struct ubus_object interface_tester_object;
+
+static char const * const notification_types[INTERFACE_NOTIFICATION_COUNT] =
+{
+    [INTERFACE_NOTIFICATION_CONNECTION] = "connection",
+    [INTERFACE_NOTIFICATION_TESTER] = "tester",
+    [INTERFACE_NOTIFICATION_RECOVERY] = "recovery",
+    [INTERFACE_NOTIFICATION_TEST_RUN] = "test_run",
+};
+
+static bool
+interface_has_subscribers(interface_st const * const iface)
+{
+    return interface_tester_object.has_subscribers
+           || (iface->ubus_object.name != NULL && iface->ubus_object.has_subscribers);
+}
+
+/*
+ * Notify the subscribers of the main object and of the interface's own object.
+ * The notifications aren't acknowledged, so nothing waits for the subscribers.
+ */
+static void
+notify_interface_subscribers(
+    interface_st * const iface,
+    interface_notification_t const type,
+    struct blob_buf const * const b)
+{
+    struct ubus_context * const ubus = &iface->ctx->ubus_conn.ctx;
+    int const no_reply = -1;
+
+    if (interface_tester_object.has_subscribers)
+    {
+        ubus_notify(ubus, &interface_tester_object, notification_types[type], b->head, no_reply);
+    }
+    if (iface->ubus_object.name != NULL && iface->ubus_object.has_subscribers)
+    {
+        ubus_notify(ubus, &iface->ubus_object, notification_types[type], b->head, no_reply);
+    }
+}
+
+void
+ubus_notify_interface_state(
+    interface_st * const iface,
+    interface_notification_t const type,
+    char const * const state)
+{
+    if (iface->ctx->ubus_conn.ctx.sock.fd < 0 || !interface_has_subscribers(iface))
+    {
+        goto done;
+    }
+
+    struct blob_buf b = { 0 };
+
+    blob_buf_init(&b, 0);
+    blobmsg_add_string(&b, "interface", iface->name);
+    blobmsg_add_string(&b, "state", state);
+    notify_interface_subscribers(iface, type, &b);
+    blob_buf_free(&b);
+
+done:
+    return;
+}
+
+void
+ubus_notify_interface_test_run(interface_st * const iface, bool const test_run_passed)
+{
+    if (iface->ctx->ubus_conn.ctx.sock.fd < 0 || !interface_has_subscribers(iface))
+    {
+        goto done;
+    }
+
+    test_run_statistics_st const * const stats = &iface->tester.stats.test_runs;
+    struct blob_buf b = { 0 };
+
+    blob_buf_init(&b, 0);
+    blobmsg_add_string(&b, "interface", iface->name);
+    blobmsg_add_string(&b, "result", test_run_passed ? "pass" : "fail");
+    blobmsg_add_u64(&b, "consecutive_passes", stats->consecutive_passes);
+    blobmsg_add_u64(&b, "consecutive_failures", stats->consecutive_failures);
+    blobmsg_add_u8(&b, "is_operational", iface->recovery.state == RECOVERY_STATE_OPERATIONAL);
+    notify_interface_subscribers(iface, INTERFACE_NOTIFICATION_TEST_RUN, &b);
     blob_buf_free(&b);
 
 done:
@@ -82,6 +188,10 @@ done:
 
 static char const interface_monitor_event_id[] = "network.interface";
 static char const interface_state_event_id[] = "interface.state";
+static char const object_add_event_id[] = "ubus.object.add";
+static char const object_remove_event_id[] = "ubus.object.remove";
+/* netifd's object, and the prefix of its objects for each interface. */
+static char const network_interface_object_path[] = "network.interface";
 
 typedef enum network_interface_event_policy_t
 {
@@ -156,6 +266,7 @@ typedef enum interface_state_event_policy_t
 {
     INTERFACE_STATE_EVENT_STATE,
     INTERFACE_STATE_EVENT_INTERFACE,
+    INTERFACE_STATE_EVENT_DEVICE,
     INTERFACE_STATE_EVENT_COUNT__,
 } interface_state_event_policy_t;
 
@@ -164,6 +275,8 @@ static const struct blobmsg_policy
 {
     [INTERFACE_STATE_EVENT_STATE] = { .name = "state", .type = BLOBMSG_TYPE_STRING },
     [INTERFACE_STATE_EVENT_INTERFACE] = { .name = "interface", .type = BLOBMSG_TYPE_STRING },
+    /* Optional. The L3 device, as in $DEVICE from the hotplug script. */
+    [INTERFACE_STATE_EVENT_DEVICE] = { .name = "device", .type = BLOBMSG_TYPE_STRING },
 };
 
 static void
@@ -211,6 +324,11 @@ interface_state_event_handler_cb(
         goto done;
     }
 
+    if (tb[INTERFACE_STATE_EVENT_DEVICE] != NULL)
+    {
+        interface_connection_set_device(
+            &iface->connection, blobmsg_get_string(tb[INTERFACE_STATE_EVENT_DEVICE]));
+    }
     interface_connection_connected(&iface->connection);
 
 done:
@@ -235,17 +353,169 @@ ubus_subscribe_to_interface_state_events(
     ubus_register_event_handler(ubus, interface_events_ctx, interface_state_event_id);
 }
 
-static int
-iface_handle_state(
-    struct ubus_context * const ubus, struct ubus_object * const obj,
-    struct ubus_request_data * const req, const char * const method,
+typedef enum object_event_policy_t
+{
+    OBJECT_EVENT_ID,
+    OBJECT_EVENT_PATH,
+    OBJECT_EVENT_COUNT__,
+} object_event_policy_t;
+
+static const struct blobmsg_policy
+    object_event_policy[OBJECT_EVENT_COUNT__] =
+{
+    [OBJECT_EVENT_ID] = { .name = "id", .type = BLOBMSG_TYPE_INT32 },
+    [OBJECT_EVENT_PATH] = { .name = "path", .type = BLOBMSG_TYPE_STRING },
+};
+
+/* Sets the cached id of the object with the given path, if it is one of netifd's. */
+static void
+network_object_id_update(
+    interface_tester_shared_st * const ctx, char const * const path, uint32_t const id)
+{
+    size_t const prefix_len = strlen(network_interface_object_path);
+
+    if (strncmp(path, network_interface_object_path, prefix_len) != 0)
+    {
+        goto done;
+    }
+
+    if (path[prefix_len] == '\0')
+    {
+        ctx->network_interface_id = id;
+        goto done;
+    }
+
+#if WITH_METRICS_ADJUSTMENT
+    if (path[prefix_len] != '.')
+    {
+        goto done;
+    }
+
+    interface_st * const iface = interface_tester_lookup_by_name(ctx, &path[prefix_len + 1]);
+
+    if (iface == NULL)
+    {
+        goto done;
+    }
+
+    metrics_adjuster_set_object_id(&iface->recovery.metrics_adjuster, id);
+#endif
+
+done:
+    return;
+}
+
+static void
+object_event_handler_cb(
+    struct ubus_context * const ubus,
+    struct ubus_event_handler * const ev,
+    const char * const type,
     struct blob_attr * const msg)
 {
-    UNUSED(ubus);
-    UNUSED(req);
-    UNUSED(method);
-    UNUSED(msg);
-    interface_st * const iface = container_of(obj, interface_st, ubus_object);
+    UNUSED(ev);
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+    struct blob_attr * tb[OBJECT_EVENT_COUNT__];
+
+    blobmsg_parse(object_event_policy, OBJECT_EVENT_COUNT__, tb,
+                  blobmsg_data(msg), blobmsg_data_len(msg));
+
+    if (tb[OBJECT_EVENT_ID] == NULL || tb[OBJECT_EVENT_PATH] == NULL)
+    {
+        goto done;
+    }
+
+    /* A removed object is looked up again if it is needed before it is added back. */
+    bool const was_added = strcmp(type, object_add_event_id) == 0;
+
+    network_object_id_update(
+        ctx,
+        blobmsg_get_string(tb[OBJECT_EVENT_PATH]),
+        was_added ? blobmsg_get_u32(tb[OBJECT_EVENT_ID]) : 0);
+
+done:
+    return;
+}
+
+void
+ubus_subscribe_to_object_events(
+    struct ubus_context * const ubus,
+    struct ubus_event_handler * const object_events_ctx)
+{
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+
+    ctx->network_interface_id = 0;
+#if WITH_METRICS_ADJUSTMENT
+    interface_st * iface;
+
+    vlist_for_each_element(&ctx->interfaces, iface, node)
+    {
+        metrics_adjuster_set_object_id(&iface->recovery.metrics_adjuster, 0);
+    }
+#endif
+
+    object_events_ctx->cb = object_event_handler_cb;
+    ubus_register_event_handler(ubus, object_events_ctx, object_add_event_id);
+    ubus_register_event_handler(ubus, object_events_ctx, object_remove_event_id);
+}
+
+typedef enum interface_name_policy_t
+{
+    INTERFACE_NAME_INTERFACE,
+    INTERFACE_NAME_COUNT,
+} interface_name_policy_t;
+
+static const struct blobmsg_policy
+    interface_name_policy[INTERFACE_NAME_COUNT] =
+{
+    [INTERFACE_NAME_INTERFACE] = { .name = "interface", .type = BLOBMSG_TYPE_STRING },
+};
+
+static char const *
+interface_name_from_msg(struct blob_attr * const msg)
+{
+    struct blob_attr * tb[INTERFACE_NAME_COUNT];
+
+    blobmsg_parse(interface_name_policy, ARRAY_SIZE(tb), tb, blob_data(msg), blob_len(msg));
+
+    return tb[INTERFACE_NAME_INTERFACE] != NULL
+        ? blobmsg_get_string(tb[INTERFACE_NAME_INTERFACE])
+        : NULL;
+}
+
+/*
+ * Returns the interface named by the interface argument of a call to the main
+ * object, or NULL with the status to reply with.
+ */
+static interface_st *
+interface_from_msg(
+    struct ubus_context * const ubus, struct blob_attr * const msg, int * const status)
+{
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+    char const * const name = interface_name_from_msg(msg);
+    interface_st * iface = NULL;
+
+    if (name == NULL)
+    {
+        *status = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    iface = interface_tester_lookup_by_name(ctx, name);
+    *status = iface != NULL ? UBUS_STATUS_OK : UBUS_STATUS_NOT_FOUND;
+
+done:
+    return iface;
+}
+
+static int
+send_interface_state(
+    struct ubus_context * const ubus,
+    struct ubus_request_data * const req,
+    interface_st * const iface)
+{
     struct blob_buf b = { 0 };
 
     blob_buf_init(&b, 0);
@@ -258,6 +528,58 @@ iface_handle_state(
     return UBUS_STATUS_OK;
 }
 
+static int
+send_interface_output(
+    struct ubus_context * const ubus,
+    struct ubus_request_data * const req,
+    interface_st const * const iface)
+{
+    struct blob_buf b = { 0 };
+
+    blob_buf_init(&b, 0);
+
+    interface_output_dump(iface, &b);
+    ubus_send_reply(ubus, req, b.head);
+
+    blob_buf_free(&b);
+
+    return UBUS_STATUS_OK;
+}
+
+static int
+start_interface_test_run(interface_st * const iface)
+{
+    interface_tester_send_event(iface, TESTER_EVENT_TEST_RUN_REQUESTED);
+
+    return UBUS_STATUS_OK;
+}
+
+static int
+iface_handle_state(
+    struct ubus_context * const ubus, struct ubus_object * const obj,
+    struct ubus_request_data * const req, const char * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED(method);
+    UNUSED(msg);
+    interface_st * const iface = container_of(obj, interface_st, ubus_object);
+
+    return send_interface_state(ubus, req, iface);
+}
+
+static int
+iface_handle_last_output(
+    struct ubus_context * const ubus, struct ubus_object * const obj,
+    struct ubus_request_data * const req, const char * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED(method);
+    UNUSED(msg);
+    interface_st * const iface = container_of(obj, interface_st, ubus_object);
+
+    return send_interface_output(ubus, req, iface);
+}
+
 static int
 iface_handle_test(
     struct ubus_context * const ubus, struct ubus_object * const obj,
@@ -270,13 +592,33 @@ iface_handle_test(
     UNUSED(msg);
     interface_st * const iface = container_of(obj, interface_st, ubus_object);
 
-    interface_tester_send_event(iface, TESTER_EVENT_TEST_RUN_REQUESTED);
+    return start_interface_test_run(iface);
+}
 
-    return UBUS_STATUS_OK;
+static int
+interface_tester_handle_last_output(
+    struct ubus_context * const ubus, struct ubus_object * const obj,
+    struct ubus_request_data * const req, const char * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED(obj);
+    UNUSED(method);
+    int res;
+    interface_st const * const iface = interface_from_msg(ubus, msg, &res);
+
+    if (iface == NULL)
+    {
+        goto done;
+    }
+
+    res = send_interface_output(ubus, req, iface);
+
+done:
+    return res;
 }
 
 static int
-iface_handle_all_states(
+interface_tester_handle_test(
     struct ubus_context * const ubus, struct ubus_object * const obj,
     struct ubus_request_data * const req, const char * const method,
     struct blob_attr * const msg)
@@ -284,20 +626,185 @@ iface_handle_all_states(
     UNUSED(obj);
     UNUSED(req);
     UNUSED(method);
-    UNUSED(msg);
+    int res;
+    interface_st * const iface = interface_from_msg(ubus, msg, &res);
+
+    if (iface == NULL)
+    {
+        goto done;
+    }
+
+    res = start_interface_test_run(iface);
+
+done:
+    return res;
+}
+
+typedef enum state_policy_t
+{
+    STATE_INTERFACE,
+    STATE_SINCE,
+    STATE_COUNT__,
+} state_policy_t;
+
+static const struct blobmsg_policy state_policy[STATE_COUNT__] =
+{
+    [STATE_INTERFACE] = { .name = "interface", .type = BLOBMSG_TYPE_STRING },
+    /* An int32 or int64, depending on its size. */
+    [STATE_SINCE] = { .name = "since", .type = BLOBMSG_TYPE_UNSPEC },
+};
+
+static bool
+generation_from_attr(struct blob_attr * const attr, uint64_t * const generation)
+{
+    bool success = true;
+
+    switch (blobmsg_type(attr))
+    {
+    case BLOBMSG_TYPE_INT32:
+        *generation = blobmsg_get_u32(attr);
+        break;
+
+    case BLOBMSG_TYPE_INT64:
+        *generation = blobmsg_get_u64(attr);
+        break;
+
+    default:
+        success = false;
+        break;
+    }
+
+    return success;
+}
+
+static int
+iface_handle_all_states(
+    struct ubus_context * const ubus, struct ubus_object * const obj,
+    struct ubus_request_data * const req, const char * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED(obj);
+    UNUSED(method);
     interface_tester_shared_st * const ctx =
         container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+    struct blob_attr * tb[STATE_COUNT__];
+    uint64_t since = 0;
+    int res;
+
+    blobmsg_parse(state_policy, STATE_COUNT__, tb, blob_data(msg), blob_len(msg));
+
+    /* With an interface argument, only the state of that interface. */
+    if (tb[STATE_INTERFACE] != NULL)
+    {
+        interface_st * const iface = interface_from_msg(ubus, msg, &res);
+
+        if (iface != NULL)
+        {
+            res = send_interface_state(ubus, req, iface);
+        }
+        goto done;
+    }
+
+    if (tb[STATE_SINCE] != NULL && !generation_from_attr(tb[STATE_SINCE], &since))
+    {
+        res = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
     struct blob_buf b = { 0 };
 
     blob_buf_init(&b, 0);
 
-    interface_states_dump(ctx, &b);
+    if (tb[STATE_SINCE] != NULL)
+    {
+        interface_states_dump_since(ctx, &b, since);
+    }
+    else
+    {
+        interface_states_dump(ctx, &b);
+    }
 
     ubus_send_reply(ubus, req, b.head);
 
     blob_buf_free(&b);
 
-    return UBUS_STATUS_OK;
+    res = UBUS_STATUS_OK;
+
+done:
+    return res;
+}
+
+typedef enum trace_policy_t
+{
+    TRACE_SINCE,
+    TRACE_LIMIT,
+    TRACE_COUNT__,
+} trace_policy_t;
+
+static const struct blobmsg_policy trace_policy[TRACE_COUNT__] =
+{
+    /* An int32 or int64, depending on its size. */
+    [TRACE_SINCE] = { .name = "since", .type = BLOBMSG_TYPE_UNSPEC },
+    [TRACE_LIMIT] = { .name = "limit", .type = BLOBMSG_TYPE_INT32 },
+};
+
+static int
+iface_handle_trace(
+    struct ubus_context * const ubus, struct ubus_object * const obj,
+    struct ubus_request_data * const req, const char * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED(obj);
+    UNUSED(method);
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+    struct blob_attr * tb[TRACE_COUNT__];
+    size_t limit = FLIGHT_RECORDER_TRACE_MAX_RECORDS;
+    uint64_t since;
+    int res;
+
+    blobmsg_parse(trace_policy, TRACE_COUNT__, tb, blob_data(msg), blob_len(msg));
+
+    if (tb[TRACE_LIMIT] != NULL)
+    {
+        limit = blobmsg_get_u32(tb[TRACE_LIMIT]);
+    }
+    if (tb[TRACE_SINCE] != NULL)
+    {
+        if (!generation_from_attr(tb[TRACE_SINCE], &since))
+        {
+            res = UBUS_STATUS_INVALID_ARGUMENT;
+            goto done;
+        }
+    }
+    else
+    {
+        /* The most recent transitions. */
+        uint64_t const total = flight_recorder_total();
+        size_t const wanted = limit < FLIGHT_RECORDER_TRACE_MAX_RECORDS
+            ? limit
+            : FLIGHT_RECORDER_TRACE_MAX_RECORDS;
+
+        since = total > wanted ? total - wanted : 0;
+    }
+
+    struct blob_buf b = { 0 };
+
+    blob_buf_init(&b, 0);
+
+    flight_recorder_trace_dump(ctx, &b, since, limit);
+
+    res = ubus_send_reply(ubus, req, b.head);
+    if (res != UBUS_STATUS_OK)
+    {
+        DLOG("%s: failed to send the trace (%zu bytes): %s",
+             __func__, (size_t)blob_pad_len(b.head), ubus_strerror(res));
+    }
+
+    blob_buf_free(&b);
+
+done:
+    return res;
 }
 
 static int
@@ -313,7 +820,7 @@ iface_handle_config_reload(
     interface_tester_shared_st * const ctx =
         container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
 
-    config_load_from_file_check(ctx);
+    config_watcher_load_all(&ctx->config_watcher);
 
     return UBUS_STATUS_OK;
 }
@@ -321,60 +828,102 @@ iface_handle_config_reload(
 enum
 {
     STATE_GET_UP,
+    STATE_GET_L3_DEVICE,
     STATE_GET_COUNT,
 };
 
 static const struct blobmsg_policy state_get_policy[STATE_GET_COUNT] =
 {
     [STATE_GET_UP] = { .name = "up", .type = BLOBMSG_TYPE_BOOL },
+    [STATE_GET_L3_DEVICE] = { .name = "l3_device", .type = BLOBMSG_TYPE_STRING },
 };
 
-static void
-get_interface_state_cb(
-    struct ubus_request * const req,
-    int const type,
-    struct blob_attr * const msg)
+bool
+interface_state_from_status(
+    struct blob_attr * const msg, char * const device, size_t const device_size)
 {
-    UNUSED(type);
     struct blob_attr * tb[STATE_GET_COUNT];
-    bool * const state = (bool *)req->priv;
 
     blobmsg_parse(state_get_policy, STATE_GET_COUNT, tb, blob_data(msg), blob_len(msg));
 
-    *state = tb[STATE_GET_UP] != NULL && blobmsg_get_bool(tb[STATE_GET_UP]);
+    if (tb[STATE_GET_L3_DEVICE] != NULL)
+    {
+        snprintf(device, device_size, "%s", blobmsg_get_string(tb[STATE_GET_L3_DEVICE]));
+    }
+
+    return tb[STATE_GET_UP] != NULL && blobmsg_get_bool(tb[STATE_GET_UP]);
 }
 
-bool
-interface_get_current_state(
-    struct ubus_context * const ubus, char const * const interface_name)
+static uint32_t
+network_interface_object_id(interface_tester_shared_st * const ctx)
 {
-    uint32_t id;
-    bool state = false;
-    char * path = NULL;
-
-    if (asprintf(&path, "network.interface.%s", interface_name) == -1)
+    /*
+     * The status of every interface is requested from the one object, so it
+     * is only looked up once rather than once per interface.
+     */
+    if (ctx->network_interface_id == 0
+        && ubus_lookup_id(
+            &ctx->ubus_conn.ctx, network_interface_object_path, &ctx->network_interface_id)
+           != UBUS_STATUS_OK)
     {
-        goto done;
+        ctx->network_interface_id = 0;
     }
 
-    if (ubus_lookup_id(ubus, path, &id) != UBUS_STATUS_OK)
+    return ctx->network_interface_id;
+}
+
+bool
+interface_request_current_state(
+    struct ubus_context * const ubus,
+    char const * const interface_name,
+    struct ubus_request * const req,
+    ubus_data_handler_t const data_cb,
+    ubus_complete_handler_t const complete_cb,
+    void * const priv)
+{
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+    bool success = false;
+    struct blob_buf b = { 0 };
+    uint32_t const id = network_interface_object_id(ctx);
+
+    if (id == 0)
     {
         goto done;
     }
 
-    int const ret = ubus_invoke(
-        ubus, id, "status", NULL, get_interface_state_cb, &state, UBUS_TIMEOUT_MS);
+    blob_buf_init(&b, 0);
+    blobmsg_add_string(&b, "interface", interface_name);
 
-    if (ret != UBUS_STATUS_OK)
+    if (ubus_invoke_async(ubus, id, "status", b.head, req) != UBUS_STATUS_OK)
     {
         goto done;
     }
-    /* Else the state has been set by the callback. */
+
+    req->data_cb = data_cb;
+    req->complete_cb = complete_cb;
+    req->priv = priv;
+    ubus_complete_request_async(ubus, req);
+
+    success = true;
 
 done:
-    free(path);
+    blob_buf_free(&b);
 
-    return state;
+    return success;
+}
+
+void
+interface_state_request_failed(struct ubus_context * const ubus, int const status)
+{
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+
+    /* netifd may have restarted, so look its object up again next time. */
+    if (status == UBUS_STATUS_NOT_FOUND)
+    {
+        ctx->network_interface_id = 0;
+    }
 }
 
 #if WITH_METRICS_ADJUSTMENT
@@ -382,44 +931,57 @@ bool
 ubus_send_metrics_adjust_request(
     struct ubus_context * const ubus,
     char const * const interface_name,
-    uint32_t const amount)
+    uint32_t * const object_id,
+    uint32_t const amount,
+    struct ubus_request * const req,
+    ubus_complete_handler_t const complete_cb,
+    void * const priv)
 {
-    uint32_t id;
     bool success = false;
-    char * path = NULL;
-
-    if (asprintf(&path, "network.interface.%s", interface_name) == -1)
-    {
-        goto done;
-    }
+    struct blob_buf b = { 0 };
 
-    if (ubus_lookup_id(ubus, path, &id) != UBUS_STATUS_OK)
+    if (*object_id == 0)
     {
-        goto done;
+        char * path = NULL;
+
+        if (asprintf(&path, "%s.%s", network_interface_object_path, interface_name) == -1)
+        {
+            goto done;
+        }
+        if (ubus_lookup_id(ubus, path, object_id) != UBUS_STATUS_OK)
+        {
+            *object_id = 0;
+        }
+        free(path);
+        if (*object_id == 0)
+        {
+            goto done;
+        }
     }
-    struct blob_buf b = { 0 };
 
     blob_buf_init(&b, 0);
 
     blobmsg_add_u32(&b, "adjustment", amount);
     blobmsg_add_u8(&b, "persist", true);
 
-    int const ret = ubus_invoke(
-        ubus, id, "adjust_metrics", b.head, NULL, NULL, UBUS_TIMEOUT_MS);
-
-    blob_buf_free(&b);
-
-    if (ret != UBUS_STATUS_OK)
+    if (ubus_invoke_async(ubus, *object_id, "adjust_metrics", b.head, req) != UBUS_STATUS_OK)
     {
-        DLOG("%s: failed to set metrics adjustment to %"PRIu32,
+        DLOG("%s: failed to send metrics adjustment of %"PRIu32,
              interface_name, amount);
         goto done;
     }
-    /* Else the state has been set by the callback. */
+
+    /* Else the request has been sent. Without complete_cb the reply is ignored. */
+    if (complete_cb != NULL)
+    {
+        req->complete_cb = complete_cb;
+        req->priv = priv;
+        ubus_complete_request_async(ubus, req);
+    }
     success = true;
 
 done:
-    free(path);
+    blob_buf_free(&b);
 
     return success;
 }
@@ -431,6 +993,7 @@ static struct
 {
     { .name = "state", .handler = iface_handle_state },
     { .name = "start_test_run", .handler = iface_handle_test },
+    { .name = "last_output", .handler = iface_handle_last_output },
 };
 
 static struct
@@ -473,6 +1036,7 @@ done:
 typedef enum interface_tester_config_policy_t
 {
     INTERFACE_TESTER_CONFIG,
+    INTERFACE_TESTER_PROFILES,
     INTERFACE_TESTER_COUNT,
 } interface_tester_config_policy_t;
 
@@ -480,15 +1044,212 @@ static const struct blobmsg_policy
     interface_tester_config_policy[INTERFACE_TESTER_COUNT] =
 {
     [INTERFACE_TESTER_CONFIG] = { .name = "interfaces", .type = BLOBMSG_TYPE_TABLE },
+    [INTERFACE_TESTER_PROFILES] = { .name = Sprofiles, .type = BLOBMSG_TYPE_TABLE },
+};
+
+typedef enum interface_config_set_policy_t
+{
+    INTERFACE_CONFIG_SET_INTERFACE,
+    INTERFACE_CONFIG_SET_CONFIG,
+    INTERFACE_CONFIG_SET_PROFILES,
+    INTERFACE_CONFIG_SET_COUNT,
+} interface_config_set_policy_t;
+
+static const struct blobmsg_policy
+    interface_config_set_policy[INTERFACE_CONFIG_SET_COUNT] =
+{
+    [INTERFACE_CONFIG_SET_INTERFACE] = { .name = "interface", .type = BLOBMSG_TYPE_STRING },
+    [INTERFACE_CONFIG_SET_CONFIG] = { .name = Sconfig, .type = BLOBMSG_TYPE_TABLE },
+    [INTERFACE_CONFIG_SET_PROFILES] = { .name = Sprofiles, .type = BLOBMSG_TYPE_TABLE },
 };
 
+/* Add or update a single interface, leaving the others alone. */
+static int
+interface_tester_handle_config_set(
+    struct ubus_context * const ubus, struct ubus_object * const obj,
+    struct ubus_request_data * const req, const char * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED(obj);
+    UNUSED(req);
+    UNUSED(method);
+    int res;
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+    struct blob_attr * tb[INTERFACE_CONFIG_SET_COUNT];
+
+    blobmsg_parse(interface_config_set_policy, ARRAY_SIZE(tb), tb, blob_data(msg), blob_len(msg));
+    if (tb[INTERFACE_CONFIG_SET_INTERFACE] == NULL || tb[INTERFACE_CONFIG_SET_CONFIG] == NULL)
+    {
+        res = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    res = config_set_interface(
+        ctx,
+        &ctx->ubus_source,
+        tb[INTERFACE_CONFIG_SET_PROFILES],
+        blobmsg_get_string(tb[INTERFACE_CONFIG_SET_INTERFACE]),
+        tb[INTERFACE_CONFIG_SET_CONFIG]);
+
+done:
+    return res;
+}
+
+static int
+interface_tester_handle_config_delete(
+    struct ubus_context * const ubus, struct ubus_object * const obj,
+    struct ubus_request_data * const req, const char * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED(obj);
+    UNUSED(req);
+    UNUSED(method);
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+    char const * const name = interface_name_from_msg(msg);
+
+    return name != NULL ? config_delete_interface(ctx, name) : UBUS_STATUS_INVALID_ARGUMENT;
+}
+
+static int
+interface_tester_handle_config_get(
+    struct ubus_context * const ubus, struct ubus_object * const obj,
+    struct ubus_request_data * const req, const char * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED(obj);
+    UNUSED(method);
+    int res;
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+    char const * const name = interface_name_from_msg(msg);
+
+    if (name == NULL)
+    {
+        res = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    interface_st const * const iface = interface_tester_lookup_by_name(ctx, name);
+
+    if (iface == NULL)
+    {
+        res = UBUS_STATUS_NOT_FOUND;
+        goto done;
+    }
+
+    struct blob_buf b = { 0 };
+
+    blob_buf_init(&b, 0);
+
+    interface_config_dump(iface, &b);
+    ubus_send_reply(ubus, req, b.head);
+
+    blob_buf_free(&b);
+
+    res = UBUS_STATUS_OK;
+
+done:
+    return res;
+}
+
+typedef enum interface_config_bulk_policy_t
+{
+    INTERFACE_CONFIG_BULK_SET,
+    INTERFACE_CONFIG_BULK_DELETE,
+    INTERFACE_CONFIG_BULK_PROFILES,
+    INTERFACE_CONFIG_BULK_COUNT,
+} interface_config_bulk_policy_t;
+
+static const struct blobmsg_policy
+    interface_config_bulk_policy[INTERFACE_CONFIG_BULK_COUNT] =
+{
+    [INTERFACE_CONFIG_BULK_SET] = { .name = "set", .type = BLOBMSG_TYPE_TABLE },
+    [INTERFACE_CONFIG_BULK_DELETE] = { .name = "delete", .type = BLOBMSG_TYPE_ARRAY },
+    [INTERFACE_CONFIG_BULK_PROFILES] = { .name = Sprofiles, .type = BLOBMSG_TYPE_TABLE },
+};
+
+/*
+ * Delete the named interfaces and then add or update the others, as though
+ * config_delete and config_set had been called for each of them, and reply
+ * with the names of any that couldn't be.
+ */
+static int
+interface_tester_handle_config_bulk(
+    struct ubus_context * const ubus, struct ubus_object * const obj,
+    struct ubus_request_data * const req, const char * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED(obj);
+    UNUSED(method);
+    int res;
+    interface_tester_shared_st * const ctx =
+        container_of(ubus, interface_tester_shared_st, ubus_conn.ctx);
+    struct blob_attr * tb[INTERFACE_CONFIG_BULK_COUNT];
+    struct blob_attr * cur;
+    size_t rem;
+
+    blobmsg_parse(interface_config_bulk_policy, ARRAY_SIZE(tb), tb, blob_data(msg), blob_len(msg));
+    if ((tb[INTERFACE_CONFIG_BULK_SET] == NULL && tb[INTERFACE_CONFIG_BULK_DELETE] == NULL)
+        || (tb[INTERFACE_CONFIG_BULK_DELETE] != NULL
+            && blobmsg_check_array(tb[INTERFACE_CONFIG_BULK_DELETE], BLOBMSG_TYPE_STRING) < 0))
+    {
+        res = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    struct blob_buf b = { 0 };
+
+    blob_buf_init(&b, 0);
+
+    void * const failed_cky = blobmsg_open_array(&b, "failed");
+
+    blobmsg_for_each_attr(cur, tb[INTERFACE_CONFIG_BULK_DELETE], rem)
+    {
+        if (config_delete_interface(ctx, blobmsg_get_string(cur)) != UBUS_STATUS_OK)
+        {
+            blobmsg_add_string(&b, NULL, blobmsg_get_string(cur));
+        }
+    }
+
+    blobmsg_for_each_attr(cur, tb[INTERFACE_CONFIG_BULK_SET], rem)
+    {
+        if (blobmsg_type(cur) != BLOBMSG_TYPE_TABLE
+            || config_set_interface(
+                ctx, &ctx->ubus_source, tb[INTERFACE_CONFIG_BULK_PROFILES], blobmsg_name(cur), cur)
+               != UBUS_STATUS_OK)
+        {
+            blobmsg_add_string(&b, NULL, blobmsg_name(cur));
+        }
+    }
+
+    blobmsg_close_array(&b, failed_cky);
+    ubus_send_reply(ubus, req, b.head);
+
+    blob_buf_free(&b);
+
+    res = UBUS_STATUS_OK;
+
+done:
+    return res;
+}
+
 /* The methods supported by the main process. */
 static struct ubus_method
     iface_tester_object_methods[] =
 {
     UBUS_METHOD("config", interface_tester_handle_config, interface_tester_config_policy),
-    UBUS_METHOD_NOARG("state", iface_handle_all_states),
+    UBUS_METHOD("config_set", interface_tester_handle_config_set, interface_config_set_policy),
+    UBUS_METHOD(
+        "config_delete", interface_tester_handle_config_delete, interface_name_policy),
+    UBUS_METHOD("config_get", interface_tester_handle_config_get, interface_name_policy),
+    UBUS_METHOD("config_bulk", interface_tester_handle_config_bulk, interface_config_bulk_policy),
+    UBUS_METHOD("state", iface_handle_all_states, state_policy),
+    UBUS_METHOD("start_test_run", interface_tester_handle_test, interface_name_policy),
+    UBUS_METHOD("last_output", interface_tester_handle_last_output, interface_name_policy),
     UBUS_METHOD_NOARG("config_reload", iface_handle_config_reload),
+    UBUS_METHOD("trace", iface_handle_trace, trace_policy),
 };
 
 static struct
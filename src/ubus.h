@@ -20,6 +20,28 @@ void
 ubus_send_interface_test_run_event(
     struct ubus_context * ubus, char const * interface_name, bool test_run_passed);
 
+typedef enum interface_notification_t
+{
+    INTERFACE_NOTIFICATION_CONNECTION,
+    INTERFACE_NOTIFICATION_TESTER,
+    INTERFACE_NOTIFICATION_RECOVERY,
+    INTERFACE_NOTIFICATION_TEST_RUN,
+    INTERFACE_NOTIFICATION_COUNT,
+} interface_notification_t;
+
+/*
+ * Tell the subscribers of the main object, and of the interface's own object,
+ * that one of the state machines of the interface has changed state. Nothing
+ * is built or sent unless there are subscribers.
+ */
+void
+ubus_notify_interface_state(
+    interface_st * iface, interface_notification_t type, char const * state);
+
+/* As ubus_notify_interface_state(), with the result of a test run. */
+void
+ubus_notify_interface_test_run(interface_st * iface, bool test_run_passed);
+
 void
 ubus_subscribe_to_interface_events(
     struct ubus_context * ubus, struct ubus_event_handler * interface_events_ctx);
@@ -28,13 +50,59 @@ void
 ubus_subscribe_to_interface_state_events(
     struct ubus_context * ubus, struct ubus_event_handler * interface_events_ctx);
 
+/*
+ * Keep the cached ids of netifd's objects up to date as ubusd reports objects
+ * being added and removed. Any ids cached before are forgotten, as they may
+ * belong to an earlier connection to ubusd.
+ */
+void
+ubus_subscribe_to_object_events(
+    struct ubus_context * ubus, struct ubus_event_handler * object_events_ctx);
+
+/*
+ * Ask netifd for the current state of the interface without waiting for the
+ * reply. data_cb is passed the status, and complete_cb is called with the
+ * result once the reply has been received. Returns false if the request
+ * couldn't be sent, in which case neither callback is called.
+ */
+bool
+interface_request_current_state(
+    struct ubus_context * ubus,
+    char const * interface_name,
+    struct ubus_request * req,
+    ubus_data_handler_t data_cb,
+    ubus_complete_handler_t complete_cb,
+    void * priv);
+
+/*
+ * Returns whether the status from netifd says the interface is up, and copies
+ * the L3 device, if any, into device.
+ */
 bool
-interface_get_current_state(struct ubus_context * ubus, char const * interface_name);
+interface_state_from_status(struct blob_attr * msg, char * device, size_t device_size);
+
+/* Called when the status request completes with an error. */
+void
+interface_state_request_failed(struct ubus_context * ubus, int status);
 
 #if WITH_METRICS_ADJUSTMENT
+/*
+ * Ask netifd to adjust the metrics of the routes of the interface, without
+ * waiting for the reply. complete_cb is called with the result once the reply
+ * has been received, unless it is NULL, in which case the reply is ignored.
+ * Returns false if the request couldn't be sent, in which case complete_cb
+ * isn't called. object_id holds the id of netifd's object for the interface,
+ * and is looked up and updated if it is 0.
+ */
 bool
 ubus_send_metrics_adjust_request(
-    struct ubus_context * ubus, char const * interface_name, uint32_t amount);
+    struct ubus_context * ubus,
+    char const * interface_name,
+    uint32_t * object_id,
+    uint32_t amount,
+    struct ubus_request * req,
+    ubus_complete_handler_t complete_cb,
+    void * priv);
 #endif
 
 bool
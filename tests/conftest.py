@@ -2,7 +2,7 @@ from _pytest.config import Config
 from _pytest.fixtures import fixture
 from typing import Generator
 from fixtures.interface_tester import InterfaceTester
-from fixtures.ubus import Ubus, UbusListener
+from fixtures.ubus import Ubus, UbusListener, UbusSubscriber
 from fixtures.waiter import Waiter
 import logging
 
@@ -39,6 +39,12 @@ def ubus_listener(ubusd: Ubus, logger: logging.Logger, waiter: waiter) -> Genera
         yield ul
 
 
+@fixture()
+def ubus_subscriber(ubusd: Ubus, logger: logging.Logger, waiter: waiter) -> Generator[UbusSubscriber, None, None]:
+    with UbusSubscriber(ubusd, logger, waiter) as us:
+        yield us
+
+
 @fixture()
 def interface_tester(
         pytestconfig: Config, ubusd: Ubus, logger: logging.Logger
@@ -32,6 +32,7 @@ class IfaceTesterTestConfig:
     label: str
     params: dict[str, Any] = dataclasses.field(default_factory=lambda: {})
     response_timeout_secs: int = 0
+    type: str = "executable"
 
 
 @dataclass
@@ -46,6 +47,7 @@ class IfaceTesterConfig:
     fail_threshold: int = 1
     response_timeout_secs: int = 5
     failing_tests_metrics_increase: int = 0
+    parallel_tests: bool = False
 
 
 @dataclass
@@ -73,7 +75,11 @@ class InterfaceTester:
         self.stop()
 
     def _start_tester(
-            self, config: str | None = None, test_dir: str | None = None, tasks_dir: str | None = None
+            self,
+            config: str | None = None,
+            test_dir: str | None = None,
+            tasks_dir: str | None = None,
+            extra_args: list[str] | None = None,
     ) -> Popen:
         args = [
                 self._exe_path,
@@ -86,6 +92,8 @@ class InterfaceTester:
             args.extend(["-S", test_dir])
         if tasks_dir:
             args.extend(["-r", tasks_dir])
+        if extra_args:
+            args.extend(extra_args)
         process = Popen(args, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
         return process
 
@@ -93,9 +101,17 @@ class InterfaceTester:
         for line in process.stderr:
             self._log.debug(f"tester: {line}")
 
-    def start(self, config: str | None = None, test_dir: str | None = None, tasks_dir: str | None = None) -> None:
+    def start(
+            self,
+            config: str | None = None,
+            test_dir: str | None = None,
+            tasks_dir: str | None = None,
+            extra_args: list[str] | None = None,
+    ) -> None:
         self.stop()
-        self._process = self._start_tester(config=config, test_dir=test_dir, tasks_dir=tasks_dir)
+        self._process = self._start_tester(
+            config=config, test_dir=test_dir, tasks_dir=tasks_dir, extra_args=extra_args
+        )
         self._read_thread = threading.Thread(target=self._read_tester, args=(self._process,))
         self._read_thread.start()
 
@@ -50,6 +50,16 @@ class Ubus:
 
         return result.returncode, result.stdout
 
+    def call(self, object_name: str, method: str, args: dict[str, Any] | None = None) -> dict[str, Any]:
+        result = subprocess.run(
+            ["ubus", "-s", self.socket_path, "call", object_name, method, json.dumps(args or {})],
+            capture_output=True,
+            text=True,
+            check=True,
+        )
+
+        return json.loads(result.stdout) if result.stdout else {}
+
 @dataclass
 class UbusEvent:
     timestamp: float
@@ -87,12 +97,15 @@ class UbusListener:
         self.stop_listener()
         # Start a process that outputs JSON objects line by line
         process = Popen(
-            ['ubus', '-s', self._ubusd.socket_path, "listen"],
+            ['ubus', '-s', self._ubusd.socket_path, *self._command()],
             stdout=subprocess.PIPE,
             text=True  # To get string output, not bytes
         )
         return process
 
+    def _command(self) -> list[str]:
+        return ["listen"]
+
     def _read_json_stream(self, process: Popen):
         buffer = ""
         for line in process.stdout:
@@ -138,3 +151,45 @@ class UbusListener:
                 if self._dict_contains_all(data, event_data[event_name]):
                     return event
         return self._waiter.wait_for(have_event, timeout, interval=0.1, description=f"event: {event_name} with: {data}")
+
+    def wait_for_events(
+        self, event_name: str, data: dict[str, Any], key: str, values: set[Any], timeout: float
+    ) -> list[UbusEvent]:
+        """Wait for an event matching data for every one of the values of the event's key field."""
+        outstanding = set(values)
+        matched: list[UbusEvent] = []
+
+        def have_events() -> list[UbusEvent] | bool:
+            while True:
+                try:
+                    event = self._events.get(block=False)
+                except queue.Empty:
+                    return False
+                event_data = event.data
+                if event_name not in event_data.keys():
+                    continue
+                if not isinstance(event_data[event_name], dict):
+                    continue
+                if not self._dict_contains_all(data, event_data[event_name]):
+                    continue
+                value = event_data[event_name].get(key)
+                if value in outstanding:
+                    outstanding.remove(value)
+                    matched.append(event)
+                if not outstanding:
+                    return matched
+        return self._waiter.wait_for(
+            have_events, timeout, interval=0.1, description=f"events: {event_name} with: {data} for all {key}"
+        )
+
+
+class UbusSubscriber(UbusListener):
+    """Receives the notifications sent by a ubus object, as UbusListener receives events."""
+    _object_name: str = ""
+
+    def _command(self) -> list[str]:
+        return ["subscribe", self._object_name]
+
+    def subscribe(self, object_name: str) -> None:
+        self._object_name = object_name
+        self.listen()
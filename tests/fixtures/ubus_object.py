@@ -0,0 +1,288 @@
+from __future__ import annotations
+import socket
+import struct
+import threading
+from dataclasses import dataclass
+from logging import Logger
+from threading import Thread
+from typing import Any, Callable
+
+from fixtures.ubus import Ubus
+
+# The ubus command line tool can't register an object, so objects that stand in
+# for other daemons (e.g. netifd) talk to ubusd directly over its socket.
+
+UBUS_STATUS_OK = 0
+UBUS_STATUS_METHOD_NOT_FOUND = 3
+
+_MSG_HELLO = 0
+_MSG_STATUS = 1
+_MSG_DATA = 2
+_MSG_INVOKE = 5
+_MSG_ADD_OBJECT = 6
+
+_ATTR_STATUS = 1
+_ATTR_OBJPATH = 2
+_ATTR_OBJID = 3
+_ATTR_METHOD = 4
+_ATTR_SIGNATURE = 6
+_ATTR_DATA = 7
+_ATTR_NO_REPLY = 10
+
+_BLOBMSG_TYPE_ARRAY = 1
+_BLOBMSG_TYPE_TABLE = 2
+_BLOBMSG_TYPE_STRING = 3
+_BLOBMSG_TYPE_INT64 = 4
+_BLOBMSG_TYPE_INT32 = 5
+_BLOBMSG_TYPE_INT16 = 6
+_BLOBMSG_TYPE_BOOL = 7
+
+_BLOB_ATTR_EXTENDED = 0x80000000
+_BLOB_ATTR_ID_SHIFT = 24
+_BLOB_ATTR_ID_MASK = 0x7F000000
+_BLOB_ATTR_LEN_MASK = 0x00FFFFFF
+
+_MSG_HEADER = struct.Struct(">BBHI")
+
+
+def _pad(length: int) -> int:
+    return (length + 3) & ~3
+
+
+def _blob_attr(attr_id: int, payload: bytes, extended: bool = False) -> bytes:
+    id_len = (attr_id << _BLOB_ATTR_ID_SHIFT) | (4 + len(payload))
+    if extended:
+        id_len |= _BLOB_ATTR_EXTENDED
+    attr = struct.pack(">I", id_len) + payload
+    return attr + bytes(_pad(len(attr)) - len(attr))
+
+
+def _blob_attrs(data: bytes) -> list[tuple[int, bool, bytes]]:
+    attrs = []
+    offset = 0
+    while offset + 4 <= len(data):
+        (id_len,) = struct.unpack_from(">I", data, offset)
+        length = id_len & _BLOB_ATTR_LEN_MASK
+        if length < 4 or offset + length > len(data):
+            break
+        attr_id = (id_len & _BLOB_ATTR_ID_MASK) >> _BLOB_ATTR_ID_SHIFT
+        attrs.append((attr_id, bool(id_len & _BLOB_ATTR_EXTENDED), data[offset + 4 : offset + length]))
+        offset += _pad(length)
+    return attrs
+
+
+def _blobmsg_attr(name: str, value: Any) -> bytes:
+    encoded_name = name.encode()
+    header = struct.pack(">H", len(encoded_name)) + encoded_name + b"\0"
+    header += bytes(_pad(len(header)) - len(header))
+    if isinstance(value, bool):
+        attr_type, payload = _BLOBMSG_TYPE_BOOL, bytes([value])
+    elif isinstance(value, int):
+        attr_type, payload = _BLOBMSG_TYPE_INT32, struct.pack(">I", value & 0xFFFFFFFF)
+    elif isinstance(value, str):
+        attr_type, payload = _BLOBMSG_TYPE_STRING, value.encode() + b"\0"
+    elif isinstance(value, dict):
+        attr_type, payload = _BLOBMSG_TYPE_TABLE, _blobmsg_table(value)
+    elif isinstance(value, list):
+        attr_type, payload = _BLOBMSG_TYPE_ARRAY, b"".join(_blobmsg_attr("", item) for item in value)
+    else:
+        raise TypeError(f"can't encode {value!r}")
+    return _blob_attr(attr_type, header + payload, extended=True)
+
+
+def _blobmsg_table(values: dict[str, Any]) -> bytes:
+    return b"".join(_blobmsg_attr(name, value) for name, value in values.items())
+
+
+def _blobmsg_decode(data: bytes, is_array: bool = False) -> dict[str, Any] | list[Any]:
+    values = []
+    for attr_type, _, payload in _blob_attrs(data):
+        (name_len,) = struct.unpack_from(">H", payload)
+        name = payload[2 : 2 + name_len].decode()
+        value = payload[_pad(2 + name_len + 1) :]
+        if attr_type == _BLOBMSG_TYPE_TABLE:
+            values.append((name, _blobmsg_decode(value)))
+        elif attr_type == _BLOBMSG_TYPE_ARRAY:
+            values.append((name, _blobmsg_decode(value, is_array=True)))
+        elif attr_type == _BLOBMSG_TYPE_STRING:
+            values.append((name, value.split(b"\0", 1)[0].decode()))
+        elif attr_type == _BLOBMSG_TYPE_INT64:
+            values.append((name, struct.unpack_from(">q", value)[0]))
+        elif attr_type == _BLOBMSG_TYPE_INT32:
+            values.append((name, struct.unpack_from(">i", value)[0]))
+        elif attr_type == _BLOBMSG_TYPE_INT16:
+            values.append((name, struct.unpack_from(">h", value)[0]))
+        elif attr_type == _BLOBMSG_TYPE_BOOL:
+            values.append((name, bool(value[0])))
+    return [value for _, value in values] if is_array else dict(values)
+
+
+# Returns the reply to a call, or None to leave the call unanswered.
+UbusMethodHandler = Callable[[dict[str, Any]], dict[str, Any] | None]
+
+
+@dataclass
+class UbusCall:
+    method: str
+    args: dict[str, Any]
+    seq: int
+    peer: int
+
+
+class UbusObject:
+    """
+    An object registered with ubusd whose methods are answered by handlers.
+    While held, calls are recorded but not answered until they are released,
+    so that a test can see how many calls arrive before any is answered.
+    Stopping removes the object from ubus.
+    """
+
+    _ubusd: Ubus
+    _log: Logger
+    _path: str
+    _methods: dict[str, UbusMethodHandler]
+    _socket: socket.socket | None = None
+    _read_thread: Thread | None = None
+    _lock: threading.Lock
+    _seq: int = 0
+    _id: int = 0
+    _held: bool = False
+    _pending: list[UbusCall]
+    calls: list[UbusCall]
+
+    def __init__(self, ubusd: Ubus, logger: Logger, path: str, methods: dict[str, UbusMethodHandler]) -> None:
+        self._ubusd = ubusd
+        self._log = logger
+        self._path = path
+        self._methods = methods
+        self._lock = threading.Lock()
+        self._pending = []
+        self.calls = []
+
+    def __enter__(self) -> UbusObject:
+        self.start()
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb) -> None:
+        self.stop()
+
+    @property
+    def id(self) -> int:
+        return self._id
+
+    def start(self) -> None:
+        self._socket = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self._socket.connect(self._ubusd.socket_path)
+        msg_type, _, _, _ = self._receive()
+        assert msg_type == _MSG_HELLO
+
+        self._seq += 1
+        signature = b"".join(_blobmsg_attr(method, {}) for method in self._methods)
+        self._send(
+            _MSG_ADD_OBJECT,
+            self._seq,
+            0,
+            _blob_attr(_ATTR_OBJPATH, self._path.encode() + b"\0") + _blob_attr(_ATTR_SIGNATURE, signature),
+        )
+        while True:
+            msg_type, seq, _, attrs = self._receive()
+            if seq != self._seq:
+                continue
+            if msg_type == _MSG_DATA and _ATTR_OBJID in attrs:
+                (self._id,) = struct.unpack(">I", attrs[_ATTR_OBJID])
+            elif msg_type == _MSG_STATUS:
+                (status,) = struct.unpack(">i", attrs[_ATTR_STATUS])
+                assert status == UBUS_STATUS_OK, f"can't add {self._path}: {status}"
+                break
+        self._log.info(f"added ubus object {self._path} ({self._id:#x})")
+
+        self._read_thread = Thread(target=self._read_calls, daemon=True)
+        self._read_thread.start()
+
+    def stop(self) -> None:
+        if self._socket is None:
+            return
+        # ubusd removes the object once the connection is closed.
+        self._socket.shutdown(socket.SHUT_RDWR)
+        if self._read_thread is not None:
+            self._read_thread.join()
+            self._read_thread = None
+        with self._lock:
+            self._socket.close()
+            self._socket = None
+            self._pending = []
+        self._log.info(f"removed ubus object {self._path}")
+
+    def hold(self) -> None:
+        self._held = True
+
+    def release(self) -> None:
+        with self._lock:
+            self._held = False
+            pending, self._pending = self._pending, []
+        for call in pending:
+            self._answer(call)
+
+    def calls_to(self, method: str) -> list[UbusCall]:
+        with self._lock:
+            return [call for call in self.calls if call.method == method]
+
+    def _send(self, msg_type: int, seq: int, peer: int, attrs: bytes) -> None:
+        self._socket.sendall(_MSG_HEADER.pack(0, msg_type, seq, peer) + _blob_attr(0, attrs))
+
+    def _receive_exactly(self, length: int) -> bytes:
+        data = b""
+        while len(data) < length:
+            chunk = self._socket.recv(length - len(data))
+            if not chunk:
+                raise ConnectionError("ubusd closed the connection")
+            data += chunk
+        return data
+
+    def _receive(self) -> (int, int, int, dict[int, bytes]):
+        _, msg_type, seq, peer = _MSG_HEADER.unpack(self._receive_exactly(_MSG_HEADER.size))
+        (id_len,) = struct.unpack(">I", self._receive_exactly(4))
+        data = self._receive_exactly((id_len & _BLOB_ATTR_LEN_MASK) - 4)
+        return msg_type, seq, peer, {attr_id: payload for attr_id, _, payload in _blob_attrs(data)}
+
+    def _read_calls(self) -> None:
+        while True:
+            try:
+                msg_type, seq, peer, attrs = self._receive()
+            except (ConnectionError, OSError):
+                return
+            if msg_type != _MSG_INVOKE:
+                continue
+            call = UbusCall(
+                method=attrs[_ATTR_METHOD].split(b"\0", 1)[0].decode(),
+                args=_blobmsg_decode(attrs.get(_ATTR_DATA, b"")),
+                seq=seq,
+                peer=peer,
+            )
+            # A call that doesn't want a reply is only recorded.
+            wants_reply = not attrs.get(_ATTR_NO_REPLY, b"\0")[0]
+            with self._lock:
+                self.calls.append(call)
+                if wants_reply and self._held:
+                    self._pending.append(call)
+                    continue
+            if wants_reply:
+                self._answer(call)
+
+    def _answer(self, call: UbusCall) -> None:
+        handler = self._methods.get(call.method)
+        reply = handler(call.args) if handler is not None else None
+        if handler is not None and reply is None:
+            return
+
+        object_id = _blob_attr(_ATTR_OBJID, struct.pack(">I", self._id))
+        status = UBUS_STATUS_OK if handler is not None else UBUS_STATUS_METHOD_NOT_FOUND
+        with self._lock:
+            # Stopped before the call was answered.
+            if self._socket is None:
+                return
+            if reply:
+                self._send(_MSG_DATA, call.seq, call.peer, object_id + _blob_attr(_ATTR_DATA, _blobmsg_table(reply)))
+            self._send(
+                _MSG_STATUS, call.seq, call.peer, _blob_attr(_ATTR_STATUS, struct.pack(">i", status)) + object_id
+            )
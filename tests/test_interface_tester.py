@@ -1,9 +1,22 @@
+import dataclasses
+import errno
+import json
+import os
+import socket
+import subprocess
 import time
+from logging import Logger
+from pathlib import Path
+from typing import Any
+
+import pytest
 
 from _pytest.config import Config
 from fixtures.interface_tester import InterfaceTester, IfaceTesterInterfaceConfig, \
     IfaceTesterTestConfig, IfaceTesterConfig, SuccessCondition
-from fixtures.ubus import UbusListener, Ubus
+from fixtures.ubus import UbusListener, UbusSubscriber, Ubus
+from fixtures.ubus_object import UbusObject
+from fixtures.waiter import TimeoutException, Waiter
 
 
 def test_interface_tester_up_down_events(ubus_listener: UbusListener, interface_tester: InterfaceTester) -> None:
@@ -235,3 +248,995 @@ def test_interface_tester_one_test_must_pass_all_tests_fail_fails_test_run(
         {"result": "fail", "interface": interface_name},
         max_seconds_to_wait,
     )
+
+
+def _processes_with_cmdline(cmdline: list[str]) -> list[int]:
+    pids = []
+    for pid in os.listdir("/proc"):
+        if not pid.isdigit():
+            continue
+        try:
+            with open(f"/proc/{pid}/cmdline", "rb") as f:
+                args = f.read().decode(errors="replace").split("\0")[:-1]
+        except OSError:
+            continue
+        if args == cmdline:
+            pids.append(int(pid))
+    return pids
+
+
+def test_interface_tester_timed_out_tests_leave_no_child_processes(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    num_interfaces = 250
+    # An unusual sleep time so that the test's children can be identified.
+    sleep_secs = 97
+    response_timeout_secs = 2
+    interface_names = {f"stress{i}" for i in range(num_interfaces)}
+    configs = [
+        IfaceTesterInterfaceConfig(
+            name=interface_name,
+            config=IfaceTesterConfig(
+                response_timeout_secs=response_timeout_secs,
+                # Ensure that no further test runs start before the check for leftover children.
+                failing_interval_secs=600,
+                tests=[
+                    IfaceTesterTestConfig(
+                        executable="forking_test",
+                        label="test with a child that takes too long",
+                        params={"sleep": sleep_secs},
+                    )
+                ],
+            ),
+        )
+        for interface_name in interface_names
+    ]
+    interface_tester.load_config(configs)
+
+    for interface_name in interface_names:
+        ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_events(
+        "interface.tester.test_run", {"result": "fail"}, "interface", interface_names, 60
+    )
+
+    leftover_children = _processes_with_cmdline(["sleep", str(sleep_secs)])
+    assert not leftover_children, f"children of timed out tests were left running: {leftover_children}"
+
+
+def test_interface_tester_parallel_tests_end_test_run_on_first_failure(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    interface_name = "wan"
+    # An unusual sleep time so that the slow test's children can be identified.
+    sleep_secs = 93
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterInterfaceConfig(
+        name=interface_name,
+        config=IfaceTesterConfig(
+            parallel_tests=True,
+            response_timeout_secs=30,
+            failing_interval_secs=600,
+            tests=[
+                IfaceTesterTestConfig(
+                    executable="forking_test", label="Slow test", params={"sleep": sleep_secs}
+                ),
+                IfaceTesterTestConfig(executable="failing_test", label="Failing test"),
+            ],
+        ),
+    )
+    interface_tester.load_config([config])
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    # The failing test decides the test run long before the slow test would time out.
+    ubus_listener.wait_for_event(
+        "interface.tester.test_run", {"result": "fail", "interface": interface_name}, 10
+    )
+
+    leftover_children = _processes_with_cmdline(["sleep", str(sleep_secs)])
+    assert not leftover_children, f"the slow test was left running: {leftover_children}"
+
+
+def test_interface_tester_parallel_test_results_are_not_lost(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    interface_name = "wan"
+    num_tests = 8
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterInterfaceConfig(
+        name=interface_name,
+        config=IfaceTesterConfig(
+            parallel_tests=True,
+            tests=[
+                IfaceTesterTestConfig(executable="passing_test", label=f"Passing test {i}")
+                for i in range(num_tests)
+            ],
+        ),
+    )
+    interface_tester.load_config([config])
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    # The run only passes once the result of every test has been handled.
+    ubus_listener.wait_for_event(
+        "interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10
+    )
+
+    state = ubusd.call(f"interface.tester.interface.{interface_name}", "state")
+    event_queue = state["state"]["tester"]["event_queue"]
+    assert event_queue["dropped"] == 0
+    assert event_queue["handled"] >= num_tests
+
+
+def test_interface_tester_process_limit_serialises_tests(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"),
+        pytestconfig.getoption("tests"),
+        pytestconfig.getoption("tasks"),
+        extra_args=["-j", "1"],
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    num_interfaces = 3
+    test_secs = 2
+    interface_names = {f"limited{i}" for i in range(num_interfaces)}
+    configs = [
+        IfaceTesterInterfaceConfig(
+            name=interface_name,
+            config=IfaceTesterConfig(
+                tests=[
+                    IfaceTesterTestConfig(executable="forking_test", label="Slow test", params={"sleep": test_secs})
+                ]
+            ),
+        )
+        for interface_name in interface_names
+    ]
+    interface_tester.load_config(configs)
+
+    start = time.monotonic()
+    for interface_name in interface_names:
+        ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_events(
+        "interface.tester.test_run", {"result": "pass"}, "interface", interface_names, 30
+    )
+
+    # With only one test allowed to run at a time the tests can't overlap.
+    assert time.monotonic() - start >= num_interfaces * test_secs
+
+
+def test_interface_tester_phase_spreading_staggers_first_test_runs(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"),
+        pytestconfig.getoption("tests"),
+        pytestconfig.getoption("tasks"),
+        extra_args=["-P"],
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    interface_names = ["spread0", "spread1"]
+    configs = [
+        IfaceTesterInterfaceConfig(
+            name=interface_name,
+            config=IfaceTesterConfig(
+                tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")],
+                passing_interval_secs=4,
+            ),
+        )
+        for interface_name in interface_names
+    ]
+    interface_tester.load_config(configs)
+
+    for interface_name in interface_names:
+        ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass"}, 10)
+    first_run = time.monotonic()
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass"}, 10)
+
+    # The second interface to settle waits about 0.62 of the interval.
+    assert time.monotonic() - first_run >= 2
+
+
+def test_interface_tester_captures_test_output(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"),
+        pytestconfig.getoption("tests"),
+        pytestconfig.getoption("tasks"),
+        extra_args=["-O", "4096"],
+    )
+    interface_name = "wan"
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterInterfaceConfig(
+        name=interface_name,
+        config=IfaceTesterConfig(
+            tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")]
+        ),
+    )
+    interface_tester.load_config([config])
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event(
+        "interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10
+    )
+
+    output = ubusd.call(f"interface.tester.interface.{interface_name}", "last_output")
+    assert output["buffer_size"] == 4096
+    assert output["truncated_bytes"] == 0
+    assert "--- test 0: Passing test" in output["output"]
+    assert "passing_test on wan: passed" in output["output"]
+
+
+def test_interface_tester_trace_shows_state_transitions(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    interface_name = "wan"
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterInterfaceConfig(
+        name=interface_name,
+        config=IfaceTesterConfig(
+            tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")]
+        ),
+    )
+    interface_tester.load_config([config])
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event(
+        "interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10
+    )
+
+    trace = ubusd.call("interface.tester", "trace")
+    events = trace["traceEvents"]
+    track_names = {e["tid"]: e["args"]["name"] for e in events if e["name"] == "thread_name"}
+    spans = [e for e in events if e["ph"] == "X"]
+    testing = [s for s in spans if s["cat"] == "tester" and s["name"] == "testing"]
+    assert len(testing) == 1
+    assert track_names[testing[0]["tid"]] == "wan tester"
+    assert testing[0]["args"] == {"from": "stopped", "event": "connection settled"}
+    assert any(s["cat"] == "connection" and s["name"] == "connected" for s in spans)
+
+    # Only the most recent transition, and then nothing newer than it.
+    latest = ubusd.call("interface.tester", "trace", {"limit": 1})
+    assert len([e for e in latest["traceEvents"] if e["ph"] == "X"]) == 1
+    assert latest["otherData"]["next"] == latest["otherData"]["transitions_recorded"]
+    newer = ubusd.call("interface.tester", "trace", {"since": latest["otherData"]["next"]})
+    assert not [e for e in newer["traceEvents"] if e["ph"] == "X"]
+
+
+def test_interface_tester_missing_executable_is_reported_and_fails(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    interface_name = "wan"
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterInterfaceConfig(
+        name=interface_name,
+        config=IfaceTesterConfig(
+            tests=[IfaceTesterTestConfig(executable="no_such_test", label="Missing test")]
+        ),
+    )
+    interface_tester.load_config([config])
+
+    state = ubusd.call(f"interface.tester.interface.{interface_name}", "state")
+    test = state["config"]["tests"][0]
+    assert not test["executable_resolved"]
+    assert test["executable_error"] == os.strerror(errno.ENOENT)
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event(
+        "interface.tester.test_run", {"result": "fail", "interface": interface_name}, 10
+    )
+
+
+def test_interface_tester_records_test_resource_usage(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    interface_name = "wan"
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterInterfaceConfig(
+        name=interface_name,
+        config=IfaceTesterConfig(
+            tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test", params={"sleep": 1.5})]
+        ),
+    )
+    interface_tester.load_config([config])
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event(
+        "interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10
+    )
+
+    state = ubusd.call(f"interface.tester.interface.{interface_name}", "state")
+    executions = state["state"]["tester"]["stats"]["test_executions"]
+    assert len(executions) == 1
+    assert executions[0]["executions"] == 1
+    assert executions[0]["max_wall_msecs"] >= 1500
+    assert executions[0]["max_rss_kb"] > 0
+    assert executions[0]["wall_msecs_histogram"] == {"lt_2048": 1}
+
+
+def _ping_sockets_permitted() -> bool:
+    try:
+        socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_ICMP).close()
+    except OSError:
+        return False
+    return True
+
+
+@pytest.mark.skipif(not _ping_sockets_permitted(), reason="ping sockets aren't permitted (net.ipv4.ping_group_range)")
+def test_interface_tester_icmp_tests(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    configs = [
+        IfaceTesterInterfaceConfig(
+            name="reachable",
+            config=IfaceTesterConfig(
+                tests=[
+                    IfaceTesterTestConfig(
+                        type="icmp", executable="", label="ping loopback", params={"hostname": "127.0.0.1"}
+                    )
+                ]
+            ),
+        ),
+        IfaceTesterInterfaceConfig(
+            name="unreachable",
+            config=IfaceTesterConfig(
+                tests=[
+                    IfaceTesterTestConfig(
+                        type="icmp",
+                        executable="",
+                        label="ping TEST-NET-1 via loopback",
+                        params={"hostname": "192.0.2.1", "count": "2", "device": "lo"},
+                    )
+                ]
+            ),
+        ),
+    ]
+    interface_tester.load_config(configs)
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": "reachable", "device": "lo"})
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": "unreachable"})
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass", "interface": "reachable"}, 10)
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "fail", "interface": "unreachable"}, 10)
+
+
+def test_interface_tester_interval_change_does_not_restart_tester(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    interface_name = "wan"
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterInterfaceConfig(
+        name=interface_name,
+        config=IfaceTesterConfig(
+            tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")],
+            passing_interval_secs=600,
+        ),
+    )
+    interface_tester.load_config([config])
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event(
+        "interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10
+    )
+
+    config.config.passing_interval_secs = 3
+    reconfigured = time.monotonic()
+    interface_tester.load_config([config])
+    ubus_listener.wait_for_event(
+        "interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10
+    )
+
+    # The interval timer is re-armed rather than the tester being restarted,
+    # which would have started a test run straight away.
+    assert time.monotonic() - reconfigured >= 2
+
+
+def test_interface_tester_lowering_pass_threshold_below_passes_makes_interface_operational(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    interface_name = "wan"
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterInterfaceConfig(
+        name=interface_name,
+        config=IfaceTesterConfig(
+            tests=[IfaceTesterTestConfig(executable="failing_test", label="Failing test")],
+            passing_interval_secs=600,
+            failing_interval_secs=600,
+            pass_threshold=5,
+        ),
+    )
+    interface_tester.load_config([config])
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event(
+        "interface.tester.operational", {"is_operational": False, "interface": interface_name}, 10
+    )
+
+    # Four passes aren't enough to reach the pass threshold of five.
+    config.config.tests = [IfaceTesterTestConfig(executable="passing_test", label="Passing test")]
+    interface_tester.load_config([config])
+    for _ in range(4):
+        ubusd.call("interface.tester", "start_test_run", {"interface": interface_name})
+        ubus_listener.wait_for_event(
+            "interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10
+        )
+    state = ubusd.call(f"interface.tester.interface.{interface_name}", "state")["state"]["tester"]
+    assert state["operational_state"] == "broken"
+
+    config.config.pass_threshold = 3
+    interface_tester.load_config([config])
+    ubus_listener.wait_for_event(
+        "interface.tester.operational", {"is_operational": True, "interface": interface_name}, 1
+    )
+
+
+def _interface_exists(ubusd: Ubus, interface_name: str) -> bool:
+    try:
+        ubusd.call(f"interface.tester.interface.{interface_name}", "state")
+    except subprocess.CalledProcessError:
+        return False
+    return True
+
+
+def test_interface_tester_loads_configuration_fragments_as_they_are_written(
+    interface_tester: InterfaceTester,
+    pytestconfig: Config,
+    ubus_listener: UbusListener,
+    ubusd: Ubus,
+    waiter: Waiter,
+    tmp_path: Path,
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"),
+        pytestconfig.getoption("tests"),
+        pytestconfig.getoption("tasks"),
+        extra_args=["-d", str(tmp_path)],
+    )
+    interface_name = "wan"
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterConfig(
+        tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")]
+    )
+    fragment = tmp_path / f"{interface_name}.json"
+    fragment.write_text(json.dumps({"interfaces": {interface_name: dataclasses.asdict(config)}}))
+
+    # The fragment is loaded without being asked for.
+    waiter.wait_for(lambda: _interface_exists(ubusd, interface_name), 5, 0.1, "the interface to be configured")
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event(
+        "interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10
+    )
+
+    fragment.unlink()
+    waiter.wait_for(lambda: not _interface_exists(ubusd, interface_name), 5, 0.1, "the interface to be removed")
+
+
+def _passing_interval_secs(ubusd: Ubus, interface_name: str) -> int | None:
+    try:
+        return ubusd.call("interface.tester", "config_get", {"interface": interface_name})[
+            "passing_interval_secs"
+        ]
+    except subprocess.CalledProcessError:
+        return None
+
+
+def _start_with_file_and_fragments(
+    interface_tester: InterfaceTester,
+    pytestconfig: Config,
+    ubus_listener: UbusListener,
+    tmp_path: Path,
+    interface_name: str,
+    passing_interval_secs: int,
+) -> tuple[Path, Path]:
+    config_file = tmp_path / "etc" / "interface_tester.json"
+    fragment_dir = tmp_path / "fragments"
+    config_file.parent.mkdir()
+    fragment_dir.mkdir()
+    _write_interface_config(config_file, interface_name, passing_interval_secs)
+    ubus_listener.listen()
+    interface_tester.start(
+        str(config_file),
+        pytestconfig.getoption("tests"),
+        pytestconfig.getoption("tasks"),
+        extra_args=["-d", str(fragment_dir)],
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    return config_file, fragment_dir / f"{interface_name}.json"
+
+
+def _write_interface_config(path: Path, interface_name: str, passing_interval_secs: int) -> None:
+    config = IfaceTesterConfig(
+        tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")],
+        passing_interval_secs=passing_interval_secs,
+    )
+    path.write_text(json.dumps({"interfaces": {interface_name: dataclasses.asdict(config)}}))
+
+
+def test_interface_tester_falls_back_to_the_file_when_an_overriding_fragment_is_deleted(
+    interface_tester: InterfaceTester,
+    pytestconfig: Config,
+    ubus_listener: UbusListener,
+    ubusd: Ubus,
+    waiter: Waiter,
+    tmp_path: Path,
+) -> None:
+    interface_name = "wan"
+    _, fragment = _start_with_file_and_fragments(
+        interface_tester, pytestconfig, ubus_listener, tmp_path, interface_name, 600
+    )
+    waiter.wait_for(
+        lambda: _passing_interval_secs(ubusd, interface_name) == 600, 5, 0.1, "the file to be loaded"
+    )
+
+    _write_interface_config(fragment, interface_name, 700)
+    waiter.wait_for(
+        lambda: _passing_interval_secs(ubusd, interface_name) == 700, 5, 0.1, "the fragment to override the file"
+    )
+
+    # The file still defines the interface, so it isn't removed.
+    fragment.unlink()
+    waiter.wait_for(
+        lambda: _passing_interval_secs(ubusd, interface_name) == 600, 5, 0.1, "the file's definition to be restored"
+    )
+
+
+def test_interface_tester_file_changes_dont_replace_an_overriding_fragment(
+    interface_tester: InterfaceTester,
+    pytestconfig: Config,
+    ubus_listener: UbusListener,
+    ubusd: Ubus,
+    waiter: Waiter,
+    tmp_path: Path,
+) -> None:
+    interface_name = "wan"
+    config_file, fragment = _start_with_file_and_fragments(
+        interface_tester, pytestconfig, ubus_listener, tmp_path, interface_name, 600
+    )
+    _write_interface_config(fragment, interface_name, 700)
+    waiter.wait_for(
+        lambda: _passing_interval_secs(ubusd, interface_name) == 700, 5, 0.1, "the fragment to override the file"
+    )
+
+    _write_interface_config(config_file, interface_name, 800)
+    # Give the watcher time to load the file before checking that it changed nothing.
+    time.sleep(2)
+    assert _passing_interval_secs(ubusd, interface_name) == 700
+
+    # The file's new definition is used once the fragment no longer overrides it.
+    fragment.unlink()
+    waiter.wait_for(
+        lambda: _passing_interval_secs(ubusd, interface_name) == 800, 5, 0.1, "the file's new definition to be used"
+    )
+
+
+def test_interface_tester_configuration_loads_from_cache_after_restart(
+    interface_tester: InterfaceTester,
+    pytestconfig: Config,
+    ubus_listener: UbusListener,
+    ubusd: Ubus,
+    waiter: Waiter,
+    tmp_path: Path,
+) -> None:
+    interface_name = "wan"
+    config = IfaceTesterConfig(
+        tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")]
+    )
+    config_file = tmp_path / "interface_tester.json"
+    config_file.write_text(json.dumps({"interfaces": {interface_name: dataclasses.asdict(config)}}))
+    cache_file = tmp_path / "interface_tester.json.cache"
+
+    interface_tester.start(
+        str(config_file), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    waiter.wait_for(cache_file.exists, 5, 0.1, "the configuration to be cached")
+    cached = cache_file.stat()
+
+    # The second time around the configuration comes from the cache.
+    ubus_listener.listen()
+    interface_tester.start(
+        str(config_file), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event(
+        "interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10
+    )
+
+    # Parsing the JSON again would have replaced the cache with a new file.
+    reloaded = cache_file.stat()
+    assert (reloaded.st_ino, reloaded.st_mtime_ns) == (cached.st_ino, cached.st_mtime_ns)
+
+
+def test_interface_tester_interfaces_take_parameters_from_profile(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    profile = IfaceTesterConfig(
+        tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")]
+    )
+    ubusd.call(
+        "interface.tester",
+        "config",
+        {
+            "profiles": {"tunnel": dataclasses.asdict(profile)},
+            "interfaces": {
+                "tun0": {"profile": "tunnel"},
+                # The interface's own tests take precedence over the profile's.
+                "tun1": {
+                    "profile": "tunnel",
+                    "tests": [{"executable": "failing_test", "label": "Failing test"}],
+                },
+            },
+        },
+    )
+
+    for interface_name in ("tun0", "tun1"):
+        ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass", "interface": "tun0"}, 10)
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "fail", "interface": "tun1"}, 10)
+
+
+def test_interface_tester_config_set_and_delete_affect_only_one_interface(
+    interface_tester: InterfaceTester,
+    pytestconfig: Config,
+    ubus_listener: UbusListener,
+    ubusd: Ubus,
+    waiter: Waiter,
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterConfig(
+        tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")],
+        passing_interval_secs=600,
+    )
+    interface_tester.load_config([IfaceTesterInterfaceConfig(name="wan", config=config)])
+
+    ubusd.call("interface.tester", "config_set", {"interface": "lan", "config": dataclasses.asdict(config)})
+    assert ubusd.call("interface.tester", "config_get", {"interface": "lan"})["passing_interval_secs"] == 600
+
+    ubusd.call("interface.tester", "config_delete", {"interface": "lan"})
+    waiter.wait_for(lambda: not _interface_exists(ubusd, "lan"), 5, 0.1, "the interface to be removed")
+    assert _interface_exists(ubusd, "wan")
+
+    result = ubusd.call(
+        "interface.tester",
+        "config_bulk",
+        {"delete": ["lan"], "set": {"lan": dataclasses.asdict(config)}},
+    )
+    # lan had already been deleted.
+    assert result["failed"] == ["lan"]
+    assert _interface_exists(ubusd, "lan")
+    assert _interface_exists(ubusd, "wan")
+
+
+def test_interface_tester_interfaces_start_disconnected_without_netifd(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterConfig(tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")])
+    interface_names = [f"wan{i}" for i in range(20)]
+    interface_tester.load_config(
+        [IfaceTesterInterfaceConfig(name=interface_name, config=config) for interface_name in interface_names]
+    )
+
+    # There is no netifd to ask, so the interfaces wait for interface events.
+    for interface_name in interface_names:
+        state = ubusd.call(f"interface.tester.interface.{interface_name}", "state")["state"]["interface"]
+        assert state["state"] == "disconnected"
+        assert not state["state_discovery_pending"]
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": "wan0"})
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass", "interface": "wan0"}, 10)
+
+
+def _netifd_status(args: dict[str, Any]) -> dict[str, Any]:
+    # Every interface is up.
+    return {"up": True, "l3_device": f"dev-{args['interface']}"}
+
+
+def _interface_connection_state(ubusd: Ubus, interface_name: str) -> dict[str, Any]:
+    return ubusd.call(f"interface.tester.interface.{interface_name}", "state")["state"]["interface"]
+
+
+def _interface_is_connected(ubusd: Ubus, interface_name: str) -> bool:
+    return _interface_connection_state(ubusd, interface_name)["connected"] == "yes"
+
+
+def test_interface_tester_follows_netifd_to_its_new_object(
+    interface_tester: InterfaceTester,
+    pytestconfig: Config,
+    ubus_listener: UbusListener,
+    ubusd: Ubus,
+    waiter: Waiter,
+    logger: Logger,
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterConfig(tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")])
+
+    with UbusObject(ubusd, logger, "network.interface", {"status": _netifd_status}) as netifd:
+        interface_tester.load_config([IfaceTesterInterfaceConfig(name="wan0", config=config)])
+        waiter.wait_for(lambda: _interface_is_connected(ubusd, "wan0"), 5, 0.1, "wan0 to be connected")
+        old_id = netifd.id
+
+    # netifd restarts, and its object comes back with a new id.
+    with UbusObject(ubusd, logger, "network.interface", {"status": _netifd_status}) as netifd:
+        assert netifd.id != old_id
+        ubusd.call("interface.tester", "config_set", {"interface": "wan1", "config": dataclasses.asdict(config)})
+        waiter.wait_for(lambda: _interface_is_connected(ubusd, "wan1"), 5, 0.1, "wan1 to be connected")
+        # The state was asked for from the new object, not the one that was removed.
+        assert [call.args["interface"] for call in netifd.calls_to("status")] == ["wan1"]
+
+
+def test_interface_tester_interfaces_take_their_state_from_netifd(
+    interface_tester: InterfaceTester,
+    pytestconfig: Config,
+    ubus_listener: UbusListener,
+    ubusd: Ubus,
+    waiter: Waiter,
+    logger: Logger,
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterConfig(tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")])
+    interface_names = [f"wan{i}" for i in range(20)]
+
+    with UbusObject(ubusd, logger, "network.interface", {"status": _netifd_status}) as netifd:
+        netifd.hold()
+        interface_tester.load_config(
+            [IfaceTesterInterfaceConfig(name=interface_name, config=config) for interface_name in interface_names]
+        )
+
+        # Every interface asks before any of them has been answered.
+        waiter.wait_for(
+            lambda: len(netifd.calls_to("status")) == len(interface_names),
+            5,
+            0.1,
+            "the state of every interface to be requested",
+        )
+        assert sorted(call.args["interface"] for call in netifd.calls_to("status")) == sorted(interface_names)
+        assert _interface_connection_state(ubusd, "wan0")["state_discovery_pending"]
+
+        # No interface.state events are needed.
+        netifd.release()
+        for interface_name in interface_names:
+            waiter.wait_for(
+                lambda: _interface_is_connected(ubusd, interface_name), 5, 0.1, f"{interface_name} to be connected"
+            )
+            state = _interface_connection_state(ubusd, interface_name)
+            assert state["device"] == f"dev-{interface_name}"
+            assert not state["state_discovery_pending"]
+        ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass", "interface": "wan0"}, 10)
+
+
+def test_interface_tester_stops_waiting_for_netifd_after_5_seconds(
+    interface_tester: InterfaceTester,
+    pytestconfig: Config,
+    ubus_listener: UbusListener,
+    ubusd: Ubus,
+    waiter: Waiter,
+    logger: Logger,
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterConfig(tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")])
+
+    with UbusObject(ubusd, logger, "network.interface", {"status": _netifd_status}) as netifd:
+        # netifd never answers.
+        netifd.hold()
+        requested = time.monotonic()
+        interface_tester.load_config([IfaceTesterInterfaceConfig(name="wan", config=config)])
+        waiter.wait_for(lambda: netifd.calls_to("status"), 5, 0.1, "the state to be requested")
+        assert _interface_connection_state(ubusd, "wan")["state_discovery_pending"]
+
+        waiter.wait_for(
+            lambda: not _interface_connection_state(ubusd, "wan")["state_discovery_pending"],
+            10,
+            0.1,
+            "the state request to time out",
+        )
+        assert time.monotonic() - requested >= 4.5
+        assert _interface_connection_state(ubusd, "wan")["state"] == "disconnected"
+
+        # Interface events still work.
+        ubusd.send_event("interface.state", {"state": "ifup", "interface": "wan"})
+        ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass", "interface": "wan"}, 10)
+
+
+def test_interface_tester_main_object_serves_interfaces_without_their_own_objects(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"),
+        pytestconfig.getoption("tests"),
+        pytestconfig.getoption("tasks"),
+        extra_args=["-N"],
+    )
+    interface_name = "wan"
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterInterfaceConfig(
+        name=interface_name,
+        config=IfaceTesterConfig(
+            tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")],
+            passing_interval_secs=600,
+        ),
+    )
+    interface_tester.load_config([config])
+
+    with pytest.raises(subprocess.CalledProcessError):
+        ubusd.call(f"interface.tester.interface.{interface_name}", "state")
+    with pytest.raises(subprocess.CalledProcessError):
+        ubusd.call("interface.tester", "state", {"interface": "lan"})
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": interface_name})
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10)
+
+    # The interval is long, so this test run is the one that was asked for.
+    ubusd.call("interface.tester", "start_test_run", {"interface": interface_name})
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass", "interface": interface_name}, 10)
+
+    state = ubusd.call("interface.tester", "state", {"interface": interface_name})
+    assert state["state"]["interface"]["state"] == "connected"
+
+
+def test_interface_tester_state_since_returns_only_changed_interfaces(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, ubusd: Ubus
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterConfig(
+        tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")],
+        passing_interval_secs=600,
+    )
+    interface_tester.load_config(
+        [IfaceTesterInterfaceConfig(name=interface_name, config=config) for interface_name in ["wan", "lan"]]
+    )
+
+    states = ubusd.call("interface.tester", "state", {"since": 0})
+    assert set(states["interfaces"].keys()) == {"wan", "lan"}
+    generation = states["generation"]
+    assert ubusd.call("interface.tester", "state", {"since": generation})["interfaces"] == {}
+
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": "wan"})
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass", "interface": "wan"}, 10)
+
+    states = ubusd.call("interface.tester", "state", {"since": generation})
+    assert set(states["interfaces"].keys()) == {"wan"}
+    assert states["interfaces"]["wan"]["generation"] > generation
+    assert states["membership_generation"] <= generation
+
+
+def test_interface_tester_notifies_subscribers_of_state_changes(
+    interface_tester: InterfaceTester,
+    pytestconfig: Config,
+    ubus_listener: UbusListener,
+    ubus_subscriber: UbusSubscriber,
+    ubusd: Ubus,
+    logger: Logger,
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"), pytestconfig.getoption("tests"), pytestconfig.getoption("tasks")
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    config = IfaceTesterConfig(
+        tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")],
+        passing_interval_secs=600,
+    )
+    interface_tester.load_config(
+        [IfaceTesterInterfaceConfig(name=interface_name, config=config) for interface_name in ["wan", "lan"]]
+    )
+    # Only the notifications about wan are sent to the subscribers of its object.
+    ubus_subscriber.subscribe("interface.tester.interface.wan")
+    time.sleep(0.5)
+
+    start_time = time.perf_counter()
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": "lan"})
+    ubusd.send_event("interface.state", {"state": "ifup", "interface": "wan"})
+    connected = ubus_subscriber.wait_for_event("connection", {"interface": "wan", "state": "settling"}, 5)
+    test_run = ubus_subscriber.wait_for_event("test_run", {"interface": "wan", "result": "pass"}, 10)
+    assert test_run.data["test_run"]["consecutive_passes"] == 1
+
+    latency = connected.timestamp - start_time
+    logger.info(f"connection notification latency: {latency * 1000:.1f} msecs")
+    assert latency < 1, f"took {latency:.3f} seconds to be notified of the connection"
+
+    ubus_listener.wait_for_event("interface.tester.test_run", {"result": "pass", "interface": "lan"}, 10)
+    with pytest.raises(TimeoutException):
+        ubus_subscriber.wait_for_event("connection", {"interface": "lan"}, 1)
+
+
+def test_interface_tester_batches_events(
+    interface_tester: InterfaceTester, pytestconfig: Config, ubus_listener: UbusListener, logger: Logger
+) -> None:
+    ubus_listener.listen()
+    interface_tester.start(
+        pytestconfig.getoption("config"),
+        pytestconfig.getoption("tests"),
+        pytestconfig.getoption("tasks"),
+        extra_args=["-b", "200"],
+    )
+    ubus_listener.wait_for_event("interface.tester", {"state": "up"}, 5)
+    interface_names = {f"tun{i}" for i in range(20)}
+    config = IfaceTesterConfig(tests=[IfaceTesterTestConfig(executable="passing_test", label="Passing test")])
+    # Each interface starts out operational.
+    interface_tester.load_config(
+        [IfaceTesterInterfaceConfig(name=interface_name, config=config) for interface_name in interface_names]
+    )
+
+    outstanding = set(interface_names)
+    batches = 0
+    while outstanding:
+        batch = ubus_listener.wait_for_event("interface.tester.batch", {}, 5)
+        batches += 1
+        for event in batch.data["interface.tester.batch"]["events"]:
+            assert event["interface.tester.operational"]["is_operational"]
+            outstanding.discard(event["interface.tester.operational"]["interface"])
+
+    logger.info(f"{len(interface_names)} operational events sent in {batches} ubus messages")
+    assert batches < len(interface_names) / 4